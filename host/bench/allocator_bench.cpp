@@ -0,0 +1,118 @@
+#include "../shim/hostshim.h"
+
+#include <memory/buddy.h>
+#include <memory/slab.h>
+#include <memory/vmm.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    struct Benchmark
+    {
+        const char* name;
+        void (*body)(uint64_t iterations);
+    };
+
+    void buddyOrder0(const uint64_t iterations)
+    {
+        for (uint64_t i = 0; i < iterations; ++i) BuddyAllocator::free(BuddyAllocator::alloc(0), 0);
+    }
+
+    void buddyOrder4(const uint64_t iterations)
+    {
+        for (uint64_t i = 0; i < iterations; ++i) BuddyAllocator::free(BuddyAllocator::alloc(4), 4);
+    }
+
+    void buddyBatch64(const uint64_t iterations)
+    {
+        uint64_t pages[64];
+        for (uint64_t i = 0; i < iterations; i += 64)
+        {
+            for (uint64_t& page : pages) page = BuddyAllocator::alloc(0);
+            for (const uint64_t page : pages) BuddyAllocator::free(page, 0);
+        }
+    }
+
+    void slab64(const uint64_t iterations)
+    {
+        for (uint64_t i = 0; i < iterations; ++i) SlabAllocator::free(SlabAllocator::alloc(64));
+    }
+
+    void slab1024(const uint64_t iterations)
+    {
+        for (uint64_t i = 0; i < iterations; ++i) SlabAllocator::free(SlabAllocator::alloc(1024));
+    }
+
+    void vmmAllocate(const uint64_t iterations)
+    {
+        for (uint64_t i = 0; i < iterations; ++i)
+            VMM::unmap(VMM::allocate(FrameAllocator::SMALL_SIZE, VMM::RegionType::ANONYMOUS, PageFlags::RW));
+    }
+
+    double runThreads(const Benchmark& benchmark, const unsigned threadCount, const uint64_t iterations)
+    {
+        std::atomic<unsigned> ready = 0;
+        std::atomic<bool> go = false;
+        std::vector<std::thread> threads;
+
+        for (unsigned t = 0; t < threadCount; ++t)
+            threads.emplace_back([&]
+            {
+                ++ready;
+                while (!go.load(std::memory_order_acquire)) std::this_thread::yield();
+                benchmark.body(iterations);
+            });
+
+        while (ready.load() < threadCount) std::this_thread::yield();
+        const auto start = Clock::now();
+        go.store(true, std::memory_order_release);
+        for (auto& thread : threads) thread.join();
+
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    void report(const Benchmark& benchmark, const unsigned threadCount)
+    {
+        uint64_t iterations = 64;
+        double seconds = runThreads(benchmark, threadCount, iterations);
+        while (seconds < 0.2 && iterations < (1ULL << 30))
+        {
+            iterations *= seconds > 0.02 ? 2 : 8;
+            seconds = runThreads(benchmark, threadCount, iterations);
+        }
+
+        const double operations = static_cast<double>(iterations) * threadCount;
+        std::printf("%-28s/threads:%-2u %12.1f ns/op %14.0f ops/s %12lu iterations\n", benchmark.name, threadCount,
+                    seconds * 1e9 * threadCount / operations, operations / seconds, iterations);
+    }
+
+    const Benchmark benchmarks[] = {
+        {"BM_BuddyAllocFreeOrder0", buddyOrder0},
+        {"BM_BuddyAllocFreeOrder4", buddyOrder4},
+        {"BM_BuddyBatch64", buddyBatch64},
+        {"BM_SlabAllocFree64", slab64},
+        {"BM_SlabAllocFree1024", slab1024},
+        {"BM_VmmAllocateUnmap4K", vmmAllocate}
+    };
+}
+
+int main()
+{
+    if (!HostShim::init(64ULL << 20, 448ULL << 20))
+    {
+        std::fprintf(stderr, "failed to initialise the hosted allocators\n");
+        return 1;
+    }
+
+    for (const Benchmark& benchmark : benchmarks)
+        for (unsigned threads = 1; threads <= 4; threads *= 2) report(benchmark, threads);
+
+    return 0;
+}
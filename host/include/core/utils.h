@@ -0,0 +1,10 @@
+#pragma once
+
+// Hosted replacement for src/include/core/utils.h: the kernel declares its own libc subset, which clashes with the
+// host C library, so the hosted build takes those functions from libc instead.
+
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
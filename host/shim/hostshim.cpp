@@ -0,0 +1,195 @@
+#include "hostshim.h"
+
+#include <core/limine.h>
+#include <core/stats.h>
+#include <core/trace.h>
+#include <drivers/serial.h>
+#include <memory/buddy.h>
+#include <memory/paging.h>
+#include <memory/slab.h>
+#include <memory/spinlock.h>
+#include <memory/zeropool.h>
+#include <arch/x86_64/smp.h>
+
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+#include <sys/mman.h>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+limine_hhdm_request hhdm_request = {};
+limine_memmap_request memmap_request = {};
+
+namespace
+{
+    constexpr size_t ENTRY_COUNT = 4;
+
+    limine_hhdm_response hhdmResponse = {};
+    limine_memmap_response memmapResponse = {};
+    limine_memmap_entry entries[ENTRY_COUNT] = {};
+    limine_memmap_entry* entryPointers[ENTRY_COUNT] = {};
+    uint64_t earlyConsumed[ENTRY_COUNT] = {};
+
+    std::mutex mappingLock;
+    std::unordered_map<uint64_t, uint64_t> mappings;
+    uint64_t remaps = 0;
+}
+
+bool HostShim::init(const uint64_t lowBytes, const uint64_t highBytes)
+{
+    const uint64_t span = HIGH_BASE + highBytes;
+    void* arena = mmap(nullptr, span, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (arena == MAP_FAILED) return false;
+
+    entries[0] = {0x1000, 0x9E000, LIMINE_MEMMAP_USABLE};
+    entries[1] = {LOW_BASE, lowBytes, LIMINE_MEMMAP_USABLE};
+    entries[2] = {LOW_BASE + lowBytes, 0x10000, LIMINE_MEMMAP_RESERVED};
+    entries[3] = {HIGH_BASE, highBytes, LIMINE_MEMMAP_USABLE};
+    for (size_t i = 0; i < ENTRY_COUNT; ++i) entryPointers[i] = &entries[i];
+
+    hhdmResponse.offset = reinterpret_cast<uint64_t>(arena);
+    memmapResponse.entry_count = ENTRY_COUNT;
+    memmapResponse.entries = entryPointers;
+    hhdm_request.response = &hhdmResponse;
+    memmap_request.response = &memmapResponse;
+
+    return BuddyAllocator::init() && SlabAllocator::init();
+}
+
+void* HostShim::toVirtual(const uint64_t physical) { return reinterpret_cast<void*>(physical + hhdmResponse.offset); }
+
+uint64_t HostShim::mappedPages()
+{
+    std::lock_guard guard(mappingLock);
+    return mappings.size();
+}
+
+uint64_t HostShim::remapCount()
+{
+    std::lock_guard guard(mappingLock);
+    return remaps;
+}
+
+uint64_t HostShim::translate(const uint64_t virtualAddress)
+{
+    std::lock_guard guard(mappingLock);
+    const auto it = mappings.find(Alignment::alignDown(virtualAddress, FrameAllocator::SMALL_SIZE));
+    return it == mappings.end() ? 0 : it->second + virtualAddress % FrameAllocator::SMALL_SIZE;
+}
+
+void Serial::printf(const char* fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    vfprintf(stderr, fmt, args);
+    va_end(args);
+}
+
+Spinlock::Spinlock() : locked(0) {}
+
+void Spinlock::lock() { while (__atomic_test_and_set(&locked, __ATOMIC_ACQUIRE)) __builtin_ia32_pause(); }
+void Spinlock::unlock() { __atomic_clear(&locked, __ATOMIC_RELEASE); }
+bool Spinlock::tryLock() { return !__atomic_test_and_set(&locked, __ATOMIC_ACQUIRE); }
+bool Spinlock::isLocked() const { return __atomic_load_n(&locked, __ATOMIC_RELAXED); }
+
+LockGuard::LockGuard(Spinlock& l, const bool hasInterrupts) : lock(l), hasInterrupts(hasInterrupts) { lock.lock(); }
+LockGuard::~LockGuard() { lock.unlock(); }
+
+void SMP::bootParallel(const BootFn fn, void* arg, const uint64_t chunks)
+{
+    std::atomic<uint64_t> next = 0;
+    auto worker = [&]
+    {
+        for (uint64_t chunk = next++; chunk < chunks; chunk = next++) fn(chunk, arg);
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < std::thread::hardware_concurrency() && i < chunks; ++i) threads.emplace_back(worker);
+
+    worker();
+    for (auto& thread : threads) thread.join();
+}
+
+bool Alignment::overlaps(const uint64_t address1, const uint64_t size1, const uint64_t address2, const uint64_t size2)
+{
+    return address1 < address2 + size2 && address2 < address1 + size1;
+}
+
+bool Alignment::aligned(const uint64_t address, const uint64_t size) { return (address & (size - 1)) == 0; }
+uint64_t Alignment::alignDown(const uint64_t address, const uint64_t size) { return address & ~(size - 1); }
+uint64_t Alignment::alignUp(const uint64_t address, const uint64_t size) { return (address + size - 1) & ~(size - 1); }
+
+bool Paging::map(uint64_t virtualAddress, uint64_t physicalAddress, uint64_t size, PageFlags)
+{
+    if (size == 0) return false;
+
+    virtualAddress = Alignment::alignDown(virtualAddress, FrameAllocator::SMALL_SIZE);
+    physicalAddress = Alignment::alignDown(physicalAddress, FrameAllocator::SMALL_SIZE);
+    size = Alignment::alignUp(virtualAddress + size, FrameAllocator::SMALL_SIZE) - virtualAddress;
+
+    std::lock_guard guard(mappingLock);
+    for (uint64_t offset = 0; offset < size; offset += FrameAllocator::SMALL_SIZE)
+        if (!mappings.insert_or_assign(virtualAddress + offset, physicalAddress + offset).second) ++remaps;
+
+    return true;
+}
+
+void Paging::unmap(uint64_t virtualAddress, uint64_t size)
+{
+    virtualAddress = Alignment::alignDown(virtualAddress, FrameAllocator::SMALL_SIZE);
+    size = Alignment::alignUp(virtualAddress + size, FrameAllocator::SMALL_SIZE) - virtualAddress;
+
+    std::lock_guard guard(mappingLock);
+    for (uint64_t offset = 0; offset < size; offset += FrameAllocator::SMALL_SIZE) mappings.erase(virtualAddress + offset);
+}
+
+void* FrameAllocator::allocEarly(const uint64_t count)
+{
+    if (count == 0 || BuddyAllocator::isReady()) return nullptr;
+
+    for (size_t i = 0; i < ENTRY_COUNT; ++i)
+    {
+        const auto& e = entries[i];
+        if (e.type != LIMINE_MEMMAP_USABLE || e.base < HostShim::LOW_BASE) continue;
+
+        const uint64_t base = Alignment::alignUp(e.base, SMALL_SIZE);
+        if (base + earlyConsumed[i] + count * SMALL_SIZE > Alignment::alignDown(e.base + e.length, SMALL_SIZE)) continue;
+
+        const uint64_t frame = base + earlyConsumed[i];
+        earlyConsumed[i] += count * SMALL_SIZE;
+
+        return reinterpret_cast<void*>(frame);
+    }
+
+    return nullptr;
+}
+
+uint64_t FrameAllocator::earlyUsed(const size_t entryIndex)
+{
+    if (entryIndex >= ENTRY_COUNT || !earlyConsumed[entryIndex]) return 0;
+    return Alignment::alignUp(entries[entryIndex].base, SMALL_SIZE) - entries[entryIndex].base +
+        earlyConsumed[entryIndex];
+}
+
+void* FrameAllocator::alloc(const AllocFlags flags)
+{
+    if (!BuddyAllocator::isReady()) return allocEarly(1);
+    return reinterpret_cast<void*>(BuddyAllocator::alloc(0, flags));
+}
+
+void FrameAllocator::free(void* frame) { BuddyAllocator::free(reinterpret_cast<uint64_t>(frame), 0); }
+
+uint32_t Trace::enabledMask = 0;
+void Trace::record(Event, uint64_t, uint64_t, uint32_t) {}
+
+uint64_t* Stats::cpuCounters[SMP::MAX_CPUS] = {};
+uint32_t CPUManager::getCurrentCPUId() { return 0; }
+
+uint64_t ZeroPool::take() { return 0; }
+uint64_t ZeroPool::drain() { return 0; }
+void ZeroPool::zeroPages(const uint64_t physical, const uint64_t count)
+{
+    memset(HostShim::toVirtual(physical), 0, count * FrameAllocator::SMALL_SIZE);
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace HostShim
+{
+    constexpr uint64_t LOW_BASE = 0x100000, HIGH_BASE = 0x100000000ULL;
+
+    bool init(uint64_t lowBytes, uint64_t highBytes);
+    void* toVirtual(uint64_t physical);
+
+    uint64_t mappedPages();
+    uint64_t remapCount();
+    uint64_t translate(uint64_t virtualAddress);
+}
@@ -0,0 +1,424 @@
+#include "../shim/hostshim.h"
+
+#include <memory/buddy.h>
+#include <memory/slab.h>
+#include <memory/vmm.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
+#include <map>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    struct TestCase
+    {
+        const char* name;
+        void (*fn)();
+    };
+
+    uint64_t failures = 0;
+    uint64_t seed = 0x6d657368;
+
+#define CHECK(condition)                                                                \
+    do                                                                                  \
+    {                                                                                   \
+        if (!(condition))                                                               \
+        {                                                                               \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            ++failures;                                                                 \
+        }                                                                               \
+    }                                                                                   \
+    while (0)
+
+    uint64_t blockSize(const int order) { return FrameAllocator::SMALL_SIZE << order; }
+
+    void stampBlock(const uint64_t address, const int order, const uint8_t tag)
+    {
+        auto* bytes = static_cast<uint8_t*>(HostShim::toVirtual(address));
+        bytes[0] = tag;
+        bytes[blockSize(order) - 1] = tag;
+    }
+
+    bool blockStamped(const uint64_t address, const int order, const uint8_t tag)
+    {
+        const auto* bytes = static_cast<const uint8_t*>(HostShim::toVirtual(address));
+        return bytes[0] == tag && bytes[blockSize(order) - 1] == tag;
+    }
+
+    void buddyRandomStress()
+    {
+        const uint64_t baseline = BuddyAllocator::getFreePages();
+        std::mt19937_64 rng(seed);
+        std::map<uint64_t, int> live;
+
+        for (int step = 0; step < 50000; ++step)
+        {
+            if (live.empty() || rng() % 3 != 0)
+            {
+                const int order = static_cast<int>(rng() % 7);
+                const bool dma32 = rng() % 4 == 0;
+                const uint64_t address = BuddyAllocator::alloc(order, dma32 ? AllocFlags::DMA32 : AllocFlags::NONE);
+                if (!address) continue;
+
+                CHECK(address % blockSize(order) == 0);
+                if (dma32) CHECK(address + blockSize(order) <= BuddyAllocator::DMA32_LIMIT);
+
+                const auto next = live.lower_bound(address);
+                if (next != live.end()) CHECK(address + blockSize(order) <= next->first);
+                if (next != live.begin()) CHECK(std::prev(next)->first + blockSize(std::prev(next)->second) <= address);
+
+                stampBlock(address, order, static_cast<uint8_t>(address >> 12));
+                live[address] = order;
+                continue;
+            }
+
+            auto it = live.begin();
+            std::advance(it, static_cast<long>(rng() % live.size()));
+            CHECK(blockStamped(it->first, it->second, static_cast<uint8_t>(it->first >> 12)));
+
+            BuddyAllocator::free(it->first, it->second);
+            live.erase(it);
+        }
+
+        for (const auto& [address, order] : live) BuddyAllocator::free(address, order);
+        CHECK(BuddyAllocator::getFreePages() == baseline);
+    }
+
+    void buddyCoalescesAfterExhaustion()
+    {
+        const uint64_t baseline = BuddyAllocator::getFreePages();
+        std::vector<uint64_t> pages;
+
+        while (const uint64_t page = BuddyAllocator::alloc(0)) pages.push_back(page);
+        CHECK(!pages.empty());
+        CHECK(BuddyAllocator::alloc(0) == 0);
+
+        std::shuffle(pages.begin(), pages.end(), std::mt19937_64(seed));
+        for (const uint64_t page : pages) BuddyAllocator::free(page, 0);
+        CHECK(BuddyAllocator::getFreePages() == baseline);
+
+        const uint64_t block = BuddyAllocator::alloc(12);
+        CHECK(block != 0);
+        BuddyAllocator::free(block, 12);
+    }
+
+    std::vector<uint64_t> reclaimablePages;
+
+    uint64_t releaseReclaimable(const uint64_t pages)
+    {
+        uint64_t released = 0;
+        while (released < pages && !reclaimablePages.empty())
+        {
+            BuddyAllocator::free(reclaimablePages.back(), 0);
+            reclaimablePages.pop_back();
+            ++released;
+        }
+
+        return released;
+    }
+
+    void buddyReclaimsUnderPressure()
+    {
+        const uint64_t baseline = BuddyAllocator::getFreePages();
+        while (const uint64_t page = BuddyAllocator::alloc(0)) reclaimablePages.push_back(page);
+        CHECK(BuddyAllocator::registerReclaimer(releaseReclaimable));
+
+        const uint64_t cached = reclaimablePages.size();
+        CHECK(cached != 0);
+
+        std::vector<uint64_t> pages;
+        for (int i = 0; i < 64; ++i)
+        {
+            const uint64_t page = BuddyAllocator::alloc(0);
+            CHECK(page != 0);
+            if (page) pages.push_back(page);
+        }
+
+        CHECK(reclaimablePages.size() == cached - pages.size());
+
+        for (const uint64_t page : pages) BuddyAllocator::free(page, 0);
+        releaseReclaimable(reclaimablePages.size());
+        CHECK(BuddyAllocator::getFreePages() == baseline);
+    }
+
+    void buddyRejectsBadFrees()
+    {
+        const uint64_t baseline = BuddyAllocator::getFreePages();
+        const uint64_t block = BuddyAllocator::alloc(3);
+        CHECK(block != 0);
+
+        BuddyAllocator::free(block, 2);
+        BuddyAllocator::free(block + FrameAllocator::SMALL_SIZE, 0);
+        CHECK(BuddyAllocator::getFreePages() == baseline - 8);
+
+        BuddyAllocator::free(block, 3);
+        BuddyAllocator::free(block, 3);
+        CHECK(BuddyAllocator::getFreePages() == baseline);
+    }
+
+    void buddyAddsDonatedMemory()
+    {
+        const uint64_t baseline = BuddyAllocator::getFreePages(), total = BuddyAllocator::getTotalPages();
+        const uint64_t start = HostShim::LOW_BASE + (64ULL << 20);
+
+        CHECK(BuddyAllocator::addMemory(start + 0x800, start + 0x4800) == 3);
+        CHECK(BuddyAllocator::getFreePages() == baseline + 3);
+        CHECK(BuddyAllocator::getTotalPages() == total + 3);
+        CHECK(BuddyAllocator::addMemory(start + 0x4800, start + 0x4900) == 0);
+    }
+
+    void buddyAllocBelowHonoursLimit()
+    {
+        std::mt19937_64 rng(seed);
+        for (int i = 0; i < 2000; ++i)
+        {
+            const int order = static_cast<int>(rng() % 5);
+            const uint64_t limit = HostShim::LOW_BASE + (rng() % 32 + 1) * 0x100000;
+            const uint64_t address = BuddyAllocator::allocBelow(order, limit);
+            if (!address) continue;
+
+            CHECK(address + blockSize(order) <= limit);
+            BuddyAllocator::free(address, order);
+        }
+    }
+
+    void buddyZeroedPagesAreClean()
+    {
+        for (int i = 0; i < 256; ++i)
+        {
+            const uint64_t dirty = BuddyAllocator::alloc(0);
+            memset(HostShim::toVirtual(dirty), 0xA5, FrameAllocator::SMALL_SIZE);
+            BuddyAllocator::free(dirty, 0);
+
+            const uint64_t page = BuddyAllocator::alloc(0, AllocFlags::ZEROED);
+            CHECK(page != 0);
+
+            const auto* bytes = static_cast<const uint8_t*>(HostShim::toVirtual(page));
+            CHECK(std::all_of(bytes, bytes + FrameAllocator::SMALL_SIZE, [](const uint8_t b) { return b == 0; }));
+            BuddyAllocator::free(page, 0);
+        }
+    }
+
+    void buddyConcurrentStress()
+    {
+        const uint64_t baseline = BuddyAllocator::getFreePages();
+        std::vector<std::thread> threads;
+
+        for (unsigned t = 0; t < 4; ++t)
+            threads.emplace_back([t]
+            {
+                std::mt19937_64 rng(seed + t);
+                std::vector<std::pair<uint64_t, int>> live;
+
+                for (int step = 0; step < 20000; ++step)
+                {
+                    if (live.empty() || rng() % 2)
+                    {
+                        const int order = static_cast<int>(rng() % 4);
+                        if (const uint64_t address = BuddyAllocator::alloc(order))
+                        {
+                            stampBlock(address, order, static_cast<uint8_t>(t + 1));
+                            live.emplace_back(address, order);
+                        }
+                        continue;
+                    }
+
+                    const size_t index = rng() % live.size();
+                    CHECK(blockStamped(live[index].first, live[index].second, static_cast<uint8_t>(t + 1)));
+                    BuddyAllocator::free(live[index].first, live[index].second);
+                    live[index] = live.back();
+                    live.pop_back();
+                }
+
+                for (const auto& [address, order] : live) BuddyAllocator::free(address, order);
+            });
+
+        for (auto& thread : threads) thread.join();
+        CHECK(BuddyAllocator::getFreePages() == baseline);
+    }
+
+    struct SlabObject
+    {
+        uint8_t* pointer;
+        size_t size;
+        uint8_t pattern;
+    };
+
+    void slabWorker(const uint64_t workerSeed, const int steps)
+    {
+        std::mt19937_64 rng(workerSeed);
+        std::vector<SlabObject> live;
+
+        for (int step = 0; step < steps; ++step)
+        {
+            if (live.empty() || rng() % 3 != 0)
+            {
+                const size_t size = rng() % 4 ? rng() % 512 + 1 : rng() % 16384 + 1;
+                const size_t alignment = size_t{16} << rng() % 5;
+
+                auto* pointer = static_cast<uint8_t*>(SlabAllocator::alloc(size, alignment));
+                CHECK(pointer != nullptr);
+                if (!pointer) continue;
+
+                CHECK(reinterpret_cast<uint64_t>(pointer) % alignment == 0);
+                CHECK(SlabAllocator::usableSize(pointer) >= size);
+
+                const auto pattern = static_cast<uint8_t>(rng());
+                memset(pointer, pattern, size);
+                live.push_back({pointer, size, pattern});
+                continue;
+            }
+
+            const size_t index = rng() % live.size();
+            const SlabObject object = live[index];
+            CHECK(std::all_of(object.pointer, object.pointer + object.size,
+                              [&](const uint8_t b) { return b == object.pattern; }));
+
+            SlabAllocator::free(object.pointer);
+            live[index] = live.back();
+            live.pop_back();
+        }
+
+        for (const SlabObject& object : live) SlabAllocator::free(object.pointer);
+    }
+
+    void slabRandomStress() { slabWorker(seed, 50000); }
+
+    void slabConcurrentStress()
+    {
+        std::vector<std::thread> threads;
+        for (unsigned t = 0; t < 4; ++t) threads.emplace_back(slabWorker, seed + t, 20000);
+        for (auto& thread : threads) thread.join();
+    }
+
+    void slabDedicatedCache()
+    {
+        const uint64_t baseline = BuddyAllocator::getFreePages();
+        SlabCache* cache = SlabAllocator::createCache("test-104", 104, 8);
+        CHECK(cache != nullptr);
+        if (!cache) return;
+
+        std::vector<uint8_t*> live;
+        for (int i = 0; i < 4096; ++i)
+        {
+            auto* pointer = static_cast<uint8_t*>(SlabAllocator::cacheAlloc(cache));
+            CHECK(pointer != nullptr);
+            if (!pointer) break;
+
+            CHECK(reinterpret_cast<uint64_t>(pointer) % 8 == 0);
+            CHECK(SlabAllocator::usableSize(pointer) == 104);
+            memset(pointer, static_cast<uint8_t>(i), 104);
+            live.push_back(pointer);
+        }
+
+        for (size_t i = 0; i < live.size(); ++i)
+            CHECK(std::all_of(live[i], live[i] + 104, [&](const uint8_t b) { return b == static_cast<uint8_t>(i); }));
+        for (uint8_t* pointer : live) SlabAllocator::free(pointer);
+
+        CHECK(BuddyAllocator::getFreePages() == baseline);
+        CHECK(SlabAllocator::createCache("test-huge", FrameAllocator::SMALL_SIZE) == nullptr);
+    }
+
+    void vmmRandomRegions()
+    {
+        const uint64_t mappedBaseline = HostShim::mappedPages(), remapBaseline = HostShim::remapCount();
+        std::mt19937_64 rng(seed);
+        std::map<uint64_t, uint64_t> live;
+
+        for (int step = 0; step < 4000; ++step)
+        {
+            if (live.empty() || rng() % 3 != 0)
+            {
+                const uint64_t size = (rng() % 32 + 1) * FrameAllocator::SMALL_SIZE;
+                const bool commit = rng() % 2;
+                void* base = commit ? VMM::allocate(size, VMM::RegionType::ANONYMOUS, PageFlags::RW)
+                                    : VMM::reserve(size, VMM::RegionType::HEAP, PageFlags::RW);
+                CHECK(base != nullptr);
+                if (!base) continue;
+
+                const auto address = reinterpret_cast<uint64_t>(base);
+                const VMM::Region* region = VMM::findRegion(address + size - 1);
+                CHECK(region && region->base == address && region->size == size);
+                if (commit) CHECK(HostShim::translate(address) != 0);
+
+                const auto next = live.lower_bound(address);
+                if (next != live.end()) CHECK(address + size <= next->first);
+                if (next != live.begin()) CHECK(std::prev(next)->first + std::prev(next)->second <= address);
+
+                live[address] = size;
+                continue;
+            }
+
+            auto it = live.begin();
+            std::advance(it, static_cast<long>(rng() % live.size()));
+            CHECK(VMM::unmap(reinterpret_cast<void*>(it->first)));
+            CHECK(VMM::findRegion(it->first) == nullptr);
+            live.erase(it);
+        }
+
+        for (const auto& [address, size] : live) VMM::unmap(reinterpret_cast<void*>(address));
+        CHECK(HostShim::mappedPages() == mappedBaseline);
+        CHECK(HostShim::remapCount() == remapBaseline);
+    }
+
+    void vmmStackGuardIsUnbacked()
+    {
+        const uint64_t baseline = BuddyAllocator::getFreePages(), mappedBaseline = HostShim::mappedPages();
+        const uint64_t size = 5 * FrameAllocator::SMALL_SIZE;
+
+        void* base = VMM::allocate(size, VMM::RegionType::STACK, PageFlags::RW);
+        CHECK(base != nullptr);
+        if (!base) return;
+
+        const auto address = reinterpret_cast<uint64_t>(base);
+        CHECK(HostShim::translate(address) == 0);
+        CHECK(HostShim::translate(address + VMM::STACK_GUARD_PAGES * FrameAllocator::SMALL_SIZE) != 0);
+        CHECK(HostShim::mappedPages() == mappedBaseline + 5 - VMM::STACK_GUARD_PAGES);
+        CHECK(VMM::protect(base, PageFlags::RW | PageFlags::NO_EXECUTE));
+        CHECK(HostShim::translate(address) == 0);
+
+        CHECK(VMM::unmap(base));
+        CHECK(HostShim::mappedPages() == mappedBaseline);
+        CHECK(BuddyAllocator::getFreePages() == baseline);
+    }
+
+    const TestCase tests[] = {
+        {"buddy_random_stress", buddyRandomStress},
+        {"buddy_coalesces_after_exhaustion", buddyCoalescesAfterExhaustion},
+        {"buddy_reclaims_under_pressure", buddyReclaimsUnderPressure},
+        {"buddy_rejects_bad_frees", buddyRejectsBadFrees},
+        {"buddy_adds_donated_memory", buddyAddsDonatedMemory},
+        {"buddy_alloc_below_honours_limit", buddyAllocBelowHonoursLimit},
+        {"buddy_zeroed_pages_are_clean", buddyZeroedPagesAreClean},
+        {"buddy_concurrent_stress", buddyConcurrentStress},
+        {"slab_random_stress", slabRandomStress},
+        {"slab_concurrent_stress", slabConcurrentStress},
+        {"slab_dedicated_cache", slabDedicatedCache},
+        {"vmm_random_regions", vmmRandomRegions},
+        {"vmm_stack_guard_is_unbacked", vmmStackGuardIsUnbacked}
+    };
+}
+
+int main(const int argc, char** argv)
+{
+    if (argc > 1) seed = std::strtoull(argv[1], nullptr, 0);
+    if (!HostShim::init(64ULL << 20, 192ULL << 20))
+    {
+        std::fprintf(stderr, "failed to initialise the hosted allocators\n");
+        return 1;
+    }
+
+    std::printf("seed 0x%lx\n", seed);
+    for (const TestCase& test : tests)
+    {
+        const uint64_t before = failures;
+        test.fn();
+        std::printf("[%s] %s\n", failures == before ? "PASS" : "FAIL", test.name);
+    }
+
+    return failures ? 1 : 0;
+}
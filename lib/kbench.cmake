@@ -0,0 +1,33 @@
+if (NOT QEMU OR NOT ISO)
+    message(FATAL_ERROR "kbench.cmake requires QEMU and ISO.")
+endif ()
+
+set(disk_args "")
+if (DISK_DIR)
+    set(disk_args -drive file=${DISK_DIR}/virtio-disk.img,format=raw,if=none,id=vdisk
+        -device virtio-blk-pci,drive=vdisk,num-queues=4
+        -drive file=${DISK_DIR}/nvme-disk.img,format=raw,if=none,id=ndisk -device nvme,drive=ndisk,serial=mesh0
+        -drive file=${DISK_DIR}/ahci-disk.img,format=raw,if=none,id=sdisk -device ide-hd,drive=sdisk,bus=ide.0)
+endif ()
+
+execute_process(
+    COMMAND ${QEMU} -machine q35 -m 512M -smp 4 -serial stdio -display none -no-reboot -cdrom ${ISO}
+    -device isa-debug-exit,iobase=0xf4,iosize=0x04
+    -drive if=pflash,format=raw,readonly=on,file=${OVMF_CODE}
+    -drive if=pflash,format=raw,file=${OVMF_VARS}
+    ${disk_args}
+    RESULT_VARIABLE result
+    OUTPUT_VARIABLE output
+    ERROR_VARIABLE output
+    TIMEOUT 600
+)
+
+message("${output}")
+if (LOG)
+    file(WRITE ${LOG} "${output}")
+endif ()
+
+# isa-debug-exit turns a write of N into the exit status (N << 1) | 1; KBench::EXIT_SUCCESS is 0x10.
+if (NOT result EQUAL 33)
+    message(FATAL_ERROR "kbench failed (QEMU exit status ${result}).")
+endif ()
@@ -0,0 +1,40 @@
+if (NOT NM OR NOT ELF OR NOT OUT)
+    message(FATAL_ERROR "symbols.cmake requires NM, ELF and OUT.")
+endif ()
+
+execute_process(COMMAND ${NM} -n -S -C --defined-only ${ELF} OUTPUT_VARIABLE listing RESULT_VARIABLE result)
+if (NOT result EQUAL 0)
+    message(FATAL_ERROR "nm failed on ${ELF}.")
+endif ()
+
+string(REPLACE ";" "," listing "${listing}")
+string(REPLACE "\n" ";" lines "${listing}")
+
+set(entries "")
+set(strings "")
+set(count 0)
+set(offset 0)
+
+foreach (line IN LISTS lines)
+    if (NOT line MATCHES "^([0-9a-f]+) (([0-9a-f]+) )?[tTwW] (.+)$")
+        continue()
+    endif ()
+
+    set(address ${CMAKE_MATCH_1})
+    set(size ${CMAKE_MATCH_3})
+    set(name "${CMAKE_MATCH_4}")
+    if (NOT size)
+        set(size 0)
+    endif ()
+
+    string(REPLACE "\"" "'" name "${name}")
+    string(LENGTH "${name}" length)
+
+    string(APPEND entries "    dq 0x${address}\n    dd ${offset}, 0x${size}\n")
+    string(APPEND strings "    db \"${name}\", 0\n")
+    math(EXPR offset "${offset} + ${length} + 1")
+    math(EXPR count "${count} + 1")
+endforeach ()
+
+file(WRITE ${OUT} "bits 64\nsection .ksymtab progbits alloc noexec nowrite align=8\n    dd 0x4D59534B, ${count}\n"
+    "${entries}${strings}")
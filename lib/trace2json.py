@@ -0,0 +1,58 @@
+#!/usr/bin/env python3
+"""Convert a Mesh TRACE_BEGIN..TRACE_END serial dump into Chrome/Perfetto trace JSON."""
+
+import json
+import sys
+
+ARGUMENT_NAMES = {
+    "sched_switch": ("prev", "next", "prev_state"),
+    "sched_wake": ("task", "priority", "cpu"),
+    "sched_migrate": ("task", "from_cpu", "to_cpu"),
+    "buddy_alloc": ("address", "order", "flags"),
+    "buddy_free": ("address", "order", "unused"),
+    "slab_alloc": ("address", "size", "unused"),
+    "slab_free": ("address", "unused", "unused"),
+    "page_fault": ("cr2", "rip", "error"),
+    "lock_contended": ("lock", "cycles", "unused"),
+}
+
+
+def main():
+    source = open(sys.argv[1]) if len(sys.argv) > 1 else sys.stdin
+    frequency, base, events, tracing = 0, None, [], False
+
+    for line in source:
+        fields = line.split()
+        if not fields:
+            continue
+        if fields[0] == "TRACE_BEGIN":
+            tracing = True
+            frequency = int(dict(f.split("=") for f in fields[1:])["tsc_hz"])
+            continue
+        if fields[0] == "TRACE_END":
+            break
+        if not tracing or fields[0] != "T" or len(fields) != 7:
+            continue
+
+        cpu, tsc, name = int(fields[1]), int(fields[2], 16), fields[3]
+        args = [int(value, 16) for value in fields[4:]]
+        base = tsc if base is None else min(base, tsc)
+        event = {"pid": 0, "tid": cpu, "ts": tsc, "name": name}
+
+        if name in ("irq_entry", "irq_exit"):
+            event.update(name="irq 0x%x" % args[0], ph="B" if name == "irq_entry" else "E")
+        else:
+            labels = ARGUMENT_NAMES.get(name, ("arg0", "arg1", "arg2"))
+            event.update(ph="i", s="t", args={label: hex(value) for label, value in zip(labels, args)})
+        events.append(event)
+
+    scale = 1e6 / frequency if frequency else 1.0
+    for event in events:
+        event["ts"] = (event["ts"] - base) * scale
+    events.sort(key=lambda event: (event["tid"], event["ts"]))
+
+    json.dump({"traceEvents": events, "displayTimeUnit": "ns"}, sys.stdout)
+
+
+if __name__ == "__main__":
+    main()
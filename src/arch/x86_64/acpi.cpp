@@ -79,9 +79,25 @@ struct __attribute__ ((packed)) FADT
              xGpe0Block, xGpe1Block;
 };
 
+struct __attribute__ ((packed)) MCFG
+{
+    SDTHeader header;
+    uint64_t reserved;
+};
+
+struct __attribute__ ((packed)) MCFGEntry
+{
+    uint64_t baseAddress;
+    uint16_t segmentGroup;
+    uint8_t startBus, endBus;
+    uint32_t reserved;
+};
+
 extern limine_hhdm_request hhdm_request;
 extern limine_rsdp_request rsdp_request;
 
+SDTHeader* rootTable = nullptr;
+
 bool signaturesMatch(const char* sig1, const char* sig2, const size_t len)
 {
     for (size_t i = 0; i < len; ++i) if (sig1[i] != sig2[i]) return false;
@@ -161,6 +177,7 @@ bool ACPI::init(MADTInfo& madtInfo)
         return false;
     }
 
+    rootTable = root;
     if (auto* facpHeader = findTable(root, "FACP"); !facpHeader) Serial::printf("ACPI: FACP not found\n");
     else
     {
@@ -240,3 +257,34 @@ void ACPI::resolveIsa(const MADTInfo& madtInfo, const uint8_t src, uint32_t& glo
         levelTriggered = false;
     }
 }
+
+bool ACPI::findMCFG(MCFGInfo& mcfgInfo)
+{
+    mcfgInfo.count = 0;
+    if (!rootTable) return false;
+
+    const auto* mcfg = reinterpret_cast<const MCFG*>(findTable(rootTable, "MCFG"));
+    if (!mcfg)
+    {
+        Serial::printf("ACPI: MCFG not found\n");
+        return false;
+    }
+
+    const auto* entries = reinterpret_cast<const MCFGEntry*>(reinterpret_cast<const uint8_t*>(mcfg) + sizeof(MCFG));
+    const uint64_t entryCount = (mcfg->header.length - sizeof(MCFG)) / sizeof(MCFGEntry);
+
+    for (uint64_t i = 0; i < entryCount; ++i)
+    {
+        const MCFGEntry& entry = entries[i];
+        if (!entry.baseAddress || entry.endBus < entry.startBus) continue;
+        if (mcfgInfo.count >= MCFGInfo::MAX_SEGMENTS)
+        {
+            Serial::printf("ACPI: Too many MCFG entries, ignoring segment %u\n", entry.segmentGroup);
+            continue;
+        }
+
+        mcfgInfo.segments[mcfgInfo.count++] = {entry.baseAddress, entry.segmentGroup, entry.startBus, entry.endBus};
+    }
+
+    return mcfgInfo.count > 0;
+}
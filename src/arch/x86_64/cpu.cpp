@@ -1,4 +1,9 @@
 #include <arch/x86_64/cpu.h>
+#include <arch/x86_64/irq.h>
+#include <core/stats.h>
+#include <memory/zeropool.h>
+#include <task/parallel.h>
+#include <task/workqueue.h>
 
 extern Scheduler::Scheduler schedulers[SMP::MAX_CPUS];
 CPU cpus[SMP::MAX_CPUS];
@@ -49,7 +54,11 @@ bool CPUManager::initRuntime(const uint32_t cpuId)
     cpu->schedulerReady = true;
     cpu->online = true;
 
-    return true;
+    return Stats::initCPU(cpuId) &&
+           IRQ::initCPU(cpuId) &&
+           WorkQueue::initCPU(cpuId) &&
+           Parallel::initCPU(cpuId) &&
+           ZeroPool::initCPU(cpuId);
 }
 
 CPU* CPUManager::getCurrentCPU()
@@ -0,0 +1,169 @@
+#include <arch/x86_64/cpu.h>
+#include <arch/x86_64/ipi.h>
+#include <arch/x86_64/isr.h>
+#include <arch/x86_64/lapic.h>
+#include <memory/slab.h>
+#include <memory/spinlock.h>
+
+struct CallRequest
+{
+    IPI::CallFn fn;
+    void* arg;
+    CallRequest* next;
+    uint32_t* pending;
+    uint32_t busy;
+    bool owned;
+};
+
+struct alignas(64) CallQueue
+{
+    CallRequest* head;
+    uint32_t reschedulePending;
+};
+
+CallQueue callQueues[SMP::MAX_CPUS] = {};
+CallRequest broadcastSlots[SMP::MAX_CPUS] = {};
+Spinlock broadcastLock;
+
+bool cpuAcceptsIPI(const uint32_t cpuId) { return cpuId < SMP::MAX_CPUS && cpus[cpuId].online; }
+
+bool enqueueCall(const uint32_t cpuId, CallRequest* request)
+{
+    CallRequest* head = __atomic_load_n(&callQueues[cpuId].head, __ATOMIC_RELAXED);
+    do request->next = head;
+    while (!__atomic_compare_exchange_n(&callQueues[cpuId].head, &head, request, true, __ATOMIC_RELEASE,
+                                        __ATOMIC_RELAXED));
+
+    return head == nullptr;
+}
+
+void submitCall(const uint32_t cpuId, CallRequest* request)
+{
+    if (enqueueCall(cpuId, request)) LAPIC::sendIPI(cpus[cpuId].lapicId, IPI::VECTOR_CALL);
+}
+
+void waitBusy(const uint32_t* busy)
+{
+    while (__atomic_load_n(busy, __ATOMIC_ACQUIRE))
+    {
+        IPI::processCalls();
+        asm volatile ("pause");
+    }
+}
+
+void IPI::sendReschedule(const uint32_t cpuId)
+{
+    if (!cpuAcceptsIPI(cpuId)) return;
+    if (cpuId == CPUManager::getCurrentCPUId()) return;
+    if (__atomic_exchange_n(&callQueues[cpuId].reschedulePending, 1, __ATOMIC_ACQ_REL)) return;
+
+    LAPIC::sendIPI(cpus[cpuId].lapicId, VECTOR_RESCHEDULE);
+}
+
+void IPI::acknowledgeReschedule()
+{
+    __atomic_store_n(&callQueues[CPUManager::getCurrentCPUId()].reschedulePending, 0, __ATOMIC_RELEASE);
+}
+
+bool IPI::callOnCpu(const uint32_t cpuId, const CallFn fn, void* arg, const bool wait)
+{
+    if (!fn || !cpuAcceptsIPI(cpuId)) return false;
+
+    if (cpuId == CPUManager::getCurrentCPUId())
+    {
+        uint64_t rflags;
+        asm volatile ("pushfq\npopq %0" : "=r"(rflags) :: "memory");
+        Interrupt::disableInterrupts();
+
+        fn(arg);
+        asm volatile ("pushq %0\npopfq" :: "r"(rflags) : "memory");
+
+        return true;
+    }
+
+    if (!wait)
+    {
+        auto* request = static_cast<CallRequest*>(SlabAllocator::alloc(sizeof(CallRequest), alignof(CallRequest)));
+        if (!request) return false;
+
+        *request = {fn, arg, nullptr, nullptr, 1, true};
+        submitCall(cpuId, request);
+
+        return true;
+    }
+
+    CallRequest request = {fn, arg, nullptr, nullptr, 1, false};
+    submitCall(cpuId, &request);
+    waitBusy(&request.busy);
+
+    return true;
+}
+
+bool IPI::callOnAllCpus(const CallFn fn, void* arg, const bool wait, const bool includeSelf)
+{
+    if (!fn) return false;
+
+    uint64_t rflags;
+    asm volatile ("pushfq\npopq %0" : "=r"(rflags) :: "memory");
+    Interrupt::disableInterrupts();
+
+    while (!broadcastLock.tryLock())
+    {
+        processCalls();
+        asm volatile ("pause");
+    }
+
+    const uint32_t self = CPUManager::getCurrentCPUId();
+    uint32_t pending = 0;
+
+    for (uint32_t i = 0; i < SMP::getCpuCount(); ++i)
+    {
+        if (i == self || !cpuAcceptsIPI(i)) continue;
+
+        CallRequest& slot = broadcastSlots[i];
+        waitBusy(&slot.busy);
+
+        slot = {fn, arg, nullptr, wait ? &pending : nullptr, 1, false};
+        if (wait) __atomic_add_fetch(&pending, 1, __ATOMIC_RELAXED);
+
+        submitCall(i, &slot);
+    }
+
+    broadcastLock.unlock();
+    if (includeSelf) fn(arg);
+
+    if (wait) waitBusy(&pending);
+    asm volatile ("pushq %0\npopfq" :: "r"(rflags) : "memory");
+
+    return true;
+}
+
+void IPI::processCalls()
+{
+    CallRequest* list = __atomic_exchange_n(&callQueues[CPUManager::getCurrentCPUId()].head, nullptr,
+                                            __ATOMIC_ACQUIRE);
+
+    CallRequest* ordered = nullptr;
+    while (list)
+    {
+        CallRequest* next = list->next;
+        list->next = ordered;
+        ordered = list;
+        list = next;
+    }
+
+    while (ordered)
+    {
+        CallRequest* request = ordered;
+        ordered = request->next;
+
+        request->fn(request->arg);
+
+        if (request->owned) SlabAllocator::free(request);
+        else
+        {
+            if (request->pending) __atomic_sub_fetch(request->pending, 1, __ATOMIC_RELEASE);
+            __atomic_store_n(&request->busy, 0, __ATOMIC_RELEASE);
+        }
+    }
+}
@@ -0,0 +1,476 @@
+#include <arch/x86_64/cpu.h>
+#include <arch/x86_64/idt.h>
+#include <arch/x86_64/irq.h>
+#include <arch/x86_64/isr.h>
+#include <arch/x86_64/lapic.h>
+#include <core/stats.h>
+#include <core/trace.h>
+#include <task/scheduler.h>
+#include <drivers/serial.h>
+#include <memory/slab.h>
+#include <memory/spinlock.h>
+#include <task/softirq.h>
+
+struct VectorSlot
+{
+    IRQ::Handler handler;
+    void* arg;
+    uint64_t count;
+};
+
+struct IrqLine
+{
+    const char* name;
+    IRQ::Vector vector, retired;
+    IRQ::CpuMask affinity;
+    IRQ::Retarget retarget;
+    void* owner;
+    uint32_t gsi, index;
+    uint64_t carried, lastCount, rate;
+    bool used, ioapic, pinned;
+};
+
+constexpr uint8_t RESERVED_VECTOR_YIELD = 0x80;
+constexpr uint64_t BALANCE_MIN_RATE = 100;
+constexpr int IRQ_BALANCER_PRIORITY = 2;
+
+extern Scheduler::Scheduler schedulers[SMP::MAX_CPUS];
+
+VectorSlot* vectorTables[SMP::MAX_CPUS] = {};
+uint32_t vectorCounts[SMP::MAX_CPUS] = {}, spreadCursor = 0;
+Spinlock vectorLock, lineLock;
+
+IrqLine irqLines[IRQ::MAX_LINES] = {};
+IRQ::CpuMask isolatedCpus = {};
+uint64_t cpuIrqLoad[SMP::MAX_CPUS] = {};
+uint32_t balancerInterval = 0;
+bool balancerStarted = false;
+
+template <uint8_t Vector>
+__attribute__ ((interrupt)) void irqStub(Interrupt::Frame*) { IRQ::dispatch(Vector); }
+
+template <uint8_t Vector>
+void installStubs()
+{
+    if (Vector != RESERVED_VECTOR_YIELD) IDTManager::setEntry(Vector, reinterpret_cast<void(*)()>(irqStub<Vector>));
+    if constexpr (Vector < IRQ::LAST_DYNAMIC_VECTOR) installStubs<Vector + 1>();
+}
+
+bool vectorUsable(const uint32_t index) { return index + IRQ::FIRST_DYNAMIC_VECTOR != RESERVED_VECTOR_YIELD; }
+
+bool cpuAcceptsVectors(const uint32_t cpuId)
+{
+    return cpuId < SMP::MAX_CPUS && cpus[cpuId].online && vectorTables[cpuId];
+}
+
+void IRQ::init() { installStubs<FIRST_DYNAMIC_VECTOR>(); }
+
+bool IRQ::initCPU(const uint32_t cpuId)
+{
+    if (cpuId >= SMP::MAX_CPUS) return false;
+    if (vectorTables[cpuId]) return true;
+
+    auto* table = static_cast<VectorSlot*>(SlabAllocator::alloc(sizeof(VectorSlot) * DYNAMIC_VECTOR_COUNT,
+                                                                alignof(VectorSlot)));
+    if (!table)
+    {
+        Serial::printf("IRQ: Failed to allocate vector table for CPU %u\n", cpuId);
+        return false;
+    }
+
+    memset(table, 0, sizeof(VectorSlot) * DYNAMIC_VECTOR_COUNT);
+    __atomic_store_n(&vectorTables[cpuId], table, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+bool allocateOn(const uint32_t cpuId, const IRQ::Handler handler, void* arg, IRQ::Vector& out)
+{
+    VectorSlot* table = vectorTables[cpuId];
+    for (uint32_t i = 0; i < IRQ::DYNAMIC_VECTOR_COUNT; ++i)
+    {
+        if (!vectorUsable(i) || table[i].handler) continue;
+
+        table[i].arg = arg;
+        table[i].count = 0;
+        __atomic_store_n(&table[i].handler, handler, __ATOMIC_RELEASE);
+        ++vectorCounts[cpuId];
+
+        out = {cpuId, static_cast<uint8_t>(IRQ::FIRST_DYNAMIC_VECTOR + i)};
+        return true;
+    }
+
+    return false;
+}
+
+IRQ::CpuMask IRQ::allCpus()
+{
+    CpuMask mask;
+    for (uint32_t i = 0; i < SMP::getCpuCount(); ++i) mask.set(i);
+
+    return mask;
+}
+
+IRQ::CpuMask effectiveMask(const IRQ::CpuMask& affinity)
+{
+    IRQ::CpuMask mask;
+    bool any = false;
+
+    for (uint32_t i = 0; i < SMP::MAX_CPUS / 64; ++i)
+    {
+        mask.bits[i] = affinity.bits[i] & ~__atomic_load_n(&isolatedCpus.bits[i], __ATOMIC_RELAXED);
+        any |= mask.bits[i] != 0;
+    }
+
+    return any ? mask : affinity;
+}
+
+uint32_t leastLoadedCpu(const IRQ::CpuMask& allowed)
+{
+    const uint32_t count = SMP::getCpuCount(), start = spreadCursor++ % count;
+    uint32_t best = IRQ::ANY_CPU;
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const uint32_t cpuId = (start + i) % count;
+        if (!allowed.test(cpuId) || !cpuAcceptsVectors(cpuId)) continue;
+        if (vectorCounts[cpuId] >= IRQ::DYNAMIC_VECTOR_COUNT - 1) continue;
+        if (best == IRQ::ANY_CPU || vectorCounts[cpuId] < vectorCounts[best]) best = cpuId;
+    }
+
+    return best;
+}
+
+bool IRQ::allocate(uint32_t cpuId, const Handler handler, void* arg, Vector& out)
+{
+    if (!handler) return false;
+    LockGuard guard(vectorLock);
+
+    if (cpuId == ANY_CPU) cpuId = leastLoadedCpu(effectiveMask(allCpus()));
+    if (!cpuAcceptsVectors(cpuId)) return false;
+
+    return allocateOn(cpuId, handler, arg, out);
+}
+
+uint32_t IRQ::allocateSpread(const uint32_t count, const Handler handler, void* const* args, Vector* out)
+{
+    if (!handler || !out) return 0;
+
+    uint32_t allocated = 0;
+    for (; allocated < count; ++allocated)
+        if (!allocate(ANY_CPU, handler, args ? args[allocated] : nullptr, out[allocated])) break;
+
+    return allocated;
+}
+
+void IRQ::free(const Vector& vector)
+{
+    if (vector.cpuId >= SMP::MAX_CPUS || vector.vector < FIRST_DYNAMIC_VECTOR || vector.vector > LAST_DYNAMIC_VECTOR)
+        return;
+
+    LockGuard guard(vectorLock);
+    VectorSlot* table = vectorTables[vector.cpuId];
+    if (!table) return;
+
+    VectorSlot& slot = table[vector.vector - FIRST_DYNAMIC_VECTOR];
+    if (!slot.handler) return;
+
+    __atomic_store_n(&slot.handler, nullptr, __ATOMIC_RELEASE);
+    --vectorCounts[vector.cpuId];
+}
+
+uint32_t IRQ::getAllocatedCount(const uint32_t cpuId)
+{
+    return cpuId < SMP::MAX_CPUS ? __atomic_load_n(&vectorCounts[cpuId], __ATOMIC_RELAXED) : 0;
+}
+
+void IRQ::dispatch(const uint8_t vector)
+{
+    Trace::point(Trace::Event::IRQ_ENTRY, vector);
+    Stats::add(Stats::IRQS + vector);
+
+    if (VectorSlot* table = vectorTables[CPUManager::getCurrentCPUId()])
+    {
+        VectorSlot& slot = table[vector - FIRST_DYNAMIC_VECTOR];
+        if (const Handler handler = __atomic_load_n(&slot.handler, __ATOMIC_ACQUIRE))
+        {
+            __atomic_store_n(&slot.count, slot.count + 1, __ATOMIC_RELAXED);
+            handler(slot.arg);
+        }
+    }
+
+    LAPIC::sendEOI();
+    Softirq::run();
+    Trace::point(Trace::Event::IRQ_EXIT, vector);
+}
+
+IrqLine* findLine(const IRQ::LineId line)
+{
+    return line < IRQ::MAX_LINES && irqLines[line].used ? &irqLines[line] : nullptr;
+}
+
+IRQ::LineId addLine(const IrqLine& info)
+{
+    LockGuard guard(lineLock);
+    for (IRQ::LineId i = 0; i < IRQ::MAX_LINES; ++i)
+    {
+        if (irqLines[i].used) continue;
+
+        irqLines[i] = info;
+        irqLines[i].affinity = IRQ::allCpus();
+        irqLines[i].used = true;
+
+        return i;
+    }
+
+    Serial::printf("IRQ: Line table full, cannot register %s\n", info.name);
+    return IRQ::INVALID_LINE;
+}
+
+uint64_t slotCount(const IRQ::Vector& vector)
+{
+    const VectorSlot* table = vectorTables[vector.cpuId];
+    return table ? __atomic_load_n(&table[vector.vector - IRQ::FIRST_DYNAMIC_VECTOR].count, __ATOMIC_RELAXED) : 0;
+}
+
+uint64_t lineCount(const IrqLine& line)
+{
+    if (line.ioapic) return Stats::read(static_cast<Stats::Id>(Stats::IRQS + line.vector.vector));
+
+    return line.carried + (line.retired.vector ? slotCount(line.retired) : 0) + slotCount(line.vector);
+}
+
+void retireVector(IrqLine& line)
+{
+    if (!line.retired.vector) return;
+
+    line.carried += slotCount(line.retired);
+    IRQ::free(line.retired);
+    line.retired = {};
+}
+
+bool moveLine(IrqLine& line, const uint32_t cpuId)
+{
+    if (line.vector.cpuId == cpuId) return true;
+    if (!cpuAcceptsVectors(cpuId) || cpus[cpuId].lapicId > 0xFF) return false;
+
+    if (line.ioapic)
+    {
+        IOAPIC::setDestination(line.gsi, static_cast<uint8_t>(cpus[cpuId].lapicId));
+        line.vector.cpuId = cpuId;
+
+        return true;
+    }
+
+    const VectorSlot& current = vectorTables[line.vector.cpuId][line.vector.vector - IRQ::FIRST_DYNAMIC_VECTOR];
+    const IRQ::Handler handler = __atomic_load_n(&current.handler, __ATOMIC_ACQUIRE);
+
+    IRQ::Vector next;
+    if (!handler || !IRQ::allocate(cpuId, handler, current.arg, next)) return false;
+    if (!line.retarget(line.owner, line.index, next))
+    {
+        IRQ::free(next);
+        return false;
+    }
+
+    retireVector(line);
+    line.retired = line.vector;
+    line.vector = next;
+
+    return true;
+}
+
+bool placeLine(IrqLine& line)
+{
+    const IRQ::CpuMask allowed = effectiveMask(line.affinity);
+    if (allowed.test(line.vector.cpuId)) return true;
+
+    uint32_t target;
+    {
+        LockGuard guard(vectorLock);
+        target = leastLoadedCpu(allowed);
+    }
+
+    return target != IRQ::ANY_CPU && moveLine(line, target);
+}
+
+IRQ::LineId IRQ::registerIoapicLine(const char* name, const uint32_t gsi, const uint8_t vector, const uint32_t cpuId)
+{
+    IrqLine line = {};
+    line.name = name;
+    line.vector = {cpuId, vector};
+    line.gsi = gsi;
+    line.ioapic = true;
+
+    return addLine(line);
+}
+
+IRQ::LineId IRQ::registerMsiLine(const char* name, const Vector& vector, const Retarget retarget, void* owner,
+                                 const uint32_t index)
+{
+    if (!retarget || vector.cpuId >= SMP::MAX_CPUS || vector.vector < FIRST_DYNAMIC_VECTOR ||
+        vector.vector > LAST_DYNAMIC_VECTOR)
+        return INVALID_LINE;
+
+    IrqLine line = {};
+    line.name = name;
+    line.vector = vector;
+    line.retarget = retarget;
+    line.owner = owner;
+    line.index = index;
+
+    return addLine(line);
+}
+
+void IRQ::unregisterLine(const LineId line)
+{
+    LockGuard guard(lineLock);
+    IrqLine* info = findLine(line);
+    if (!info) return;
+
+    if (!info->ioapic)
+    {
+        free(info->vector);
+        if (info->retired.vector) free(info->retired);
+    }
+
+    *info = {};
+}
+
+bool IRQ::setAffinity(const LineId line, const CpuMask& affinity)
+{
+    LockGuard guard(lineLock);
+    IrqLine* info = findLine(line);
+    if (!info) return false;
+
+    bool any = false;
+    for (uint32_t i = 0; i < SMP::getCpuCount(); ++i) any |= affinity.test(i) && cpuAcceptsVectors(i);
+    if (!any) return false;
+
+    info->affinity = affinity;
+    return placeLine(*info);
+}
+
+bool IRQ::setPinned(const LineId line, const bool pinned)
+{
+    LockGuard guard(lineLock);
+    IrqLine* info = findLine(line);
+    if (!info) return false;
+
+    info->pinned = pinned;
+    return true;
+}
+
+bool IRQ::migrate(const LineId line, const uint32_t cpuId)
+{
+    LockGuard guard(lineLock);
+    IrqLine* info = findLine(line);
+
+    return info && info->affinity.test(cpuId) && moveLine(*info, cpuId);
+}
+
+void IRQ::setIsolated(const CpuMask& isolated)
+{
+    LockGuard guard(lineLock);
+    for (uint32_t i = 0; i < SMP::MAX_CPUS / 64; ++i)
+        __atomic_store_n(&isolatedCpus.bits[i], isolated.bits[i], __ATOMIC_RELAXED);
+
+    for (IrqLine& line : irqLines)
+        if (line.used && !placeLine(line))
+            Serial::printf("IRQ: Cannot move %s off isolated CPU %u\n", line.name, line.vector.cpuId);
+}
+
+uint64_t IRQ::getLineCount(const LineId line)
+{
+    LockGuard guard(lineLock);
+    const IrqLine* info = findLine(line);
+
+    return info ? lineCount(*info) : 0;
+}
+
+void balanceLines(const uint32_t intervalMs)
+{
+    LockGuard guard(lineLock);
+    const uint32_t cpuCount = SMP::getCpuCount();
+    memset(cpuIrqLoad, 0, sizeof(cpuIrqLoad));
+
+    for (IrqLine& line : irqLines)
+    {
+        if (!line.used) continue;
+        retireVector(line);
+
+        const uint64_t total = lineCount(line);
+        line.rate = (total - line.lastCount) * 1000 / intervalMs;
+        line.lastCount = total;
+        cpuIrqLoad[line.vector.cpuId] += line.rate;
+    }
+
+    uint32_t source = 0;
+    for (uint32_t i = 1; i < cpuCount; ++i) if (cpuIrqLoad[i] > cpuIrqLoad[source]) source = i;
+
+    IrqLine* candidate = nullptr;
+    uint32_t target = IRQ::ANY_CPU;
+
+    for (IrqLine& line : irqLines)
+    {
+        if (!line.used || line.pinned || line.vector.cpuId != source || line.rate < BALANCE_MIN_RATE) continue;
+        if (candidate && line.rate <= candidate->rate) continue;
+
+        const IRQ::CpuMask allowed = effectiveMask(line.affinity);
+        uint32_t best = IRQ::ANY_CPU;
+
+        for (uint32_t i = 0; i < cpuCount; ++i)
+        {
+            if (i == source || !allowed.test(i) || !cpuAcceptsVectors(i)) continue;
+            if (best == IRQ::ANY_CPU || cpuIrqLoad[i] < cpuIrqLoad[best]) best = i;
+        }
+
+        if (best == IRQ::ANY_CPU || cpuIrqLoad[best] + line.rate >= cpuIrqLoad[source]) continue;
+
+        candidate = &line;
+        target = best;
+    }
+
+    if (candidate && moveLine(*candidate, target))
+        Serial::printf("IRQ: Moved %s from CPU %u to CPU %u (%lu/s)\n", candidate->name, source, target,
+                       candidate->rate);
+}
+
+void irqBalancerMain(void*)
+{
+    while (true)
+    {
+        const uint32_t intervalMs = __atomic_load_n(&balancerInterval, __ATOMIC_RELAXED);
+        Task::taskSleep(intervalMs);
+        balanceLines(intervalMs);
+    }
+}
+
+bool IRQ::startBalancer(const uint32_t intervalMs)
+{
+    if (intervalMs == 0) return false;
+    __atomic_store_n(&balancerInterval, intervalMs, __ATOMIC_RELAXED);
+
+    if (__atomic_exchange_n(&balancerStarted, true, __ATOMIC_ACQ_REL)) return true;
+
+    Task::Task* task = Task::taskCreate(irqBalancerMain, nullptr, IRQ_BALANCER_PRIORITY);
+    if (!task)
+    {
+        Serial::printf("IRQ: Failed to create balancer task\n");
+        __atomic_store_n(&balancerStarted, false, __ATOMIC_RELEASE);
+
+        return false;
+    }
+
+    Scheduler::addReady(&schedulers[CPUManager::getCurrentCPUId()], task);
+    return true;
+}
+
+void IRQ::dumpLines()
+{
+    LockGuard guard(lineLock);
+    for (const IrqLine& line : irqLines)
+        if (line.used)
+            Serial::printf("IRQ: %s cpu=%u vector=%x count=%lu rate=%lu%s\n", line.name, line.vector.cpuId,
+                           line.vector.vector, lineCount(line), line.rate, line.pinned ? " pinned" : "");
+}
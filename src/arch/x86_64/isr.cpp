@@ -1,8 +1,12 @@
+#include <arch/x86_64/ipi.h>
 #include <arch/x86_64/isr.h>
 #include <arch/x86_64/lapic.h>
 #include <core/panic.h>
+#include <core/stats.h>
+#include <core/trace.h>
 #include <drivers/keyboard.h>
 #include <memory/vmm.h>
+#include <task/softirq.h>
 
 const char* exceptionName(const uint64_t intNum)
 {
@@ -51,6 +55,8 @@ void showException(const Interrupt::Frame* frame, const uint64_t intNum, const u
     {
         uint64_t cr2 = 0;
         asm volatile ("mov %%cr2, %0" : "=r"(cr2));
+        Trace::point(Trace::Event::PAGE_FAULT, cr2, frame ? frame->rip : 0, static_cast<uint32_t>(errorCode));
+        Stats::add(Stats::PAGE_FAULTS);
 
         if (const VMM::Region* region = VMM::findRegion(cr2))
             Panic::panicFrame(
@@ -116,7 +122,21 @@ __attribute__ ((interrupt)) void isr31(const Interrupt::Frame* f) { showExceptio
 
 __attribute__ ((interrupt)) void isrKeyboard(Interrupt::Frame*)
 {
+    Trace::point(Trace::Event::IRQ_ENTRY, 0x21);
+    Stats::add(Stats::IRQS + 0x21);
     Keyboard::irq();
     LAPIC::sendEOI();
+    Softirq::run();
+    Trace::point(Trace::Event::IRQ_EXIT, 0x21);
+}
+
+__attribute__ ((interrupt)) void isrCallFunction(Interrupt::Frame*)
+{
+    Trace::point(Trace::Event::IRQ_ENTRY, IPI::VECTOR_CALL);
+    Stats::add(Stats::IRQS + IPI::VECTOR_CALL);
+    LAPIC::sendEOI();
+    IPI::processCalls();
+    Softirq::run();
+    Trace::point(Trace::Event::IRQ_EXIT, IPI::VECTOR_CALL);
 }
 }
@@ -1,14 +1,20 @@
 #include <arch/x86_64/isr.h>
 #include <arch/x86_64/lapic.h>
+#include <arch/x86_64/smp.h>
+#include <arch/x86_64/tsc.h>
 #include <drivers/serial.h>
 #include <memory/atomic.h>
+#include <memory/spinlock.h>
 
-constexpr uint32_t REG_SVR = 0xF0, REG_EOI = 0xB0, REG_LVT_TIMER = 0x320,
-                   REG_TIMER_INITIAL_COUNT = 0x380, REG_TIMER_CURRENT_COUNT = 0x390,
+constexpr uint32_t REG_ID = 0x20, REG_SVR = 0xF0, REG_EOI = 0xB0, REG_ICR_LOW = 0x300, REG_ICR_HIGH = 0x310,
+                   REG_LVT_TIMER = 0x320, REG_TIMER_INITIAL_COUNT = 0x380, REG_TIMER_CURRENT_COUNT = 0x390,
                    REG_TIMER_DIVIDE_CONFIG = 0x3E0;
+constexpr uint32_t MSR_APIC_BASE = 0x1B, MSR_X2APIC_BASE = 0x800, MSR_X2APIC_ICR = 0x830;
 
 volatile uint32_t *lapicRegisters = nullptr, *ioapicRegisters = nullptr;
 uint32_t globalIrqBase = 0;
+Spinlock ioapicLock;
+bool x2apicMode = false;
 
 Atomic apicTicks{0};
 bool isApicTimer32Bit = false;
@@ -51,13 +57,60 @@ void timerWaitTicks(const uint64_t ticks)
 void LAPIC::init(const uint64_t virtBase)
 {
     lapicRegisters = reinterpret_cast<volatile uint32_t*>(virtBase);
+
+    uint32_t low, high;
+    asm volatile ("rdmsr" : "=a"(low), "=d"(high) : "c"(MSR_APIC_BASE));
+    if (SMP::getCPUFeatures().hasX2APIC && !(low & (1u << 10)))
+    {
+        low |= (1u << 11) | (1u << 10);
+        asm volatile ("wrmsr" :: "c"(MSR_APIC_BASE), "a"(low), "d"(high) : "memory");
+    }
+    x2apicMode = low & (1u << 10);
+
     write(REG_SVR, (read(REG_SVR) & ~0xFFu) | 0xFFu | (1u << 8));
 }
 
-void LAPIC::write(const uint32_t reg, const uint32_t value) { lapicRegisters[reg / 4] = value; }
-uint32_t LAPIC::read(const uint32_t reg) { return lapicRegisters[reg / 4]; }
+void LAPIC::write(const uint32_t reg, const uint32_t value)
+{
+    if (x2apicMode) asm volatile ("wrmsr" :: "c"(MSR_X2APIC_BASE + (reg >> 4)), "a"(value), "d"(0) : "memory");
+    else lapicRegisters[reg / 4] = value;
+}
+
+uint32_t LAPIC::read(const uint32_t reg)
+{
+    if (!x2apicMode) return lapicRegisters[reg / 4];
+
+    uint32_t low, high;
+    asm volatile ("rdmsr" : "=a"(low), "=d"(high) : "c"(MSR_X2APIC_BASE + (reg >> 4)));
+
+    return low;
+}
+
 void LAPIC::sendEOI() { write(REG_EOI, 0); }
 
+void LAPIC::sendIPI(const uint32_t lapicId, const uint8_t vector)
+{
+    const uint32_t command = vector | (1u << 14);
+    if (x2apicMode)
+    {
+        asm volatile ("wrmsr" :: "c"(MSR_X2APIC_ICR), "a"(command), "d"(lapicId) : "memory");
+        return;
+    }
+
+    uint64_t rflags;
+    asm volatile ("pushfq\npopq %0" : "=r"(rflags) :: "memory");
+    Interrupt::disableInterrupts();
+
+    while (read(REG_ICR_LOW) & (1u << 12)) asm volatile ("pause");
+    write(REG_ICR_HIGH, lapicId << 24);
+    write(REG_ICR_LOW, command);
+
+    asm volatile ("pushq %0\npopfq" :: "r"(rflags) : "memory");
+}
+
+uint32_t LAPIC::getId() { return x2apicMode ? read(REG_ID) : read(REG_ID) >> 24; }
+bool LAPIC::isX2APIC() { return x2apicMode; }
+
 void LAPIC::timerInit(const uint8_t vector)
 {
     write(REG_LVT_TIMER, (read(REG_LVT_TIMER) & ~0xFFu) | vector | (1u << 16));
@@ -89,9 +142,11 @@ void LAPIC::timerCalibrate(const uint32_t sampleMs)
 {
     if (apicTimerPort == 0 || sampleMs == 0) return;
 
+    const uint64_t tscStart = TSC::read();
     write(REG_TIMER_INITIAL_COUNT, 0xFFFFFFFFu);
     timerWaitTicks(3579545u * sampleMs / 1000u);
 
+    TSC::setFrequency((TSC::read() - tscStart) * 1000u / sampleMs);
     apicTimerFrequency = (0xFFFFFFFFu - read(REG_TIMER_CURRENT_COUNT)) * 1000u / sampleMs;
     apicTimerTick = apicTimerFrequency / 1000u;
 
@@ -143,14 +198,34 @@ void IOAPIC::redirect(const uint32_t irq, const uint8_t vector, const uint8_t la
     write(reg + 1, static_cast<uint32_t>(entry >> 32));
 }
 
+void IOAPIC::setDestination(const uint32_t irq, const uint8_t lapicId)
+{
+    if (irq < globalIrqBase || !ioapicRegisters) return;
+
+    const uint32_t reg = 0x10 + (irq - globalIrqBase) * 2;
+    LockGuard guard(ioapicLock);
+
+    ioapicRegisters[0] = reg;
+    const uint32_t low = ioapicRegisters[4];
+    ioapicRegisters[4] = low | 1u << 16;
+
+    ioapicRegisters[0] = reg + 1;
+    ioapicRegisters[4] = static_cast<uint32_t>(lapicId) << 24;
+
+    ioapicRegisters[0] = reg;
+    ioapicRegisters[4] = low;
+}
+
 void IOAPIC::write(const uint32_t reg, const uint32_t value)
 {
+    LockGuard guard(ioapicLock);
     ioapicRegisters[0] = reg;
     ioapicRegisters[4] = value;
 }
 
 uint32_t IOAPIC::read(const uint32_t reg)
 {
+    LockGuard guard(ioapicLock);
     ioapicRegisters[0] = reg;
     return ioapicRegisters[4];
 }
@@ -9,6 +9,7 @@
 #include <memory/atomic.h>
 #include <memory/paging.h>
 #include <memory/spinlock.h>
+#include <task/task.h>
 
 struct ApBootInfo
 {
@@ -16,6 +17,15 @@ struct ApBootInfo
     uint32_t cpuId;
 };
 
+struct BootJob
+{
+    SMP::BootFn fn;
+    void* arg;
+    uint64_t chunks, nextChunk;
+    uint32_t generation, finished;
+    bool released;
+};
+
 extern limine_hhdm_request hhdm_request;
 extern limine_executable_address_request executable_addr_request;
 extern limine_mp_request mp_request;
@@ -31,12 +41,47 @@ Atomic apReadyCount{0};
 SMP::CPUFeatures cpuFeatures = {};
 uint32_t cpuCount = 0, cpuIds[SMP::MAX_CPUS] = {};
 uint64_t lapicPhysBase = 0, lapicVirtBase = 0;
+BootJob bootJob = {};
+
+void runBootChunks()
+{
+    const SMP::BootFn fn = bootJob.fn;
+    void* arg = bootJob.arg;
+    const uint64_t chunks = bootJob.chunks;
+
+    while (true)
+    {
+        const uint64_t chunk = __atomic_fetch_add(&bootJob.nextChunk, 1, __ATOMIC_ACQ_REL);
+        if (chunk >= chunks) return;
+
+        fn(chunk, arg);
+    }
+}
+
+void waitForBootJobs()
+{
+    uint32_t seen = 0;
+
+    while (!__atomic_load_n(&bootJob.released, __ATOMIC_ACQUIRE))
+    {
+        if (const uint32_t generation = __atomic_load_n(&bootJob.generation, __ATOMIC_ACQUIRE); generation != seen)
+        {
+            seen = generation;
+            runBootChunks();
+            __atomic_add_fetch(&bootJob.finished, 1, __ATOMIC_RELEASE);
+        }
+
+        asm volatile ("pause");
+    }
+}
 
 extern "C" void apMain(uint32_t cpuId)
 {
     GDTManager::load();
     IDTManager::load();
     GDTManager::loadTR(cpuId);
+    Paging::enable();
+    LAPIC::init(SMP::getLapicBase());
 
     if (uint32_t lapicId = SMP::getLapicId(); !CPUManager::initCPU(cpuId, lapicId))
     {
@@ -44,15 +89,17 @@ extern "C" void apMain(uint32_t cpuId)
         while (true) asm volatile ("hlt");
     }
 
-    LAPIC::init(SMP::getLapicBase());
+    apReadyCount.increment();
+    waitForBootJobs();
+
     if (!CPUManager::initRuntime(cpuId))
     {
         Renderer::printf("\x1b[31m[AP] Failed to initialize CPU %u runtime!\x1b[0m\n", cpuId);
         while (true) asm volatile ("hlt");
     }
 
-    apReadyCount.increment();
     Interrupt::enableInterrupts();
+    Task::taskYield();
 
     while (true) asm volatile ("hlt");
 }
@@ -127,6 +174,24 @@ void SMP::init()
     else Renderer::printf("\x1b[32mAll %u cores online!\x1b[0m\n", cpuCount);
 }
 
+void SMP::bootParallel(const BootFn fn, void* arg, const uint64_t chunks)
+{
+    if (!fn || chunks == 0) return;
+
+    const uint32_t parked = apReadyCount.load();
+    bootJob.fn = fn;
+    bootJob.arg = arg;
+    bootJob.chunks = chunks;
+    __atomic_store_n(&bootJob.nextChunk, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&bootJob.finished, 0, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&bootJob.generation, 1, __ATOMIC_RELEASE);
+
+    runBootChunks();
+    while (__atomic_load_n(&bootJob.finished, __ATOMIC_ACQUIRE) < parked) asm volatile ("pause");
+}
+
+void SMP::releaseAPs() { __atomic_store_n(&bootJob.released, true, __ATOMIC_RELEASE); }
+
 void SMP::detectCPUFeatures()
 {
     uint32_t eax, ebx, ecx, edx;
@@ -170,13 +235,7 @@ uint32_t SMP::getLapicId()
     uint32_t low, high;
     asm volatile ("rdmsr" : "=a"(low), "=d"(high) : "c"(0x1B));
 
-    if ((static_cast<uint64_t>(high) << 32 | low) & 1ULL << 10)
-    {
-        uint32_t idLow, idHigh;
-        asm volatile ("rdmsr" : "=a"(idLow), "=d"(idHigh) : "c"(0x802));
-
-        return idLow;
-    }
+    if ((static_cast<uint64_t>(high) << 32 | low) & 1ULL << 10) return LAPIC::getId();
 
     auto* lapic = reinterpret_cast<volatile uint32_t*>(lapicVirtBase);
     return lapic[0x20 / 4] >> 24;
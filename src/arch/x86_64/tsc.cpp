@@ -0,0 +1,26 @@
+#include <arch/x86_64/tsc.h>
+
+uint64_t tscFrequency = 0;
+
+uint64_t TSC::read()
+{
+    uint32_t low, high;
+    asm volatile ("rdtsc" : "=a"(low), "=d"(high));
+
+    return static_cast<uint64_t>(high) << 32 | low;
+}
+
+void TSC::setFrequency(const uint64_t hz) { tscFrequency = hz; }
+uint64_t TSC::getFrequency() { return tscFrequency; }
+
+uint64_t TSC::toNanoseconds(const uint64_t cycles)
+{
+    if (!tscFrequency) return 0;
+    return cycles / tscFrequency * 1000000000u + cycles % tscFrequency * 1000000000u / tscFrequency;
+}
+
+uint64_t TSC::toMicroseconds(const uint64_t cycles)
+{
+    if (!tscFrequency) return 0;
+    return cycles / tscFrequency * 1000000u + cycles % tscFrequency * 1000000u / tscFrequency;
+}
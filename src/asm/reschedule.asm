@@ -0,0 +1,50 @@
+bits 64
+default rel
+
+section .text
+    global isrReschedule
+    extern schedulerRescheduleIRQ
+
+isrReschedule:
+    push rax
+    push rbx
+    push rcx
+    push rdx
+    push rbp
+    push rsi
+    push rdi
+    push r8
+    push r9
+    push r10
+    push r11
+    push r12
+    push r13
+    push r14
+    push r15
+
+    push qword 0
+    lea rdi, [rsp + 8]
+    call schedulerRescheduleIRQ
+    add rsp, 8
+
+    test rax, rax
+    jz .noSwitch
+    mov rsp, rax
+.noSwitch:
+    pop r15
+    pop r14
+    pop r13
+    pop r12
+    pop r11
+    pop r10
+    pop r9
+    pop r8
+    pop rdi
+    pop rsi
+    pop rbp
+    pop rdx
+    pop rcx
+    pop rbx
+    pop rax
+
+    iretq
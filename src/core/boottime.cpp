@@ -0,0 +1,43 @@
+#include <arch/x86_64/tsc.h>
+#include <core/boottime.h>
+#include <drivers/renderer.h>
+
+struct BootPhase
+{
+    const char* name;
+    uint64_t start;
+};
+
+constexpr size_t MAX_BOOT_PHASES = 32;
+
+BootPhase bootPhases[MAX_BOOT_PHASES] = {};
+size_t bootPhaseCount = 0;
+uint64_t bootStart = 0;
+
+void BootTime::phase(const char* name)
+{
+    const uint64_t now = TSC::read();
+    if (!bootStart) bootStart = now;
+    if (bootPhaseCount < MAX_BOOT_PHASES) bootPhases[bootPhaseCount++] = {name, now};
+}
+
+void BootTime::report()
+{
+    const uint64_t end = TSC::read();
+    if (!bootPhaseCount) return;
+
+    if (!TSC::getFrequency())
+    {
+        Renderer::printf("\x1b[33mBoot timing unavailable: TSC not calibrated.\x1b[0m\n");
+        return;
+    }
+
+    Renderer::printf("\x1b[36mBoot timing (TSC %lu kHz):\x1b[0m\n", TSC::getFrequency() / 1000);
+    for (size_t i = 0; i < bootPhaseCount; ++i)
+    {
+        const uint64_t phaseEnd = i + 1 < bootPhaseCount ? bootPhases[i + 1].start : end;
+        Renderer::printf("  %s: %lu us\n", bootPhases[i].name, TSC::toMicroseconds(phaseEnd - bootPhases[i].start));
+    }
+
+    Renderer::printf("  Total: %lu us\n", TSC::toMicroseconds(end - bootStart));
+}
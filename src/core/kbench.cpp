@@ -0,0 +1,505 @@
+#include <arch/x86_64/cpu.h>
+#include <arch/x86_64/isr.h>
+#include <arch/x86_64/tsc.h>
+#include <core/kbench.h>
+#include <drivers/block.h>
+#include <drivers/serial.h>
+#include <fs/vfs.h>
+#include <memory/buddy.h>
+#include <memory/pagecache.h>
+#include <memory/paging.h>
+#include <memory/slab.h>
+#include <memory/vmm.h>
+#include <task/parallel.h>
+#include <task/scheduler.h>
+
+struct BenchSlot
+{
+    uint64_t* samples;
+    uint64_t totalCycles;
+    uint32_t errors;
+};
+
+struct BenchRun
+{
+    const KBench::Benchmark* benchmark;
+    BenchSlot slots[SMP::MAX_CPUS];
+    uint32_t ready, done;
+    bool go;
+};
+
+struct MapBenchState
+{
+    void* window;
+    uint64_t frame;
+};
+
+struct BlockBenchState
+{
+    Block::Device* device;
+    void* buffer;
+    uint64_t seed;
+};
+
+struct ParallelBenchState
+{
+    uint32_t* hits;
+    uint32_t pass, spawned;
+};
+
+constexpr int BENCH_WORKER_PRIORITY = Task::MAX_PRIORITY - 1;
+
+extern Scheduler::Scheduler schedulers[SMP::MAX_CPUS];
+
+KBench::Benchmark benchmarks[KBench::MAX_BENCHMARKS] = {};
+uint32_t benchmarkCount = 0;
+bool builtinsRegistered = false;
+BenchRun benchRun = {};
+
+bool benchBuddyOrder0(void*)
+{
+    const uint64_t page = BuddyAllocator::alloc(0);
+    BuddyAllocator::free(page, 0);
+
+    return page != 0;
+}
+
+bool benchBuddyOrder4(void*)
+{
+    const uint64_t block = BuddyAllocator::alloc(4);
+    BuddyAllocator::free(block, 4);
+
+    return block != 0;
+}
+
+bool benchBuddyZeroed(void*)
+{
+    const uint64_t page = BuddyAllocator::alloc(0, AllocFlags::ZEROED);
+    BuddyAllocator::free(page, 0);
+
+    return page != 0;
+}
+
+bool benchSlab64(void*)
+{
+    void* object = SlabAllocator::alloc(64);
+    SlabAllocator::free(object);
+
+    return object != nullptr;
+}
+
+bool benchSlab1024(void*)
+{
+    void* object = SlabAllocator::alloc(1024);
+    SlabAllocator::free(object);
+
+    return object != nullptr;
+}
+
+bool benchVmmAllocate(void*)
+{
+    void* region = VMM::allocate(FrameAllocator::SMALL_SIZE, VMM::RegionType::ANONYMOUS,
+                                 PageFlags::RW | PageFlags::NO_EXECUTE);
+    if (!region) return false;
+
+    return VMM::unmap(region);
+}
+
+void* setupPagingMap(uint32_t)
+{
+    auto* state = static_cast<MapBenchState*>(SlabAllocator::alloc(sizeof(MapBenchState), alignof(MapBenchState)));
+    if (!state) return nullptr;
+
+    state->window = VMM::reserve(FrameAllocator::SMALL_SIZE, VMM::RegionType::RESERVED, PageFlags::RW);
+    state->frame = reinterpret_cast<uint64_t>(FrameAllocator::alloc());
+    return state;
+}
+
+bool benchPagingMap(void* arg)
+{
+    const auto* state = static_cast<MapBenchState*>(arg);
+    if (!state || !state->window || !state->frame) return false;
+
+    const auto virt = reinterpret_cast<uint64_t>(state->window);
+    if (!Paging::map(virt, state->frame, FrameAllocator::SMALL_SIZE,
+                     PageFlags::PRESENT | PageFlags::RW | PageFlags::NO_EXECUTE))
+        return false;
+
+    Paging::unmap(virt, FrameAllocator::SMALL_SIZE);
+    return true;
+}
+
+void teardownPagingMap(void* arg)
+{
+    auto* state = static_cast<MapBenchState*>(arg);
+    if (!state) return;
+
+    if (state->window) VMM::unmap(state->window);
+    if (state->frame) FrameAllocator::free(reinterpret_cast<void*>(state->frame));
+    SlabAllocator::free(state);
+}
+
+bool benchYield(void*)
+{
+    Task::taskYield();
+    return true;
+}
+
+constexpr uint64_t PARALLEL_BENCH_ITEMS = 16384;
+constexpr uint32_t PARALLEL_BENCH_TASKS = 64;
+
+void* setupParallelBench(uint32_t)
+{
+    auto* state = static_cast<ParallelBenchState*>(SlabAllocator::alloc(sizeof(ParallelBenchState),
+                                                                        alignof(ParallelBenchState)));
+    if (!state) return nullptr;
+
+    state->hits = static_cast<uint32_t*>(VMM::allocate(PARALLEL_BENCH_ITEMS * sizeof(uint32_t),
+                                                       VMM::RegionType::HEAP, PageFlags::RW | PageFlags::NO_EXECUTE));
+    if (state->hits) memset(state->hits, 0, PARALLEL_BENCH_ITEMS * sizeof(uint32_t));
+    state->pass = state->spawned = 0;
+
+    return state;
+}
+
+void teardownParallelBench(void* arg)
+{
+    auto* state = static_cast<ParallelBenchState*>(arg);
+    if (!state) return;
+
+    if (state->hits) VMM::unmap(state->hits);
+    SlabAllocator::free(state);
+}
+
+void markParallelRange(const uint64_t begin, const uint64_t end, void* arg)
+{
+    auto* hits = static_cast<uint32_t*>(arg);
+    for (uint64_t i = begin; i < end; ++i) __atomic_add_fetch(&hits[i], 1, __ATOMIC_RELAXED);
+}
+
+bool benchParallelFor(void* arg)
+{
+    auto* state = static_cast<ParallelBenchState*>(arg);
+    if (!state || !state->hits) return false;
+
+    const uint32_t pass = ++state->pass;
+    Parallel::parallelFor(0, PARALLEL_BENCH_ITEMS, 0, markParallelRange, state->hits);
+
+    for (uint64_t i = 0; i < PARALLEL_BENCH_ITEMS; ++i)
+        if (__atomic_load_n(&state->hits[i], __ATOMIC_RELAXED) != pass) return false;
+
+    return true;
+}
+
+void countParallelTask(void* arg)
+{
+    __atomic_add_fetch(&static_cast<ParallelBenchState*>(arg)->spawned, 1, __ATOMIC_RELAXED);
+}
+
+bool benchParallelSpawnJoin(void* arg)
+{
+    auto* state = static_cast<ParallelBenchState*>(arg);
+    if (!state) return false;
+
+    Parallel::TaskGroup group;
+    state->spawned = 0;
+    for (uint32_t i = 0; i < PARALLEL_BENCH_TASKS; ++i) Parallel::spawn(&group, countParallelTask, state);
+    Parallel::join(&group);
+
+    return __atomic_load_n(&state->spawned, __ATOMIC_RELAXED) == PARALLEL_BENCH_TASKS;
+}
+
+constexpr uint32_t BLOCK_BENCH_BUFFER = 65536;
+
+void* setupBlockBench(const uint32_t cpuId)
+{
+    auto* state = static_cast<BlockBenchState*>(SlabAllocator::alloc(sizeof(BlockBenchState),
+                                                                     alignof(BlockBenchState)));
+    if (!state) return nullptr;
+
+    state->device = Block::getDevice(0);
+    state->buffer = SlabAllocator::alloc(BLOCK_BENCH_BUFFER, FrameAllocator::SMALL_SIZE);
+    state->seed = TSC::read() ^ (static_cast<uint64_t>(cpuId + 1) * 0x9E3779B97F4A7C15ULL);
+    return state;
+}
+
+void teardownBlockBench(void* arg)
+{
+    auto* state = static_cast<BlockBenchState*>(arg);
+    if (!state) return;
+
+    if (state->buffer) SlabAllocator::free(state->buffer);
+    SlabAllocator::free(state);
+}
+
+bool runBlockBench(void* arg, const Block::Op op, const uint32_t sectors)
+{
+    auto* state = static_cast<BlockBenchState*>(arg);
+    if (!state || !state->device || !state->buffer || state->device->sectors < BLOCK_BENCH_BUFFER / Block::SECTOR_SIZE)
+        return false;
+
+    state->seed ^= state->seed << 13;
+    state->seed ^= state->seed >> 7;
+    state->seed ^= state->seed << 17;
+
+    const uint64_t slots = (state->device->sectors - sectors) / sectors + 1;
+    return Block::transfer(state->device, op, state->seed % slots * sectors, sectors, state->buffer) ==
+           Block::Status::OK;
+}
+
+bool benchBlockRead4k(void* arg) { return runBlockBench(arg, Block::Op::READ, 8); }
+
+bool benchBlockRead64k(void* arg) { return runBlockBench(arg, Block::Op::READ, 128); }
+
+bool benchBlockWrite4k(void* arg) { return runBlockBench(arg, Block::Op::WRITE, 8); }
+
+constexpr uint64_t PAGE_CACHE_BENCH_SPAN = 1024 * 1024;
+
+bool benchPageCacheHot64k(void* arg)
+{
+    auto* state = static_cast<BlockBenchState*>(arg);
+    if (!state || !state->device || !state->buffer) return false;
+
+    PageCache::Mapping* mapping = PageCache::blockMapping(state->device);
+    if (!mapping || mapping->size < PAGE_CACHE_BENCH_SPAN) return false;
+
+    state->seed = state->seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    const uint64_t offset = (state->seed >> 33) % (PAGE_CACHE_BENCH_SPAN / BLOCK_BENCH_BUFFER) * BLOCK_BENCH_BUFFER;
+    return PageCache::read(mapping, offset, state->buffer, BLOCK_BENCH_BUFFER) == BLOCK_BENCH_BUFFER;
+}
+
+const KBench::Benchmark blockBenchmarks[] = {
+    {"blk_read_4k", setupBlockBench, benchBlockRead4k, teardownBlockBench, 4096},
+    {"blk_read_64k", setupBlockBench, benchBlockRead64k, teardownBlockBench, 1024},
+    {"blk_write_4k", setupBlockBench, benchBlockWrite4k, teardownBlockBench, 4096},
+    {"pagecache_read_hot_64k", setupBlockBench, benchPageCacheHot64k, teardownBlockBench, 4096}
+};
+
+void* setupVfsBench(uint32_t)
+{
+    const char* paths[] = {"/kbench", "/kbench/a", "/kbench/a/b", "/kbench/a/b/c"};
+    for (const char* path : paths) VFS::create(path, VFS::InodeType::DIRECTORY);
+
+    return nullptr;
+}
+
+bool benchVfsLookup(void*)
+{
+    VFS::Dentry* dentry;
+    if (VFS::lookup("/kbench/a/b/c", &dentry) != VFS::Status::OK) return false;
+
+    VFS::release(dentry);
+    return true;
+}
+
+bool benchVfsLookupNegative(void*)
+{
+    VFS::Dentry* dentry;
+    return VFS::lookup("/kbench/a/b/missing", &dentry) == VFS::Status::NOT_FOUND;
+}
+
+const KBench::Benchmark builtinBenchmarks[] = {
+    {"buddy_alloc_free_order0", nullptr, benchBuddyOrder0, nullptr, 16384},
+    {"buddy_alloc_free_order4", nullptr, benchBuddyOrder4, nullptr, 16384},
+    {"buddy_alloc_zeroed", nullptr, benchBuddyZeroed, nullptr, 4096},
+    {"slab_alloc_free_64", nullptr, benchSlab64, nullptr, 16384},
+    {"slab_alloc_free_1024", nullptr, benchSlab1024, nullptr, 16384},
+    {"vmm_allocate_unmap_4k", nullptr, benchVmmAllocate, nullptr, 4096},
+    {"paging_map_unmap_4k", setupPagingMap, benchPagingMap, teardownPagingMap, 16384},
+    {"task_yield", nullptr, benchYield, nullptr, 16384},
+    {"parallel_for_16k", setupParallelBench, benchParallelFor, teardownParallelBench, 1024},
+    {"parallel_spawn_join_64", setupParallelBench, benchParallelSpawnJoin, teardownParallelBench, 4096},
+    {"vfs_lookup_hot", setupVfsBench, benchVfsLookup, nullptr, 16384},
+    {"vfs_lookup_negative", setupVfsBench, benchVfsLookupNegative, nullptr, 16384}
+};
+
+void siftDown(uint64_t* values, uint64_t root, const uint64_t count)
+{
+    while (root * 2 + 1 < count)
+    {
+        uint64_t child = root * 2 + 1;
+        if (child + 1 < count && values[child] < values[child + 1]) ++child;
+        if (values[root] >= values[child]) return;
+
+        const uint64_t tmp = values[root];
+        values[root] = values[child];
+        values[child] = tmp;
+        root = child;
+    }
+}
+
+void sortSamples(uint64_t* values, const uint64_t count)
+{
+    if (count < 2) return;
+
+    for (uint64_t i = count / 2; i-- > 0;) siftDown(values, i, count);
+    for (uint64_t end = count - 1; end > 0; --end)
+    {
+        const uint64_t tmp = values[0];
+        values[0] = values[end];
+        values[end] = tmp;
+        siftDown(values, 0, end);
+    }
+}
+
+void runBenchLoop(const uint32_t slotIndex)
+{
+    const KBench::Benchmark* benchmark = benchRun.benchmark;
+    BenchSlot& slot = benchRun.slots[slotIndex];
+    void* state = benchmark->setup ? benchmark->setup(slotIndex) : nullptr;
+
+    __atomic_add_fetch(&benchRun.ready, 1, __ATOMIC_ACQ_REL);
+    while (!__atomic_load_n(&benchRun.go, __ATOMIC_ACQUIRE)) asm volatile ("pause");
+
+    const uint64_t start = TSC::read();
+    for (uint32_t i = 0; i < benchmark->iterations; ++i)
+    {
+        const uint64_t before = TSC::read();
+        if (!benchmark->run(state)) ++slot.errors;
+        slot.samples[i] = TSC::read() - before;
+    }
+
+    slot.totalCycles = TSC::read() - start;
+    if (benchmark->teardown) benchmark->teardown(state);
+
+    __atomic_add_fetch(&benchRun.done, 1, __ATOMIC_ACQ_REL);
+}
+
+void benchWorkerMain(void* arg) { runBenchLoop(static_cast<uint32_t>(reinterpret_cast<uint64_t>(arg))); }
+
+void waitForCount(const uint32_t* counter, const uint32_t target)
+{
+    while (__atomic_load_n(counter, __ATOMIC_ACQUIRE) < target) asm volatile ("pause");
+}
+
+bool reportSlot(const KBench::Benchmark& benchmark, const uint32_t cpuCount, const uint32_t cpuId, uint64_t& opsSum)
+{
+    BenchSlot& slot = benchRun.slots[cpuId];
+    const uint64_t count = benchmark.iterations;
+    sortSamples(slot.samples, count);
+
+    const uint64_t elapsed = TSC::toNanoseconds(slot.totalCycles);
+    const uint64_t opsPerSec = elapsed ? count * 1000000000ULL / elapsed : 0;
+    opsSum += opsPerSec;
+
+    Serial::printf("KBENCH bench=%s cpus=%u cpu=%u iters=%lu min_ns=%lu median_ns=%lu p99_ns=%lu max_ns=%lu "
+                   "ops_per_sec=%lu errors=%u\n", benchmark.name, cpuCount, cpuId, count,
+                   TSC::toNanoseconds(slot.samples[0]), TSC::toNanoseconds(slot.samples[count / 2]),
+                   TSC::toNanoseconds(slot.samples[count * 99 / 100]), TSC::toNanoseconds(slot.samples[count - 1]),
+                   opsPerSec, slot.errors);
+
+    return slot.errors == 0;
+}
+
+bool runBenchmark(const KBench::Benchmark& benchmark, const uint32_t cpuCount)
+{
+    benchRun.benchmark = &benchmark;
+    benchRun.ready = benchRun.done = 0;
+    benchRun.go = false;
+
+    uint32_t launched = 1;
+    bool ok = true;
+
+    for (uint32_t i = 0; i < cpuCount; ++i)
+    {
+        BenchSlot& slot = benchRun.slots[i];
+        slot = {};
+        slot.samples = static_cast<uint64_t*>(VMM::allocate(benchmark.iterations * sizeof(uint64_t),
+                                                            VMM::RegionType::HEAP, PageFlags::RW |
+                                                            PageFlags::NO_EXECUTE));
+        if (!slot.samples) ok = false;
+    }
+
+    for (uint32_t i = 1; ok && i < cpuCount; ++i)
+    {
+        Task::Task* task = Task::taskCreate(benchWorkerMain, reinterpret_cast<void*>(static_cast<uint64_t>(i)),
+                                            BENCH_WORKER_PRIORITY);
+        if (!task)
+        {
+            ok = false;
+            break;
+        }
+
+        Scheduler::addReady(&schedulers[i], task);
+        ++launched;
+    }
+
+    if (ok && launched == cpuCount)
+    {
+        waitForCount(&benchRun.ready, cpuCount - 1);
+        __atomic_store_n(&benchRun.go, true, __ATOMIC_RELEASE);
+        runBenchLoop(0);
+        waitForCount(&benchRun.done, cpuCount);
+
+        uint64_t opsSum = 0;
+        for (uint32_t i = 0; i < cpuCount; ++i) ok &= reportSlot(benchmark, cpuCount, i, opsSum);
+        Serial::printf("KBENCH_TOTAL bench=%s cpus=%u ops_per_sec=%lu\n", benchmark.name, cpuCount, opsSum);
+    }
+    else
+    {
+        __atomic_store_n(&benchRun.go, true, __ATOMIC_RELEASE);
+        waitForCount(&benchRun.done, launched - 1);
+        Serial::printf("KBENCH_ERROR bench=%s cpus=%u reason=setup\n", benchmark.name, cpuCount);
+    }
+
+    for (uint32_t i = 0; i < cpuCount; ++i)
+        if (benchRun.slots[i].samples) VMM::unmap(benchRun.slots[i].samples);
+
+    return ok;
+}
+
+bool KBench::registerBenchmark(const Benchmark& benchmark)
+{
+    if (!benchmark.name || !benchmark.run || benchmark.iterations == 0 || benchmark.iterations > MAX_ITERATIONS)
+        return false;
+    if (benchmarkCount >= MAX_BENCHMARKS) return false;
+
+    benchmarks[benchmarkCount++] = benchmark;
+    return true;
+}
+
+bool KBench::runAll(uint32_t maxCpus)
+{
+    if (!builtinsRegistered)
+    {
+        builtinsRegistered = true;
+        for (const Benchmark& benchmark : builtinBenchmarks) registerBenchmark(benchmark);
+        if (Block::getDeviceCount())
+            for (const Benchmark& benchmark : blockBenchmarks) registerBenchmark(benchmark);
+    }
+
+    if (!TSC::getFrequency())
+    {
+        Serial::printf("KBENCH_ERROR reason=tsc_uncalibrated\n");
+        return false;
+    }
+
+    if (CPUManager::getCurrentCPUId() != 0 || !Interrupt::interruptsEnabled())
+    {
+        Serial::printf("KBENCH_ERROR reason=must_run_on_bsp_with_interrupts\n");
+        return false;
+    }
+
+    uint32_t online = 0;
+    while (online < SMP::getCpuCount() && cpus[online].online) ++online;
+    if (maxCpus == 0 || maxCpus > online) maxCpus = online;
+
+    Serial::printf("KBENCH_BEGIN benchmarks=%u cpus=%u tsc_khz=%lu\n", benchmarkCount, maxCpus,
+                   TSC::getFrequency() / 1000);
+
+    bool ok = true;
+    for (uint32_t i = 0; i < benchmarkCount; ++i)
+        for (uint32_t cpuCount = 1; cpuCount <= maxCpus; ++cpuCount) ok &= runBenchmark(benchmarks[i], cpuCount);
+
+    if (Block::getDeviceCount()) Block::dumpStats();
+    Serial::printf("KBENCH_END status=%s\n", ok ? "ok" : "fail");
+    return ok;
+}
+
+void KBench::exit(const uint8_t code)
+{
+    outb(EXIT_PORT, code);
+
+    Interrupt::disableInterrupts();
+    while (true) asm volatile ("hlt");
+}
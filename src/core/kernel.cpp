@@ -2,14 +2,29 @@
 #include <arch/x86_64/cpu.h>
 #include <arch/x86_64/gdt.h>
 #include <arch/x86_64/idt.h>
+#include <arch/x86_64/ipi.h>
+#include <arch/x86_64/irq.h>
 #include <arch/x86_64/isr.h>
 #include <arch/x86_64/lapic.h>
 #include <arch/x86_64/smp.h>
+#include <core/boottime.h>
+#include <core/kbench.h>
 #include <core/limine.h>
 #include <core/panic.h>
+#include <core/profiler.h>
+#include <core/stats.h>
+#include <core/trace.h>
+#include <drivers/ahci.h>
+#include <drivers/block.h>
 #include <drivers/keyboard.h>
+#include <drivers/nvme.h>
+#include <drivers/pci.h>
 #include <drivers/renderer.h>
+#include <drivers/virtioblk.h>
+#include <fs/initramfs.h>
+#include <fs/vfs.h>
 #include <memory/buddy.h>
+#include <memory/pagecache.h>
 #include <memory/paging.h>
 #include <memory/slab.h>
 
@@ -19,12 +34,32 @@ extern limine_hhdm_request hhdm_request;
 extern limine_executable_address_request executable_addr_request;
 extern limine_mp_request mp_request;
 extern limine_date_at_boot_request date_at_boot_request;
+extern limine_rsdp_request rsdp_request;
+extern limine_executable_file_request executable_file_request;
+extern limine_module_request module_request;
 
 extern "C" void isrTimer();
 extern "C" void isrYield();
+extern "C" void isrReschedule();
 
 extern Scheduler::Scheduler schedulers[SMP::MAX_CPUS];
 
+constexpr size_t MAX_PRESERVED_MEMMAP_ENTRIES = 256, MAX_PRESERVED_FRAMEBUFFERS = 4;
+
+limine_hhdm_response hhdmCopy = {};
+limine_memmap_response memmapCopy = {};
+limine_memmap_entry memmapEntryCopies[MAX_PRESERVED_MEMMAP_ENTRIES] = {};
+limine_memmap_entry* memmapEntryPointers[MAX_PRESERVED_MEMMAP_ENTRIES] = {};
+limine_executable_address_response executableAddressCopy = {};
+limine_date_at_boot_response dateAtBootCopy = {};
+limine_rsdp_response rsdpCopy = {};
+limine_mp_response mpCopy = {};
+limine_mp_info mpInfoCopies[SMP::MAX_CPUS] = {};
+limine_mp_info* mpInfoPointers[SMP::MAX_CPUS] = {};
+limine_framebuffer_response framebufferCopy = {};
+limine_framebuffer framebufferCopies[MAX_PRESERVED_FRAMEBUFFERS] = {};
+limine_framebuffer* framebufferPointers[MAX_PRESERVED_FRAMEBUFFERS] = {};
+
 void initSIMD()
 {
     SMP::detectCPUFeatures();
@@ -107,9 +142,12 @@ void initIDT()
 {
     Renderer::printf("\x1b[36mInitializing IDT... ");
     IDTManager::init();
+    IRQ::init();
     IDTManager::setEntry(0x21, reinterpret_cast<void(*)()>(isrKeyboard), 0x8E, 0);
     IDTManager::setEntry(0x22, isrTimer, 0x8E, 0);
     IDTManager::setEntry(0x80, isrYield, 0x8E, 0);
+    IDTManager::setEntry(IPI::VECTOR_CALL, reinterpret_cast<void(*)()>(isrCallFunction), 0x8E, 0);
+    IDTManager::setEntry(IPI::VECTOR_RESCHEDULE, isrReschedule, 0x8E, 0);
     IDTManager::load();
     Renderer::printf("\x1b[32mDone!\n");
 }
@@ -119,8 +157,15 @@ void initPaging()
     Renderer::printf("\x1b[36mInitializing Paging... ");
     if (!FrameAllocator::init()) Panic::panic("Failed to initialize FrameAllocator.");
     if (!Paging::init()) Panic::panic("Failed to initialize Paging.");
+    Renderer::printf("\x1b[32mDone!\n");
+}
+
+void initMemory()
+{
+    Renderer::printf("\x1b[36mInitializing Memory Allocators on %u CPUs... ", SMP::getCpuCount());
     if (!BuddyAllocator::init()) Panic::panic("Failed to initialize BuddyAllocator.");
     if (!SlabAllocator::init()) Panic::panic("Failed to initialize SlabAllocator.");
+    SMP::releaseAPs();
     Renderer::printf("\x1b[32mDone!\n");
 }
 
@@ -151,6 +196,7 @@ void initIOAPIC()
 
     ACPI::resolveIsa(madt, 1, globalIrq, activeLow, levelTriggered);
     IOAPIC::redirect(globalIrq, 0x21, lapicId, activeLow, levelTriggered);
+    IRQ::registerIoapicLine("keyboard", globalIrq, 0x21, 0);
 
     outb(0x21, 0xFF);
     outb(0xA1, 0xFF);
@@ -158,45 +204,231 @@ void initIOAPIC()
     Renderer::printf("\x1b[32mDone!\x1b[0m\n");
 }
 
+void initPCI()
+{
+    Renderer::printf("\x1b[36mEnumerating PCI devices... ");
+
+    VirtioBlk::init();
+    Nvme::init();
+    AHCI::init();
+
+    ACPI::MCFGInfo mcfg = {};
+    ACPI::findMCFG(mcfg);
+    if (!PCI::init(mcfg))
+    {
+        Renderer::printf("\x1b[31mNo PCI devices found.\x1b[0m\n");
+        return;
+    }
+
+    PCI::dump();
+    Renderer::printf("\x1b[32m%u devices, %u block devices\x1b[0m\n", PCI::getDeviceCount(), Block::getDeviceCount());
+}
+
+void startLapicTimer(void*)
+{
+    LAPIC::timerInit(0x22);
+    LAPIC::timerSetDivide(16);
+    LAPIC::timerPeriodic();
+    CPUManager::getCurrentCPU()->timerReady = true;
+}
+
+bool preserveLimineResponses()
+{
+    if (memmap_request.response->entry_count > MAX_PRESERVED_MEMMAP_ENTRIES) return false;
+    if (mp_request.response && mp_request.response->cpu_count > SMP::MAX_CPUS) return false;
+
+    hhdmCopy = *hhdm_request.response;
+    hhdm_request.response = &hhdmCopy;
+
+    memmapCopy = *memmap_request.response;
+    for (size_t i = 0; i < memmapCopy.entry_count; ++i)
+    {
+        memmapEntryCopies[i] = *memmap_request.response->entries[i];
+        memmapEntryPointers[i] = &memmapEntryCopies[i];
+    }
+    memmapCopy.entries = memmapEntryPointers;
+    memmap_request.response = &memmapCopy;
+
+    executableAddressCopy = *executable_addr_request.response;
+    executable_addr_request.response = &executableAddressCopy;
+
+    if (date_at_boot_request.response)
+    {
+        dateAtBootCopy = *date_at_boot_request.response;
+        date_at_boot_request.response = &dateAtBootCopy;
+    }
+
+    if (rsdp_request.response)
+    {
+        rsdpCopy = *rsdp_request.response;
+        rsdp_request.response = &rsdpCopy;
+    }
+
+    if (mp_request.response)
+    {
+        mpCopy = *mp_request.response;
+        for (size_t i = 0; i < mpCopy.cpu_count; ++i)
+        {
+            mpInfoCopies[i] = *mp_request.response->cpus[i];
+            mpInfoPointers[i] = &mpInfoCopies[i];
+        }
+        mpCopy.cpus = mpInfoPointers;
+        mp_request.response = &mpCopy;
+    }
+
+    if (framebuffer_request.response)
+    {
+        framebufferCopy = *framebuffer_request.response;
+        if (framebufferCopy.framebuffer_count > MAX_PRESERVED_FRAMEBUFFERS)
+            framebufferCopy.framebuffer_count = MAX_PRESERVED_FRAMEBUFFERS;
+
+        for (size_t i = 0; i < framebufferCopy.framebuffer_count; ++i)
+        {
+            framebufferCopies[i] = *framebuffer_request.response->framebuffers[i];
+            framebufferCopies[i].edid = nullptr;
+            framebufferCopies[i].edid_size = 0;
+            framebufferCopies[i].modes = nullptr;
+            framebufferCopies[i].mode_count = 0;
+            framebufferPointers[i] = &framebufferCopies[i];
+        }
+        framebufferCopy.framebuffers = framebufferPointers;
+        framebuffer_request.response = &framebufferCopy;
+    }
+
+    executable_file_request.response = nullptr;
+    module_request.response = nullptr;
+
+    return true;
+}
+
+void reclaimBootloaderMemory()
+{
+    Renderer::printf("\x1b[36mReclaiming Bootloader Memory... ");
+
+    if (SMP::getCpuCount() < mp_request.response->cpu_count)
+    {
+        Renderer::printf("\x1b[33mSkipped (not all CPUs left the bootloader).\x1b[0m\n");
+        return;
+    }
+
+    if (!preserveLimineResponses())
+    {
+        Renderer::printf("\x1b[33mSkipped (bootloader responses too large to preserve).\x1b[0m\n");
+        return;
+    }
+
+    uint64_t rsp;
+    asm volatile ("mov %%rsp, %0" : "=r"(rsp));
+
+    const uint64_t pages = BuddyAllocator::reclaimBootloaderMemory(rsp - hhdm_request.response->offset);
+    Renderer::printf("\x1b[32m%lu KiB\x1b[0m\n", pages * FrameAllocator::SMALL_SIZE / 1024);
+}
+
+uint32_t onlineCpuCount()
+{
+    uint32_t online = 0;
+    for (uint32_t i = 0; i < SMP::getCpuCount(); ++i) online += __atomic_load_n(&cpus[i].online, __ATOMIC_ACQUIRE);
+
+    return online;
+}
+
 void initLapicTimer()
 {
     Renderer::printf("\x1b[36mInitializing LAPIC Timer... ");
     LAPIC::timerInit(0x22);
     LAPIC::timerSetDivide(16);
     LAPIC::timerCalibrate(10);
-    LAPIC::timerPeriodic();
-    CPUManager::getCurrentCPU()->timerReady = true;
+
+    int timeout = 1000000;
+    while (onlineCpuCount() < SMP::getCpuCount() && timeout--) asm volatile ("pause");
+
+    IPI::callOnAllCpus(startLapicTimer, nullptr);
+    if (const uint32_t online = onlineCpuCount(); online < SMP::getCpuCount())
+        Renderer::printf("\x1b[33mOnly %u of %u CPUs online. ", online, SMP::getCpuCount());
     Renderer::printf("\x1b[32mDone!\x1b[0m\n");
 }
 
 extern "C" [[noreturn]] void kernelMain()
 {
+    BootTime::phase("Console");
     initRenderer();
     initSIMD();
     Renderer::setSerialPrint(true);
     dumpStats();
 
+    BootTime::phase("Paging");
     initPaging();
+    BootTime::phase("Descriptor tables");
     initGDT();
     initIDT();
+    BootTime::phase("SMP bring-up");
     SMP::init();
     LAPIC::init(SMP::getLapicBase());
 
     if (!CPUManager::initCPU(0, mp_request.response->bsp_lapic_id)) Panic::panic("Failed to initialize primary CPU.");
+
+    BootTime::phase("Memory allocators");
+    initMemory();
+    BootTime::phase("CPU runtime");
     if (!CPUManager::initRuntime(0)) Panic::panic("Failed to initialize primary CPU runtime.");
 
+    BootTime::phase("Devices");
     initIOAPIC();
     Keyboard::init();
+    BootTime::phase("PCI");
+    initPCI();
+    BootTime::phase("Page cache");
+    PageCache::init();
+    BootTime::phase("VFS");
+    VFS::init();
+    BootTime::phase("Initramfs");
+    Initramfs::init();
+    BootTime::phase("LAPIC timer");
     initLapicTimer();
+    BootTime::phase("Bootloader reclaim");
+    reclaimBootloaderMemory();
+    BootTime::report();
 
     Interrupt::enableInterrupts();
+#if MESH_STATS_INTERVAL_MS
+    Stats::startReporter(MESH_STATS_INTERVAL_MS);
+#endif
+#if MESH_IRQ_BALANCE_MS
+    IRQ::startBalancer(MESH_IRQ_BALANCE_MS);
+#endif
+#if MESH_PROFILE_MS
+    const uint64_t profileStart = LAPIC::timerGetTicks();
+    Profiler::start(MESH_PROFILE_PERIOD);
+#endif
+#if MESH_TRACE_MS
+    const uint64_t traceStart = LAPIC::timerGetTicks();
+    Trace::start();
+#endif
+#ifdef MESH_KBENCH
+    KBench::exit(KBench::runAll() ? KBench::EXIT_SUCCESS : KBench::EXIT_FAILURE);
+#endif
     while (true)
     {
-        Keyboard::service();
         while (char c = Keyboard::readChar()) Renderer::printf("%c", c);
 
+        const uint64_t now = LAPIC::timerGetTicks();
+#if MESH_PROFILE_MS
+        if (Profiler::isRunning() && now - profileStart >= MESH_PROFILE_MS)
+        {
+            Profiler::stop();
+            Profiler::dump();
+        }
+#endif
+#if MESH_TRACE_MS
+        if (__atomic_load_n(&Trace::enabledMask, __ATOMIC_RELAXED) && now - traceStart >= MESH_TRACE_MS)
+        {
+            Trace::stop();
+            Trace::dump();
+        }
+#endif
+
         static uint64_t last = 0;
-        if (const uint64_t now = LAPIC::timerGetTicks(); now / 1000 != last / 1000)
+        if (now / 1000 != last / 1000)
         {
             Renderer::printf("\x1b[90m.\x1b[0m");
             last = now;
@@ -15,7 +15,7 @@ executable_addr_request =
     .id = LIMINE_EXECUTABLE_ADDRESS_REQUEST, .revision = 0
 };
 __attribute__ ((used, section (".limine_requests"))) volatile struct limine_mp_request mp_request = {
-    .id = LIMINE_MP_REQUEST, .revision = 0
+    .id = LIMINE_MP_REQUEST, .revision = 0, .flags = LIMINE_MP_X2APIC
 };
 __attribute__ ((used, section (".limine_requests"))) volatile struct limine_date_at_boot_request date_at_boot_request =
 {
@@ -1,6 +1,7 @@
 #include <arch/x86_64/cpu.h>
 #include <arch/x86_64/isr.h>
 #include <core/panic.h>
+#include <core/symbols.h>
 #include <drivers/renderer.h>
 
 uint64_t readRbp()
@@ -39,6 +40,8 @@ void Panic::panicFrame(const Interrupt::Frame* frame, const char* fmt, ...)
 
     if (frame)
     {
+        if (const Symbols::Symbol symbol = Symbols::symbolize(frame->rip); symbol.name)
+            Renderer::printf("\x1b[90mIn:\x1b[0m %s+0x%lx\n", symbol.name, symbol.offset);
         Renderer::printf("\x1b[90mRIP:\x1b[0m 0x%lx | ", frame->rip);
         Renderer::printf("\x1b[90mRSP:\x1b[0m 0x%lx\n", frame->rsp);
         Renderer::printf("\x1b[90mRFLAGS:\x1b[0m 0x%lx | ", frame->rflags);
@@ -79,7 +82,9 @@ void Panic::printStackTrace(uint64_t basePointer, const int maxFrames)
         }
 
         const auto* frame = reinterpret_cast<const uint64_t*>(rbp);
-        Renderer::printf("\x1b[90m#%d: 0x%lx\x1b[0m\n", i, frame[1]);
+        if (const Symbols::Symbol symbol = Symbols::symbolize(frame[1]); symbol.name)
+            Renderer::printf("\x1b[90m#%d: 0x%lx\x1b[0m %s+0x%lx\n", i, frame[1], symbol.name, symbol.offset);
+        else Renderer::printf("\x1b[90m#%d: 0x%lx\x1b[0m\n", i, frame[1]);
 
         if (frame[0] <= rbp)
         {
@@ -0,0 +1,140 @@
+#include <arch/x86_64/cpu.h>
+#include <core/profiler.h>
+#include <core/symbols.h>
+#include <drivers/serial.h>
+#include <memory/vmm.h>
+
+struct ProfileSample
+{
+    uint64_t frames[Profiler::MAX_DEPTH + 1];
+    uint32_t depth;
+};
+
+struct alignas(64) ProfileBuffer
+{
+    ProfileSample* samples;
+    uint64_t written, ticks;
+};
+
+constexpr uint64_t KERNEL_SPACE_BASE = 0xFFFF800000000000ULL;
+
+ProfileBuffer profileBuffers[SMP::MAX_CPUS] = {};
+uint32_t profilePeriod = 1;
+bool profilerRunning = false;
+
+uint64_t stackLimitFor(const uint64_t rsp)
+{
+    if (const CPU* cpu = CPUManager::getCurrentCPU(); cpu && cpu->currentTask)
+    {
+        const Task::Task* task = cpu->currentTask;
+        if (rsp >= task->kernelStackBase && rsp < task->kernelStackTop) return task->kernelStackTop;
+    }
+
+    return Alignment::alignUp(rsp + 1, FrameAllocator::SMALL_SIZE);
+}
+
+bool Profiler::start(uint32_t period)
+{
+    if (period == 0) period = 1;
+
+    for (uint32_t i = 0; i < SMP::getCpuCount(); ++i)
+    {
+        ProfileBuffer& buffer = profileBuffers[i];
+        if (buffer.samples) continue;
+
+        buffer.samples = static_cast<ProfileSample*>(VMM::allocate(SAMPLES_PER_CPU * sizeof(ProfileSample),
+                                                                   VMM::RegionType::HEAP, PageFlags::RW |
+                                                                   PageFlags::NO_EXECUTE));
+        if (!buffer.samples)
+        {
+            Serial::printf("Profiler: Failed to allocate sample buffer for CPU %u\n", i);
+            return false;
+        }
+    }
+
+    __atomic_store_n(&profilePeriod, period, __ATOMIC_RELAXED);
+    __atomic_store_n(&profilerRunning, true, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+void Profiler::stop() { __atomic_store_n(&profilerRunning, false, __ATOMIC_RELEASE); }
+bool Profiler::isRunning() { return __atomic_load_n(&profilerRunning, __ATOMIC_ACQUIRE); }
+
+void Profiler::reset()
+{
+    stop();
+    for (uint32_t i = 0; i < SMP::getCpuCount(); ++i)
+    {
+        __atomic_store_n(&profileBuffers[i].written, 0, __ATOMIC_RELEASE);
+        profileBuffers[i].ticks = 0;
+    }
+}
+
+void Profiler::sample(const Interrupt::TimerFrame* frame)
+{
+    if (!frame || !__atomic_load_n(&profilerRunning, __ATOMIC_ACQUIRE)) return;
+
+    ProfileBuffer& buffer = profileBuffers[CPUManager::getCurrentCPUId()];
+    if (!buffer.samples || ++buffer.ticks % __atomic_load_n(&profilePeriod, __ATOMIC_RELAXED) != 0) return;
+
+    const uint64_t written = __atomic_load_n(&buffer.written, __ATOMIC_RELAXED);
+    ProfileSample& sample = buffer.samples[written % SAMPLES_PER_CPU];
+    sample.frames[0] = frame->rip;
+    sample.depth = 1;
+
+    if (frame->rip >= KERNEL_SPACE_BASE)
+    {
+        const uint64_t limit = stackLimitFor(frame->rsp);
+        uint64_t rbp = frame->rbp;
+
+        while (sample.depth <= MAX_DEPTH && rbp >= frame->rsp && rbp + 16 <= limit && !(rbp & 0x7))
+        {
+            const auto* link = reinterpret_cast<const uint64_t*>(rbp);
+            if (link[1] < KERNEL_SPACE_BASE) break;
+
+            sample.frames[sample.depth++] = link[1];
+            if (link[0] <= rbp) break;
+            rbp = link[0];
+        }
+    }
+
+    __atomic_store_n(&buffer.written, written + 1, __ATOMIC_RELEASE);
+}
+
+void Profiler::dump()
+{
+    if (isRunning())
+    {
+        Serial::printf("Profiler: Stopping before dump\n");
+        stop();
+    }
+
+    Serial::printf("PROFILE_BEGIN period=%u\n", profilePeriod);
+    for (uint32_t cpuId = 0; cpuId < SMP::getCpuCount(); ++cpuId)
+    {
+        const ProfileBuffer& buffer = profileBuffers[cpuId];
+        if (!buffer.samples) continue;
+
+        const uint64_t written = __atomic_load_n(&buffer.written, __ATOMIC_ACQUIRE);
+        const uint64_t count = written < SAMPLES_PER_CPU ? written : SAMPLES_PER_CPU;
+
+        for (uint64_t i = written - count; i < written; ++i)
+        {
+            const ProfileSample& sample = buffer.samples[i % SAMPLES_PER_CPU];
+
+            Serial::printf("cpu%u", cpuId);
+            for (uint32_t depth = sample.depth; depth-- > 0;)
+            {
+                if (const Symbols::Symbol symbol = Symbols::symbolize(sample.frames[depth]); symbol.name)
+                    Serial::printf(";%s", symbol.name);
+                else Serial::printf(";0x%lx", sample.frames[depth]);
+            }
+            Serial::printf(" 1\n");
+        }
+
+        if (written > count) Serial::printf("# cpu%u dropped %lu samples\n", cpuId, written - count);
+    }
+
+    Serial::printf("PROFILE_END\n");
+}
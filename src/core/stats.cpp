@@ -0,0 +1,183 @@
+#include <arch/x86_64/tsc.h>
+#include <core/stats.h>
+#include <drivers/serial.h>
+#include <memory/buddy.h>
+#include <memory/slab.h>
+#include <memory/spinlock.h>
+#include <task/scheduler.h>
+
+struct CounterInfo
+{
+    const char* name;
+    Stats::Id base;
+    uint32_t instances;
+};
+
+struct GaugeInfo
+{
+    const char* name;
+    Stats::GaugeFn read;
+};
+
+constexpr uint32_t MAX_COUNTER_GROUPS = 64;
+constexpr int STATS_REPORTER_PRIORITY = 2;
+
+extern Scheduler::Scheduler schedulers[SMP::MAX_CPUS];
+
+uint64_t* Stats::cpuCounters[SMP::MAX_CPUS] = {};
+
+CounterInfo counterGroups[MAX_COUNTER_GROUPS] = {
+    {"sched.context_switches", Stats::CONTEXT_SWITCHES, 1},
+    {"mm.page_faults", Stats::PAGE_FAULTS, 1},
+    {"mm.tlb_flushes", Stats::TLB_FLUSHES, 1},
+    {"buddy.allocs", Stats::BUDDY_ALLOCS, 1},
+    {"buddy.frees", Stats::BUDDY_FREES, 1},
+    {"buddy.splits", Stats::BUDDY_SPLITS, 1},
+    {"buddy.merges", Stats::BUDDY_MERGES, 1},
+    {"slab.frees", Stats::SLAB_FREES, 1},
+    {"slab.allocs", Stats::SLAB_ALLOCS, Stats::SLAB_CLASSES},
+    {"irq", Stats::IRQS, Stats::IRQ_VECTORS}
+};
+GaugeInfo gauges[Stats::MAX_GAUGES] = {
+    {"buddy.free_pages", [] { return BuddyAllocator::getFreePages(); }},
+    {"buddy.free_pages_dma32", [] { return BuddyAllocator::getFreePages(BuddyAllocator::Zone::DMA32); }}
+};
+
+uint32_t counterGroupCount = 10, gaugeCount = 2;
+Stats::Id nextCounterId = Stats::BUILTIN_COUNT;
+Spinlock statsLock;
+uint32_t reporterInterval = 0;
+bool reporterStarted = false;
+
+bool Stats::initCPU(const uint32_t cpuId)
+{
+    if (cpuId >= SMP::MAX_CPUS) return false;
+    if (cpuCounters[cpuId]) return true;
+
+    auto* row = static_cast<uint64_t*>(SlabAllocator::alloc(MAX_COUNTERS * sizeof(uint64_t), 64));
+    if (!row)
+    {
+        Serial::printf("Stats: Failed to allocate counters for CPU %u\n", cpuId);
+        return false;
+    }
+
+    memset(row, 0, MAX_COUNTERS * sizeof(uint64_t));
+    __atomic_store_n(&cpuCounters[cpuId], row, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+Stats::Id Stats::registerCounter(const char* name, const uint32_t instances)
+{
+    if (!name || instances == 0) return INVALID;
+    LockGuard guard(statsLock);
+
+    if (counterGroupCount >= MAX_COUNTER_GROUPS || nextCounterId + instances > MAX_COUNTERS) return INVALID;
+
+    const Id base = nextCounterId;
+    counterGroups[counterGroupCount++] = {name, base, instances};
+    nextCounterId = static_cast<Id>(nextCounterId + instances);
+
+    return base;
+}
+
+bool Stats::registerGauge(const char* name, const GaugeFn read)
+{
+    if (!name || !read) return false;
+    LockGuard guard(statsLock);
+
+    if (gaugeCount >= MAX_GAUGES) return false;
+    gauges[gaugeCount++] = {name, read};
+
+    return true;
+}
+
+uint64_t Stats::read(const Id id)
+{
+    if (id >= MAX_COUNTERS) return 0;
+
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < SMP::getCpuCount(); ++i)
+        if (const uint64_t* row = __atomic_load_n(&cpuCounters[i], __ATOMIC_ACQUIRE); row)
+            total += __atomic_load_n(&row[id], __ATOMIC_RELAXED);
+
+    return total;
+}
+
+void Stats::snapshot(Snapshot& out)
+{
+    memset(out.values, 0, sizeof(out.values));
+    out.tsc = TSC::read();
+
+    for (uint32_t i = 0; i < SMP::getCpuCount(); ++i)
+    {
+        const uint64_t* row = __atomic_load_n(&cpuCounters[i], __ATOMIC_ACQUIRE);
+        if (!row) continue;
+
+        for (uint32_t id = 0; id < MAX_COUNTERS; ++id) out.values[id] += __atomic_load_n(&row[id], __ATOMIC_RELAXED);
+    }
+}
+
+void Stats::printDiff(const Snapshot& before, const Snapshot& after)
+{
+    const uint64_t elapsedUs = TSC::toMicroseconds(after.tsc - before.tsc);
+    Serial::printf("STATS_BEGIN interval_us=%lu\n", elapsedUs);
+
+    for (uint32_t group = 0; group < counterGroupCount; ++group)
+    {
+        const CounterInfo& info = counterGroups[group];
+        for (uint32_t i = 0; i < info.instances; ++i)
+        {
+            const Id id = static_cast<Id>(info.base + i);
+            const uint64_t delta = after.values[id] - before.values[id];
+            if (!delta) continue;
+
+            const uint64_t rate = elapsedUs ? delta * 1000000 / elapsedUs : 0;
+            if (info.instances == 1)
+                Serial::printf("STATS %s total=%lu delta=%lu per_sec=%lu\n", info.name, after.values[id], delta,
+                               rate);
+            else
+                Serial::printf("STATS %s[%u] total=%lu delta=%lu per_sec=%lu\n", info.name, i, after.values[id],
+                               delta, rate);
+        }
+    }
+
+    for (uint32_t i = 0; i < gaugeCount; ++i) Serial::printf("STATS %s value=%lu\n", gauges[i].name, gauges[i].read());
+    Serial::printf("STATS_END\n");
+}
+
+void statsReporterMain(void*)
+{
+    static Stats::Snapshot snapshots[2];
+    uint32_t current = 0;
+    Stats::snapshot(snapshots[current]);
+
+    while (true)
+    {
+        Task::taskSleep(__atomic_load_n(&reporterInterval, __ATOMIC_RELAXED));
+
+        Stats::snapshot(snapshots[current ^ 1]);
+        Stats::printDiff(snapshots[current], snapshots[current ^ 1]);
+        current ^= 1;
+    }
+}
+
+bool Stats::startReporter(const uint32_t intervalMs)
+{
+    if (intervalMs == 0) return false;
+    __atomic_store_n(&reporterInterval, intervalMs, __ATOMIC_RELAXED);
+
+    if (__atomic_exchange_n(&reporterStarted, true, __ATOMIC_ACQ_REL)) return true;
+
+    Task::Task* task = Task::taskCreate(statsReporterMain, nullptr, STATS_REPORTER_PRIORITY);
+    if (!task)
+    {
+        Serial::printf("Stats: Failed to create reporter task\n");
+        __atomic_store_n(&reporterStarted, false, __ATOMIC_RELEASE);
+
+        return false;
+    }
+
+    Scheduler::addReady(&schedulers[CPUManager::getCurrentCPUId()], task);
+    return true;
+}
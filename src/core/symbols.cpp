@@ -0,0 +1,59 @@
+#include <core/symbols.h>
+
+struct SymbolTableHeader
+{
+    uint32_t magic, count;
+};
+
+struct SymbolEntry
+{
+    uint64_t address;
+    uint32_t nameOffset, size;
+};
+
+extern "C" const uint8_t __ksymtab_start[], __ksymtab_end[];
+constexpr uint32_t SYMBOL_TABLE_MAGIC = 0x4D59534B;
+
+const SymbolTableHeader* symbolTable()
+{
+    if (static_cast<size_t>(__ksymtab_end - __ksymtab_start) < sizeof(SymbolTableHeader)) return nullptr;
+
+    const auto* header = reinterpret_cast<const SymbolTableHeader*>(__ksymtab_start);
+    if (header->magic != SYMBOL_TABLE_MAGIC) return nullptr;
+    if (sizeof(SymbolTableHeader) + header->count * sizeof(SymbolEntry) >
+        static_cast<size_t>(__ksymtab_end - __ksymtab_start))
+        return nullptr;
+
+    return header;
+}
+
+bool Symbols::isAvailable() { return symbolTable() != nullptr; }
+
+uint32_t Symbols::getCount()
+{
+    const SymbolTableHeader* header = symbolTable();
+    return header ? header->count : 0;
+}
+
+Symbols::Symbol Symbols::symbolize(const uint64_t address)
+{
+    const SymbolTableHeader* header = symbolTable();
+    if (!header || header->count == 0) return {};
+
+    const auto* entries = reinterpret_cast<const SymbolEntry*>(header + 1);
+    const auto* names = reinterpret_cast<const char*>(entries + header->count);
+    if (address < entries[0].address) return {};
+
+    uint32_t low = 0, high = header->count;
+    while (high - low > 1)
+    {
+        const uint32_t mid = low + (high - low) / 2;
+        if (entries[mid].address <= address) low = mid;
+        else high = mid;
+    }
+
+    const SymbolEntry& entry = entries[low];
+    if (entry.size && address - entry.address >= entry.size) return {};
+
+    return {names + entry.nameOffset, entry.address, address - entry.address};
+}
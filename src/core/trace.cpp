@@ -0,0 +1,100 @@
+#include <arch/x86_64/cpu.h>
+#include <arch/x86_64/tsc.h>
+#include <core/trace.h>
+#include <drivers/serial.h>
+#include <memory/vmm.h>
+
+struct alignas(64) TraceBuffer
+{
+    Trace::Record* records;
+    uint64_t written;
+};
+
+constexpr const char* eventNames[] = {
+    "sched_switch", "sched_wake", "sched_migrate", "buddy_alloc", "buddy_free", "slab_alloc", "slab_free",
+    "page_fault", "irq_entry", "irq_exit", "lock_contended"
+};
+static_assert(sizeof(eventNames) / sizeof(eventNames[0]) == static_cast<size_t>(Trace::Event::COUNT));
+
+uint32_t Trace::enabledMask = 0;
+TraceBuffer traceBuffers[SMP::MAX_CPUS] = {};
+
+bool Trace::start(const uint32_t mask)
+{
+    for (uint32_t i = 0; i < SMP::getCpuCount(); ++i)
+    {
+        TraceBuffer& buffer = traceBuffers[i];
+        if (buffer.records) continue;
+
+        auto* records = static_cast<Record*>(VMM::allocate(RECORDS_PER_CPU * sizeof(Record), VMM::RegionType::HEAP,
+                                                           PageFlags::RW | PageFlags::NO_EXECUTE));
+        if (!records)
+        {
+            Serial::printf("Trace: Failed to allocate trace buffer for CPU %u\n", i);
+            return false;
+        }
+
+        __atomic_store_n(&buffer.records, records, __ATOMIC_RELEASE);
+    }
+
+    __atomic_store_n(&enabledMask, mask & ALL_EVENTS, __ATOMIC_RELEASE);
+    return true;
+}
+
+void Trace::stop() { __atomic_store_n(&enabledMask, 0, __ATOMIC_RELEASE); }
+
+void Trace::reset()
+{
+    stop();
+    for (uint32_t i = 0; i < SMP::getCpuCount(); ++i) __atomic_store_n(&traceBuffers[i].written, 0, __ATOMIC_RELEASE);
+}
+
+const char* Trace::eventName(const Event event)
+{
+    return event < Event::COUNT ? eventNames[static_cast<uint32_t>(event)] : "unknown";
+}
+
+void Trace::record(const Event event, const uint64_t arg0, const uint64_t arg1, const uint32_t arg2)
+{
+    uint64_t rflags;
+    asm volatile ("pushfq\npopq %0\ncli" : "=r"(rflags) :: "memory");
+
+    const uint32_t cpuId = CPUManager::getCurrentCPUId();
+    TraceBuffer& buffer = traceBuffers[cpuId];
+
+    if (Record* records = __atomic_load_n(&buffer.records, __ATOMIC_ACQUIRE))
+    {
+        const uint64_t written = buffer.written;
+        records[written % RECORDS_PER_CPU] = {TSC::read(), arg0, arg1, static_cast<uint16_t>(event),
+                                              static_cast<uint16_t>(cpuId), arg2};
+        __atomic_store_n(&buffer.written, written + 1, __ATOMIC_RELEASE);
+    }
+
+    asm volatile ("pushq %0\npopfq" :: "r"(rflags) : "memory");
+}
+
+void Trace::dump()
+{
+    const uint32_t mask = __atomic_exchange_n(&enabledMask, 0, __ATOMIC_ACQ_REL);
+
+    Serial::printf("TRACE_BEGIN tsc_hz=%lu cpus=%u\n", TSC::getFrequency(), SMP::getCpuCount());
+    for (uint32_t cpuId = 0; cpuId < SMP::getCpuCount(); ++cpuId)
+    {
+        const TraceBuffer& buffer = traceBuffers[cpuId];
+        if (!buffer.records) continue;
+
+        const uint64_t written = __atomic_load_n(&buffer.written, __ATOMIC_ACQUIRE);
+        const uint64_t count = written < RECORDS_PER_CPU ? written : RECORDS_PER_CPU;
+        if (written > count) Serial::printf("TRACE_LOST cpu=%u records=%lu\n", cpuId, written - count);
+
+        for (uint64_t i = written - count; i < written; ++i)
+        {
+            const Record& r = buffer.records[i % RECORDS_PER_CPU];
+            Serial::printf("T %u %lx %s %lx %lx %x\n", r.cpu, r.tsc, eventName(static_cast<Event>(r.event)), r.arg0,
+                           r.arg1, r.arg2);
+        }
+    }
+
+    Serial::printf("TRACE_END\n");
+    __atomic_store_n(&enabledMask, mask, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,536 @@
+#include <arch/x86_64/tsc.h>
+#include <core/limine.h>
+#include <drivers/ahci.h>
+#include <drivers/block.h>
+#include <drivers/pci.h>
+#include <drivers/serial.h>
+#include <memory/buddy.h>
+#include <memory/paging.h>
+#include <memory/slab.h>
+
+extern limine_hhdm_request hhdm_request;
+
+constexpr uint32_t HBA_CAP = 0x00, HBA_GHC = 0x04, HBA_IS = 0x08, HBA_PI = 0x0C, HBA_VS = 0x10, HBA_CCC_CTL = 0x14,
+                   HBA_CCC_PORTS = 0x18, HBA_PORTS = 0x100, HBA_PORT_SIZE = 0x80;
+constexpr uint32_t HBA_CAP_SNCQ = 1u << 30, HBA_CAP_S64A = 1u << 31, HBA_CAP_CCCS = 1u << 7;
+constexpr uint32_t HBA_GHC_IE = 1u << 1, HBA_GHC_AE = 1u << 31;
+
+constexpr uint32_t PORT_CLB = 0x00, PORT_FB = 0x08, PORT_IS = 0x10, PORT_IE = 0x14, PORT_CMD = 0x18, PORT_TFD = 0x20,
+                   PORT_SIG = 0x24, PORT_SSTS = 0x28, PORT_SERR = 0x30, PORT_SACT = 0x34, PORT_CI = 0x38;
+constexpr uint32_t PORT_CMD_ST = 1u << 0, PORT_CMD_FRE = 1u << 4, PORT_CMD_FR = 1u << 14, PORT_CMD_CR = 1u << 15;
+constexpr uint32_t PORT_IS_DHRS = 1u << 0, PORT_IS_SDBS = 1u << 3, PORT_IS_TFES = 1u << 30,
+                   PORT_IS_ERRORS = 0x7DC00050;
+constexpr uint32_t PORT_TFD_ERR = 1u << 0, PORT_TFD_DRQ = 1u << 3, PORT_TFD_BSY = 1u << 7;
+constexpr uint32_t SATA_SIGNATURE_DISK = 0x00000101;
+
+constexpr uint8_t FIS_H2D = 0x27, FIS_COMMAND = 0x80, ATA_DEVICE_LBA = 0x40;
+constexpr uint8_t ATA_IDENTIFY = 0xEC, ATA_READ_DMA_EXT = 0x25, ATA_WRITE_DMA_EXT = 0x35, ATA_FLUSH_EXT = 0xEA,
+                  ATA_READ_FPDMA = 0x60, ATA_WRITE_FPDMA = 0x61;
+
+constexpr uint32_t AHCI_PRDT_ENTRIES = AHCI::MAX_TRANSFER / 4096 + 1, AHCI_TABLE_STRIDE = 768,
+                   AHCI_FIS_OFFSET = 1024, AHCI_TIMEOUT_MS = 1000;
+constexpr int AHCI_LIST_ORDER = 0, AHCI_TABLE_ORDER = 3;
+
+struct AhciCommandHeader
+{
+    uint16_t flags, prdtLength;
+    volatile uint32_t bytes;
+    uint64_t table;
+    uint32_t reserved[4];
+};
+
+struct AhciPrd
+{
+    uint64_t address;
+    uint32_t reserved, count;
+};
+
+struct AhciController;
+
+struct AhciPort
+{
+    Block::Device block;
+    Spinlock lock;
+    AhciController* controller;
+    volatile uint8_t* registers;
+    uint32_t index, slotMask, issued, unqueued;
+    bool ncq;
+    AhciCommandHeader* commands;
+    uint8_t* tables;
+    uint64_t listPhysical, tablesPhysical;
+    Block::Request* inflight[AHCI::MAX_SLOTS];
+};
+
+struct AhciController
+{
+    PCI::Device* pci;
+    volatile uint8_t* registers;
+    uint32_t portMask;
+    bool dma64, coalescing;
+    AhciPort* ports[AHCI::MAX_PORTS];
+};
+
+uint32_t ahciDiskCount = 0;
+
+uint32_t ahciRead(volatile uint8_t* registers, const uint32_t offset)
+{
+    return *reinterpret_cast<volatile uint32_t*>(registers + offset);
+}
+
+void ahciWrite(volatile uint8_t* registers, const uint32_t offset, const uint32_t value)
+{
+    *reinterpret_cast<volatile uint32_t*>(registers + offset) = value;
+}
+
+bool ahciWait(volatile uint8_t* registers, const uint32_t offset, const uint32_t mask, const uint32_t value)
+{
+    const uint64_t start = TSC::read(), frequency = TSC::getFrequency();
+    for (uint64_t spins = 0; spins < (1ULL << 32); ++spins)
+    {
+        if ((ahciRead(registers, offset) & mask) == value) return true;
+        if (frequency && TSC::read() - start > frequency / 1000 * AHCI_TIMEOUT_MS) break;
+
+        asm volatile ("pause");
+    }
+
+    return false;
+}
+
+uint64_t ahciAlloc(const AhciController& controller, const int order)
+{
+    return controller.dma64 ? BuddyAllocator::alloc(order, AllocFlags::ZEROED)
+                            : BuddyAllocator::alloc(order, AllocFlags::ZEROED | AllocFlags::DMA32);
+}
+
+bool ahciStopPort(const AhciPort& port)
+{
+    ahciWrite(port.registers, PORT_CMD, ahciRead(port.registers, PORT_CMD) & ~PORT_CMD_ST);
+    if (!ahciWait(port.registers, PORT_CMD, PORT_CMD_CR, 0)) return false;
+
+    ahciWrite(port.registers, PORT_CMD, ahciRead(port.registers, PORT_CMD) & ~PORT_CMD_FRE);
+    return ahciWait(port.registers, PORT_CMD, PORT_CMD_FR, 0);
+}
+
+bool ahciStartPort(const AhciPort& port)
+{
+    ahciWrite(port.registers, PORT_SERR, 0xFFFFFFFF);
+    ahciWrite(port.registers, PORT_IS, 0xFFFFFFFF);
+    ahciWrite(port.registers, PORT_CMD, ahciRead(port.registers, PORT_CMD) | PORT_CMD_FRE);
+    if (!ahciWait(port.registers, PORT_TFD, PORT_TFD_BSY | PORT_TFD_DRQ, 0)) return false;
+
+    ahciWrite(port.registers, PORT_CMD, ahciRead(port.registers, PORT_CMD) | PORT_CMD_ST);
+    return true;
+}
+
+void ahciBuildFis(uint8_t* fis, const uint8_t command, const uint64_t lba, const uint16_t count, const uint32_t tag)
+{
+    memset(fis, 0, 64);
+    fis[0] = FIS_H2D;
+    fis[1] = FIS_COMMAND;
+    fis[2] = command;
+    fis[4] = static_cast<uint8_t>(lba);
+    fis[5] = static_cast<uint8_t>(lba >> 8);
+    fis[6] = static_cast<uint8_t>(lba >> 16);
+    fis[7] = ATA_DEVICE_LBA;
+    fis[8] = static_cast<uint8_t>(lba >> 24);
+    fis[9] = static_cast<uint8_t>(lba >> 32);
+    fis[10] = static_cast<uint8_t>(lba >> 40);
+
+    if (command == ATA_READ_FPDMA || command == ATA_WRITE_FPDMA)
+    {
+        fis[3] = static_cast<uint8_t>(count);
+        fis[11] = static_cast<uint8_t>(count >> 8);
+        fis[12] = static_cast<uint8_t>(tag << 3);
+    }
+    else
+    {
+        fis[12] = static_cast<uint8_t>(count);
+        fis[13] = static_cast<uint8_t>(count >> 8);
+    }
+}
+
+uint32_t ahciBuildPrdt(const AhciPort& port, const uint32_t slot, const void* buffer, const uint64_t length)
+{
+    Block::Segment segments[AHCI_PRDT_ENTRIES];
+    const uint32_t count = Block::buildSegments(buffer, length, segments, AHCI_PRDT_ENTRIES);
+    auto* prdt = reinterpret_cast<AhciPrd*>(port.tables + slot * AHCI_TABLE_STRIDE + 0x80);
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        if ((segments[i].physical | segments[i].length) & 1) return 0;
+        if (!port.controller->dma64 && segments[i].physical + segments[i].length > 0x100000000ULL) return 0;
+
+        prdt[i] = {segments[i].physical, 0, segments[i].length - 1};
+    }
+
+    return count;
+}
+
+bool ahciPrepare(AhciPort& port, const uint32_t slot, const uint8_t command, const uint64_t lba, const uint16_t count,
+                 const void* buffer, const uint64_t length, const bool write)
+{
+    uint32_t prdtLength = 0;
+    if (length && !(prdtLength = ahciBuildPrdt(port, slot, buffer, length))) return false;
+
+    ahciBuildFis(port.tables + slot * AHCI_TABLE_STRIDE, command, lba, count, slot);
+
+    AhciCommandHeader& header = port.commands[slot];
+    header.flags = static_cast<uint16_t>(5 | (write ? 1u << 6 : 0));
+    header.prdtLength = static_cast<uint16_t>(prdtLength);
+    header.bytes = 0;
+    header.table = port.tablesPhysical + slot * AHCI_TABLE_STRIDE;
+
+    return true;
+}
+
+bool ahciIdentify(AhciPort& port, const uint64_t physical)
+{
+    if (!ahciPrepare(port, 0, ATA_IDENTIFY, 0, 0, nullptr, 0, false)) return false;
+
+    *reinterpret_cast<AhciPrd*>(port.tables + 0x80) = {physical, 0, Block::SECTOR_SIZE - 1};
+    port.commands[0].prdtLength = 1;
+    port.tables[7] = 0;
+
+    ahciWrite(port.registers, PORT_CI, 1);
+    if (!ahciWait(port.registers, PORT_CI, 1, 0)) return false;
+
+    return !(ahciRead(port.registers, PORT_TFD) & PORT_TFD_ERR) && !(ahciRead(port.registers, PORT_IS) & PORT_IS_TFES);
+}
+
+uint32_t ahciSubmit(Block::Device* device, const uint32_t, Block::Request** requests, const uint32_t count)
+{
+    auto* port = static_cast<AhciPort*>(device->driverData);
+    Block::Request* rejected = nullptr;
+    uint32_t accepted = 0;
+
+    {
+        LockGuard guard(port->lock);
+        uint32_t queued = 0, unqueued = 0;
+
+        for (; accepted < count; ++accepted)
+        {
+            Block::Request* request = requests[accepted];
+            const bool flush = request->op == Block::Op::FLUSH, write = request->op == Block::Op::WRITE,
+                       native = port->ncq && !flush;
+
+            if (port->ncq && (native ? port->unqueued : port->issued & ~port->unqueued)) break;
+
+            const uint32_t free = port->slotMask & ~port->issued;
+            if (!free) break;
+
+            const uint32_t slot = __builtin_ctz(free);
+            uint8_t command = ATA_FLUSH_EXT;
+            if (!flush) command = native ? write ? ATA_WRITE_FPDMA : ATA_READ_FPDMA
+                                  : write ? ATA_WRITE_DMA_EXT : ATA_READ_DMA_EXT;
+
+            const uint64_t length = flush ? 0 : static_cast<uint64_t>(request->sectors) * Block::SECTOR_SIZE;
+            if (!ahciPrepare(*port, slot, command, flush ? 0 : request->sector,
+                             static_cast<uint16_t>(flush ? 0 : request->sectors), request->buffer, length, write))
+            {
+                request->status = Block::Status::INVALID;
+                request->next = rejected;
+                rejected = request;
+                continue;
+            }
+
+            port->inflight[slot] = request;
+            port->issued |= 1u << slot;
+            if (native) queued |= 1u << slot;
+            else
+            {
+                unqueued |= 1u << slot;
+                port->unqueued |= 1u << slot;
+            }
+        }
+
+        if (queued) ahciWrite(port->registers, PORT_SACT, queued);
+        if (queued | unqueued) ahciWrite(port->registers, PORT_CI, queued | unqueued);
+    }
+
+    Block::completeList(rejected);
+    return accepted;
+}
+
+uint32_t ahciReap(AhciPort& port)
+{
+    Block::Request* done = nullptr;
+    uint32_t completed = 0;
+
+    {
+        LockGuard guard(port.lock);
+        if (!port.issued) return 0;
+
+        const uint32_t status = ahciRead(port.registers, PORT_IS);
+        uint32_t finished = port.issued & ~(ahciRead(port.registers, PORT_SACT) | ahciRead(port.registers, PORT_CI));
+        Block::Status result = Block::Status::OK;
+
+        if (status & PORT_IS_ERRORS)
+        {
+            Serial::printf("AHCI: Port %u error (IS %x, TFD %x), restarting\n", port.index, status,
+                           ahciRead(port.registers, PORT_TFD));
+            ahciStopPort(port);
+            ahciStartPort(port);
+
+            finished = port.issued;
+            result = Block::Status::IO_ERROR;
+        }
+
+        for (uint32_t pending = finished; pending; pending &= pending - 1)
+        {
+            const uint32_t slot = __builtin_ctz(pending);
+            Block::Request* request = port.inflight[slot];
+            port.inflight[slot] = nullptr;
+
+            request->status = result;
+            request->next = done;
+            done = request;
+            ++completed;
+        }
+
+        port.issued &= ~finished;
+        port.unqueued &= ~finished;
+    }
+
+    Block::completeList(done);
+    return completed;
+}
+
+uint32_t ahciPoll(Block::Device* device, const uint32_t)
+{
+    return ahciReap(*static_cast<AhciPort*>(device->driverData));
+}
+
+void ahciInterrupt(void* arg)
+{
+    auto* controller = static_cast<AhciController*>(arg);
+    const uint32_t pending = ahciRead(controller->registers, HBA_IS);
+
+    for (uint32_t ports = pending & controller->portMask; ports; ports &= ports - 1)
+    {
+        AhciPort* port = controller->ports[__builtin_ctz(ports)];
+        ahciWrite(port->registers, PORT_IS, ahciRead(port->registers, PORT_IS) & ~PORT_IS_ERRORS);
+        ahciReap(*port);
+        Block::kick(&port->block, 0);
+    }
+
+    if (controller->coalescing && pending & ~controller->portMask)
+        for (uint32_t ports = controller->portMask; ports; ports &= ports - 1)
+        {
+            AhciPort* port = controller->ports[__builtin_ctz(ports)];
+            ahciReap(*port);
+            Block::kick(&port->block, 0);
+        }
+
+    ahciWrite(controller->registers, HBA_IS, pending);
+}
+
+constexpr Block::Operations ahciOps = {ahciSubmit, ahciPoll};
+
+bool ahciSetupPort(AhciController& controller, AhciPort& port, const uint32_t index, const uint32_t slots)
+{
+    port.controller = &controller;
+    port.index = index;
+    port.registers = controller.registers + HBA_PORTS + index * HBA_PORT_SIZE;
+
+    if ((ahciRead(port.registers, PORT_SSTS) & 0xF) != 3) return false;
+    if (ahciRead(port.registers, PORT_SIG) != SATA_SIGNATURE_DISK) return false;
+    if (!ahciStopPort(port))
+    {
+        Serial::printf("AHCI: Port %u did not stop\n", index);
+        return false;
+    }
+
+    port.listPhysical = ahciAlloc(controller, AHCI_LIST_ORDER);
+    port.tablesPhysical = ahciAlloc(controller, AHCI_TABLE_ORDER);
+    if (!port.listPhysical || !port.tablesPhysical) return false;
+
+    port.commands = reinterpret_cast<AhciCommandHeader*>(port.listPhysical + hhdm_request.response->offset);
+    port.tables = reinterpret_cast<uint8_t*>(port.tablesPhysical + hhdm_request.response->offset);
+    port.slotMask = slots == 32 ? 0xFFFFFFFF : (1u << slots) - 1;
+
+    ahciWrite(port.registers, PORT_CLB, static_cast<uint32_t>(port.listPhysical));
+    ahciWrite(port.registers, PORT_CLB + 4, static_cast<uint32_t>(port.listPhysical >> 32));
+    ahciWrite(port.registers, PORT_FB, static_cast<uint32_t>(port.listPhysical + AHCI_FIS_OFFSET));
+    ahciWrite(port.registers, PORT_FB + 4, static_cast<uint32_t>((port.listPhysical + AHCI_FIS_OFFSET) >> 32));
+    ahciWrite(port.registers, PORT_IE, 0);
+
+    if (!ahciStartPort(port))
+    {
+        Serial::printf("AHCI: Port %u did not start\n", index);
+        return false;
+    }
+
+    return true;
+}
+
+void ahciReleasePort(AhciPort* port)
+{
+    if (port->registers) ahciWrite(port->registers, PORT_IE, 0);
+    if (port->listPhysical || port->tablesPhysical)
+    {
+        ahciStopPort(*port);
+        for (uint32_t offset = PORT_CLB; offset <= PORT_FB + 4; offset += 4) ahciWrite(port->registers, offset, 0);
+    }
+
+    if (port->tablesPhysical) BuddyAllocator::free(port->tablesPhysical, AHCI_TABLE_ORDER);
+    if (port->listPhysical) BuddyAllocator::free(port->listPhysical, AHCI_LIST_ORDER);
+    SlabAllocator::free(port);
+}
+
+bool ahciIdentifyPort(AhciPort& port, const bool hbaNcq)
+{
+    const uint64_t page = ahciAlloc(*port.controller, 0);
+    if (!page) return false;
+
+    auto* identify = reinterpret_cast<uint16_t*>(page + hhdm_request.response->offset);
+    bool ok = ahciIdentify(port, page);
+    if (ok)
+    {
+        const bool lba48 = identify[83] & (1u << 10);
+        port.block.sectors = lba48 ? *reinterpret_cast<const uint64_t*>(&identify[100])
+                                   : identify[60] | static_cast<uint64_t>(identify[61]) << 16;
+
+        const bool largeSectors = (identify[106] & 0xC000) == 0x4000 && (identify[106] & (1u << 12));
+        if (!lba48 || !port.block.sectors || largeSectors)
+        {
+            Serial::printf("AHCI: Port %u needs LBA48 and 512-byte sectors\n", port.index);
+            ok = false;
+        }
+
+        port.ncq = hbaNcq && (identify[76] & (1u << 8));
+        if (port.ncq)
+        {
+            const uint32_t depth = (identify[75] & 0x1F) + 1u;
+            if (depth < 32) port.slotMask &= (1u << depth) - 1;
+        }
+    }
+
+    BuddyAllocator::free(page, 0);
+    return ok;
+}
+
+void ahciEnableCoalescing(AhciController& controller)
+{
+    ahciWrite(controller.registers, HBA_CCC_CTL, 0);
+    const uint32_t control = ahciRead(controller.registers, HBA_CCC_CTL);
+    const uint32_t interrupt = control >> 3 & 0x1F;
+
+    ahciWrite(controller.registers, HBA_CCC_PORTS, controller.portMask);
+    ahciWrite(controller.registers, HBA_CCC_CTL, AHCI::COALESCE_TIMEOUT_MS << 16 | AHCI::COALESCE_COMPLETIONS << 8 |
+                                                 interrupt << 3 | 1u);
+    controller.coalescing = true;
+}
+
+bool ahciProbe(PCI::Device& device)
+{
+    auto* registers = static_cast<volatile uint8_t*>(PCI::mapBar(device, 5));
+    if (!registers) return false;
+
+    auto* controller = static_cast<AhciController*>(SlabAllocator::alloc(sizeof(AhciController),
+                                                                         alignof(AhciController)));
+    if (!controller) return false;
+
+    memset(controller, 0, sizeof(AhciController));
+    controller->pci = &device;
+    controller->registers = registers;
+    PCI::setCommand(device, PCI::COMMAND_MEMORY | PCI::COMMAND_BUS_MASTER);
+
+    ahciWrite(registers, HBA_GHC, HBA_GHC_AE);
+    ahciWrite(registers, HBA_IS, 0xFFFFFFFF);
+
+    const uint32_t capabilities = ahciRead(registers, HBA_CAP), implemented = ahciRead(registers, HBA_PI),
+                   slots = (capabilities >> 8 & 0x1F) + 1u, version = ahciRead(registers, HBA_VS);
+    controller->dma64 = capabilities & HBA_CAP_S64A;
+    Serial::printf("AHCI: Version %x.%x, %u slots, ports %x%s\n", version >> 16, version & 0xFFFF, slots, implemented,
+                   capabilities & HBA_CAP_SNCQ ? ", NCQ" : "");
+
+    for (uint32_t index = 0; index < AHCI::MAX_PORTS; ++index)
+    {
+        if (!(implemented & (1u << index))) continue;
+
+        auto* port = static_cast<AhciPort*>(SlabAllocator::alloc(sizeof(AhciPort), alignof(AhciPort)));
+        if (!port) break;
+
+        memset(port, 0, sizeof(AhciPort));
+        if (!ahciSetupPort(*controller, *port, index, slots) || !ahciIdentifyPort(*port, capabilities & HBA_CAP_SNCQ))
+        {
+            ahciReleasePort(port);
+            continue;
+        }
+
+        controller->ports[index] = port;
+        controller->portMask |= 1u << index;
+    }
+
+    if (!controller->portMask)
+    {
+        PCI::setCommand(device, 0, PCI::COMMAND_BUS_MASTER);
+        SlabAllocator::free(controller);
+        return false;
+    }
+
+    void* args[] = {controller};
+    IRQ::Vector vector;
+    IRQ::LineId line;
+    const bool interrupts = PCI::allocateVectors(device, 1, ahciInterrupt, args, &vector, &line) != 0;
+    if (!interrupts) Serial::printf("AHCI: No MSI vector, completions are polled\n");
+    if (interrupts && capabilities & HBA_CAP_CCCS) ahciEnableCoalescing(*controller);
+
+    for (uint32_t ports = controller->portMask; ports; ports &= ports - 1)
+    {
+        AhciPort& port = *controller->ports[__builtin_ctz(ports)];
+        Block::Device& block = port.block;
+        block.queueCount = 1;
+        block.queueDepth = static_cast<uint32_t>(__builtin_popcount(port.slotMask));
+        block.maxSectors = AHCI::MAX_TRANSFER / Block::SECTOR_SIZE;
+        block.maxSegments = AHCI_PRDT_ENTRIES;
+        block.scheduler = Block::Scheduler::DEADLINE;
+        block.ops = &ahciOps;
+        block.driverData = &port;
+
+        const uint32_t index = ahciDiskCount++;
+        block.name[0] = 's';
+        block.name[1] = 'd';
+        block.name[2] = static_cast<char>('a' + index % 26);
+
+        const uint32_t completions = controller->coalescing ? 0 : PORT_IS_DHRS | PORT_IS_SDBS;
+        if (interrupts) ahciWrite(port.registers, PORT_IE, completions | PORT_IS_ERRORS);
+
+        Serial::printf("AHCI: Port %u is %s, %s with %u slots\n", port.index, block.name,
+                       port.ncq ? "NCQ" : "legacy DMA", block.queueDepth);
+        if (Block::registerDevice(&block)) continue;
+
+        Serial::printf("AHCI: Failed to register port %u\n", port.index);
+        controller->portMask &= ~(1u << port.index);
+        controller->ports[port.index] = nullptr;
+        --ahciDiskCount;
+        ahciReleasePort(&port);
+    }
+
+    if (controller->coalescing) ahciWrite(registers, HBA_CCC_PORTS, controller->portMask);
+    if (!controller->portMask)
+    {
+        if (interrupts) PCI::freeVectors(device, &vector, &line, 1);
+        PCI::setCommand(device, 0, PCI::COMMAND_BUS_MASTER);
+        SlabAllocator::free(controller);
+
+        return false;
+    }
+
+    if (interrupts) ahciWrite(registers, HBA_GHC, HBA_GHC_AE | HBA_GHC_IE);
+    device.driverData = controller;
+
+    return true;
+}
+
+bool AHCI::init()
+{
+    PCI::Driver driver;
+    driver.name = "ahci";
+    driver.classCode = CLASS_STORAGE;
+    driver.subclass = SUBCLASS_SATA;
+    driver.progIf = PROG_IF_AHCI;
+    driver.probe = ahciProbe;
+
+    return PCI::registerDriver(driver);
+}
@@ -0,0 +1,760 @@
+#include <arch/x86_64/cpu.h>
+#include <arch/x86_64/isr.h>
+#include <arch/x86_64/tsc.h>
+#include <drivers/block.h>
+#include <drivers/serial.h>
+#include <memory/paging.h>
+#include <memory/slab.h>
+#include <memory/spinlock.h>
+#include <task/task.h>
+
+struct SoftwareQueue
+{
+    Spinlock lock;
+    Block::Request *head, *tail;
+    Block::Request** tailLink;
+};
+
+struct HardwareQueue
+{
+    Spinlock lock;
+    Block::Request *dispatchHead, *dispatchTail;
+    Block::Request *sorted[2], *fifoHead[2], *fifoTail[2];
+    uint64_t position;
+    uint32_t batchLeft, starved, batchDirection;
+    uint32_t inflight;
+    bool running, rerun;
+    uint64_t pendingCpus[SMP::MAX_CPUS / 64];
+};
+
+struct BlockStats
+{
+    uint64_t latency[2][Block::HISTOGRAM_BUCKETS];
+    uint64_t depth[Block::HISTOGRAM_BUCKETS];
+    uint64_t dispatched, merges;
+    uint32_t maxDepth;
+};
+
+struct BlockDeviceEntry
+{
+    Block::Device* device;
+    HardwareQueue* hardware;
+    SoftwareQueue* software[SMP::MAX_CPUS];
+    BlockStats stats;
+};
+
+constexpr uint32_t SUBMIT_CHUNK = 32, TRANSFER_BATCH = 16;
+
+BlockDeviceEntry blockDevices[Block::MAX_DEVICES] = {};
+uint32_t blockDeviceCount = 0;
+Spinlock blockDeviceLock;
+SlabCache* blockRequestCache = nullptr;
+
+BlockDeviceEntry* entryFor(const Block::Device* device)
+{
+    for (uint32_t i = 0; i < __atomic_load_n(&blockDeviceCount, __ATOMIC_ACQUIRE); ++i)
+        if (blockDevices[i].device == device) return &blockDevices[i];
+
+    return nullptr;
+}
+
+bool namesEqual(const char* a, const char* b)
+{
+    while (*a && *a == *b) ++a, ++b;
+    return *a == *b;
+}
+
+uint32_t histogramBucket(const uint64_t value)
+{
+    const uint32_t bucket = value ? 64 - __builtin_clzll(value) : 0;
+    return bucket < Block::HISTOGRAM_BUCKETS ? bucket : Block::HISTOGRAM_BUCKETS - 1;
+}
+
+bool Block::registerDevice(Device* device)
+{
+    if (!device || !device->ops || !device->ops->submit || !device->queueCount || !device->sectors) return false;
+
+    auto* hardware = static_cast<HardwareQueue*>(SlabAllocator::alloc(sizeof(HardwareQueue) * device->queueCount,
+                                                                      alignof(HardwareQueue)));
+    if (!hardware) return false;
+
+    memset(hardware, 0, sizeof(HardwareQueue) * device->queueCount);
+    for (uint16_t& queue : device->queueForCpu) if (queue >= device->queueCount) queue %= device->queueCount;
+
+    {
+        LockGuard guard(blockDeviceLock);
+        if (blockDeviceCount >= MAX_DEVICES)
+        {
+            SlabAllocator::free(hardware);
+            Serial::printf("Block: Device table full, cannot register %s\n", device->name);
+
+            return false;
+        }
+
+        BlockDeviceEntry& entry = blockDevices[blockDeviceCount];
+        memset(&entry, 0, sizeof(entry));
+        entry.device = device;
+        entry.hardware = hardware;
+        __atomic_store_n(&blockDeviceCount, blockDeviceCount + 1, __ATOMIC_RELEASE);
+    }
+
+    Serial::printf("Block: %s has %lu sectors, %u queues of depth %u, %s scheduler\n", device->name, device->sectors,
+                   device->queueCount, device->queueDepth,
+                   device->scheduler == Scheduler::DEADLINE ? "deadline" : "none");
+    return true;
+}
+
+uint32_t Block::getDeviceCount() { return __atomic_load_n(&blockDeviceCount, __ATOMIC_ACQUIRE); }
+
+Block::Device* Block::getDevice(const uint32_t index)
+{
+    return index < getDeviceCount() ? blockDevices[index].device : nullptr;
+}
+
+Block::Device* Block::findDevice(const char* name)
+{
+    if (!name) return nullptr;
+
+    for (uint32_t i = 0; i < getDeviceCount(); ++i)
+        if (namesEqual(blockDevices[i].device->name, name)) return blockDevices[i].device;
+
+    return nullptr;
+}
+
+Block::Request* Block::allocRequest()
+{
+    SlabCache* cache = __atomic_load_n(&blockRequestCache, __ATOMIC_ACQUIRE);
+    if (!cache)
+    {
+        LockGuard guard(blockDeviceLock);
+        if (!blockRequestCache)
+            __atomic_store_n(&blockRequestCache,
+                             SlabAllocator::createCache("block-request", sizeof(Request), alignof(Request)),
+                             __ATOMIC_RELEASE);
+        if (!(cache = blockRequestCache)) return nullptr;
+    }
+
+    auto* request = static_cast<Request*>(SlabAllocator::cacheAlloc(cache));
+    if (request) memset(request, 0, sizeof(Request));
+
+    return request;
+}
+
+void Block::freeRequest(Request* request)
+{
+    if (request) SlabAllocator::free(request);
+}
+
+Block::Status validateRequest(const Block::Request* request)
+{
+    const Block::Device* device = request->device;
+    if (request->op == Block::Op::FLUSH) return Block::Status::PENDING;
+    if (!request->buffer || !request->sectors) return Block::Status::INVALID;
+    if (request->sector >= device->sectors || request->sectors > device->sectors - request->sector)
+        return Block::Status::INVALID;
+    if (device->maxSectors && request->sectors > device->maxSectors) return Block::Status::INVALID;
+    if (request->op == Block::Op::WRITE && device->readOnly) return Block::Status::UNSUPPORTED;
+
+    return Block::Status::PENDING;
+}
+
+void finishRequest(Block::Request* request, const Block::Status status)
+{
+    request->status = status;
+    if (request->callback) request->callback(request);
+}
+
+void mergedDone(Block::Request* container)
+{
+    Block::Request* child = container->merged;
+    while (child)
+    {
+        Block::Request* next = child->merged;
+        child->merged = nullptr;
+        finishRequest(child, container->status);
+        child = next;
+    }
+
+    Block::freeRequest(container);
+}
+
+bool requestsAdjacent(const Block::Request* first, const Block::Request* second)
+{
+    if (first->op != second->op || first->op == Block::Op::FLUSH) return false;
+    if (first->sector + first->sectors != second->sector) return false;
+    if (static_cast<uint8_t*>(first->buffer) + static_cast<uint64_t>(first->sectors) * Block::SECTOR_SIZE !=
+        second->buffer)
+        return false;
+
+    const uint32_t maxSectors = first->device->maxSectors;
+    return !maxSectors || first->sectors + second->sectors <= maxSectors;
+}
+
+Block::Request* mergeRequests(Block::Request* tail, Block::Request* request)
+{
+    const bool back = requestsAdjacent(tail, request), front = !back && requestsAdjacent(request, tail);
+    if (!back && !front) return nullptr;
+
+    Block::Request* container = tail;
+    if (tail->callback != mergedDone)
+    {
+        if (!(container = Block::allocRequest())) return nullptr;
+
+        *container = *tail;
+        container->callback = mergedDone;
+        container->context = nullptr;
+        container->merged = tail;
+        container->next = container->sortNext = nullptr;
+        tail->merged = nullptr;
+    }
+
+    request->next = request->merged = nullptr;
+    container->sectors += request->sectors;
+
+    if (back)
+    {
+        Block::Request* last = container->merged;
+        while (last->merged) last = last->merged;
+        last->merged = request;
+    }
+    else
+    {
+        request->merged = container->merged;
+        container->merged = request;
+        container->sector = request->sector;
+        container->buffer = request->buffer;
+    }
+
+    return container;
+}
+
+bool insertSoftware(SoftwareQueue& software, Block::Request* request)
+{
+    if (software.tail)
+        if (Block::Request* merged = mergeRequests(software.tail, request))
+        {
+            *software.tailLink = merged;
+            software.tail = merged;
+            return true;
+        }
+
+    request->next = nullptr;
+    if (software.tail)
+    {
+        software.tailLink = &software.tail->next;
+        software.tail->next = request;
+    }
+    else
+    {
+        software.tailLink = &software.head;
+        software.head = request;
+    }
+
+    software.tail = request;
+    return false;
+}
+
+SoftwareQueue* softwareFor(BlockDeviceEntry& entry, const uint32_t cpu)
+{
+    if (SoftwareQueue* software = __atomic_load_n(&entry.software[cpu], __ATOMIC_ACQUIRE)) return software;
+
+    auto* software = static_cast<SoftwareQueue*>(SlabAllocator::alloc(sizeof(SoftwareQueue), alignof(SoftwareQueue)));
+    if (!software) return nullptr;
+
+    memset(software, 0, sizeof(SoftwareQueue));
+    software->tailLink = &software->head;
+
+    SoftwareQueue* expected = nullptr;
+    if (__atomic_compare_exchange_n(&entry.software[cpu], &expected, software, false, __ATOMIC_ACQ_REL,
+                                    __ATOMIC_ACQUIRE))
+        return software;
+
+    SlabAllocator::free(software);
+    return expected;
+}
+
+void appendDispatch(HardwareQueue& hardware, Block::Request* request)
+{
+    request->next = nullptr;
+    if (hardware.dispatchTail) hardware.dispatchTail->next = request;
+    else hardware.dispatchHead = request;
+    hardware.dispatchTail = request;
+}
+
+void drainSorted(HardwareQueue& hardware)
+{
+    for (uint32_t direction = 0; direction < 2; ++direction)
+    {
+        Block::Request* request = hardware.sorted[direction];
+        while (request)
+        {
+            Block::Request* next = request->sortNext;
+            request->sortNext = nullptr;
+            appendDispatch(hardware, request);
+            request = next;
+        }
+
+        hardware.sorted[direction] = hardware.fifoHead[direction] = hardware.fifoTail[direction] = nullptr;
+    }
+
+    hardware.batchLeft = 0;
+}
+
+void scheduleInsert(const Block::Device* device, HardwareQueue& hardware, Block::Request* request)
+{
+    if (device->scheduler == Block::Scheduler::NONE)
+    {
+        appendDispatch(hardware, request);
+        return;
+    }
+
+    if (request->op == Block::Op::FLUSH)
+    {
+        drainSorted(hardware);
+        appendDispatch(hardware, request);
+        return;
+    }
+
+    const uint32_t direction = request->op == Block::Op::WRITE;
+    const uint64_t expire = direction ? Block::WRITE_EXPIRE_MS : Block::READ_EXPIRE_MS;
+    request->deadline = TSC::read() + TSC::getFrequency() / 1000 * expire;
+
+    request->next = nullptr;
+    if (hardware.fifoTail[direction]) hardware.fifoTail[direction]->next = request;
+    else hardware.fifoHead[direction] = request;
+    hardware.fifoTail[direction] = request;
+
+    Block::Request** link = &hardware.sorted[direction];
+    while (*link && (*link)->sector <= request->sector) link = &(*link)->sortNext;
+    request->sortNext = *link;
+    *link = request;
+}
+
+Block::Request* scheduleNext(const Block::Device* device, HardwareQueue& hardware)
+{
+    if (Block::Request* request = hardware.dispatchHead)
+    {
+        if (!(hardware.dispatchHead = request->next)) hardware.dispatchTail = nullptr;
+        request->next = nullptr;
+        return request;
+    }
+
+    if (device->scheduler == Block::Scheduler::NONE) return nullptr;
+
+    uint32_t direction = hardware.batchDirection;
+    if (!hardware.batchLeft || !hardware.sorted[direction])
+    {
+        const bool reads = hardware.sorted[0], writes = hardware.sorted[1];
+        if (!reads && !writes) return nullptr;
+
+        if (reads && (!writes || hardware.starved < Block::WRITES_STARVED))
+        {
+            direction = 0;
+            if (writes) ++hardware.starved;
+        }
+        else
+        {
+            direction = 1;
+            hardware.starved = 0;
+        }
+
+        hardware.batchDirection = direction;
+        hardware.batchLeft = Block::DEADLINE_BATCH;
+        if (hardware.fifoHead[direction]->deadline <= TSC::read())
+            hardware.position = hardware.fifoHead[direction]->sector;
+    }
+
+    Block::Request** link = &hardware.sorted[direction];
+    while (*link && (*link)->sector < hardware.position) link = &(*link)->sortNext;
+    if (!*link) link = &hardware.sorted[direction];
+
+    Block::Request* request = *link;
+    *link = request->sortNext;
+    request->sortNext = nullptr;
+
+    Block::Request *previous = nullptr, *cursor = hardware.fifoHead[direction];
+    while (cursor != request) previous = cursor, cursor = cursor->next;
+    if (previous) previous->next = request->next;
+    else hardware.fifoHead[direction] = request->next;
+    if (hardware.fifoTail[direction] == request) hardware.fifoTail[direction] = previous;
+
+    request->next = nullptr;
+    hardware.position = request->sector + request->sectors;
+    --hardware.batchLeft;
+
+    return request;
+}
+
+void drainSoftware(BlockDeviceEntry& entry, HardwareQueue& hardware)
+{
+    for (uint32_t word = 0; word < SMP::MAX_CPUS / 64; ++word)
+    {
+        uint64_t cpus = __atomic_exchange_n(&hardware.pendingCpus[word], 0, __ATOMIC_ACQ_REL);
+        while (cpus)
+        {
+            const uint32_t cpu = word * 64 + __builtin_ctzll(cpus);
+            cpus &= cpus - 1;
+
+            SoftwareQueue* software = __atomic_load_n(&entry.software[cpu], __ATOMIC_ACQUIRE);
+            if (!software) continue;
+
+            Block::Request* list;
+            {
+                LockGuard guard(software->lock);
+                list = software->head;
+                software->head = software->tail = nullptr;
+                software->tailLink = &software->head;
+            }
+
+            LockGuard guard(hardware.lock);
+            while (list)
+            {
+                Block::Request* next = list->next;
+                scheduleInsert(entry.device, hardware, list);
+                list = next;
+            }
+        }
+    }
+}
+
+void dispatchHardware(BlockDeviceEntry& entry, const uint32_t queue)
+{
+    Block::Device* device = entry.device;
+    HardwareQueue& hardware = entry.hardware[queue];
+    const uint32_t queueDepth = device->queueDepth ? device->queueDepth : UINT32_MAX;
+
+    while (true)
+    {
+        Block::Request* batch[SUBMIT_CHUNK];
+        uint32_t count = 0, inflight;
+        {
+            LockGuard guard(hardware.lock);
+            inflight = __atomic_load_n(&hardware.inflight, __ATOMIC_RELAXED);
+            while (count < SUBMIT_CHUNK && inflight + count < queueDepth)
+            {
+                Block::Request* request = scheduleNext(device, hardware);
+                if (!request) break;
+                batch[count++] = request;
+            }
+
+            inflight = __atomic_add_fetch(&hardware.inflight, count, __ATOMIC_RELAXED);
+        }
+
+        if (!count) return;
+
+        __atomic_add_fetch(&entry.stats.depth[histogramBucket(inflight)], 1, __ATOMIC_RELAXED);
+        if (inflight > __atomic_load_n(&entry.stats.maxDepth, __ATOMIC_RELAXED))
+            __atomic_store_n(&entry.stats.maxDepth, inflight, __ATOMIC_RELAXED);
+
+        const uint32_t accepted = device->ops->submit(device, queue, batch, count);
+        __atomic_add_fetch(&entry.stats.dispatched, accepted, __ATOMIC_RELAXED);
+        if (accepted >= count) continue;
+
+        LockGuard guard(hardware.lock);
+        __atomic_sub_fetch(&hardware.inflight, count - accepted, __ATOMIC_RELAXED);
+        for (uint32_t i = count; i-- > accepted;)
+        {
+            batch[i]->next = hardware.dispatchHead;
+            hardware.dispatchHead = batch[i];
+            if (!hardware.dispatchTail) hardware.dispatchTail = batch[i];
+        }
+
+        return;
+    }
+}
+
+void runHardwareQueue(BlockDeviceEntry& entry, const uint32_t queue)
+{
+    HardwareQueue& hardware = entry.hardware[queue];
+
+    __atomic_store_n(&hardware.rerun, true, __ATOMIC_SEQ_CST);
+    while (!__atomic_exchange_n(&hardware.running, true, __ATOMIC_SEQ_CST))
+    {
+        while (__atomic_exchange_n(&hardware.rerun, false, __ATOMIC_SEQ_CST))
+        {
+            drainSoftware(entry, hardware);
+            dispatchHardware(entry, queue);
+        }
+
+        __atomic_store_n(&hardware.running, false, __ATOMIC_SEQ_CST);
+        if (!__atomic_load_n(&hardware.rerun, __ATOMIC_SEQ_CST)) return;
+    }
+}
+
+bool Block::setScheduler(Device* device, const Scheduler scheduler)
+{
+    BlockDeviceEntry* entry = entryFor(device);
+    if (!entry) return false;
+
+    __atomic_store_n(&device->scheduler, scheduler, __ATOMIC_RELEASE);
+    for (uint32_t queue = 0; queue < device->queueCount; ++queue)
+    {
+        LockGuard guard(entry->hardware[queue].lock);
+        drainSorted(entry->hardware[queue]);
+    }
+
+    for (uint32_t queue = 0; queue < device->queueCount; ++queue) runHardwareQueue(*entry, queue);
+    return true;
+}
+
+void Block::plug(Plug& plug, Request* request)
+{
+    request->next = request->merged = request->sortNext = nullptr;
+    request->submitTsc = TSC::read();
+
+    if (const Status status = validateRequest(request); status != Status::PENDING)
+    {
+        finishRequest(request, status);
+        return;
+    }
+
+    request->status = Status::PENDING;
+    if (request->op == Op::FLUSH) unplug(plug);
+
+    Request** link = &plug.head;
+    while (*link && ((*link)->device < request->device ||
+                     ((*link)->device == request->device && (*link)->sector <= request->sector)))
+        link = &(*link)->next;
+    request->next = *link;
+    *link = request;
+
+    if (++plug.count >= PLUG_LIMIT) unplug(plug);
+}
+
+void Block::unplug(Plug& plug)
+{
+    Request* list = plug.head;
+    plug.head = nullptr;
+    plug.count = 0;
+
+    const uint32_t cpu = CPUManager::getCurrentCPUId();
+    while (list)
+    {
+        Device* device = list->device;
+        BlockDeviceEntry* entry = entryFor(device);
+        SoftwareQueue* software = entry ? softwareFor(*entry, cpu) : nullptr;
+        if (!software)
+        {
+            Request* next = list->next;
+            finishRequest(list, entry ? Status::IO_ERROR : Status::INVALID);
+            list = next;
+            continue;
+        }
+
+        const uint32_t queue = device->queueForCpu[cpu];
+        {
+            LockGuard guard(software->lock);
+            while (list && list->device == device)
+            {
+                Request* next = list->next;
+                list->queue = static_cast<uint16_t>(queue);
+                if (insertSoftware(*software, list)) __atomic_add_fetch(&entry->stats.merges, 1, __ATOMIC_RELAXED);
+                list = next;
+            }
+        }
+
+        __atomic_or_fetch(&entry->hardware[queue].pendingCpus[cpu / 64], 1ULL << (cpu % 64), __ATOMIC_RELEASE);
+        runHardwareQueue(*entry, queue);
+    }
+}
+
+uint32_t Block::submitBatch(Device* device, Request** requests, const uint32_t count)
+{
+    if (!device || !requests) return 0;
+
+    Plug batch;
+    uint32_t submitted = 0;
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        requests[i]->device = device;
+        plug(batch, requests[i]);
+        if (requests[i]->status == Status::PENDING) ++submitted;
+    }
+
+    unplug(batch);
+    return submitted;
+}
+
+bool Block::submit(Request* request)
+{
+    return request && request->device && submitBatch(request->device, &request, 1) == 1;
+}
+
+void Block::complete(Request* request, const Status status)
+{
+    Device* device = request->device;
+    if (BlockDeviceEntry* entry = entryFor(device); entry && request->queue < device->queueCount)
+    {
+        __atomic_sub_fetch(&entry->hardware[request->queue].inflight, 1, __ATOMIC_RELAXED);
+
+        if (request->submitTsc && request->op != Op::FLUSH)
+        {
+            const uint64_t latency = TSC::read() - request->submitTsc;
+            __atomic_add_fetch(&entry->stats.latency[request->op == Op::WRITE]
+                                                    [histogramBucket(TSC::toMicroseconds(latency))],
+                               1, __ATOMIC_RELAXED);
+
+            if (device->hybridPoll && status == Status::OK)
+            {
+                const uint64_t mean = __atomic_load_n(&device->meanLatency, __ATOMIC_RELAXED);
+                __atomic_store_n(&device->meanLatency, mean ? mean - mean / 8 + latency / 8 : latency,
+                                 __ATOMIC_RELAXED);
+            }
+        }
+    }
+
+    finishRequest(request, status);
+}
+
+void Block::completeList(Request* list)
+{
+    while (list)
+    {
+        Request* next = list->next;
+        complete(list, list->status);
+        list = next;
+    }
+}
+
+void Block::kick(Device* device, const uint32_t queue)
+{
+    BlockDeviceEntry* entry = entryFor(device);
+    if (entry && queue < device->queueCount) runHardwareQueue(*entry, queue);
+}
+
+uint32_t Block::poll(Device* device)
+{
+    if (!device || !device->ops->poll) return 0;
+
+    uint32_t completed = 0;
+    for (uint32_t queue = 0; queue < device->queueCount; ++queue)
+    {
+        completed += device->ops->poll(device, queue);
+        kick(device, queue);
+    }
+
+    return completed;
+}
+
+void transferDone(Block::Request* request)
+{
+    __atomic_sub_fetch(static_cast<uint32_t*>(request->context), 1, __ATOMIC_RELEASE);
+}
+
+Block::Status Block::transfer(Device* device, const Op op, uint64_t sector, uint32_t sectors, void* buffer)
+{
+    if (!device) return Status::INVALID;
+    if (op == Op::FLUSH) sectors = 0;
+
+    const uint32_t chunkSectors = device->maxSectors ? device->maxSectors : sectors;
+    auto* cursor = static_cast<uint8_t*>(buffer);
+
+    do
+    {
+        Request requests[TRANSFER_BATCH];
+        Request* batch[TRANSFER_BATCH];
+        uint32_t count = 0, outstanding = 0;
+
+        do
+        {
+            const uint32_t chunk = op == Op::FLUSH ? 0 : sectors < chunkSectors ? sectors : chunkSectors;
+
+            requests[count] = {};
+            requests[count].op = op;
+            requests[count].sector = sector;
+            requests[count].sectors = chunk;
+            requests[count].buffer = cursor;
+            requests[count].callback = transferDone;
+            requests[count].context = &outstanding;
+            batch[count] = &requests[count];
+            ++count;
+
+            sector += chunk;
+            sectors -= chunk;
+            cursor += static_cast<uint64_t>(chunk) * SECTOR_SIZE;
+        } while (sectors && count < TRANSFER_BATCH);
+
+        outstanding = count;
+        const uint64_t spinFrom = TSC::read() + __atomic_load_n(&device->meanLatency, __ATOMIC_RELAXED) / 2;
+        submitBatch(device, batch, count);
+
+        while (__atomic_load_n(&outstanding, __ATOMIC_ACQUIRE))
+        {
+            if (device->hybridPoll && TSC::read() >= spinFrom)
+            {
+                poll(device);
+                asm volatile ("pause");
+                continue;
+            }
+
+            if (!device->hybridPoll) poll(device);
+            if (Interrupt::interruptsEnabled()) Task::taskYield();
+            else asm volatile ("pause");
+        }
+
+        for (uint32_t i = 0; i < count; ++i) if (requests[i].status != Status::OK) return requests[i].status;
+    } while (sectors);
+
+    return Status::OK;
+}
+
+uint32_t Block::buildSegments(const void* buffer, uint64_t length, Segment* segments, const uint32_t maxSegments)
+{
+    auto address = reinterpret_cast<uint64_t>(buffer);
+    uint32_t count = 0;
+
+    while (length)
+    {
+        const uint64_t physical = Paging::translate(address);
+        if (!physical) return 0;
+
+        uint64_t chunk = FrameAllocator::SMALL_SIZE - (address & (FrameAllocator::SMALL_SIZE - 1));
+        if (chunk > length) chunk = length;
+
+        if (count && segments[count - 1].physical + segments[count - 1].length == physical)
+            segments[count - 1].length += static_cast<uint32_t>(chunk);
+        else
+        {
+            if (count == maxSegments) return 0;
+            segments[count++] = {physical, static_cast<uint32_t>(chunk)};
+        }
+
+        address += chunk;
+        length -= chunk;
+    }
+
+    return count;
+}
+
+void Block::dumpStats()
+{
+    static constexpr const char* opNames[2] = {"read", "write"};
+
+    for (uint32_t i = 0; i < getDeviceCount(); ++i)
+    {
+        const Device* device = blockDevices[i].device;
+        BlockStats& stats = blockDevices[i].stats;
+
+        Serial::printf("BLOCK %s scheduler=%s queues=%u dispatched=%lu merges=%lu max_depth=%u\n", device->name,
+                       device->scheduler == Scheduler::DEADLINE ? "deadline" : "none", device->queueCount,
+                       __atomic_load_n(&stats.dispatched, __ATOMIC_RELAXED),
+                       __atomic_load_n(&stats.merges, __ATOMIC_RELAXED),
+                       __atomic_load_n(&stats.maxDepth, __ATOMIC_RELAXED));
+
+        for (uint32_t op = 0; op < 2; ++op)
+        {
+            Serial::printf("BLOCK %s %s_latency_us", device->name, opNames[op]);
+            for (uint32_t bucket = 0; bucket < HISTOGRAM_BUCKETS; ++bucket)
+                if (const uint64_t count = __atomic_load_n(&stats.latency[op][bucket], __ATOMIC_RELAXED))
+                    Serial::printf(" <%lu:%lu", 1UL << bucket, count);
+            Serial::printf("\n");
+        }
+
+        Serial::printf("BLOCK %s depth", device->name);
+        for (uint32_t bucket = 0; bucket < HISTOGRAM_BUCKETS; ++bucket)
+            if (const uint64_t count = __atomic_load_n(&stats.depth[bucket], __ATOMIC_RELAXED))
+                Serial::printf(" <%lu:%lu", 1UL << bucket, count);
+        Serial::printf("\n");
+    }
+}
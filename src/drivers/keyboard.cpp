@@ -1,10 +1,12 @@
 #include <drivers/keyboard.h>
 #include <drivers/serial.h>
 #include <memory/spinlock.h>
+#include <task/softirq.h>
+#include <task/workqueue.h>
 
 constexpr uint16_t DATA_PORT = 0x60, STATUS_PORT = 0x64;
 constexpr uint8_t STATUS_OUTPUT_BUFFER = 1 << 0, STATUS_INPUT_BUFFER = 1 << 1;
-constexpr size_t QUEUE_SIZE = 256;
+constexpr size_t QUEUE_SIZE = 256, RAW_SIZE = 64;
 
 struct Queue
 {
@@ -12,6 +14,12 @@ struct Queue
     size_t head = 0, tail = 0, count = 0;
 };
 
+struct RawQueue
+{
+    uint8_t bytes[RAW_SIZE] = {};
+    uint32_t head = 0, tail = 0;
+};
+
 struct DecodeState
 {
     bool prefixE0 = false, prefixE1 = false;
@@ -51,6 +59,7 @@ constexpr Pair pairs[] = {
 bool keyboardInitialized = false, ledsDirty = false;
 Spinlock lock;
 Queue eventQueue = {};
+RawQueue rawQueue = {};
 Keyboard::Modifiers currentModifiers = {false, false, false, false, false, false, false};
 DecodeState decodeState = {};
 
@@ -437,23 +446,57 @@ void pushEvent(const Keyboard::Event& event)
     eventQueue.count++;
 }
 
-bool consumeByte()
+void updateLeds(void*)
 {
-    if (!(inb(STATUS_PORT) & STATUS_OUTPUT_BUFFER)) return false;
     LockGuard guard(lock);
+    if (!keyboardInitialized || !ledsDirty) return;
 
-    const uint8_t scancode = readData();
-    Keyboard::Event e = {};
-    bool produced = false;
+    ledsDirty = false;
+    setLeds(currentModifiers.capsLock, currentModifiers.numLock, currentModifiers.scrollLock);
+}
 
-    decodeByte(scancode, e, produced);
-    if (produced)
+void processBytes()
+{
+    bool scheduleLeds = false;
     {
-        applyModifiers(e);
-        e.modifiers = currentModifiers;
-        e.ascii = mapAscii(e.key, currentModifiers);
+        LockGuard guard(lock);
+
+        uint32_t head = __atomic_load_n(&rawQueue.head, __ATOMIC_RELAXED);
+        const uint32_t tail = __atomic_load_n(&rawQueue.tail, __ATOMIC_ACQUIRE);
+
+        for (; head != tail; ++head)
+        {
+            Keyboard::Event e = {};
+            bool produced = false;
+
+            decodeByte(rawQueue.bytes[head % RAW_SIZE], e, produced);
+            if (!produced) continue;
+
+            const bool wasDirty = ledsDirty;
+            applyModifiers(e);
+            e.modifiers = currentModifiers;
+            e.ascii = mapAscii(e.key, currentModifiers);
+
+            pushEvent(e);
+            scheduleLeds |= !wasDirty && ledsDirty;
+        }
 
-        pushEvent(e);
+        __atomic_store_n(&rawQueue.head, head, __ATOMIC_RELEASE);
+    }
+
+    if (scheduleLeds) WorkQueue::queueWork(updateLeds, nullptr);
+}
+
+bool consumeByte()
+{
+    if (!(inb(STATUS_PORT) & STATUS_OUTPUT_BUFFER)) return false;
+
+    const uint8_t scancode = readData();
+    const uint32_t tail = __atomic_load_n(&rawQueue.tail, __ATOMIC_RELAXED);
+    if (tail - __atomic_load_n(&rawQueue.head, __ATOMIC_ACQUIRE) < RAW_SIZE)
+    {
+        rawQueue.bytes[tail % RAW_SIZE] = scancode;
+        __atomic_store_n(&rawQueue.tail, tail + 1, __ATOMIC_RELEASE);
     }
 
     return true;
@@ -483,18 +526,14 @@ void Keyboard::init()
     setLeds(currentModifiers.capsLock, currentModifiers.numLock, currentModifiers.scrollLock);
     sendKeyboardCommand(0xF4, false);
 
+    Softirq::setHandler(Softirq::Type::KEYBOARD, processBytes);
     keyboardInitialized = true;
 }
 
-void Keyboard::irq() { while (consumeByte()); }
-
-void Keyboard::service()
+void Keyboard::irq()
 {
-    LockGuard guard(lock);
-    if (!keyboardInitialized || !ledsDirty) return;
-
-    ledsDirty = false;
-    setLeds(currentModifiers.capsLock, currentModifiers.numLock, currentModifiers.scrollLock);
+    while (consumeByte());
+    Softirq::raise(Softirq::Type::KEYBOARD);
 }
 
 bool Keyboard::readEvent(Event& event)
@@ -527,5 +566,6 @@ void Keyboard::clear()
 {
     LockGuard guard(lock);
     eventQueue = Queue{};
+    rawQueue.head = __atomic_load_n(&rawQueue.tail, __ATOMIC_ACQUIRE);
     decodeState = {};
 }
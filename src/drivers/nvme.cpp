@@ -0,0 +1,622 @@
+#include <arch/x86_64/cpu.h>
+#include <arch/x86_64/tsc.h>
+#include <core/limine.h>
+#include <drivers/block.h>
+#include <drivers/nvme.h>
+#include <drivers/pci.h>
+#include <drivers/serial.h>
+#include <memory/buddy.h>
+#include <memory/paging.h>
+#include <memory/slab.h>
+
+extern limine_hhdm_request hhdm_request;
+
+constexpr uint32_t NVME_REG_CAP = 0x00, NVME_REG_VS = 0x08, NVME_REG_CC = 0x14, NVME_REG_CSTS = 0x1C,
+                   NVME_REG_AQA = 0x24, NVME_REG_ASQ = 0x28, NVME_REG_ACQ = 0x30, NVME_REG_DOORBELLS = 0x1000;
+constexpr uint32_t NVME_CC_ENABLE = 1u << 0, NVME_CC_IOSQES = 6u << 16, NVME_CC_IOCQES = 4u << 20;
+constexpr uint32_t NVME_CSTS_READY = 1u << 0, NVME_CSTS_FATAL = 1u << 1;
+constexpr uint8_t NVME_ADMIN_CREATE_SQ = 0x01, NVME_ADMIN_CREATE_CQ = 0x05, NVME_ADMIN_IDENTIFY = 0x06,
+                  NVME_ADMIN_SET_FEATURES = 0x09;
+constexpr uint8_t NVME_CMD_FLUSH = 0x00, NVME_CMD_WRITE = 0x01, NVME_CMD_READ = 0x02;
+constexpr uint32_t NVME_FEATURE_QUEUES = 0x07, NVME_IDENTIFY_NAMESPACE = 0, NVME_IDENTIFY_CONTROLLER = 1;
+constexpr uint32_t NVME_PRP_ENTRIES = Nvme::MAX_TRANSFER / 4096;
+constexpr int NVME_SQ_ORDER = 2, NVME_CQ_ORDER = 0, NVME_PRP_ORDER = 4;
+
+struct NvmeCommand
+{
+    uint8_t opcode, flags;
+    uint16_t cid;
+    uint32_t nsid;
+    uint64_t reserved, metadata, prp1, prp2;
+    uint32_t cdw10, cdw11, cdw12, cdw13, cdw14, cdw15;
+};
+
+struct NvmeCompletion
+{
+    uint32_t result, reserved;
+    uint16_t sqHead, sqId, cid, status;
+};
+
+struct NvmeController;
+
+struct NvmeQueue
+{
+    Spinlock lock;
+    NvmeController* controller;
+    uint32_t index;
+    uint16_t id, depth, sqTail, cqHead, freeCount;
+    bool phase;
+    NvmeCommand* sq;
+    volatile NvmeCompletion* cq;
+    volatile uint32_t *sqDoorbell, *cqDoorbell;
+    uint64_t sqPhysical, cqPhysical, prpPhysical;
+    uint64_t* prpLists;
+    Block::Request** inflight;
+    uint16_t* freeIds;
+};
+
+struct NvmeController
+{
+    Block::Device block;
+    PCI::Device* pci;
+    volatile uint8_t* registers;
+    uint32_t doorbellStride, timeoutMs, nsid, lbaShift;
+    NvmeQueue admin;
+    NvmeQueue* queues;
+};
+
+uint32_t nvmeControllerCount = 0;
+
+uint32_t nvmeRead32(const NvmeController& controller, const uint32_t offset)
+{
+    return *reinterpret_cast<volatile uint32_t*>(controller.registers + offset);
+}
+
+uint64_t nvmeRead64(const NvmeController& controller, const uint32_t offset)
+{
+    return nvmeRead32(controller, offset) | static_cast<uint64_t>(nvmeRead32(controller, offset + 4)) << 32;
+}
+
+void nvmeWrite32(const NvmeController& controller, const uint32_t offset, const uint32_t value)
+{
+    *reinterpret_cast<volatile uint32_t*>(controller.registers + offset) = value;
+}
+
+void nvmeWrite64(const NvmeController& controller, const uint32_t offset, const uint64_t value)
+{
+    nvmeWrite32(controller, offset, static_cast<uint32_t>(value));
+    nvmeWrite32(controller, offset + 4, static_cast<uint32_t>(value >> 32));
+}
+
+void* nvmeVirtual(const uint64_t physical) { return reinterpret_cast<void*>(physical + hhdm_request.response->offset); }
+
+bool nvmeWaitDeadline(const uint64_t start, const uint32_t timeoutMs)
+{
+    const uint64_t frequency = TSC::getFrequency();
+    if (!frequency) return true;
+
+    return TSC::read() - start < frequency / 1000 * timeoutMs;
+}
+
+bool nvmeWaitReady(const NvmeController& controller, const bool ready)
+{
+    const uint64_t start = TSC::read();
+    for (uint64_t spins = 0; nvmeWaitDeadline(start, controller.timeoutMs) && spins < (1ULL << 32); ++spins)
+    {
+        const uint32_t status = nvmeRead32(controller, NVME_REG_CSTS);
+        if (status & NVME_CSTS_FATAL) return false;
+        if (static_cast<bool>(status & NVME_CSTS_READY) == ready) return true;
+
+        asm volatile ("pause");
+    }
+
+    return false;
+}
+
+bool nvmeAllocQueue(NvmeController& controller, NvmeQueue& queue, const uint16_t id, const uint16_t depth,
+                    const bool io)
+{
+    memset(&queue, 0, sizeof(NvmeQueue));
+    queue.controller = &controller;
+    queue.id = id;
+    queue.depth = depth;
+    queue.phase = true;
+    queue.sqDoorbell = reinterpret_cast<volatile uint32_t*>(controller.registers + NVME_REG_DOORBELLS +
+                                                            2u * id * controller.doorbellStride);
+    queue.cqDoorbell = reinterpret_cast<volatile uint32_t*>(controller.registers + NVME_REG_DOORBELLS +
+                                                            (2u * id + 1) * controller.doorbellStride);
+
+    queue.sqPhysical = BuddyAllocator::alloc(NVME_SQ_ORDER, AllocFlags::ZEROED);
+    queue.cqPhysical = BuddyAllocator::alloc(NVME_CQ_ORDER, AllocFlags::ZEROED);
+    if (!queue.sqPhysical || !queue.cqPhysical) return false;
+
+    queue.sq = static_cast<NvmeCommand*>(nvmeVirtual(queue.sqPhysical));
+    queue.cq = static_cast<volatile NvmeCompletion*>(nvmeVirtual(queue.cqPhysical));
+    if (!io) return true;
+
+    queue.prpPhysical = BuddyAllocator::alloc(NVME_PRP_ORDER);
+    queue.inflight = static_cast<Block::Request**>(SlabAllocator::alloc(sizeof(Block::Request*) * depth));
+    queue.freeIds = static_cast<uint16_t*>(SlabAllocator::alloc(sizeof(uint16_t) * depth));
+    if (!queue.prpPhysical || !queue.inflight || !queue.freeIds) return false;
+
+    queue.prpLists = static_cast<uint64_t*>(nvmeVirtual(queue.prpPhysical));
+    memset(queue.inflight, 0, sizeof(Block::Request*) * depth);
+    for (uint16_t i = 0; i + 1 < depth; ++i) queue.freeIds[queue.freeCount++] = static_cast<uint16_t>(depth - 2 - i);
+
+    return true;
+}
+
+bool nvmeAdmin(NvmeController& controller, NvmeCommand command, uint32_t* result = nullptr)
+{
+    NvmeQueue& queue = controller.admin;
+    LockGuard guard(queue.lock);
+
+    command.cid = queue.sqTail;
+    queue.sq[queue.sqTail] = command;
+    queue.sqTail = static_cast<uint16_t>((queue.sqTail + 1) % queue.depth);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    *queue.sqDoorbell = queue.sqTail;
+
+    const uint64_t start = TSC::read();
+    volatile NvmeCompletion& entry = queue.cq[queue.cqHead];
+    uint64_t spins = 0;
+    while ((entry.status & 1) != queue.phase)
+    {
+        if (!nvmeWaitDeadline(start, controller.timeoutMs) || ++spins == 1ULL << 32)
+        {
+            Serial::printf("Nvme: Admin command %x timed out\n", command.opcode);
+            return false;
+        }
+        asm volatile ("pause");
+    }
+
+    const uint16_t status = entry.status >> 1;
+    if (result) *result = entry.result;
+    if (++queue.cqHead == queue.depth)
+    {
+        queue.cqHead = 0;
+        queue.phase = !queue.phase;
+    }
+    *queue.cqDoorbell = queue.cqHead;
+
+    if (status)
+    {
+        Serial::printf("Nvme: Admin command %x failed with status %x\n", command.opcode, status);
+        return false;
+    }
+
+    return true;
+}
+
+bool nvmeIdentify(NvmeController& controller, const uint32_t cns, const uint32_t nsid, const uint64_t buffer)
+{
+    NvmeCommand command = {};
+    command.opcode = NVME_ADMIN_IDENTIFY;
+    command.nsid = nsid;
+    command.prp1 = buffer;
+    command.cdw10 = cns;
+
+    return nvmeAdmin(controller, command);
+}
+
+bool nvmeCreateQueuePair(NvmeController& controller, const NvmeQueue& queue, const uint16_t vector,
+                         const bool interrupts)
+{
+    NvmeCommand command = {};
+    command.opcode = NVME_ADMIN_CREATE_CQ;
+    command.prp1 = queue.cqPhysical;
+    command.cdw10 = static_cast<uint32_t>(queue.depth - 1) << 16 | queue.id;
+    command.cdw11 = static_cast<uint32_t>(vector) << 16 | (interrupts ? 1u << 1 : 0) | 1u;
+    if (!nvmeAdmin(controller, command)) return false;
+
+    command = {};
+    command.opcode = NVME_ADMIN_CREATE_SQ;
+    command.prp1 = queue.sqPhysical;
+    command.cdw10 = static_cast<uint32_t>(queue.depth - 1) << 16 | queue.id;
+    command.cdw11 = static_cast<uint32_t>(queue.id) << 16 | 1u;
+
+    return nvmeAdmin(controller, command);
+}
+
+bool nvmeBuildPrps(const NvmeQueue& queue, const uint16_t cid, const void* buffer, uint64_t length,
+                   NvmeCommand& command)
+{
+    auto address = reinterpret_cast<uint64_t>(buffer);
+    if (address & 3) return false;
+
+    command.prp1 = Paging::translate(address);
+    if (!command.prp1) return false;
+
+    const uint64_t firstLength = FrameAllocator::SMALL_SIZE - (address & (FrameAllocator::SMALL_SIZE - 1));
+    if (length <= firstLength) return true;
+
+    address += firstLength;
+    length -= firstLength;
+
+    uint64_t* list = queue.prpLists + static_cast<uint64_t>(cid) * NVME_PRP_ENTRIES;
+    uint32_t entries = 0;
+    while (length)
+    {
+        if (entries == NVME_PRP_ENTRIES) return false;
+
+        const uint64_t page = Paging::translate(address);
+        if (!page) return false;
+
+        list[entries++] = page;
+        const uint64_t chunk = length < FrameAllocator::SMALL_SIZE ? length : FrameAllocator::SMALL_SIZE;
+        address += chunk;
+        length -= chunk;
+    }
+
+    command.prp2 = entries == 1 ? list[0]
+                                : queue.prpPhysical + static_cast<uint64_t>(cid) * NVME_PRP_ENTRIES * sizeof(uint64_t);
+    return true;
+}
+
+bool nvmeBuildCommand(const NvmeController& controller, const NvmeQueue& queue, const uint16_t cid,
+                      const Block::Request& request, NvmeCommand& command)
+{
+    memset(&command, 0, sizeof(NvmeCommand));
+    command.cid = cid;
+    command.nsid = controller.nsid;
+    if (request.op == Block::Op::FLUSH)
+    {
+        command.opcode = NVME_CMD_FLUSH;
+        return true;
+    }
+
+    const uint64_t mask = (1ULL << controller.lbaShift) - 1;
+    if ((request.sector | request.sectors) & mask) return false;
+
+    const uint64_t lba = request.sector >> controller.lbaShift;
+    command.opcode = request.op == Block::Op::READ ? NVME_CMD_READ : NVME_CMD_WRITE;
+    command.cdw10 = static_cast<uint32_t>(lba);
+    command.cdw11 = static_cast<uint32_t>(lba >> 32);
+    command.cdw12 = (request.sectors >> controller.lbaShift) - 1;
+
+    return nvmeBuildPrps(queue, cid, request.buffer, static_cast<uint64_t>(request.sectors) * Block::SECTOR_SIZE,
+                         command);
+}
+
+uint32_t nvmeSubmit(Block::Device* device, const uint32_t queueIndex, Block::Request** requests, const uint32_t count)
+{
+    auto* controller = static_cast<NvmeController*>(device->driverData);
+    NvmeQueue& queue = controller->queues[queueIndex];
+    Block::Request* rejected = nullptr;
+    uint32_t accepted = 0;
+
+    {
+        LockGuard guard(queue.lock);
+        const uint16_t initialTail = queue.sqTail;
+
+        for (; accepted < count && queue.freeCount; ++accepted)
+        {
+            Block::Request* request = requests[accepted];
+            const uint16_t cid = queue.freeIds[queue.freeCount - 1];
+            if (!nvmeBuildCommand(*controller, queue, cid, *request, queue.sq[queue.sqTail]))
+            {
+                request->status = Block::Status::INVALID;
+                request->next = rejected;
+                rejected = request;
+                continue;
+            }
+
+            --queue.freeCount;
+            queue.inflight[cid] = request;
+            queue.sqTail = static_cast<uint16_t>((queue.sqTail + 1) % queue.depth);
+        }
+
+        if (queue.sqTail != initialTail)
+        {
+            __atomic_thread_fence(__ATOMIC_RELEASE);
+            *queue.sqDoorbell = queue.sqTail;
+        }
+    }
+
+    Block::completeList(rejected);
+    return accepted;
+}
+
+Block::Status nvmeStatus(const uint16_t status)
+{
+    const uint16_t code = status >> 1 & 0xFF, type = status >> 9 & 0x7;
+    if (!code && !type) return Block::Status::OK;
+
+    return !type && code == 0x01 ? Block::Status::UNSUPPORTED : Block::Status::IO_ERROR;
+}
+
+uint32_t nvmeReap(NvmeQueue& queue)
+{
+    Block::Request* done = nullptr;
+    uint32_t completed = 0;
+
+    {
+        LockGuard guard(queue.lock);
+        const uint16_t initialHead = queue.cqHead;
+
+        while (true)
+        {
+            volatile NvmeCompletion& entry = queue.cq[queue.cqHead];
+            const uint16_t status = entry.status;
+            if ((status & 1) != queue.phase) break;
+
+            if (const uint16_t cid = entry.cid; cid < queue.depth && queue.inflight[cid])
+            {
+                Block::Request* request = queue.inflight[cid];
+                queue.inflight[cid] = nullptr;
+                queue.freeIds[queue.freeCount++] = cid;
+
+                request->status = nvmeStatus(status);
+                request->next = done;
+                done = request;
+                ++completed;
+            }
+
+            if (++queue.cqHead == queue.depth)
+            {
+                queue.cqHead = 0;
+                queue.phase = !queue.phase;
+            }
+        }
+
+        if (queue.cqHead != initialHead) *queue.cqDoorbell = queue.cqHead;
+    }
+
+    Block::completeList(done);
+    return completed;
+}
+
+uint32_t nvmePoll(Block::Device* device, const uint32_t queueIndex)
+{
+    return nvmeReap(static_cast<NvmeController*>(device->driverData)->queues[queueIndex]);
+}
+
+void nvmeInterrupt(void* arg)
+{
+    auto* queue = static_cast<NvmeQueue*>(arg);
+    if (!queue->controller->block.ops) return;
+
+    nvmeReap(*queue);
+    Block::kick(&queue->controller->block, queue->index);
+}
+
+constexpr Block::Operations nvmeOps = {nvmeSubmit, nvmePoll};
+
+bool nvmeEnable(NvmeController& controller)
+{
+    const uint64_t capabilities = nvmeRead64(controller, NVME_REG_CAP);
+    if (!(capabilities >> 37 & 1) || (capabilities >> 48 & 0xF))
+    {
+        Serial::printf("Nvme: Controller lacks the NVM command set or 4 KiB pages\n");
+        return false;
+    }
+
+    controller.doorbellStride = 4u << (capabilities >> 32 & 0xF);
+    controller.timeoutMs = static_cast<uint32_t>(capabilities >> 24 & 0xFF) * 500;
+    if (!controller.timeoutMs) controller.timeoutMs = 500;
+
+    nvmeWrite32(controller, NVME_REG_CC, nvmeRead32(controller, NVME_REG_CC) & ~NVME_CC_ENABLE);
+    if (!nvmeWaitReady(controller, false))
+    {
+        Serial::printf("Nvme: Controller did not reset\n");
+        return false;
+    }
+
+    if (!nvmeAllocQueue(controller, controller.admin, 0, Nvme::ADMIN_DEPTH, false)) return false;
+
+    nvmeWrite32(controller, NVME_REG_AQA, (Nvme::ADMIN_DEPTH - 1) << 16 | (Nvme::ADMIN_DEPTH - 1));
+    nvmeWrite64(controller, NVME_REG_ASQ, controller.admin.sqPhysical);
+    nvmeWrite64(controller, NVME_REG_ACQ, controller.admin.cqPhysical);
+    nvmeWrite32(controller, NVME_REG_CC, NVME_CC_ENABLE | NVME_CC_IOSQES | NVME_CC_IOCQES);
+    if (!nvmeWaitReady(controller, true))
+    {
+        Serial::printf("Nvme: Controller did not become ready\n");
+        return false;
+    }
+
+    const uint32_t version = nvmeRead32(controller, NVME_REG_VS);
+    Serial::printf("Nvme: Controller version %u.%u, doorbell stride %u\n", version >> 16, version >> 8 & 0xFF,
+                   controller.doorbellStride);
+    return true;
+}
+
+bool nvmeIdentifyNamespace(NvmeController& controller)
+{
+    const uint64_t page = BuddyAllocator::alloc(0, AllocFlags::ZEROED);
+    if (!page) return false;
+
+    const auto* data = static_cast<const uint8_t*>(nvmeVirtual(page));
+    bool ok = nvmeIdentify(controller, NVME_IDENTIFY_CONTROLLER, 0, page);
+
+    uint64_t maxTransfer = Nvme::MAX_TRANSFER;
+    if (ok && data[77] && (FrameAllocator::SMALL_SIZE << data[77]) < maxTransfer)
+        maxTransfer = FrameAllocator::SMALL_SIZE << data[77];
+
+    controller.nsid = 1;
+    ok = ok && nvmeIdentify(controller, NVME_IDENTIFY_NAMESPACE, controller.nsid, page);
+    if (ok)
+    {
+        const uint64_t size = *reinterpret_cast<const uint64_t*>(data);
+        const uint8_t format = data[26] & 0xF, lbaBits = data[128 + format * 4 + 2];
+
+        if (!size || lbaBits < 9 || lbaBits > 12)
+        {
+            Serial::printf("Nvme: Namespace 1 is empty or uses unsupported %u-bit LBAs\n", lbaBits);
+            ok = false;
+        }
+        else
+        {
+            controller.lbaShift = lbaBits - 9u;
+            controller.block.sectors = size << controller.lbaShift;
+            controller.block.sectorSize = 1u << lbaBits;
+            controller.block.maxSectors = static_cast<uint32_t>(maxTransfer / Block::SECTOR_SIZE);
+            controller.block.maxSegments = NVME_PRP_ENTRIES + 1;
+        }
+    }
+
+    BuddyAllocator::free(page, 0);
+    return ok;
+}
+
+uint32_t nvmeRequestQueues(NvmeController& controller, const uint32_t wanted)
+{
+    NvmeCommand command = {};
+    command.opcode = NVME_ADMIN_SET_FEATURES;
+    command.cdw10 = NVME_FEATURE_QUEUES;
+    command.cdw11 = (wanted - 1) << 16 | (wanted - 1);
+
+    uint32_t result = 0;
+    if (!nvmeAdmin(controller, command, &result)) return 0;
+
+    const uint32_t submission = (result & 0xFFFF) + 1, completion = (result >> 16) + 1;
+    const uint32_t granted = submission < completion ? submission : completion;
+
+    return granted < wanted ? granted : wanted;
+}
+
+void nvmeReleaseQueue(NvmeQueue& queue)
+{
+    if (queue.freeIds) SlabAllocator::free(queue.freeIds);
+    if (queue.inflight) SlabAllocator::free(queue.inflight);
+    if (queue.prpPhysical) BuddyAllocator::free(queue.prpPhysical, NVME_PRP_ORDER);
+    if (queue.cqPhysical) BuddyAllocator::free(queue.cqPhysical, NVME_CQ_ORDER);
+    if (queue.sqPhysical) BuddyAllocator::free(queue.sqPhysical, NVME_SQ_ORDER);
+    memset(&queue, 0, sizeof(NvmeQueue));
+}
+
+bool nvmeProbe(PCI::Device& device)
+{
+    auto* registers = static_cast<volatile uint8_t*>(PCI::mapBar(device, 0));
+    if (!registers) return false;
+
+    auto* controller = static_cast<NvmeController*>(SlabAllocator::alloc(sizeof(NvmeController),
+                                                                         alignof(NvmeController)));
+    if (!controller) return false;
+
+    memset(controller, 0, sizeof(NvmeController));
+    controller->pci = &device;
+    controller->registers = registers;
+    PCI::setCommand(device, PCI::COMMAND_MEMORY | PCI::COMMAND_BUS_MASTER);
+
+    Block::Device& block = controller->block;
+    void* args[Nvme::MAX_QUEUES];
+    uint32_t cpuIds[Nvme::MAX_QUEUES];
+    IRQ::Vector vectors[Nvme::MAX_QUEUES];
+    IRQ::LineId lines[Nvme::MAX_QUEUES];
+    uint32_t wanted = 0, queueCount = 0, allocated = 0, depth = 0, vectorCount = 0, index = 0, length = 0;
+
+    if (!nvmeEnable(*controller) || !nvmeIdentifyNamespace(*controller)) goto fail;
+
+    wanted = SMP::getCpuCount();
+    if (wanted > Nvme::MAX_QUEUES) wanted = Nvme::MAX_QUEUES;
+    if (wanted > device.msix.tableSize && device.msix.tableSize) wanted = device.msix.tableSize;
+
+    queueCount = nvmeRequestQueues(*controller, wanted ? wanted : 1);
+    if (!queueCount) goto fail;
+
+    depth = (nvmeRead64(*controller, NVME_REG_CAP) & 0xFFFF) + 1;
+    if (depth > Nvme::QUEUE_DEPTH) depth = Nvme::QUEUE_DEPTH;
+
+    controller->queues = static_cast<NvmeQueue*>(SlabAllocator::alloc(sizeof(NvmeQueue) * queueCount,
+                                                                      alignof(NvmeQueue)));
+    if (!controller->queues) goto fail;
+
+    memset(controller->queues, 0, sizeof(NvmeQueue) * queueCount);
+    allocated = queueCount;
+
+    for (uint32_t i = 0, cpu = 0; i < queueCount; ++i)
+    {
+        if (!nvmeAllocQueue(*controller, controller->queues[i], static_cast<uint16_t>(i + 1),
+                            static_cast<uint16_t>(depth), true))
+            goto fail;
+
+        controller->queues[i].index = i;
+        args[i] = &controller->queues[i];
+
+        while (cpu + 1 < SMP::MAX_CPUS && !cpus[cpu].online) ++cpu;
+        cpuIds[i] = cpu++;
+    }
+
+    vectorCount = device.msix.offset
+                      ? PCI::allocateVectors(device, queueCount, nvmeInterrupt, args, vectors, lines, cpuIds)
+                      : 0;
+    if (vectorCount && !(PCI::read16(device, device.msix.offset + 2) & PCI::MSIX_ENABLE))
+    {
+        PCI::freeVectors(device, vectors, lines, vectorCount);
+        vectorCount = 0;
+    }
+    if (!vectorCount) Serial::printf("Nvme: No MSI-X vectors, completions are polled\n");
+    else if (vectorCount < queueCount) queueCount = vectorCount;
+
+    for (uint32_t i = 0; i < queueCount; ++i)
+        if (!nvmeCreateQueuePair(*controller, controller->queues[i], static_cast<uint16_t>(i), vectorCount != 0))
+        {
+            if (!i) goto fail;
+
+            queueCount = i;
+            break;
+        }
+
+    for (uint32_t i = vectorCount; i-- > queueCount;)
+    {
+        PCI::maskMSIX(device, i, true);
+        if (lines[i] != IRQ::INVALID_LINE) IRQ::unregisterLine(lines[i]);
+        else IRQ::free(vectors[i]);
+    }
+    if (vectorCount > queueCount) vectorCount = queueCount;
+    for (uint32_t i = allocated; i-- > queueCount;) nvmeReleaseQueue(controller->queues[i]);
+    allocated = queueCount;
+
+    for (uint32_t i = 0; i < vectorCount; ++i)
+        if (vectors[i].cpuId == cpuIds[i]) IRQ::setPinned(lines[i], true);
+
+    block.queueCount = queueCount;
+    block.queueDepth = depth - 1;
+    block.hybridPoll = true;
+    for (uint32_t cpu = 0; cpu < SMP::MAX_CPUS; ++cpu)
+    {
+        block.queueForCpu[cpu] = static_cast<uint16_t>(cpu % queueCount);
+        for (uint32_t i = 0; i < vectorCount; ++i)
+            if (vectors[i].cpuId == cpu) block.queueForCpu[cpu] = static_cast<uint16_t>(i);
+    }
+
+    index = nvmeControllerCount++;
+    for (const char* prefix = "nvme"; *prefix; ++prefix) block.name[length++] = *prefix;
+    if (index >= 10) block.name[length++] = static_cast<char>('0' + index / 10 % 10);
+    block.name[length++] = static_cast<char>('0' + index % 10);
+    block.name[length++] = 'n';
+    block.name[length] = '1';
+
+    block.driverData = controller;
+    block.ops = &nvmeOps;
+    device.driverData = controller;
+    if (Block::registerDevice(&block)) return true;
+
+    device.driverData = nullptr;
+    --nvmeControllerCount;
+
+fail:
+    Serial::printf("Nvme: Failed to probe %x:%x.%x\n", device.bus, device.device, device.function);
+    nvmeWrite32(*controller, NVME_REG_CC, nvmeRead32(*controller, NVME_REG_CC) & ~NVME_CC_ENABLE);
+    nvmeWaitReady(*controller, false);
+
+    PCI::freeVectors(device, vectors, lines, vectorCount);
+    for (uint32_t i = allocated; i-- > 0;) nvmeReleaseQueue(controller->queues[i]);
+    if (controller->queues) SlabAllocator::free(controller->queues);
+    nvmeReleaseQueue(controller->admin);
+    SlabAllocator::free(controller);
+
+    return false;
+}
+
+bool Nvme::init()
+{
+    PCI::Driver driver;
+    driver.name = "nvme";
+    driver.classCode = CLASS_STORAGE;
+    driver.subclass = SUBCLASS_NVM;
+    driver.progIf = PROG_IF_NVME;
+    driver.probe = nvmeProbe;
+
+    return PCI::registerDriver(driver);
+}
@@ -0,0 +1,595 @@
+#include <arch/x86_64/cpu.h>
+#include <drivers/pci.h>
+#include <drivers/serial.h>
+#include <memory/spinlock.h>
+#include <memory/vmm.h>
+
+struct EcamWindow
+{
+    volatile uint8_t* base;
+    uint16_t segment;
+    uint8_t startBus, endBus;
+};
+
+constexpr uint16_t LEGACY_CONFIG_ADDRESS = 0xCF8, LEGACY_CONFIG_DATA = 0xCFC;
+constexpr uint32_t MAX_CAPABILITY_WALK = 48, MSI_ADDRESS_BASE = 0xFEE00000, MSIX_ENTRY_MASKED = 1u << 0;
+constexpr PageFlags MMIO_FLAGS = PageFlags::RW | PageFlags::CACHE_DISABLE | PageFlags::WRITE_THROUGH |
+                                 PageFlags::NO_EXECUTE;
+
+EcamWindow ecamWindows[ACPI::MCFGInfo::MAX_SEGMENTS] = {};
+uint32_t ecamWindowCount = 0;
+
+PCI::Device pciDevices[PCI::MAX_DEVICES] = {};
+PCI::Driver pciDrivers[PCI::MAX_DRIVERS] = {};
+uint32_t pciDeviceCount = 0, pciDriverCount = 0;
+bool pciReady = false;
+Spinlock pciLock, legacyConfigLock;
+
+volatile uint8_t* ecamFunction(const uint16_t segment, const uint8_t bus, const uint8_t device, const uint8_t function)
+{
+    for (uint32_t i = 0; i < ecamWindowCount; ++i)
+    {
+        const EcamWindow& window = ecamWindows[i];
+        if (window.segment != segment || bus < window.startBus || bus > window.endBus) continue;
+
+        return window.base + (static_cast<uint64_t>(bus - window.startBus) << 20 | static_cast<uint64_t>(device) << 15 |
+                              static_cast<uint64_t>(function) << 12);
+    }
+
+    return nullptr;
+}
+
+uint32_t legacyAddress(const PCI::Device& device, const uint16_t offset)
+{
+    return 0x80000000u | static_cast<uint32_t>(device.bus) << 16 | static_cast<uint32_t>(device.device) << 11 |
+           static_cast<uint32_t>(device.function) << 8 | (offset & 0xFC);
+}
+
+uint32_t legacyRead32(const PCI::Device& device, const uint16_t offset)
+{
+    if (device.segment != 0 || offset >= 256) return 0xFFFFFFFF;
+    LockGuard guard(legacyConfigLock);
+
+    outl(LEGACY_CONFIG_ADDRESS, legacyAddress(device, offset));
+    return inl(LEGACY_CONFIG_DATA);
+}
+
+void legacyWrite(const PCI::Device& device, const uint16_t offset, const uint32_t value, const uint32_t width)
+{
+    if (device.segment != 0 || offset >= 256) return;
+    LockGuard guard(legacyConfigLock);
+
+    outl(LEGACY_CONFIG_ADDRESS, legacyAddress(device, offset));
+    if (width == 4)
+    {
+        outl(LEGACY_CONFIG_DATA, value);
+        return;
+    }
+
+    const uint32_t shift = (offset & 3) * 8, mask = (width == 1 ? 0xFFu : 0xFFFFu) << shift;
+    outl(LEGACY_CONFIG_DATA, (inl(LEGACY_CONFIG_DATA) & ~mask) | (value << shift & mask));
+}
+
+uint8_t PCI::read8(const Device& device, const uint16_t offset)
+{
+    if (device.config) return device.config[offset];
+    return static_cast<uint8_t>(legacyRead32(device, offset) >> (offset & 3) * 8);
+}
+
+uint16_t PCI::read16(const Device& device, const uint16_t offset)
+{
+    if (device.config) return *reinterpret_cast<volatile uint16_t*>(device.config + offset);
+    return static_cast<uint16_t>(legacyRead32(device, offset) >> (offset & 2) * 8);
+}
+
+uint32_t PCI::read32(const Device& device, const uint16_t offset)
+{
+    if (device.config) return *reinterpret_cast<volatile uint32_t*>(device.config + offset);
+    return legacyRead32(device, offset);
+}
+
+void PCI::write8(const Device& device, const uint16_t offset, const uint8_t value)
+{
+    if (device.config) device.config[offset] = value;
+    else legacyWrite(device, offset, value, 1);
+}
+
+void PCI::write16(const Device& device, const uint16_t offset, const uint16_t value)
+{
+    if (device.config) *reinterpret_cast<volatile uint16_t*>(device.config + offset) = value;
+    else legacyWrite(device, offset, value, 2);
+}
+
+void PCI::write32(const Device& device, const uint16_t offset, const uint32_t value)
+{
+    if (device.config) *reinterpret_cast<volatile uint32_t*>(device.config + offset) = value;
+    else legacyWrite(device, offset, value, 4);
+}
+
+uint8_t PCI::findCapability(const Device& device, const uint8_t id, const uint8_t after)
+{
+    if (!(read16(device, REG_STATUS) & STATUS_CAPABILITIES)) return 0;
+
+    uint8_t pointer = (after ? read8(device, after + 1) : read8(device, REG_CAPABILITIES)) & 0xFC;
+    for (uint32_t i = 0; pointer && i < MAX_CAPABILITY_WALK; ++i)
+    {
+        if (read8(device, pointer) == id) return pointer;
+        pointer = read8(device, pointer + 1) & 0xFC;
+    }
+
+    return 0;
+}
+
+void PCI::setCommand(const Device& device, const uint16_t set, const uint16_t clear)
+{
+    write16(device, REG_COMMAND, static_cast<uint16_t>((read16(device, REG_COMMAND) & ~clear) | set));
+}
+
+void sizeBars(PCI::Device& device)
+{
+    const uint8_t layout = device.headerType & 0x7F;
+    const uint32_t count = layout == 0 ? PCI::MAX_BARS : layout == 1 ? 2 : 0;
+    if (!count) return;
+
+    const uint16_t command = PCI::read16(device, PCI::REG_COMMAND);
+    PCI::write16(device, PCI::REG_COMMAND,
+                 static_cast<uint16_t>(command & ~(PCI::COMMAND_IO | PCI::COMMAND_MEMORY)));
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const auto offset = static_cast<uint16_t>(PCI::REG_BAR0 + i * 4);
+        const uint32_t original = PCI::read32(device, offset);
+
+        PCI::write32(device, offset, 0xFFFFFFFF);
+        const uint32_t mask = PCI::read32(device, offset);
+        PCI::write32(device, offset, original);
+        if (!mask) continue;
+
+        PCI::Bar& bar = device.bars[i];
+        if (original & 1)
+        {
+            bar.type = PCI::BarType::IO;
+            bar.address = original & ~3u;
+            bar.size = (~(mask & ~3u) + 1) & 0xFFFF;
+            continue;
+        }
+
+        bar.prefetchable = original & 8;
+        uint64_t address = original & ~0xFu, sizeMask = mask & ~0xFu;
+
+        if (((original >> 1) & 3) == 2 && i + 1 < count)
+        {
+            const auto highOffset = static_cast<uint16_t>(offset + 4);
+            const uint32_t originalHigh = PCI::read32(device, highOffset);
+
+            PCI::write32(device, highOffset, 0xFFFFFFFF);
+            const uint32_t maskHigh = PCI::read32(device, highOffset);
+            PCI::write32(device, highOffset, originalHigh);
+
+            bar.type = PCI::BarType::MEMORY64;
+            address |= static_cast<uint64_t>(originalHigh) << 32;
+            sizeMask |= static_cast<uint64_t>(maskHigh) << 32;
+            ++i;
+        }
+        else
+        {
+            bar.type = PCI::BarType::MEMORY32;
+            sizeMask |= 0xFFFFFFFF00000000ULL;
+        }
+
+        bar.address = address;
+        bar.size = ~sizeMask + 1;
+    }
+
+    PCI::write16(device, PCI::REG_COMMAND, command);
+}
+
+void parseCapabilities(PCI::Device& device)
+{
+    device.pcieOffset = PCI::findCapability(device, PCI::CAP_PCIE);
+
+    if (const uint8_t offset = PCI::findCapability(device, PCI::CAP_MSI))
+    {
+        const uint16_t control = PCI::read16(device, offset + 2);
+        device.msi = {offset, static_cast<uint8_t>(1u << ((control >> 1) & 7)), (control & (1u << 7)) != 0,
+                      (control & (1u << 8)) != 0};
+    }
+
+    if (const uint8_t offset = PCI::findCapability(device, PCI::CAP_MSIX))
+    {
+        const uint16_t control = PCI::read16(device, offset + 2);
+        const uint32_t table = PCI::read32(device, offset + 4), pba = PCI::read32(device, offset + 8);
+
+        device.msix = {offset, static_cast<uint8_t>(table & 7), static_cast<uint8_t>(pba & 7),
+                       static_cast<uint16_t>((control & 0x7FF) + 1), table & ~7u, pba & ~7u};
+    }
+}
+
+bool addFunction(const uint16_t segment, const uint8_t bus, const uint8_t device, const uint8_t function,
+                 bool& multifunction)
+{
+    PCI::Device probe = {};
+    probe.segment = segment;
+    probe.bus = bus;
+    probe.device = device;
+    probe.function = function;
+    probe.config = ecamFunction(segment, bus, device, function);
+
+    const uint32_t id = PCI::read32(probe, PCI::REG_VENDOR);
+    if ((id & 0xFFFF) == 0xFFFF || (id & 0xFFFF) == 0) return false;
+
+    probe.vendorId = static_cast<uint16_t>(id);
+    probe.deviceId = static_cast<uint16_t>(id >> 16);
+
+    const uint32_t classInfo = PCI::read32(probe, PCI::REG_REVISION);
+    probe.revision = static_cast<uint8_t>(classInfo);
+    probe.progIf = static_cast<uint8_t>(classInfo >> 8);
+    probe.subclass = static_cast<uint8_t>(classInfo >> 16);
+    probe.classCode = static_cast<uint8_t>(classInfo >> 24);
+    probe.headerType = PCI::read8(probe, PCI::REG_HEADER_TYPE);
+    multifunction = probe.headerType & 0x80;
+
+    const uint16_t interrupt = PCI::read16(probe, PCI::REG_INTERRUPT_LINE);
+    probe.interruptLine = static_cast<uint8_t>(interrupt);
+    probe.interruptPin = static_cast<uint8_t>(interrupt >> 8);
+
+    if (pciDeviceCount >= PCI::MAX_DEVICES)
+    {
+        Serial::printf("PCI: Device table full, ignoring %x:%x.%x\n", bus, device, function);
+        return true;
+    }
+
+    sizeBars(probe);
+    parseCapabilities(probe);
+    pciDevices[pciDeviceCount++] = probe;
+
+    return true;
+}
+
+void scanBus(const uint16_t segment, const uint8_t bus)
+{
+    for (uint8_t device = 0; device < 32; ++device)
+    {
+        bool multifunction = false;
+        if (!addFunction(segment, bus, device, 0, multifunction) || !multifunction) continue;
+
+        for (uint8_t function = 1; function < 8; ++function) addFunction(segment, bus, device, function, multifunction);
+    }
+}
+
+bool driverMatches(const PCI::Driver& driver, const PCI::Device& device)
+{
+    return (driver.vendorId == PCI::ANY_ID || driver.vendorId == device.vendorId) &&
+           (driver.deviceId == PCI::ANY_ID || driver.deviceId == device.deviceId) &&
+           (driver.classCode == PCI::ANY_CLASS || driver.classCode == device.classCode) &&
+           (driver.subclass == PCI::ANY_CLASS || driver.subclass == device.subclass) &&
+           (driver.progIf == PCI::ANY_CLASS || driver.progIf == device.progIf);
+}
+
+void bindDriver(const PCI::Driver& driver)
+{
+    for (uint32_t i = 0; i < pciDeviceCount; ++i)
+    {
+        PCI::Device& device = pciDevices[i];
+        if (!driverMatches(driver, device)) continue;
+
+        const PCI::Driver* expected = nullptr;
+        if (!__atomic_compare_exchange_n(&device.driver, &expected, &driver, false, __ATOMIC_ACQ_REL,
+                                         __ATOMIC_RELAXED))
+            continue;
+
+        if (driver.probe(device))
+        {
+            Serial::printf("PCI: %s bound to %x:%x.%x\n", driver.name, device.bus, device.device, device.function);
+            continue;
+        }
+
+        __atomic_store_n(&device.driver, nullptr, __ATOMIC_RELEASE);
+    }
+}
+
+bool PCI::init(const ACPI::MCFGInfo& mcfg)
+{
+    for (uint32_t i = 0; i < mcfg.count; ++i)
+    {
+        const ACPI::MCFGSegment& segment = mcfg.segments[i];
+        const uint64_t size = static_cast<uint64_t>(segment.endBus - segment.startBus + 1) << 20,
+                       physical = segment.base + (static_cast<uint64_t>(segment.startBus) << 20);
+
+        void* window = VMM::reserve(size, VMM::RegionType::MMIO, MMIO_FLAGS, FrameAllocator::MEDIUM_SIZE);
+        if (!window || !VMM::map(window, physical, size, VMM::RegionType::MMIO, MMIO_FLAGS))
+        {
+            Serial::printf("PCI: Failed to map ECAM for segment %u at %lx\n", segment.segment, physical);
+            if (window) VMM::unmap(window);
+
+            continue;
+        }
+
+        ecamWindows[ecamWindowCount++] = {static_cast<volatile uint8_t*>(window), segment.segment, segment.startBus,
+                                          segment.endBus};
+    }
+
+    if (!ecamWindowCount)
+    {
+        Serial::printf("PCI: No ECAM windows, falling back to port I/O configuration access\n");
+        for (uint32_t bus = 0; bus < 256; ++bus) scanBus(0, static_cast<uint8_t>(bus));
+    }
+    else
+        for (uint32_t i = 0; i < ecamWindowCount; ++i)
+            for (uint32_t bus = ecamWindows[i].startBus; bus <= ecamWindows[i].endBus; ++bus)
+                scanBus(ecamWindows[i].segment, static_cast<uint8_t>(bus));
+
+    uint32_t driverCount;
+    {
+        LockGuard guard(pciLock);
+        pciReady = true;
+        driverCount = pciDriverCount;
+    }
+
+    for (uint32_t i = 0; i < driverCount; ++i) bindDriver(pciDrivers[i]);
+    return pciDeviceCount > 0;
+}
+
+bool PCI::registerDriver(const Driver& driver)
+{
+    if (!driver.name || !driver.probe) return false;
+
+    Driver* slot;
+    {
+        LockGuard guard(pciLock);
+        if (pciDriverCount >= MAX_DRIVERS)
+        {
+            Serial::printf("PCI: Driver table full, cannot register %s\n", driver.name);
+            return false;
+        }
+
+        slot = &pciDrivers[pciDriverCount++];
+        *slot = driver;
+        if (!pciReady) return true;
+    }
+
+    bindDriver(*slot);
+    return true;
+}
+
+uint32_t PCI::getDeviceCount() { return pciDeviceCount; }
+
+PCI::Device* PCI::getDevice(const uint32_t index) { return index < pciDeviceCount ? &pciDevices[index] : nullptr; }
+
+PCI::Device* PCI::findDevice(const uint16_t vendorId, const uint16_t deviceId)
+{
+    for (uint32_t i = 0; i < pciDeviceCount; ++i)
+        if (pciDevices[i].vendorId == vendorId && pciDevices[i].deviceId == deviceId) return &pciDevices[i];
+
+    return nullptr;
+}
+
+void* PCI::mapBar(Device& device, const uint32_t index)
+{
+    if (index >= MAX_BARS) return nullptr;
+
+    Bar& bar = device.bars[index];
+    if (bar.type != BarType::MEMORY32 && bar.type != BarType::MEMORY64) return nullptr;
+    if (!bar.size || !bar.address) return nullptr;
+
+    LockGuard guard(pciLock);
+    if (bar.mapped) return bar.mapped;
+
+    const uint64_t offset = bar.address & (FrameAllocator::SMALL_SIZE - 1),
+                   size = Alignment::alignUp(bar.size + offset, FrameAllocator::SMALL_SIZE);
+
+    void* window = VMM::reserve(size, VMM::RegionType::MMIO, MMIO_FLAGS);
+    if (!window || !VMM::map(window, bar.address - offset, size, VMM::RegionType::MMIO, MMIO_FLAGS))
+    {
+        Serial::printf("PCI: Failed to map BAR%u of %x:%x.%x\n", index, device.bus, device.device, device.function);
+        if (window) VMM::unmap(window);
+
+        return nullptr;
+    }
+
+    bar.mapped = static_cast<uint8_t*>(window) + offset;
+    return bar.mapped;
+}
+
+bool msiMessage(const IRQ::Vector& vector, uint32_t& address, uint32_t& data)
+{
+    if (vector.cpuId >= SMP::MAX_CPUS || !vector.vector) return false;
+
+    const uint32_t lapicId = cpus[vector.cpuId].lapicId;
+    if (lapicId > 0xFF)
+    {
+        Serial::printf("PCI: LAPIC ID %u of CPU %u is not reachable by MSI\n", lapicId, vector.cpuId);
+        return false;
+    }
+
+    address = MSI_ADDRESS_BASE | lapicId << 12;
+    data = vector.vector;
+
+    return true;
+}
+
+bool PCI::enableMSI(Device& device, const IRQ::Vector& vector)
+{
+    const uint8_t offset = device.msi.offset;
+    uint32_t address, data;
+    if (!offset || !msiMessage(vector, address, data)) return false;
+
+    const uint16_t control = read16(device, offset + 2);
+    write16(device, offset + 2, static_cast<uint16_t>(control & ~(MSI_ENABLE | 0x70)));
+
+    write32(device, offset + 4, address);
+    if (device.msi.is64Bit)
+    {
+        write32(device, offset + 8, 0);
+        write16(device, offset + 12, static_cast<uint16_t>(data));
+    }
+    else write16(device, offset + 8, static_cast<uint16_t>(data));
+
+    setCommand(device, COMMAND_INTX_DISABLE);
+    write16(device, offset + 2, static_cast<uint16_t>((control & ~0x70) | MSI_ENABLE));
+
+    return true;
+}
+
+bool PCI::enableMSIX(Device& device, const IRQ::Vector* vectors, const uint32_t count)
+{
+    const uint8_t offset = device.msix.offset;
+    if (!offset || !vectors || count == 0 || count > device.msix.tableSize) return false;
+
+    if (!device.msixTable)
+    {
+        auto* bar = static_cast<uint8_t*>(mapBar(device, device.msix.tableBar));
+        if (!bar) return false;
+
+        device.msixTable = reinterpret_cast<volatile uint32_t*>(bar + device.msix.tableOffset);
+    }
+
+    const uint16_t control = read16(device, offset + 2);
+    write16(device, offset + 2, static_cast<uint16_t>(control | MSIX_ENABLE | MSIX_FUNCTION_MASK));
+
+    for (uint32_t i = 0; i < device.msix.tableSize; ++i)
+    {
+        volatile uint32_t* entry = device.msixTable + i * 4;
+        uint32_t address, data;
+
+        if (i >= count || !msiMessage(vectors[i], address, data))
+        {
+            entry[3] = entry[3] | MSIX_ENTRY_MASKED;
+            continue;
+        }
+
+        entry[0] = address;
+        entry[1] = 0;
+        entry[2] = data;
+        entry[3] = entry[3] & ~MSIX_ENTRY_MASKED;
+    }
+
+    setCommand(device, COMMAND_INTX_DISABLE);
+    write16(device, offset + 2, static_cast<uint16_t>((control | MSIX_ENABLE) & ~MSIX_FUNCTION_MASK));
+
+    return true;
+}
+
+void PCI::maskMSIX(Device& device, const uint32_t entry, const bool masked)
+{
+    if (!device.msixTable || entry >= device.msix.tableSize) return;
+
+    volatile uint32_t* control = device.msixTable + entry * 4 + 3;
+    *control = masked ? *control | MSIX_ENTRY_MASKED : *control & ~MSIX_ENTRY_MASKED;
+}
+
+void PCI::disableMSI(Device& device)
+{
+    if (device.msix.offset)
+        write16(device, device.msix.offset + 2,
+                static_cast<uint16_t>(read16(device, device.msix.offset + 2) & ~MSIX_ENABLE));
+    if (device.msi.offset)
+        write16(device, device.msi.offset + 2,
+                static_cast<uint16_t>(read16(device, device.msi.offset + 2) & ~MSI_ENABLE));
+
+    setCommand(device, 0, COMMAND_INTX_DISABLE);
+}
+
+bool retargetVector(void* owner, const uint32_t index, const IRQ::Vector& vector)
+{
+    auto* device = static_cast<PCI::Device*>(owner);
+    if (!device->msixTable || !(PCI::read16(*device, device->msix.offset + 2) & PCI::MSIX_ENABLE))
+        return index == 0 && PCI::enableMSI(*device, vector);
+
+    uint32_t address, data;
+    if (index >= device->msix.tableSize || !msiMessage(vector, address, data)) return false;
+
+    volatile uint32_t* entry = device->msixTable + index * 4;
+    const uint32_t control = entry[3];
+
+    entry[3] = control | MSIX_ENTRY_MASKED;
+    entry[0] = address;
+    entry[1] = 0;
+    entry[2] = data;
+    entry[3] = control;
+    static_cast<void>(entry[3]);
+
+    return true;
+}
+
+void registerLines(PCI::Device& device, const IRQ::Vector* vectors, const uint32_t count, IRQ::LineId* lines)
+{
+    const char* name = device.driver ? device.driver->name : "pci";
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const IRQ::LineId line = IRQ::registerMsiLine(name, vectors[i], retargetVector, &device, i);
+        if (lines) lines[i] = line;
+    }
+}
+
+uint32_t PCI::allocateVectors(Device& device, uint32_t count, const IRQ::Handler handler, void* const* args,
+                              IRQ::Vector* out, IRQ::LineId* lines, const uint32_t* cpuIds)
+{
+    if (!count || !handler || !out) return 0;
+
+    if (device.msix.offset)
+    {
+        if (count > device.msix.tableSize) count = device.msix.tableSize;
+
+        uint32_t allocated = 0;
+        if (!cpuIds) allocated = IRQ::allocateSpread(count, handler, args, out);
+        else
+            for (; allocated < count; ++allocated)
+                if (!IRQ::allocate(cpuIds[allocated], handler, args ? args[allocated] : nullptr, out[allocated]) &&
+                    !IRQ::allocate(IRQ::ANY_CPU, handler, args ? args[allocated] : nullptr, out[allocated]))
+                    break;
+        if (allocated && enableMSIX(device, out, allocated))
+        {
+            registerLines(device, out, allocated, lines);
+            return allocated;
+        }
+
+        for (uint32_t i = 0; i < allocated; ++i) IRQ::free(out[i]);
+    }
+
+    if (device.msi.offset && IRQ::allocate(IRQ::ANY_CPU, handler, args ? args[0] : nullptr, out[0]))
+    {
+        if (enableMSI(device, out[0]))
+        {
+            registerLines(device, out, 1, lines);
+            return 1;
+        }
+        IRQ::free(out[0]);
+    }
+
+    Serial::printf("PCI: No MSI/MSI-X vectors for %x:%x.%x\n", device.bus, device.device, device.function);
+    return 0;
+}
+
+void PCI::freeVectors(Device& device, const IRQ::Vector* vectors, const IRQ::LineId* lines, const uint32_t count)
+{
+    disableMSI(device);
+
+    for (uint32_t i = count; i-- > 0;)
+    {
+        if (lines && lines[i] != IRQ::INVALID_LINE) IRQ::unregisterLine(lines[i]);
+        else IRQ::free(vectors[i]);
+    }
+}
+
+void PCI::dump()
+{
+    for (uint32_t i = 0; i < pciDeviceCount; ++i)
+    {
+        const Device& device = pciDevices[i];
+        Serial::printf("PCI: %x:%x:%x.%x %x:%x class %x.%x.%x", device.segment, device.bus, device.device,
+                       device.function, device.vendorId, device.deviceId, device.classCode, device.subclass,
+                       device.progIf);
+
+        if (device.msi.offset) Serial::printf(" msi=%u", device.msi.maxVectors);
+        if (device.msix.offset) Serial::printf(" msix=%u", device.msix.tableSize);
+        if (device.pcieOffset) Serial::printf(" pcie");
+        Serial::printf("\n");
+
+        for (uint32_t bar = 0; bar < MAX_BARS; ++bar)
+            if (device.bars[bar].type != BarType::NONE)
+                Serial::printf("PCI:   BAR%u %s %lx size %lx%s\n", bar,
+                               device.bars[bar].type == BarType::IO ? "io" : "mem", device.bars[bar].address,
+                               device.bars[bar].size, device.bars[bar].prefetchable ? " prefetchable" : "");
+    }
+}
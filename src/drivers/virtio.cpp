@@ -0,0 +1,285 @@
+#include <core/limine.h>
+#include <drivers/serial.h>
+#include <drivers/virtio.h>
+#include <memory/buddy.h>
+
+extern limine_hhdm_request hhdm_request;
+
+constexpr uint8_t CAP_VENDOR = 0x09;
+constexpr uint8_t CFG_COMMON = 1, CFG_NOTIFY = 2, CFG_ISR = 3, CFG_DEVICE = 4;
+constexpr uint8_t STATUS_ACKNOWLEDGE = 1, STATUS_DRIVER = 2, STATUS_DRIVER_OK = 4, STATUS_FEATURES_OK = 8,
+                  STATUS_FAILED = 128;
+
+constexpr uint16_t COMMON_DEVICE_FEATURE_SELECT = 0x00, COMMON_DEVICE_FEATURE = 0x04,
+                   COMMON_DRIVER_FEATURE_SELECT = 0x08, COMMON_DRIVER_FEATURE = 0x0C, COMMON_MSIX_CONFIG = 0x10,
+                   COMMON_NUM_QUEUES = 0x12, COMMON_STATUS = 0x14, COMMON_QUEUE_SELECT = 0x16,
+                   COMMON_QUEUE_SIZE = 0x18, COMMON_QUEUE_MSIX_VECTOR = 0x1A, COMMON_QUEUE_ENABLE = 0x1C,
+                   COMMON_QUEUE_NOTIFY_OFF = 0x1E, COMMON_QUEUE_DESC = 0x20, COMMON_QUEUE_DRIVER = 0x28,
+                   COMMON_QUEUE_DEVICE = 0x30;
+
+constexpr uint64_t RING_ORDER = 1, AVAIL_OFFSET = 4096, USED_OFFSET = 5120;
+
+template <typename T>
+T commonRead(const Virtio::Transport& transport, const uint16_t offset)
+{
+    return *reinterpret_cast<volatile T*>(transport.common + offset);
+}
+
+template <typename T>
+void commonWrite(const Virtio::Transport& transport, const uint16_t offset, const T value)
+{
+    *reinterpret_cast<volatile T*>(transport.common + offset) = value;
+}
+
+void commonWrite64(const Virtio::Transport& transport, const uint16_t offset, const uint64_t value)
+{
+    commonWrite<uint32_t>(transport, offset, static_cast<uint32_t>(value));
+    commonWrite<uint32_t>(transport, offset + 4, static_cast<uint32_t>(value >> 32));
+}
+
+volatile uint8_t* capabilityWindow(PCI::Device& device, const uint8_t capability, uint32_t& length)
+{
+    const uint8_t bar = PCI::read8(device, capability + 4);
+    if (bar >= PCI::MAX_BARS) return nullptr;
+
+    auto* base = static_cast<volatile uint8_t*>(PCI::mapBar(device, bar));
+    if (!base) return nullptr;
+
+    const uint32_t offset = PCI::read32(device, capability + 8);
+    length = PCI::read32(device, capability + 12);
+    if (static_cast<uint64_t>(offset) + length > device.bars[bar].size) return nullptr;
+
+    return base + offset;
+}
+
+bool Virtio::initTransport(PCI::Device& device, Transport& transport)
+{
+    transport = {};
+    transport.pci = &device;
+
+    for (uint8_t capability = PCI::findCapability(device, CAP_VENDOR); capability;
+         capability = PCI::findCapability(device, CAP_VENDOR, capability))
+    {
+        uint32_t length = 0;
+        const uint8_t type = PCI::read8(device, capability + 3);
+        if (type < CFG_COMMON || type > CFG_DEVICE) continue;
+
+        volatile uint8_t* window = capabilityWindow(device, capability, length);
+        if (!window) continue;
+
+        if (type == CFG_COMMON && !transport.common) transport.common = window;
+        else if (type == CFG_NOTIFY && !transport.notifyBase)
+        {
+            transport.notifyBase = window;
+            transport.notifyMultiplier = PCI::read32(device, capability + 16);
+        }
+        else if (type == CFG_ISR && !transport.isr) transport.isr = window;
+        else if (type == CFG_DEVICE && !transport.deviceConfig) transport.deviceConfig = window;
+    }
+
+    if (!transport.common || !transport.notifyBase || !transport.isr)
+    {
+        Serial::printf("Virtio: %x:%x.%x has no modern PCI capabilities\n", device.bus, device.device,
+                       device.function);
+        return false;
+    }
+
+    PCI::setCommand(device, PCI::COMMAND_MEMORY | PCI::COMMAND_BUS_MASTER);
+
+    reset(transport);
+
+    commonWrite<uint8_t>(transport, COMMON_STATUS, STATUS_ACKNOWLEDGE);
+    commonWrite<uint8_t>(transport, COMMON_STATUS, STATUS_ACKNOWLEDGE | STATUS_DRIVER);
+    return true;
+}
+
+bool Virtio::negotiate(Transport& transport, const uint64_t required, const uint64_t optional)
+{
+    commonWrite<uint32_t>(transport, COMMON_DEVICE_FEATURE_SELECT, 0);
+    uint64_t offered = commonRead<uint32_t>(transport, COMMON_DEVICE_FEATURE);
+    commonWrite<uint32_t>(transport, COMMON_DEVICE_FEATURE_SELECT, 1);
+    offered |= static_cast<uint64_t>(commonRead<uint32_t>(transport, COMMON_DEVICE_FEATURE)) << 32;
+
+    if ((offered & required) != required)
+    {
+        Serial::printf("Virtio: Device lacks required features %lx (offers %lx)\n", required, offered);
+        fail(transport);
+
+        return false;
+    }
+
+    transport.features = offered & (required | optional);
+    commonWrite<uint32_t>(transport, COMMON_DRIVER_FEATURE_SELECT, 0);
+    commonWrite<uint32_t>(transport, COMMON_DRIVER_FEATURE, static_cast<uint32_t>(transport.features));
+    commonWrite<uint32_t>(transport, COMMON_DRIVER_FEATURE_SELECT, 1);
+    commonWrite<uint32_t>(transport, COMMON_DRIVER_FEATURE, static_cast<uint32_t>(transport.features >> 32));
+
+    const uint8_t status = commonRead<uint8_t>(transport, COMMON_STATUS);
+    commonWrite<uint8_t>(transport, COMMON_STATUS, status | STATUS_FEATURES_OK);
+    if (!(commonRead<uint8_t>(transport, COMMON_STATUS) & STATUS_FEATURES_OK))
+    {
+        Serial::printf("Virtio: Device rejected features %lx\n", transport.features);
+        fail(transport);
+
+        return false;
+    }
+
+    commonWrite<uint16_t>(transport, COMMON_MSIX_CONFIG, NO_VECTOR);
+    return true;
+}
+
+uint16_t Virtio::getQueueCount(const Transport& transport)
+{
+    return commonRead<uint16_t>(transport, COMMON_NUM_QUEUES);
+}
+
+bool Virtio::setupQueue(Transport& transport, Queue& queue, const uint16_t index, const uint16_t msixEntry)
+{
+    commonWrite<uint16_t>(transport, COMMON_QUEUE_SELECT, index);
+
+    uint16_t size = commonRead<uint16_t>(transport, COMMON_QUEUE_SIZE);
+    if (!size || (size & (size - 1))) return false;
+    if (size > MAX_QUEUE_SIZE) size = MAX_QUEUE_SIZE;
+
+    const uint64_t physical = BuddyAllocator::alloc(RING_ORDER, AllocFlags::ZEROED);
+    if (!physical) return false;
+
+    auto* base = reinterpret_cast<uint8_t*>(physical + hhdm_request.response->offset);
+    memset(&queue, 0, sizeof(Queue));
+    queue.index = index;
+    queue.size = size;
+    queue.freeCount = size;
+    queue.eventIdx = transport.features & F_RING_EVENT_IDX;
+    queue.physical = physical;
+    queue.descriptors = reinterpret_cast<Descriptor*>(base);
+    queue.avail = reinterpret_cast<volatile uint16_t*>(base + AVAIL_OFFSET);
+    queue.used = reinterpret_cast<volatile uint16_t*>(base + USED_OFFSET);
+    for (uint16_t i = 0; i < size; ++i) queue.descriptors[i].next = static_cast<uint16_t>(i + 1);
+
+    commonWrite<uint16_t>(transport, COMMON_QUEUE_SIZE, size);
+    commonWrite<uint16_t>(transport, COMMON_QUEUE_MSIX_VECTOR, msixEntry);
+    if (commonRead<uint16_t>(transport, COMMON_QUEUE_MSIX_VECTOR) != msixEntry)
+    {
+        Serial::printf("Virtio: Queue %u rejected MSI-X entry %u\n", index, msixEntry);
+        BuddyAllocator::free(physical, RING_ORDER);
+
+        return false;
+    }
+
+    commonWrite64(transport, COMMON_QUEUE_DESC, physical);
+    commonWrite64(transport, COMMON_QUEUE_DRIVER, physical + AVAIL_OFFSET);
+    commonWrite64(transport, COMMON_QUEUE_DEVICE, physical + USED_OFFSET);
+
+    const uint16_t notifyOffset = commonRead<uint16_t>(transport, COMMON_QUEUE_NOTIFY_OFF);
+    queue.notify = reinterpret_cast<volatile uint16_t*>(transport.notifyBase +
+                                                        static_cast<uint64_t>(notifyOffset) *
+                                                        transport.notifyMultiplier);
+
+    commonWrite<uint16_t>(transport, COMMON_QUEUE_ENABLE, 1);
+    return true;
+}
+
+void Virtio::setDriverOk(Transport& transport)
+{
+    const uint8_t status = commonRead<uint8_t>(transport, COMMON_STATUS);
+    commonWrite<uint8_t>(transport, COMMON_STATUS, status | STATUS_DRIVER_OK);
+}
+
+void Virtio::fail(Transport& transport)
+{
+    const uint8_t status = commonRead<uint8_t>(transport, COMMON_STATUS);
+    commonWrite<uint8_t>(transport, COMMON_STATUS, status | STATUS_FAILED);
+}
+
+void Virtio::reset(Transport& transport)
+{
+    commonWrite<uint8_t>(transport, COMMON_STATUS, 0);
+    while (commonRead<uint8_t>(transport, COMMON_STATUS)) asm volatile ("pause");
+}
+
+void Virtio::releaseQueue(Queue& queue)
+{
+    if (queue.physical) BuddyAllocator::free(queue.physical, RING_ORDER);
+    memset(&queue, 0, sizeof(Queue));
+}
+
+int32_t Virtio::allocChain(Queue& queue, const uint16_t count)
+{
+    if (!count || queue.freeCount < count) return -1;
+
+    const uint16_t head = queue.freeHead;
+    uint16_t current = head;
+    for (uint16_t i = 1; i < count; ++i)
+    {
+        queue.descriptors[current].flags = DESC_F_NEXT;
+        current = queue.descriptors[current].next;
+    }
+
+    queue.descriptors[current].flags = 0;
+    queue.freeHead = queue.descriptors[current].next;
+    queue.freeCount -= count;
+
+    return head;
+}
+
+void Virtio::freeChain(Queue& queue, const uint16_t head)
+{
+    uint16_t current = head, count = 1;
+    while (queue.descriptors[current].flags & DESC_F_NEXT)
+    {
+        current = queue.descriptors[current].next;
+        ++count;
+    }
+
+    queue.descriptors[current].next = queue.freeHead;
+    queue.freeHead = head;
+    queue.freeCount += count;
+}
+
+void Virtio::publish(Queue& queue, const uint16_t head)
+{
+    queue.avail[2 + (queue.availShadow & (queue.size - 1))] = head;
+    ++queue.availShadow;
+}
+
+void Virtio::kick(Queue& queue)
+{
+    const uint16_t current = queue.availShadow, previous = queue.notified;
+    if (current == previous) return;
+
+    __atomic_store_n(&queue.avail[1], current, __ATOMIC_RELEASE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    queue.notified = current;
+
+    bool notify;
+    if (queue.eventIdx)
+    {
+        const uint16_t event = queue.used[2 + 4 * queue.size];
+        notify = static_cast<uint16_t>(current - event - 1) < static_cast<uint16_t>(current - previous);
+    }
+    else notify = !(queue.used[0] & USED_F_NO_NOTIFY);
+
+    if (notify) *queue.notify = queue.index;
+}
+
+bool Virtio::popUsed(Queue& queue, uint16_t& head, uint32_t& length)
+{
+    if (queue.lastUsed == __atomic_load_n(&queue.used[1], __ATOMIC_ACQUIRE)) return false;
+
+    const auto* element = reinterpret_cast<const volatile UsedElement*>(
+        reinterpret_cast<const volatile uint8_t*>(queue.used) + 4 +
+        sizeof(UsedElement) * (queue.lastUsed & (queue.size - 1)));
+    head = static_cast<uint16_t>(element->id);
+    length = element->length;
+    ++queue.lastUsed;
+
+    return true;
+}
+
+bool Virtio::armInterrupt(Queue& queue)
+{
+    if (queue.eventIdx) __atomic_store_n(&queue.avail[2 + queue.size], queue.lastUsed, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    return queue.lastUsed == __atomic_load_n(&queue.used[1], __ATOMIC_ACQUIRE);
+}
@@ -0,0 +1,356 @@
+#include <arch/x86_64/cpu.h>
+#include <core/limine.h>
+#include <drivers/block.h>
+#include <drivers/serial.h>
+#include <drivers/virtio.h>
+#include <drivers/virtioblk.h>
+#include <memory/buddy.h>
+#include <memory/paging.h>
+#include <memory/slab.h>
+
+extern limine_hhdm_request hhdm_request;
+
+constexpr uint64_t BLK_F_SEG_MAX = 1ULL << 2, BLK_F_RO = 1ULL << 5, BLK_F_BLK_SIZE = 1ULL << 6,
+                   BLK_F_FLUSH = 1ULL << 9, BLK_F_MQ = 1ULL << 12;
+constexpr uint32_t BLK_TYPE_IN = 0, BLK_TYPE_OUT = 1, BLK_TYPE_FLUSH = 4;
+constexpr uint8_t BLK_STATUS_OK = 0, BLK_STATUS_UNSUPPORTED = 2;
+constexpr uint16_t BLK_CONFIG_CAPACITY = 0, BLK_CONFIG_SEG_MAX = 12, BLK_CONFIG_BLK_SIZE = 20,
+                   BLK_CONFIG_NUM_QUEUES = 34;
+constexpr uint64_t BLK_HEADER_ORDER = 1, BLK_STATUS_OFFSET = 4096;
+
+struct __attribute__ ((packed)) VirtioBlkHeader
+{
+    uint32_t type, reserved;
+    uint64_t sector;
+};
+
+struct VirtioBlkDisk;
+
+struct VirtioBlkQueue
+{
+    Virtio::Queue ring;
+    VirtioBlkDisk* disk;
+    uint32_t index;
+    VirtioBlkHeader* headers;
+    volatile uint8_t* statuses;
+    uint64_t headerPhysical;
+    Block::Request** inflight;
+};
+
+struct VirtioBlkDisk
+{
+    Block::Device block;
+    Virtio::Transport transport;
+    VirtioBlkQueue* queues;
+    bool canFlush;
+};
+
+uint32_t virtioBlkDiskCount = 0;
+
+void virtioBlkDefer(Block::Request*& list, Block::Request* request, const Block::Status status)
+{
+    request->status = status;
+    request->next = list;
+    list = request;
+}
+
+uint32_t virtioBlkType(const Block::Op op)
+{
+    if (op == Block::Op::READ) return BLK_TYPE_IN;
+    return op == Block::Op::WRITE ? BLK_TYPE_OUT : BLK_TYPE_FLUSH;
+}
+
+uint32_t virtioBlkSubmit(Block::Device* device, const uint32_t queueIndex, Block::Request** requests,
+                         const uint32_t count)
+{
+    auto* disk = static_cast<VirtioBlkDisk*>(device->driverData);
+    VirtioBlkQueue& queue = disk->queues[queueIndex];
+    Block::Request* rejected = nullptr;
+    uint32_t accepted = 0;
+
+    {
+        LockGuard guard(queue.ring.lock);
+        while (accepted < count)
+        {
+            Block::Request* first = requests[accepted];
+            Block::Segment segments[VirtioBlk::MAX_SEGMENTS];
+            uint32_t segmentCount = 0;
+
+            if (first->op == Block::Op::FLUSH)
+            {
+                if (!disk->canFlush)
+                {
+                    virtioBlkDefer(rejected, first, Block::Status::OK);
+                    ++accepted;
+                    continue;
+                }
+            }
+            else if (!(segmentCount = Block::buildSegments(first->buffer,
+                                                           static_cast<uint64_t>(first->sectors) * Block::SECTOR_SIZE,
+                                                           segments, device->maxSegments)))
+            {
+                virtioBlkDefer(rejected, first, Block::Status::INVALID);
+                ++accepted;
+                continue;
+            }
+
+            const int32_t head = Virtio::allocChain(queue.ring, static_cast<uint16_t>(segmentCount + 2));
+            if (head < 0) break;
+
+            VirtioBlkHeader& header = queue.headers[head];
+            header.type = virtioBlkType(first->op);
+            header.reserved = 0;
+            header.sector = first->sector;
+            queue.statuses[head] = 0xFF;
+
+            Virtio::Descriptor* descriptors = queue.ring.descriptors;
+            uint16_t current = static_cast<uint16_t>(head);
+            descriptors[current].address = queue.headerPhysical + head * sizeof(VirtioBlkHeader);
+            descriptors[current].length = sizeof(VirtioBlkHeader);
+
+            for (uint32_t i = 0; i < segmentCount; ++i)
+            {
+                current = descriptors[current].next;
+                descriptors[current].address = segments[i].physical;
+                descriptors[current].length = segments[i].length;
+                if (first->op == Block::Op::READ) descriptors[current].flags |= Virtio::DESC_F_WRITE;
+            }
+
+            current = descriptors[current].next;
+            descriptors[current].address = queue.headerPhysical + BLK_STATUS_OFFSET + head;
+            descriptors[current].length = 1;
+            descriptors[current].flags |= Virtio::DESC_F_WRITE;
+
+            queue.inflight[head] = first;
+            Virtio::publish(queue.ring, static_cast<uint16_t>(head));
+            ++accepted;
+        }
+
+        Virtio::kick(queue.ring);
+    }
+
+    Block::completeList(rejected);
+    return accepted;
+}
+
+uint32_t virtioBlkReap(VirtioBlkQueue& queue)
+{
+    Block::Request* done = nullptr;
+    uint32_t completed = 0;
+
+    {
+        LockGuard guard(queue.ring.lock);
+        do
+        {
+            uint16_t head;
+            uint32_t length;
+            while (Virtio::popUsed(queue.ring, head, length))
+            {
+                Block::Request* request = queue.inflight[head];
+                const uint8_t result = queue.statuses[head];
+                const Block::Status status = result == BLK_STATUS_OK ? Block::Status::OK
+                                             : result == BLK_STATUS_UNSUPPORTED ? Block::Status::UNSUPPORTED
+                                                                                : Block::Status::IO_ERROR;
+
+                queue.inflight[head] = nullptr;
+                Virtio::freeChain(queue.ring, head);
+
+                virtioBlkDefer(done, request, status);
+                ++completed;
+            }
+        } while (!Virtio::armInterrupt(queue.ring));
+    }
+
+    Block::completeList(done);
+    return completed;
+}
+
+uint32_t virtioBlkPoll(Block::Device* device, const uint32_t queueIndex)
+{
+    return virtioBlkReap(static_cast<VirtioBlkDisk*>(device->driverData)->queues[queueIndex]);
+}
+
+void virtioBlkInterrupt(void* arg)
+{
+    auto* queue = static_cast<VirtioBlkQueue*>(arg);
+    virtioBlkReap(*queue);
+    Block::kick(&queue->disk->block, queue->index);
+}
+
+constexpr Block::Operations virtioBlkOps = {virtioBlkSubmit, virtioBlkPoll};
+
+bool virtioBlkSetupQueues(VirtioBlkDisk& disk, const IRQ::Vector* vectors, const uint32_t vectorCount)
+{
+    for (uint32_t i = 0; i < disk.block.queueCount; ++i)
+    {
+        VirtioBlkQueue& queue = disk.queues[i];
+        const uint16_t entry = i < vectorCount ? static_cast<uint16_t>(i) : Virtio::NO_VECTOR;
+        if (!Virtio::setupQueue(disk.transport, queue.ring, static_cast<uint16_t>(i), entry)) return false;
+
+        queue.headerPhysical = BuddyAllocator::alloc(BLK_HEADER_ORDER, AllocFlags::ZEROED);
+        queue.inflight = static_cast<Block::Request**>(SlabAllocator::alloc(sizeof(Block::Request*) *
+                                                                            queue.ring.size));
+        if (!queue.headerPhysical || !queue.inflight) return false;
+
+        auto* base = reinterpret_cast<uint8_t*>(queue.headerPhysical + hhdm_request.response->offset);
+        queue.headers = reinterpret_cast<VirtioBlkHeader*>(base);
+        queue.statuses = base + BLK_STATUS_OFFSET;
+        memset(queue.inflight, 0, sizeof(Block::Request*) * queue.ring.size);
+
+        const uint32_t chain = queue.ring.size - 2u;
+        if (disk.block.maxSegments > chain) disk.block.maxSegments = chain;
+        if (!disk.block.queueDepth || queue.ring.size < disk.block.queueDepth)
+            disk.block.queueDepth = queue.ring.size;
+    }
+
+    for (uint32_t cpu = 0; cpu < SMP::MAX_CPUS; ++cpu)
+    {
+        disk.block.queueForCpu[cpu] = static_cast<uint16_t>(cpu % disk.block.queueCount);
+        for (uint32_t i = 0; i < vectorCount && i < disk.block.queueCount; ++i)
+            if (vectors[i].cpuId == cpu) disk.block.queueForCpu[cpu] = static_cast<uint16_t>(i);
+    }
+
+    return true;
+}
+
+void virtioBlkRelease(VirtioBlkDisk* disk, const IRQ::Vector* vectors, const IRQ::LineId* lines,
+                      const uint32_t vectorCount)
+{
+    Virtio::fail(disk->transport);
+    Virtio::reset(disk->transport);
+
+    for (uint32_t i = disk->block.queueCount; i-- > 0;)
+    {
+        VirtioBlkQueue& queue = disk->queues[i];
+        if (queue.inflight) SlabAllocator::free(queue.inflight);
+        if (queue.headerPhysical) BuddyAllocator::free(queue.headerPhysical, BLK_HEADER_ORDER);
+        Virtio::releaseQueue(queue.ring);
+    }
+
+    PCI::freeVectors(*disk->transport.pci, vectors, lines, vectorCount);
+    SlabAllocator::free(disk->queues);
+    SlabAllocator::free(disk);
+}
+
+bool virtioBlkProbe(PCI::Device& device)
+{
+    auto* disk = static_cast<VirtioBlkDisk*>(SlabAllocator::alloc(sizeof(VirtioBlkDisk), alignof(VirtioBlkDisk)));
+    if (!disk) return false;
+
+    memset(disk, 0, sizeof(VirtioBlkDisk));
+    if (!Virtio::initTransport(device, disk->transport) ||
+        !Virtio::negotiate(disk->transport, Virtio::F_VERSION_1, Virtio::F_RING_EVENT_IDX | BLK_F_SEG_MAX |
+                                                                 BLK_F_RO | BLK_F_BLK_SIZE | BLK_F_FLUSH | BLK_F_MQ) ||
+        !disk->transport.deviceConfig)
+    {
+        SlabAllocator::free(disk);
+        return false;
+    }
+
+    const Virtio::Transport& transport = disk->transport;
+    volatile uint8_t* config = transport.deviceConfig;
+    Block::Device& block = disk->block;
+
+    block.sectors = *reinterpret_cast<volatile uint64_t*>(config + BLK_CONFIG_CAPACITY);
+    block.sectorSize = transport.features & BLK_F_BLK_SIZE
+                           ? *reinterpret_cast<volatile uint32_t*>(config + BLK_CONFIG_BLK_SIZE)
+                           : Block::SECTOR_SIZE;
+    block.maxSegments = transport.features & BLK_F_SEG_MAX
+                            ? *reinterpret_cast<volatile uint32_t*>(config + BLK_CONFIG_SEG_MAX)
+                            : VirtioBlk::MAX_SEGMENTS;
+    if (!block.maxSegments || block.maxSegments > VirtioBlk::MAX_SEGMENTS) block.maxSegments = VirtioBlk::MAX_SEGMENTS;
+    block.readOnly = transport.features & BLK_F_RO;
+    disk->canFlush = transport.features & BLK_F_FLUSH;
+
+    uint32_t queueCount = transport.features & BLK_F_MQ
+                              ? *reinterpret_cast<volatile uint16_t*>(config + BLK_CONFIG_NUM_QUEUES)
+                              : 1;
+    if (queueCount > Virtio::getQueueCount(transport)) queueCount = Virtio::getQueueCount(transport);
+    if (queueCount > SMP::getCpuCount()) queueCount = SMP::getCpuCount();
+    if (queueCount > VirtioBlk::MAX_QUEUES) queueCount = VirtioBlk::MAX_QUEUES;
+    if (!queueCount) queueCount = 1;
+    block.queueCount = queueCount;
+
+    disk->queues = static_cast<VirtioBlkQueue*>(SlabAllocator::alloc(sizeof(VirtioBlkQueue) * queueCount,
+                                                                     alignof(VirtioBlkQueue)));
+    if (!disk->queues)
+    {
+        Virtio::fail(disk->transport);
+        SlabAllocator::free(disk);
+
+        return false;
+    }
+    memset(disk->queues, 0, sizeof(VirtioBlkQueue) * queueCount);
+
+    void* args[VirtioBlk::MAX_QUEUES];
+    uint32_t cpuIds[VirtioBlk::MAX_QUEUES];
+    IRQ::Vector vectors[VirtioBlk::MAX_QUEUES];
+    IRQ::LineId lines[VirtioBlk::MAX_QUEUES];
+    for (uint32_t i = 0, cpu = 0; i < queueCount; ++i)
+    {
+        disk->queues[i].disk = disk;
+        disk->queues[i].index = i;
+        args[i] = &disk->queues[i];
+
+        while (cpu + 1 < SMP::MAX_CPUS && !cpus[cpu].online) ++cpu;
+        cpuIds[i] = cpu++;
+    }
+
+    uint32_t vectorCount = device.msix.offset
+                               ? PCI::allocateVectors(device, queueCount, virtioBlkInterrupt, args, vectors, lines,
+                                                      cpuIds)
+                               : 0;
+    if (vectorCount && !(PCI::read16(device, device.msix.offset + 2) & PCI::MSIX_ENABLE))
+    {
+        PCI::freeVectors(device, vectors, lines, vectorCount);
+        vectorCount = 0;
+    }
+    if (!vectorCount) Serial::printf("VirtioBlk: No MSI-X vectors, completions are polled\n");
+    else if (vectorCount < queueCount) block.queueCount = vectorCount;
+
+    for (uint32_t i = 0; i < vectorCount; ++i)
+        if (vectors[i].cpuId == cpuIds[i]) IRQ::setPinned(lines[i], true);
+
+    if (!virtioBlkSetupQueues(*disk, vectors, vectorCount))
+    {
+        Serial::printf("VirtioBlk: Failed to set up queues for %x:%x.%x\n", device.bus, device.device,
+                       device.function);
+        virtioBlkRelease(disk, vectors, lines, vectorCount);
+
+        return false;
+    }
+
+    block.maxSectors = (block.maxSegments - 1) * (FrameAllocator::SMALL_SIZE / Block::SECTOR_SIZE);
+    if (!block.maxSectors) block.maxSectors = FrameAllocator::SMALL_SIZE / Block::SECTOR_SIZE;
+    block.ops = &virtioBlkOps;
+    block.driverData = disk;
+
+    const uint32_t index = virtioBlkDiskCount++;
+    block.name[0] = 'v';
+    block.name[1] = 'd';
+    block.name[2] = static_cast<char>('a' + index % 26);
+
+    Virtio::setDriverOk(disk->transport);
+    device.driverData = disk;
+    if (Block::registerDevice(&block)) return true;
+
+    device.driverData = nullptr;
+    --virtioBlkDiskCount;
+    virtioBlkRelease(disk, vectors, lines, vectorCount);
+
+    return false;
+}
+
+bool VirtioBlk::init()
+{
+    PCI::Driver driver;
+    driver.name = "virtio-blk";
+    driver.vendorId = Virtio::VENDOR_ID;
+    driver.probe = virtioBlkProbe;
+
+    driver.deviceId = MODERN_DEVICE_ID;
+    const bool modern = PCI::registerDriver(driver);
+    driver.deviceId = TRANSITIONAL_DEVICE_ID;
+
+    return PCI::registerDriver(driver) && modern;
+}
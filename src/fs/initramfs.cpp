@@ -0,0 +1,495 @@
+#include <core/limine.h>
+#include <drivers/serial.h>
+#include <fs/initramfs.h>
+#include <memory/buddy.h>
+#include <memory/paging.h>
+#include <memory/slab.h>
+
+extern limine_module_request module_request;
+extern limine_hhdm_request hhdm_request;
+
+constexpr uint64_t CPIO_HEADER_SIZE = 110, TAR_BLOCK_SIZE = 512;
+constexpr uint32_t CPIO_MODE_MASK = 0170000, CPIO_MODE_DIRECTORY = 0040000, CPIO_MODE_FILE = 0100000;
+
+struct InitramfsNode
+{
+    char name[VFS::NAME_LENGTH];
+    uint32_t length;
+    VFS::InodeType type;
+    uint64_t number, offset, size;
+    InitramfsNode *children, *sibling, *nextFile, *nextNode;
+};
+
+struct InitramfsImage
+{
+    uint64_t start, end;
+    const uint8_t* base;
+    InitramfsNode root;
+    InitramfsNode *nodes, *files, *lastFile;
+    uint64_t fileCount, directoryCount, skipped;
+};
+
+SlabCache* initramfsNodeSlab = nullptr;
+uint32_t initramfsImageCount = 0;
+uint64_t initramfsMountAttempts = 0;
+
+bool initramfsNamesMatch(const char* a, const char* b, const uint32_t length)
+{
+    for (uint32_t i = 0; i < length; ++i)
+        if (a[i] != b[i]) return false;
+
+    return true;
+}
+
+InitramfsNode* initramfsFind(const InitramfsNode* dir, const char* name, const uint32_t length)
+{
+    for (InitramfsNode* node = dir->children; node; node = node->sibling)
+        if (node->length == length && initramfsNamesMatch(node->name, name, length)) return node;
+
+    return nullptr;
+}
+
+InitramfsNode* initramfsAllocNode(InitramfsImage* image, InitramfsNode* dir, const char* name, const uint32_t length,
+                                  const VFS::InodeType type)
+{
+    auto* node = static_cast<InitramfsNode*>(SlabAllocator::cacheAlloc(initramfsNodeSlab));
+    if (!node) return nullptr;
+
+    memset(node, 0, sizeof(InitramfsNode));
+    memcpy(node->name, name, length);
+    node->length = length;
+    node->type = type;
+    node->number = VFS::allocInodeNumber();
+
+    node->sibling = dir->children;
+    dir->children = node;
+    node->nextNode = image->nodes;
+    image->nodes = node;
+
+    if (type == VFS::InodeType::DIRECTORY) ++image->directoryCount;
+    else ++image->fileCount;
+    return node;
+}
+
+void initramfsFreeNodes(InitramfsImage* image)
+{
+    while (InitramfsNode* node = image->nodes)
+    {
+        image->nodes = node->nextNode;
+        SlabAllocator::free(node);
+    }
+}
+
+void initramfsSetData(InitramfsImage* image, InitramfsNode* node, const uint64_t offset, const uint64_t size)
+{
+    if (node->size)
+    {
+        InitramfsNode** link = &image->files;
+        while (*link != node) link = &(*link)->nextFile;
+
+        *link = node->nextFile;
+        if (image->lastFile == node)
+        {
+            image->lastFile = nullptr;
+            for (InitramfsNode* file = image->files; file; file = file->nextFile) image->lastFile = file;
+        }
+        node->nextFile = nullptr;
+    }
+
+    node->offset = offset;
+    node->size = size;
+    if (!size) return;
+
+    if (image->lastFile) image->lastFile->nextFile = node;
+    else image->files = node;
+    image->lastFile = node;
+}
+
+VFS::Status initramfsAdd(InitramfsImage* image, const char* path, const uint64_t pathLength,
+                         const VFS::InodeType type, const uint64_t offset, const uint64_t size)
+{
+    InitramfsNode* dir = &image->root;
+    const char* end = path + pathLength;
+
+    while (true)
+    {
+        while (path < end && *path == '/') ++path;
+        if (path >= end) break;
+
+        uint32_t length = 0;
+        while (path + length < end && path[length] != '/') ++length;
+        const char* name = path;
+        path += length;
+
+        const char* rest = path;
+        while (rest < end && *rest == '/') ++rest;
+        const bool last = rest >= end;
+
+        if (length == 1 && name[0] == '.') continue;
+        if (length >= VFS::NAME_LENGTH || (length == 2 && name[0] == '.' && name[1] == '.'))
+        {
+            ++image->skipped;
+            return VFS::Status::OK;
+        }
+
+        InitramfsNode* node = initramfsFind(dir, name, length);
+        if (last && node && node->type != type)
+        {
+            ++image->skipped;
+            return VFS::Status::OK;
+        }
+
+        if (!node && !(node = initramfsAllocNode(image, dir, name, length, last ? type : VFS::InodeType::DIRECTORY)))
+            return VFS::Status::NO_MEMORY;
+
+        if (last && type == VFS::InodeType::FILE)
+        {
+            initramfsSetData(image, node, offset, size);
+            return VFS::Status::OK;
+        }
+
+        if (node->type != VFS::InodeType::DIRECTORY)
+        {
+            ++image->skipped;
+            return VFS::Status::OK;
+        }
+
+        dir = node;
+    }
+
+    return VFS::Status::OK;
+}
+
+bool initramfsParseHex(const char* text, const uint32_t digits, uint64_t& value)
+{
+    value = 0;
+    for (uint32_t i = 0; i < digits; ++i)
+    {
+        const char c = text[i];
+        if (c >= '0' && c <= '9') value = value << 4 | static_cast<uint64_t>(c - '0');
+        else if (c >= 'a' && c <= 'f') value = value << 4 | static_cast<uint64_t>(c - 'a' + 10);
+        else if (c >= 'A' && c <= 'F') value = value << 4 | static_cast<uint64_t>(c - 'A' + 10);
+        else return false;
+    }
+
+    return true;
+}
+
+uint64_t initramfsParseOctal(const char* text, const uint32_t digits)
+{
+    uint32_t i = 0;
+    while (i < digits && text[i] == ' ') ++i;
+
+    uint64_t value = 0;
+    for (; i < digits && text[i] >= '0' && text[i] <= '7'; ++i)
+        value = value << 3 | static_cast<uint64_t>(text[i] - '0');
+
+    return value;
+}
+
+uint32_t initramfsFieldLength(const char* field, const uint32_t size)
+{
+    uint32_t length = 0;
+    while (length < size && field[length]) ++length;
+
+    return length;
+}
+
+VFS::Status initramfsParseCpio(InitramfsImage* image, const uint64_t size)
+{
+    for (uint64_t position = 0; position + CPIO_HEADER_SIZE <= size;)
+    {
+        const char* header = reinterpret_cast<const char*>(image->base + position);
+        if (!initramfsNamesMatch(header, "07070", 5) || (header[5] != '1' && header[5] != '2'))
+            return VFS::Status::INVALID;
+
+        uint64_t fields[13];
+        for (uint32_t i = 0; i < 13; ++i)
+            if (!initramfsParseHex(header + 6 + i * 8, 8, fields[i])) return VFS::Status::INVALID;
+
+        const uint64_t mode = fields[1], fileSize = fields[6], nameSize = fields[11];
+        if (!nameSize || position + CPIO_HEADER_SIZE + nameSize > size) return VFS::Status::INVALID;
+
+        const char* name = header + CPIO_HEADER_SIZE;
+        const uint64_t data = Alignment::alignUp(position + CPIO_HEADER_SIZE + nameSize, 4);
+        if (data > size || fileSize > size - data) return VFS::Status::INVALID;
+        if (nameSize == 11 && initramfsNamesMatch(name, "TRAILER!!!", 11))
+        {
+            position = Alignment::alignUp(data + fileSize, 4);
+            while (position < size && !image->base[position]) ++position;
+            if (position + CPIO_HEADER_SIZE > size) return VFS::Status::OK;
+
+            position = Alignment::alignDown(position, 4);
+            continue;
+        }
+
+        VFS::Status status = VFS::Status::OK;
+        if ((mode & CPIO_MODE_MASK) == CPIO_MODE_DIRECTORY)
+            status = initramfsAdd(image, name, nameSize - 1, VFS::InodeType::DIRECTORY, 0, 0);
+        else if ((mode & CPIO_MODE_MASK) == CPIO_MODE_FILE)
+            status = initramfsAdd(image, name, nameSize - 1, VFS::InodeType::FILE, data, fileSize);
+        else ++image->skipped;
+        if (status != VFS::Status::OK) return status;
+
+        position = Alignment::alignUp(data + fileSize, 4);
+    }
+
+    return VFS::Status::INVALID;
+}
+
+bool initramfsTarChecksumValid(const char* header)
+{
+    uint64_t sum = 0;
+    for (uint32_t i = 0; i < TAR_BLOCK_SIZE; ++i)
+        sum += i >= 148 && i < 156 ? ' ' : static_cast<uint8_t>(header[i]);
+
+    return sum == initramfsParseOctal(header + 148, 8);
+}
+
+VFS::Status initramfsParseTar(InitramfsImage* image, const uint64_t size)
+{
+    uint64_t position = 0;
+    while (position + TAR_BLOCK_SIZE <= size)
+    {
+        const char* header = reinterpret_cast<const char*>(image->base + position);
+        if (!header[0]) return VFS::Status::OK;
+        if (!initramfsTarChecksumValid(header)) return VFS::Status::INVALID;
+
+        const uint64_t fileSize = initramfsParseOctal(header + 124, 12), data = position + TAR_BLOCK_SIZE;
+        if (fileSize > size - data) return VFS::Status::INVALID;
+
+        char path[Initramfs::MAX_PATH];
+        const uint32_t prefixLength = initramfsFieldLength(header + 345, 155);
+        const uint32_t nameLength = initramfsFieldLength(header, 100);
+        memcpy(path, header + 345, prefixLength);
+        path[prefixLength] = '/';
+        memcpy(path + prefixLength + 1, header, nameLength);
+
+        VFS::Status status = VFS::Status::OK;
+        if (header[156] == '5')
+            status = initramfsAdd(image, path, prefixLength + 1 + nameLength, VFS::InodeType::DIRECTORY, 0, 0);
+        else if (header[156] == '0' || header[156] == '\0')
+            status = initramfsAdd(image, path, prefixLength + 1 + nameLength, VFS::InodeType::FILE, data, fileSize);
+        else ++image->skipped;
+        if (status != VFS::Status::OK) return status;
+
+        position = data + Alignment::alignUp(fileSize, TAR_BLOCK_SIZE);
+    }
+
+    return position >= size ? VFS::Status::OK : VFS::Status::INVALID;
+}
+
+uint64_t initramfsRelease(const InitramfsImage* image, const bool kept)
+{
+    uint64_t cursor = image->start, released = 0;
+
+    for (const InitramfsNode* node = image->files; node; node = node->nextFile)
+    {
+        const uint64_t physical = image->start + node->offset;
+        const uint64_t start = Alignment::alignDown(physical, FrameAllocator::SMALL_SIZE);
+        const uint64_t end = Alignment::alignUp(physical + node->size, FrameAllocator::SMALL_SIZE);
+
+        if (!kept && start > cursor) released += BuddyAllocator::addMemory(cursor, start);
+        if (end <= cursor) continue;
+
+        if (kept) released += BuddyAllocator::addMemory(start > cursor ? start : cursor, end);
+        cursor = end;
+    }
+
+    if (!kept && image->end > cursor) released += BuddyAllocator::addMemory(cursor, image->end);
+    return released;
+}
+
+const void* initramfsMap(VFS::Inode* inode, const uint64_t offset, uint64_t& length)
+{
+    const auto* node = static_cast<const InitramfsNode*>(inode->data);
+    const auto* image = static_cast<const InitramfsImage*>(inode->superBlock->data);
+
+    if (offset >= node->size)
+    {
+        length = 0;
+        return nullptr;
+    }
+
+    length = node->size - offset;
+    return image->base + node->offset + offset;
+}
+
+uint64_t initramfsRead(VFS::Inode* inode, const uint64_t offset, void* buffer, uint64_t length)
+{
+    uint64_t available;
+    const void* data = initramfsMap(inode, offset, available);
+    if (length > available) length = available;
+
+    if (length) memcpy(buffer, data, length);
+    return length;
+}
+
+VFS::Status initramfsReaddir(VFS::Inode* dir, uint64_t& cookie, VFS::DirEntry& entry)
+{
+    const InitramfsNode* node = static_cast<const InitramfsNode*>(dir->data)->children;
+    for (uint64_t i = 0; node && i < cookie; ++i) node = node->sibling;
+    if (!node) return VFS::Status::NOT_FOUND;
+
+    memcpy(entry.name, node->name, node->length + 1);
+    entry.length = node->length;
+    entry.type = node->type;
+    entry.number = node->number;
+
+    ++cookie;
+    return VFS::Status::OK;
+}
+
+VFS::Status initramfsLookup(VFS::Inode* dir, const char* name, uint32_t length, VFS::Inode** out);
+
+constexpr VFS::InodeOperations initramfsOps = {initramfsLookup, nullptr, nullptr, initramfsReaddir, initramfsRead,
+                                               nullptr, initramfsMap, nullptr};
+
+VFS::Inode* initramfsInode(VFS::SuperBlock* superBlock, InitramfsNode* node)
+{
+    VFS::Inode* inode = VFS::allocInode(superBlock, node->type, &initramfsOps);
+    if (!inode) return nullptr;
+
+    inode->number = node->number;
+    inode->size = node->size;
+    inode->data = node;
+    return inode;
+}
+
+VFS::Status initramfsLookup(VFS::Inode* dir, const char* name, const uint32_t length, VFS::Inode** out)
+{
+    InitramfsNode* node = initramfsFind(static_cast<const InitramfsNode*>(dir->data), name, length);
+    if (!node) return VFS::Status::NOT_FOUND;
+
+    *out = initramfsInode(dir->superBlock, node);
+    return *out ? VFS::Status::OK : VFS::Status::NO_MEMORY;
+}
+
+uint64_t initramfsReleaseModule(const Initramfs::Image& image)
+{
+    return BuddyAllocator::addMemory(image.physical,
+                                     Alignment::alignUp(image.physical + image.size, FrameAllocator::SMALL_SIZE));
+}
+
+VFS::Status initramfsMount(Block::Device*, const void* data, VFS::SuperBlock* superBlock)
+{
+    const auto* source = static_cast<const Initramfs::Image*>(data);
+    if (!source || !source->size) return VFS::Status::INVALID;
+    ++initramfsMountAttempts;
+
+    auto* image = static_cast<InitramfsImage*>(SlabAllocator::alloc(sizeof(InitramfsImage), alignof(InitramfsImage)));
+    if (!image) return VFS::Status::NO_MEMORY;
+
+    *image = {};
+    image->start = source->physical;
+    image->end = Alignment::alignUp(source->physical + source->size, FrameAllocator::SMALL_SIZE);
+    image->base = reinterpret_cast<const uint8_t*>(source->physical + hhdm_request.response->offset);
+    image->root.type = VFS::InodeType::DIRECTORY;
+    image->root.number = VFS::allocInodeNumber();
+
+    VFS::Status status = VFS::Status::UNSUPPORTED;
+    if (source->size >= CPIO_HEADER_SIZE && initramfsNamesMatch(reinterpret_cast<const char*>(image->base), "07070", 5))
+        status = initramfsParseCpio(image, source->size);
+    else if (source->size >= TAR_BLOCK_SIZE &&
+             initramfsNamesMatch(reinterpret_cast<const char*>(image->base) + 257, "ustar", 5))
+        status = initramfsParseTar(image, source->size);
+
+    superBlock->readOnly = true;
+    superBlock->data = image;
+    if (status == VFS::Status::OK && !(superBlock->root = initramfsInode(superBlock, &image->root)))
+        status = VFS::Status::NO_MEMORY;
+
+    if (status != VFS::Status::OK)
+    {
+        initramfsFreeNodes(image);
+        SlabAllocator::free(image);
+        superBlock->data = nullptr;
+
+        const uint64_t released = initramfsReleaseModule(*source);
+        Serial::printf("Initramfs: Unrecognised or corrupt image, released %lu KiB\n",
+                       released * FrameAllocator::SMALL_SIZE / 1024);
+        return status;
+    }
+
+    const uint64_t released = initramfsRelease(image, false);
+    Serial::printf("Initramfs: %lu files, %lu directories, %lu skipped, %lu KiB released after unpacking\n",
+                   image->fileCount, image->directoryCount, image->skipped,
+                   released * FrameAllocator::SMALL_SIZE / 1024);
+    return VFS::Status::OK;
+}
+
+void initramfsUnmount(VFS::SuperBlock* superBlock)
+{
+    auto* image = static_cast<InitramfsImage*>(superBlock->data);
+    if (!image) return;
+
+    const uint64_t released = initramfsRelease(image, true);
+    Serial::printf("Initramfs: Released %lu KiB of file data\n", released * FrameAllocator::SMALL_SIZE / 1024);
+
+    initramfsFreeNodes(image);
+    SlabAllocator::free(image);
+    superBlock->data = nullptr;
+}
+
+constexpr VFS::FileSystem initramfs = {"initramfs", initramfsMount, initramfsUnmount};
+
+void initramfsMountPath(char* path, const limine_file* module, const uint32_t index)
+{
+    if (module->string && module->string[0] == '/')
+    {
+        const uint32_t length = initramfsFieldLength(module->string, Initramfs::MAX_PATH - 1);
+        memcpy(path, module->string, length);
+        path[length] = '\0';
+        return;
+    }
+
+    memcpy(path, "/initrd", 8);
+    if (!index) return;
+
+    char digits[10];
+    uint32_t count = 0;
+    for (uint32_t value = index; value; value /= 10) digits[count++] = static_cast<char>('0' + value % 10);
+    for (uint32_t i = 0; i < count; ++i) path[7 + i] = digits[count - 1 - i];
+    path[7 + count] = '\0';
+}
+
+bool Initramfs::init()
+{
+    const limine_module_response* response = module_request.response;
+    if (!response || !response->module_count) return true;
+
+    initramfsNodeSlab = SlabAllocator::createCache("initramfs-node", sizeof(InitramfsNode), alignof(InitramfsNode));
+    if (!initramfsNodeSlab || !VFS::registerFileSystem(&initramfs))
+    {
+        Serial::printf("Initramfs: Failed to register filesystem\n");
+        return false;
+    }
+
+    for (uint64_t i = 0; i < response->module_count; ++i)
+    {
+        const limine_file* module = response->modules[i];
+        const Image image = {reinterpret_cast<uint64_t>(module->address) - hhdm_request.response->offset, module->size};
+
+        char path[MAX_PATH];
+        initramfsMountPath(path, module, static_cast<uint32_t>(i));
+
+        VFS::create(path, VFS::InodeType::DIRECTORY);
+
+        const uint64_t attempts = initramfsMountAttempts;
+        if (const VFS::Status status = VFS::mount(path, "initramfs", nullptr, &image); status != VFS::Status::OK)
+        {
+            const uint64_t released = initramfsMountAttempts == attempts ? initramfsReleaseModule(image) : 0;
+            Serial::printf("Initramfs: Failed to mount %s on %s (status %u)", module->path, path,
+                           static_cast<uint32_t>(status));
+            if (released) Serial::printf(", released %lu KiB", released * FrameAllocator::SMALL_SIZE / 1024);
+            Serial::printf("\n");
+            continue;
+        }
+
+        ++initramfsImageCount;
+    }
+
+    return true;
+}
+
+uint32_t Initramfs::getImageCount() { return initramfsImageCount; }
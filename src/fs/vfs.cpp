@@ -0,0 +1,948 @@
+#include <arch/x86_64/isr.h>
+#include <core/stats.h>
+#include <drivers/serial.h>
+#include <fs/vfs.h>
+#include <memory/rcu.h>
+#include <memory/slab.h>
+#include <task/task.h>
+
+constexpr uint32_t DENTRY_DEAD = UINT32_MAX;
+constexpr uint8_t DENTRY_REFERENCED = 1u << 0, DENTRY_PINNED = 1u << 1;
+
+VFS::Dentry* dentryHash[VFS::HASH_BUCKETS] = {};
+VFS::Dentry *dentryLruHead = nullptr, *dentryLruTail = nullptr, *rootDentry = nullptr;
+uint64_t dentryCount = 0, nextInodeNumber = 1;
+Spinlock dcacheLock, fileSystemLock;
+const VFS::FileSystem* fileSystems[VFS::MAX_FILESYSTEMS] = {};
+uint32_t fileSystemCount = 0;
+SlabCache *dentrySlab = nullptr, *inodeSlab = nullptr;
+Stats::Id vfsFastLookups = Stats::INVALID, vfsSlowLookups = Stats::INVALID, vfsNegativeHits = Stats::INVALID;
+
+void vfsCount(const Stats::Id id)
+{
+    if (id != Stats::INVALID) Stats::add(id);
+}
+
+bool vfsNamesMatch(const char* a, const char* b, const uint32_t length)
+{
+    for (uint32_t i = 0; i < length; ++i)
+        if (a[i] != b[i]) return false;
+
+    return true;
+}
+
+uint32_t vfsHashName(const VFS::Dentry* parent, const char* name, const uint32_t length)
+{
+    uint64_t hash = 0xCBF29CE484222325ULL ^ reinterpret_cast<uint64_t>(parent) * 0x9E3779B97F4A7C15ULL;
+    for (uint32_t i = 0; i < length; ++i)
+    {
+        hash ^= static_cast<uint8_t>(name[i]);
+        hash *= 0x100000001B3ULL;
+    }
+
+    return static_cast<uint32_t>(hash ^ hash >> 32);
+}
+
+const char* vfsNextComponent(const char* cursor, uint32_t& length)
+{
+    while (*cursor == '/') ++cursor;
+
+    length = 0;
+    while (cursor[length] && cursor[length] != '/') ++length;
+
+    return cursor;
+}
+
+bool vfsHasTrailingSlash(const char* path)
+{
+    const char* last = path;
+    while (*path) last = path++;
+
+    return *last == '/';
+}
+
+bool vfsIsDot(const char* name, const uint32_t length) { return length == 1 && name[0] == '.'; }
+
+bool vfsIsDotDot(const char* name, const uint32_t length) { return length == 2 && name[0] == '.' && name[1] == '.'; }
+
+VFS::Dentry* dentryFind(const VFS::Dentry* parent, const char* name, const uint32_t length, const uint32_t hash)
+{
+    for (VFS::Dentry* dentry = __atomic_load_n(&dentryHash[hash & (VFS::HASH_BUCKETS - 1)], __ATOMIC_ACQUIRE); dentry;
+         dentry = __atomic_load_n(&dentry->hashNext, __ATOMIC_ACQUIRE))
+        if (dentry->hash == hash && dentry->parent == parent && dentry->length == length &&
+            vfsNamesMatch(dentry->name, name, length))
+            return dentry;
+
+    return nullptr;
+}
+
+VFS::Dentry* dentryFollowMounts(VFS::Dentry* dentry)
+{
+    while (VFS::Dentry* mounted = __atomic_load_n(&dentry->mounted, __ATOMIC_ACQUIRE)) dentry = mounted;
+    return dentry;
+}
+
+VFS::Dentry* dentryParentBase(VFS::Dentry* dentry)
+{
+    while (dentry->mountpoint) dentry = dentry->mountpoint;
+    return dentry->parent ? dentry->parent : dentry;
+}
+
+VFS::Dentry* dentryParent(VFS::Dentry* dentry) { return dentryFollowMounts(dentryParentBase(dentry)); }
+
+void dentryGet(VFS::Dentry* dentry) { __atomic_add_fetch(&dentry->refs, 1, __ATOMIC_RELAXED); }
+
+bool dentryTryGet(VFS::Dentry* dentry)
+{
+    uint32_t refs = __atomic_load_n(&dentry->refs, __ATOMIC_RELAXED);
+    do
+    {
+        if (refs == DENTRY_DEAD) return false;
+    } while (!__atomic_compare_exchange_n(&dentry->refs, &refs, refs + 1, true, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED));
+
+    return true;
+}
+
+VFS::Dentry* dentryGetMounted(VFS::Dentry* dentry)
+{
+    RcuReadGuard guard;
+
+    VFS::Dentry* top;
+    do top = dentryFollowMounts(dentry);
+    while (!dentryTryGet(top));
+
+    return top;
+}
+
+void dentryLruAdd(VFS::Dentry* dentry)
+{
+    dentry->lruPrev = nullptr;
+    dentry->lruNext = dentryLruHead;
+    if (dentryLruHead) dentryLruHead->lruPrev = dentry;
+    else dentryLruTail = dentry;
+    dentryLruHead = dentry;
+}
+
+void dentryLruRemove(VFS::Dentry* dentry)
+{
+    if (dentry->lruPrev) dentry->lruPrev->lruNext = dentry->lruNext;
+    else dentryLruHead = dentry->lruNext;
+
+    if (dentry->lruNext) dentry->lruNext->lruPrev = dentry->lruPrev;
+    else dentryLruTail = dentry->lruPrev;
+
+    dentry->lruNext = dentry->lruPrev = nullptr;
+}
+
+void dentryHashRemove(VFS::Dentry* dentry)
+{
+    VFS::Dentry** link = &dentryHash[dentry->hash & (VFS::HASH_BUCKETS - 1)];
+    while (*link != dentry) link = &(*link)->hashNext;
+    __atomic_store_n(link, dentry->hashNext, __ATOMIC_RELEASE);
+}
+
+void dentryChildAdd(VFS::Dentry* parent, VFS::Dentry* dentry)
+{
+    dentry->cookie = ++parent->nextCookie;
+    dentry->siblingNext = nullptr;
+    dentry->siblingPrev = parent->childTail;
+    if (parent->childTail) parent->childTail->siblingNext = dentry;
+    else parent->childHead = dentry;
+    parent->childTail = dentry;
+}
+
+void dentryChildRemove(VFS::Dentry* dentry)
+{
+    VFS::Dentry* parent = dentry->parent;
+    if (dentry->siblingPrev) dentry->siblingPrev->siblingNext = dentry->siblingNext;
+    else parent->childHead = dentry->siblingNext;
+
+    if (dentry->siblingNext) dentry->siblingNext->siblingPrev = dentry->siblingPrev;
+    else parent->childTail = dentry->siblingPrev;
+
+    dentry->siblingNext = dentry->siblingPrev = nullptr;
+}
+
+bool dentryKill(VFS::Dentry* dentry)
+{
+    uint32_t expected = 0;
+    if (!__atomic_compare_exchange_n(&dentry->refs, &expected, DENTRY_DEAD, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        return false;
+
+    dentryHashRemove(dentry);
+    dentryLruRemove(dentry);
+    dentryChildRemove(dentry);
+    if (dentry->inode) --dentry->parent->children;
+    --dentryCount;
+
+    return true;
+}
+
+bool dentryInMount(const VFS::Dentry* dentry, const VFS::Dentry* root)
+{
+    while (dentry->parent) dentry = dentry->parent;
+    return dentry == root;
+}
+
+VFS::Dentry* dentryAlloc(VFS::Dentry* parent, const char* name, const uint32_t length, const uint32_t hash,
+                         VFS::Inode* inode)
+{
+    auto* dentry = static_cast<VFS::Dentry*>(SlabAllocator::cacheAlloc(dentrySlab));
+    if (!dentry) return nullptr;
+
+    memset(dentry, 0, sizeof(VFS::Dentry));
+    memcpy(dentry->name, name, length);
+    dentry->length = length;
+    dentry->hash = hash;
+    dentry->parent = parent;
+    dentry->inode = inode;
+    dentry->refs = 1;
+
+    return dentry;
+}
+
+VFS::Dentry* dentryAllocRoot(VFS::Inode* inode, VFS::Dentry* mountpoint)
+{
+    VFS::Dentry* dentry = dentryAlloc(nullptr, "/", 1, 0, inode);
+    if (!dentry) return nullptr;
+
+    dentry->flags = DENTRY_PINNED;
+    dentry->mountpoint = mountpoint;
+    return dentry;
+}
+
+void inodeFree(VFS::Inode* inode)
+{
+    if (inode->ops && inode->ops->evict) inode->ops->evict(inode);
+    if (inode->mapping.ops) PageCache::releaseMapping(&inode->mapping);
+
+    SlabAllocator::free(inode);
+}
+
+void dentryFreeVictims(VFS::Dentry** victims, const uint32_t count)
+{
+    Rcu::synchronize();
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        VFS::Dentry* dentry = victims[i];
+        if (VFS::Inode* inode = dentry->inode; inode && !__atomic_sub_fetch(&inode->refs, 1, __ATOMIC_ACQ_REL))
+            inodeFree(inode);
+
+        VFS::release(dentry->parent);
+        SlabAllocator::free(dentry);
+    }
+}
+
+void inodeLock(VFS::Inode* inode)
+{
+    while (__atomic_exchange_n(&inode->locked, true, __ATOMIC_ACQUIRE))
+    {
+        if (Interrupt::interruptsEnabled()) Task::taskYield();
+        else asm volatile ("pause");
+    }
+}
+
+void inodeUnlock(VFS::Inode* inode) { __atomic_store_n(&inode->locked, false, __ATOMIC_RELEASE); }
+
+bool vfsLookupRcu(const char* path, VFS::Status& status, VFS::Dentry** out)
+{
+    RcuReadGuard guard;
+    VFS::Dentry* current = dentryFollowMounts(rootDentry);
+    const bool directoryOnly = vfsHasTrailingSlash(path);
+
+    while (true)
+    {
+        uint32_t length;
+        const char* name = vfsNextComponent(path, length);
+        if (!length) break;
+        path = name + length;
+
+        if (length >= VFS::NAME_LENGTH)
+        {
+            status = VFS::Status::NAME_TOO_LONG;
+            return true;
+        }
+
+        const VFS::Inode* dir = __atomic_load_n(&current->inode, __ATOMIC_ACQUIRE);
+        if (!dir) return false;
+        if (dir->type != VFS::InodeType::DIRECTORY)
+        {
+            status = VFS::Status::NOT_DIRECTORY;
+            return true;
+        }
+
+        if (vfsIsDot(name, length)) continue;
+        if (vfsIsDotDot(name, length))
+        {
+            current = dentryParent(current);
+            continue;
+        }
+
+        VFS::Dentry* next = dentryFind(current, name, length, vfsHashName(current, name, length));
+        if (!next) return false;
+
+        const uint32_t seq = next->seq.readBegin();
+        const VFS::Inode* inode = __atomic_load_n(&next->inode, __ATOMIC_ACQUIRE);
+        if (next->seq.readRetry(seq) || __atomic_load_n(&next->refs, __ATOMIC_RELAXED) == DENTRY_DEAD) return false;
+
+        if (!(__atomic_load_n(&next->flags, __ATOMIC_RELAXED) & DENTRY_REFERENCED))
+            __atomic_or_fetch(&next->flags, DENTRY_REFERENCED, __ATOMIC_RELAXED);
+
+        if (!inode)
+        {
+            vfsCount(vfsNegativeHits);
+            status = VFS::Status::NOT_FOUND;
+            return true;
+        }
+
+        current = dentryFollowMounts(next);
+    }
+
+    if (directoryOnly)
+    {
+        const VFS::Inode* inode = __atomic_load_n(&current->inode, __ATOMIC_ACQUIRE);
+        if (!inode) return false;
+        if (inode->type != VFS::InodeType::DIRECTORY)
+        {
+            status = VFS::Status::NOT_DIRECTORY;
+            return true;
+        }
+    }
+
+    if (!dentryTryGet(current)) return false;
+
+    status = VFS::Status::OK;
+    *out = current;
+    return true;
+}
+
+VFS::Status dentryLookupSlow(VFS::Dentry* parent, const char* name, const uint32_t length, VFS::Dentry** out)
+{
+    const uint32_t hash = vfsHashName(parent, name, length);
+    {
+        LockGuard guard(dcacheLock);
+        if (VFS::Dentry* dentry = dentryFind(parent, name, length, hash))
+        {
+            dentryGet(dentry);
+            *out = dentry;
+            return VFS::Status::OK;
+        }
+    }
+
+    VFS::Inode* dir = parent->inode;
+    VFS::Inode* inode = nullptr;
+    const VFS::Status status = dir->ops && dir->ops->lookup ? dir->ops->lookup(dir, name, length, &inode)
+                                                            : VFS::Status::NOT_FOUND;
+    if (status != VFS::Status::OK && status != VFS::Status::NOT_FOUND) return status;
+
+    VFS::Dentry* fresh = dentryAlloc(parent, name, length, hash, inode);
+    if (!fresh)
+    {
+        if (inode) VFS::putInode(inode);
+        return VFS::Status::NO_MEMORY;
+    }
+
+    {
+        LockGuard guard(dcacheLock);
+        if (VFS::Dentry* dentry = dentryFind(parent, name, length, hash))
+        {
+            dentryGet(dentry);
+            *out = dentry;
+        }
+        else
+        {
+            dentryGet(parent);
+            if (inode) ++parent->children;
+
+            fresh->hashNext = dentryHash[hash & (VFS::HASH_BUCKETS - 1)];
+            __atomic_store_n(&dentryHash[hash & (VFS::HASH_BUCKETS - 1)], fresh, __ATOMIC_RELEASE);
+            dentryLruAdd(fresh);
+            dentryChildAdd(parent, fresh);
+            ++dentryCount;
+
+            *out = fresh;
+            fresh = nullptr;
+        }
+    }
+
+    if (fresh)
+    {
+        SlabAllocator::free(fresh);
+        if (inode) VFS::putInode(inode);
+    }
+
+    if (VFS::getDentryCount() > VFS::DENTRY_LIMIT) VFS::shrinkDentries(VFS::SHRINK_BATCH);
+    return VFS::Status::OK;
+}
+
+VFS::Status vfsWalk(const char* path, const bool parentOnly, VFS::Dentry** out, const char** lastName = nullptr,
+                    uint32_t* lastLength = nullptr)
+{
+    if (!path || *path != '/' || !rootDentry) return VFS::Status::INVALID;
+
+    const char* start = path;
+    VFS::Dentry* current = dentryGetMounted(rootDentry);
+
+    while (true)
+    {
+        uint32_t length;
+        const char* name = vfsNextComponent(path, length);
+        if (!length) break;
+        path = name + length;
+
+        if (parentOnly)
+        {
+            uint32_t rest;
+            vfsNextComponent(path, rest);
+            if (!rest)
+            {
+                *lastName = name;
+                *lastLength = length;
+                *out = current;
+                return VFS::Status::OK;
+            }
+        }
+
+        VFS::Status status = VFS::Status::OK;
+        if (length >= VFS::NAME_LENGTH) status = VFS::Status::NAME_TOO_LONG;
+        else if (current->inode->type != VFS::InodeType::DIRECTORY) status = VFS::Status::NOT_DIRECTORY;
+        else if (vfsIsDot(name, length)) continue;
+
+        if (status != VFS::Status::OK)
+        {
+            VFS::release(current);
+            return status;
+        }
+
+        VFS::Dentry* next;
+        if (vfsIsDotDot(name, length)) next = dentryGetMounted(dentryParentBase(current));
+        else if ((status = dentryLookupSlow(current, name, length, &next)) != VFS::Status::OK)
+        {
+            VFS::release(current);
+            return status;
+        }
+
+        VFS::release(current);
+        if (!next->inode)
+        {
+            VFS::release(next);
+            return VFS::Status::NOT_FOUND;
+        }
+
+        current = dentryGetMounted(next);
+        VFS::release(next);
+    }
+
+    if (parentOnly)
+    {
+        VFS::release(current);
+        return VFS::Status::INVALID;
+    }
+
+    if (current->inode->type != VFS::InodeType::DIRECTORY && vfsHasTrailingSlash(start))
+    {
+        VFS::release(current);
+        return VFS::Status::NOT_DIRECTORY;
+    }
+
+    *out = current;
+    return VFS::Status::OK;
+}
+
+VFS::Status rootfsCreate(VFS::Inode* dir, const char*, uint32_t, const VFS::InodeType type, VFS::Inode** out);
+
+VFS::Status rootfsUnlink(VFS::Inode*, const char*, uint32_t, VFS::Inode*) { return VFS::Status::OK; }
+
+constexpr VFS::InodeOperations rootfsOps = {nullptr, rootfsCreate, rootfsUnlink, nullptr, nullptr, nullptr, nullptr,
+                                            nullptr};
+
+VFS::Status rootfsCreate(VFS::Inode* dir, const char*, uint32_t, const VFS::InodeType type, VFS::Inode** out)
+{
+    *out = VFS::allocInode(dir->superBlock, type, &rootfsOps);
+    return *out ? VFS::Status::OK : VFS::Status::NO_MEMORY;
+}
+
+VFS::Status rootfsMount(Block::Device*, const void*, VFS::SuperBlock* superBlock)
+{
+    superBlock->dcacheBacked = true;
+    superBlock->root = VFS::allocInode(superBlock, VFS::InodeType::DIRECTORY, &rootfsOps);
+    return superBlock->root ? VFS::Status::OK : VFS::Status::NO_MEMORY;
+}
+
+constexpr VFS::FileSystem rootfs = {"rootfs", rootfsMount, nullptr};
+
+VFS::SuperBlock* vfsMountSuperBlock(const VFS::FileSystem* fileSystem, Block::Device* device, const void* data,
+                                    VFS::Status& status)
+{
+    auto* superBlock = static_cast<VFS::SuperBlock*>(SlabAllocator::alloc(sizeof(VFS::SuperBlock),
+                                                                          alignof(VFS::SuperBlock)));
+    if (!superBlock)
+    {
+        status = VFS::Status::NO_MEMORY;
+        return nullptr;
+    }
+
+    *superBlock = {};
+    superBlock->fileSystem = fileSystem;
+    superBlock->device = device;
+
+    if ((status = fileSystem->mount(device, data, superBlock)) != VFS::Status::OK || !superBlock->root)
+    {
+        if (status == VFS::Status::OK) status = VFS::Status::IO_ERROR;
+        SlabAllocator::free(superBlock);
+        return nullptr;
+    }
+
+    return superBlock;
+}
+
+bool VFS::init()
+{
+    if (rootDentry) return true;
+
+    dentrySlab = SlabAllocator::createCache("vfs-dentry", sizeof(Dentry), alignof(Dentry));
+    inodeSlab = SlabAllocator::createCache("vfs-inode", sizeof(Inode), alignof(Inode));
+    if (!dentrySlab || !inodeSlab)
+    {
+        Serial::printf("VFS: Failed to create slab caches\n");
+        return false;
+    }
+
+    vfsFastLookups = Stats::registerCounter("vfs_lookup_fast");
+    vfsSlowLookups = Stats::registerCounter("vfs_lookup_slow");
+    vfsNegativeHits = Stats::registerCounter("vfs_negative_hits");
+    Stats::registerGauge("vfs_dentries", getDentryCount);
+
+    registerFileSystem(&rootfs);
+
+    Status status;
+    SuperBlock* superBlock = vfsMountSuperBlock(&rootfs, nullptr, nullptr, status);
+    Dentry* root = superBlock ? dentryAllocRoot(superBlock->root, nullptr) : nullptr;
+    if (!root)
+    {
+        Serial::printf("VFS: Failed to mount rootfs\n");
+        return false;
+    }
+
+    __atomic_store_n(&rootDentry, root, __ATOMIC_RELEASE);
+    return true;
+}
+
+bool VFS::registerFileSystem(const FileSystem* fileSystem)
+{
+    if (!fileSystem || !fileSystem->name || !fileSystem->mount) return false;
+    LockGuard guard(fileSystemLock);
+
+    if (fileSystemCount >= MAX_FILESYSTEMS) return false;
+    fileSystems[fileSystemCount++] = fileSystem;
+
+    return true;
+}
+
+VFS::Status VFS::mount(const char* path, const char* fileSystem, Block::Device* device, const void* data)
+{
+    if (!rootDentry || !fileSystem) return Status::INVALID;
+
+    const FileSystem* type = nullptr;
+    {
+        LockGuard guard(fileSystemLock);
+        for (uint32_t i = 0; i < fileSystemCount && !type; ++i)
+        {
+            const char *a = fileSystems[i]->name, *b = fileSystem;
+            while (*a && *a == *b) ++a, ++b;
+            if (*a == *b) type = fileSystems[i];
+        }
+    }
+
+    if (!type) return Status::UNSUPPORTED;
+
+    Dentry* target;
+    Status status = lookup(path, &target);
+    if (status != Status::OK) return status;
+    if (target->inode->type != InodeType::DIRECTORY)
+    {
+        release(target);
+        return Status::NOT_DIRECTORY;
+    }
+
+    SuperBlock* superBlock = vfsMountSuperBlock(type, device, data, status);
+    Dentry* root = superBlock ? dentryAllocRoot(superBlock->root, target) : nullptr;
+    if (!root)
+    {
+        if (superBlock)
+        {
+            putInode(superBlock->root);
+            if (type->unmount) type->unmount(superBlock);
+            SlabAllocator::free(superBlock);
+        }
+
+        release(target);
+        return superBlock ? Status::NO_MEMORY : status;
+    }
+
+    {
+        LockGuard guard(dcacheLock);
+        Dentry* top = dentryFollowMounts(target);
+        root->mountpoint = top;
+        __atomic_or_fetch(&top->flags, DENTRY_PINNED, __ATOMIC_RELAXED);
+        __atomic_store_n(&top->mounted, root, __ATOMIC_RELEASE);
+    }
+
+    Serial::printf("VFS: Mounted %s on %s%s\n", type->name, path, superBlock->readOnly ? " (read-only)" : "");
+    return Status::OK;
+}
+
+VFS::Status VFS::unmount(const char* path)
+{
+    Dentry* root;
+    Status status = lookup(path, &root);
+    if (status != Status::OK) return status;
+    if (!root->mountpoint)
+    {
+        release(root);
+        return Status::INVALID;
+    }
+
+    bool busy = false;
+    while (true)
+    {
+        Dentry* victims[SHRINK_BATCH];
+        uint32_t victimCount = 0;
+        busy = false;
+        {
+            LockGuard guard(dcacheLock);
+            for (uint32_t bucket = 0; bucket < HASH_BUCKETS && victimCount < SHRINK_BATCH; ++bucket)
+                for (Dentry *dentry = dentryHash[bucket], *next; dentry && victimCount < SHRINK_BATCH; dentry = next)
+                {
+                    next = dentry->hashNext;
+                    if (!dentryInMount(dentry, root)) continue;
+
+                    if (dentryKill(dentry)) victims[victimCount++] = dentry;
+                    else busy = true;
+                }
+        }
+
+        if (!victimCount) break;
+        dentryFreeVictims(victims, victimCount);
+    }
+
+    Dentry* mountpoint = root->mountpoint;
+    {
+        LockGuard guard(dcacheLock);
+        uint32_t expected = 2;
+        if (busy || __atomic_load_n(&root->mounted, __ATOMIC_ACQUIRE) ||
+            !__atomic_compare_exchange_n(&root->refs, &expected, DENTRY_DEAD, false, __ATOMIC_ACQUIRE,
+                                         __ATOMIC_RELAXED))
+            status = Status::BUSY;
+        else
+        {
+            __atomic_store_n(&mountpoint->mounted, static_cast<Dentry*>(nullptr), __ATOMIC_RELEASE);
+            if (!mountpoint->inode->superBlock->dcacheBacked)
+                __atomic_and_fetch(&mountpoint->flags, static_cast<uint8_t>(~DENTRY_PINNED), __ATOMIC_RELAXED);
+        }
+    }
+
+    if (status != Status::OK)
+    {
+        release(root);
+        return status;
+    }
+
+    SuperBlock* superBlock = root->inode->superBlock;
+    Rcu::synchronize();
+    putInode(root->inode);
+    SlabAllocator::free(root);
+    release(mountpoint);
+
+    if (superBlock->fileSystem->unmount) superBlock->fileSystem->unmount(superBlock);
+    Serial::printf("VFS: Unmounted %s from %s\n", superBlock->fileSystem->name, path);
+    SlabAllocator::free(superBlock);
+
+    return Status::OK;
+}
+
+VFS::Status VFS::lookup(const char* path, Dentry** out)
+{
+    if (!path || !out || *path != '/' || !rootDentry) return Status::INVALID;
+
+    Status status;
+    if (vfsLookupRcu(path, status, out))
+    {
+        vfsCount(vfsFastLookups);
+        return status;
+    }
+
+    vfsCount(vfsSlowLookups);
+    return vfsWalk(path, false, out);
+}
+
+void VFS::release(Dentry* dentry)
+{
+    if (dentry) __atomic_sub_fetch(&dentry->refs, 1, __ATOMIC_RELEASE);
+}
+
+VFS::Status VFS::create(const char* path, const InodeType type, Dentry** out)
+{
+    Dentry* parent;
+    const char* name;
+    uint32_t length;
+    Status status = vfsWalk(path, true, &parent, &name, &length);
+    if (status != Status::OK) return status;
+
+    Inode* dir = parent->inode;
+    if (length >= NAME_LENGTH) status = Status::NAME_TOO_LONG;
+    else if (dir->type != InodeType::DIRECTORY) status = Status::NOT_DIRECTORY;
+    else if (vfsIsDot(name, length) || vfsIsDotDot(name, length)) status = Status::EXISTS;
+    else if (type != InodeType::DIRECTORY && vfsHasTrailingSlash(path)) status = Status::NOT_DIRECTORY;
+    else if (dir->superBlock->readOnly) status = Status::READ_ONLY;
+    else if (!dir->ops || !dir->ops->create) status = Status::UNSUPPORTED;
+    if (status != Status::OK)
+    {
+        release(parent);
+        return status;
+    }
+
+    inodeLock(dir);
+
+    Dentry* dentry;
+    if ((status = dentryLookupSlow(parent, name, length, &dentry)) == Status::OK)
+    {
+        Inode* inode = nullptr;
+        if (dentry->inode) status = Status::EXISTS;
+        else if ((status = dir->ops->create(dir, name, length, type, &inode)) == Status::OK)
+        {
+            LockGuard guard(dcacheLock);
+            dentry->seq.writeBegin();
+            __atomic_store_n(&dentry->inode, inode, __ATOMIC_RELEASE);
+            dentry->seq.writeEnd();
+
+            ++parent->children;
+            if (dir->superBlock->dcacheBacked)
+            {
+                __atomic_or_fetch(&dentry->flags, DENTRY_PINNED, __ATOMIC_RELAXED);
+                dentryGet(dentry);
+            }
+        }
+
+        if (status == Status::OK && out) *out = dentry;
+        else release(dentry);
+    }
+
+    inodeUnlock(dir);
+    release(parent);
+    return status;
+}
+
+VFS::Status VFS::unlink(const char* path)
+{
+    Dentry* parent;
+    const char* name;
+    uint32_t length;
+    Status status = vfsWalk(path, true, &parent, &name, &length);
+    if (status != Status::OK) return status;
+
+    Inode* dir = parent->inode;
+    if (length >= NAME_LENGTH) status = Status::NAME_TOO_LONG;
+    else if (dir->type != InodeType::DIRECTORY) status = Status::NOT_DIRECTORY;
+    else if (vfsIsDot(name, length) || vfsIsDotDot(name, length)) status = Status::INVALID;
+    else if (dir->superBlock->readOnly) status = Status::READ_ONLY;
+    else if (!dir->ops || !dir->ops->unlink) status = Status::UNSUPPORTED;
+    if (status != Status::OK)
+    {
+        release(parent);
+        return status;
+    }
+
+    inodeLock(dir);
+
+    Dentry* dentry;
+    Inode* inode = nullptr;
+    if ((status = dentryLookupSlow(parent, name, length, &dentry)) == Status::OK)
+    {
+        if (!(inode = dentry->inode)) status = Status::NOT_FOUND;
+        else if (__atomic_load_n(&dentry->mounted, __ATOMIC_ACQUIRE)) status = Status::BUSY;
+        else if (inode->type == InodeType::DIRECTORY && dir->superBlock->dcacheBacked && dentry->children)
+            status = Status::NOT_EMPTY;
+        else status = dir->ops->unlink(dir, name, length, inode);
+
+        if (status == Status::OK)
+        {
+            LockGuard guard(dcacheLock);
+            dentry->seq.writeBegin();
+            __atomic_store_n(&dentry->inode, static_cast<Inode*>(nullptr), __ATOMIC_RELEASE);
+            dentry->seq.writeEnd();
+
+            --parent->children;
+            if (__atomic_fetch_and(&dentry->flags, static_cast<uint8_t>(~DENTRY_PINNED), __ATOMIC_RELAXED) &
+                DENTRY_PINNED)
+                release(dentry);
+        }
+
+        release(dentry);
+    }
+
+    inodeUnlock(dir);
+    release(parent);
+
+    if (status == Status::OK) putInode(inode);
+    return status;
+}
+
+VFS::Status VFS::open(const char* path, File& file, const bool writable)
+{
+    Dentry* dentry;
+    const Status status = lookup(path, &dentry);
+    if (status != Status::OK) return status;
+
+    Inode* inode = dentry->inode;
+    if (writable && inode->type == InodeType::DIRECTORY)
+    {
+        release(dentry);
+        return Status::IS_DIRECTORY;
+    }
+
+    if (writable && inode->superBlock->readOnly)
+    {
+        release(dentry);
+        return Status::READ_ONLY;
+    }
+
+    getInode(inode);
+    file = {dentry, inode, 0, writable};
+    return Status::OK;
+}
+
+void VFS::close(File& file)
+{
+    if (file.inode) putInode(file.inode);
+    release(file.dentry);
+    file = {};
+}
+
+uint64_t VFS::read(File& file, void* buffer, const uint64_t length)
+{
+    Inode* inode = file.inode;
+    if (!inode || inode->type == InodeType::DIRECTORY) return 0;
+
+    uint64_t done = 0;
+    if (inode->ops && inode->ops->read) done = inode->ops->read(inode, file.offset, buffer, length);
+    else if (inode->mapping.ops) done = PageCache::read(&inode->mapping, file.offset, buffer, length);
+
+    file.offset += done;
+    return done;
+}
+
+uint64_t VFS::write(File& file, const void* buffer, const uint64_t length)
+{
+    Inode* inode = file.inode;
+    if (!inode || !file.writable) return 0;
+
+    uint64_t done = 0;
+    if (inode->ops && inode->ops->write) done = inode->ops->write(inode, file.offset, buffer, length);
+    else if (inode->mapping.ops) done = PageCache::write(&inode->mapping, file.offset, buffer, length);
+
+    file.offset += done;
+    return done;
+}
+
+const void* VFS::map(const File& file, uint64_t& length)
+{
+    const Inode* inode = file.inode;
+    length = 0;
+    if (!inode || inode->type == InodeType::DIRECTORY || !inode->ops || !inode->ops->map) return nullptr;
+
+    return inode->ops->map(file.inode, file.offset, length);
+}
+
+VFS::Status VFS::readdir(File& file, DirEntry& entry)
+{
+    Inode* inode = file.inode;
+    if (!inode || inode->type != InodeType::DIRECTORY) return Status::NOT_DIRECTORY;
+    if (inode->ops && inode->ops->readdir) return inode->ops->readdir(inode, file.offset, entry);
+    if (!inode->superBlock->dcacheBacked) return Status::UNSUPPORTED;
+
+    const Dentry* dir = file.dentry;
+    LockGuard guard(dcacheLock);
+
+    for (const Dentry* dentry = dir->childHead; dentry; dentry = dentry->siblingNext)
+    {
+        if (dentry->cookie <= file.offset || !dentry->inode) continue;
+
+        memcpy(entry.name, dentry->name, dentry->length);
+        entry.name[dentry->length] = '\0';
+        entry.length = dentry->length;
+        entry.type = dentry->inode->type;
+        entry.number = dentry->inode->number;
+
+        file.offset = dentry->cookie;
+        return Status::OK;
+    }
+
+    return Status::NOT_FOUND;
+}
+
+VFS::Inode* VFS::allocInode(SuperBlock* superBlock, const InodeType type, const InodeOperations* ops)
+{
+    auto* inode = static_cast<Inode*>(SlabAllocator::cacheAlloc(inodeSlab));
+    if (!inode) return nullptr;
+
+    memset(inode, 0, sizeof(Inode));
+    inode->number = allocInodeNumber();
+    inode->type = type;
+    inode->refs = 1;
+    inode->superBlock = superBlock;
+    inode->ops = ops;
+
+    return inode;
+}
+
+uint64_t VFS::allocInodeNumber() { return __atomic_fetch_add(&nextInodeNumber, 1, __ATOMIC_RELAXED); }
+
+void VFS::getInode(Inode* inode) { __atomic_add_fetch(&inode->refs, 1, __ATOMIC_RELAXED); }
+
+void VFS::putInode(Inode* inode)
+{
+    if (!inode || __atomic_sub_fetch(&inode->refs, 1, __ATOMIC_ACQ_REL)) return;
+
+    Rcu::synchronize();
+    inodeFree(inode);
+}
+
+uint64_t VFS::shrinkDentries(const uint64_t count)
+{
+    uint64_t freed = 0;
+
+    while (freed < count)
+    {
+        Dentry* victims[SHRINK_BATCH];
+        uint32_t victimCount = 0;
+        {
+            LockGuard guard(dcacheLock);
+            for (uint64_t scanned = 0, limit = dentryCount; scanned < limit && dentryLruTail &&
+                                                            victimCount < SHRINK_BATCH && freed + victimCount < count;
+                 ++scanned)
+            {
+                Dentry* dentry = dentryLruTail;
+                if (__atomic_load_n(&dentry->flags, __ATOMIC_RELAXED) & (DENTRY_PINNED | DENTRY_REFERENCED) ||
+                    !dentryKill(dentry))
+                {
+                    __atomic_and_fetch(&dentry->flags, static_cast<uint8_t>(~DENTRY_REFERENCED), __ATOMIC_RELAXED);
+                    dentryLruRemove(dentry);
+                    dentryLruAdd(dentry);
+                    continue;
+                }
+
+                victims[victimCount++] = dentry;
+            }
+        }
+
+        if (!victimCount) break;
+
+        dentryFreeVictims(victims, victimCount);
+        freed += victimCount;
+    }
+
+    return freed;
+}
+
+uint64_t VFS::getDentryCount() { return __atomic_load_n(&dentryCount, __ATOMIC_RELAXED); }
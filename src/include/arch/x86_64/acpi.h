@@ -16,6 +16,22 @@ namespace ACPI
         ISO iso[16] = {};
     };
 
+    struct MCFGSegment
+    {
+        uint64_t base = 0;
+        uint16_t segment = 0;
+        uint8_t startBus = 0, endBus = 0;
+    };
+
+    struct MCFGInfo
+    {
+        static constexpr uint32_t MAX_SEGMENTS = 16;
+
+        MCFGSegment segments[MAX_SEGMENTS] = {};
+        uint32_t count = 0;
+    };
+
      bool init(MADTInfo& madtInfo);
      void resolveIsa(const MADTInfo& madtInfo, uint8_t src, uint32_t& globalIrq, bool& activeLow, bool& levelTriggered);
+     bool findMCFG(MCFGInfo& mcfgInfo);
 }
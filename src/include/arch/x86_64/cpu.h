@@ -10,6 +10,7 @@ struct CPU
     CPU* self;
     uint32_t id, lapicId;
     bool started, online, schedulerReady, timerReady;
+    uint32_t preemptCount;
     uint64_t kernelStackTop;
     Task::Task *currentTask, *idleTask;
     Scheduler::Scheduler* scheduler;
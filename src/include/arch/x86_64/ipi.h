@@ -0,0 +1,17 @@
+#pragma once
+
+#include <core/utils.h>
+
+namespace IPI
+{
+    using CallFn = void(*)(void*);
+
+    constexpr uint8_t VECTOR_CALL = 0xF0, VECTOR_RESCHEDULE = 0xF1;
+
+    void sendReschedule(uint32_t cpuId);
+    void acknowledgeReschedule();
+
+    bool callOnCpu(uint32_t cpuId, CallFn fn, void* arg, bool wait = true);
+    bool callOnAllCpus(CallFn fn, void* arg, bool wait = true, bool includeSelf = true);
+    void processCalls();
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <arch/x86_64/smp.h>
+#include <core/utils.h>
+
+namespace IRQ
+{
+    using Handler = void(*)(void* arg);
+    using LineId = uint32_t;
+
+    constexpr uint8_t FIRST_DYNAMIC_VECTOR = 0x30, LAST_DYNAMIC_VECTOR = 0xEF;
+    constexpr uint32_t DYNAMIC_VECTOR_COUNT = LAST_DYNAMIC_VECTOR - FIRST_DYNAMIC_VECTOR + 1, ANY_CPU = 0xFFFFFFFF;
+    constexpr uint32_t MAX_LINES = 64;
+    constexpr LineId INVALID_LINE = 0xFFFFFFFF;
+
+    struct Vector
+    {
+        uint32_t cpuId = 0;
+        uint8_t vector = 0;
+    };
+
+    using Retarget = bool(*)(void* owner, uint32_t index, const Vector& vector);
+
+    struct CpuMask
+    {
+        uint64_t bits[SMP::MAX_CPUS / 64] = {};
+
+        void set(const uint32_t cpuId) { if (cpuId < SMP::MAX_CPUS) bits[cpuId / 64] |= 1ULL << (cpuId % 64); }
+        void clear(const uint32_t cpuId) { if (cpuId < SMP::MAX_CPUS) bits[cpuId / 64] &= ~(1ULL << (cpuId % 64)); }
+        bool test(const uint32_t cpuId) const
+        {
+            return cpuId < SMP::MAX_CPUS && (bits[cpuId / 64] >> (cpuId % 64) & 1);
+        }
+    };
+
+    CpuMask allCpus();
+
+    void init();
+    bool initCPU(uint32_t cpuId);
+
+    bool allocate(uint32_t cpuId, Handler handler, void* arg, Vector& out);
+    uint32_t allocateSpread(uint32_t count, Handler handler, void* const* args, Vector* out);
+    void free(const Vector& vector);
+
+    uint32_t getAllocatedCount(uint32_t cpuId);
+    void dispatch(uint8_t vector);
+
+    LineId registerIoapicLine(const char* name, uint32_t gsi, uint8_t vector, uint32_t cpuId);
+    LineId registerMsiLine(const char* name, const Vector& vector, Retarget retarget, void* owner, uint32_t index);
+    void unregisterLine(LineId line);
+
+    bool setAffinity(LineId line, const CpuMask& affinity);
+    bool setPinned(LineId line, bool pinned);
+    bool migrate(LineId line, uint32_t cpuId);
+    void setIsolated(const CpuMask& isolated);
+
+    uint64_t getLineCount(LineId line);
+    bool startBalancer(uint32_t intervalMs);
+    void dumpLines();
+}
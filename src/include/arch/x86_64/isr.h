@@ -11,7 +11,7 @@ namespace Interrupt
 
     struct TimerFrame
     {
-        uint64_t r15, r14, r13, r12, r11, r10, r9, r8, rdi, rsi, rbp, rdx, rcx, rbx, rax, rip, cs, rflags;
+        uint64_t r15, r14, r13, r12, r11, r10, r9, r8, rdi, rsi, rbp, rdx, rcx, rbx, rax, rip, cs, rflags, rsp, ss;
     };
 
     bool interruptsEnabled();
@@ -54,4 +54,5 @@ __attribute__ ((interrupt)) void isr30(const Interrupt::Frame* f);
 __attribute__ ((interrupt)) void isr31(const Interrupt::Frame* f);
 
 __attribute__ ((interrupt)) void isrKeyboard(Interrupt::Frame* f);
+__attribute__ ((interrupt)) void isrCallFunction(Interrupt::Frame* f);
 }
@@ -8,6 +8,9 @@ namespace LAPIC
     void write(uint32_t reg, uint32_t value);
     uint32_t read(uint32_t reg);
     void sendEOI();
+    void sendIPI(uint32_t lapicId, uint8_t vector);
+    uint32_t getId();
+    bool isX2APIC();
 
     void timerInit(uint8_t vector);
     void timerSetDivide(uint8_t divide);
@@ -25,6 +28,7 @@ namespace IOAPIC
 {
     void init(uint64_t virtBase, uint32_t irqBase);
     void redirect(uint32_t irq, uint8_t vector, uint8_t lapicId, bool activeLow, bool levelTriggered);
+    void setDestination(uint32_t irq, uint8_t lapicId);
     void write(uint32_t reg, uint32_t value);
     uint32_t read(uint32_t reg);
 }
@@ -10,7 +10,11 @@ namespace SMP
              hasX2APIC, hasTSCDeadline, hasPAT;
     };
 
+    using BootFn = void(*)(uint64_t chunk, void* arg);
+
     void init();
+    void bootParallel(BootFn fn, void* arg, uint64_t chunks);
+    void releaseAPs();
     void detectCPUFeatures();
     uint32_t getCpuCount();
     uint32_t getLapicId();
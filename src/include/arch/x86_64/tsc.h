@@ -0,0 +1,12 @@
+#pragma once
+
+#include <core/utils.h>
+
+namespace TSC
+{
+    uint64_t read();
+    void setFrequency(uint64_t hz);
+    uint64_t getFrequency();
+    uint64_t toNanoseconds(uint64_t cycles);
+    uint64_t toMicroseconds(uint64_t cycles);
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <core/utils.h>
+
+namespace BootTime
+{
+    void phase(const char* name);
+    void report();
+}
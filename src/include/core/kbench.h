@@ -0,0 +1,23 @@
+#pragma once
+
+#include <core/utils.h>
+
+namespace KBench
+{
+    struct Benchmark
+    {
+        const char* name;
+        void* (*setup)(uint32_t cpuId);
+        bool (*run)(void* state);
+        void (*teardown)(void* state);
+        uint32_t iterations;
+    };
+
+    constexpr uint16_t EXIT_PORT = 0xF4;
+    constexpr uint8_t EXIT_SUCCESS = 0x10, EXIT_FAILURE = 0x11;
+    constexpr uint32_t MAX_BENCHMARKS = 32, MAX_ITERATIONS = 65536;
+
+    bool registerBenchmark(const Benchmark& benchmark);
+    bool runAll(uint32_t maxCpus = 0);
+    [[noreturn]] void exit(uint8_t code);
+}
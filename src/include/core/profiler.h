@@ -0,0 +1,17 @@
+#pragma once
+
+#include <arch/x86_64/isr.h>
+#include <core/utils.h>
+
+namespace Profiler
+{
+    constexpr uint32_t MAX_DEPTH = 16, SAMPLES_PER_CPU = 2048;
+
+    bool start(uint32_t period = 1);
+    void stop();
+    void reset();
+    bool isRunning();
+
+    void sample(const Interrupt::TimerFrame* frame);
+    void dump();
+}
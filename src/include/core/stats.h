@@ -0,0 +1,38 @@
+#pragma once
+
+#include <arch/x86_64/cpu.h>
+#include <core/utils.h>
+
+namespace Stats
+{
+    using Id = uint16_t;
+    using GaugeFn = uint64_t(*)();
+
+    constexpr uint32_t MAX_COUNTERS = 320, MAX_GAUGES = 16, SLAB_CLASSES = 10, IRQ_VECTORS = 256;
+    constexpr Id CONTEXT_SWITCHES = 0, PAGE_FAULTS = 1, TLB_FLUSHES = 2, BUDDY_ALLOCS = 3, BUDDY_FREES = 4,
+                 BUDDY_SPLITS = 5, BUDDY_MERGES = 6, SLAB_FREES = 7, SLAB_ALLOCS = 8,
+                 IRQS = SLAB_ALLOCS + SLAB_CLASSES, BUILTIN_COUNT = IRQS + IRQ_VECTORS, INVALID = 0xFFFF;
+
+    struct Snapshot
+    {
+        uint64_t tsc;
+        uint64_t values[MAX_COUNTERS];
+    };
+
+    extern uint64_t* cpuCounters[SMP::MAX_CPUS];
+
+    bool initCPU(uint32_t cpuId);
+    Id registerCounter(const char* name, uint32_t instances = 1);
+    bool registerGauge(const char* name, GaugeFn read);
+
+    inline void add(const Id id, const uint64_t delta = 1)
+    {
+        uint64_t* row = cpuCounters[CPUManager::getCurrentCPUId()];
+        if (__builtin_expect(row != nullptr, 1)) asm volatile ("addq %1, %0" : "+m"(row[id]) : "r"(delta));
+    }
+
+    uint64_t read(Id id);
+    void snapshot(Snapshot& out);
+    void printDiff(const Snapshot& before, const Snapshot& after);
+    bool startReporter(uint32_t intervalMs);
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <core/utils.h>
+
+namespace Symbols
+{
+    struct Symbol
+    {
+        const char* name = nullptr;
+        uint64_t address = 0, offset = 0;
+    };
+
+    bool isAvailable();
+    uint32_t getCount();
+    Symbol symbolize(uint64_t address);
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <core/utils.h>
+
+namespace Trace
+{
+    enum class Event : uint16_t
+    {
+        SCHED_SWITCH,
+        SCHED_WAKE,
+        SCHED_MIGRATE,
+        BUDDY_ALLOC,
+        BUDDY_FREE,
+        SLAB_ALLOC,
+        SLAB_FREE,
+        PAGE_FAULT,
+        IRQ_ENTRY,
+        IRQ_EXIT,
+        LOCK_CONTENDED,
+        COUNT
+    };
+
+    struct Record
+    {
+        uint64_t tsc, arg0, arg1;
+        uint16_t event, cpu;
+        uint32_t arg2;
+    };
+
+    constexpr uint32_t RECORDS_PER_CPU = 8192, ALL_EVENTS = (1u << static_cast<uint32_t>(Event::COUNT)) - 1;
+
+    extern uint32_t enabledMask;
+
+    bool start(uint32_t mask = ALL_EVENTS);
+    void stop();
+    void reset();
+    void dump();
+    const char* eventName(Event event);
+
+    void record(Event event, uint64_t arg0, uint64_t arg1, uint32_t arg2);
+
+    inline void point(const Event event, const uint64_t arg0 = 0, const uint64_t arg1 = 0, const uint32_t arg2 = 0)
+    {
+        if (__builtin_expect(__atomic_load_n(&enabledMask, __ATOMIC_RELAXED) & 1u << static_cast<uint32_t>(event), 0))
+            record(event, arg0, arg1, arg2);
+    }
+}
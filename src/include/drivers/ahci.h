@@ -0,0 +1,12 @@
+#pragma once
+
+#include <core/utils.h>
+
+namespace AHCI
+{
+    constexpr uint8_t CLASS_STORAGE = 0x01, SUBCLASS_SATA = 0x06, PROG_IF_AHCI = 0x01;
+    constexpr uint32_t MAX_PORTS = 32, MAX_SLOTS = 32, MAX_TRANSFER = 128 * 1024;
+    constexpr uint32_t COALESCE_COMPLETIONS = 8, COALESCE_TIMEOUT_MS = 1;
+
+    bool init();
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <arch/x86_64/smp.h>
+#include <core/utils.h>
+
+namespace Block
+{
+    constexpr uint32_t SECTOR_SIZE = 512, MAX_DEVICES = 16, NAME_LENGTH = 16, PLUG_LIMIT = 32, HISTOGRAM_BUCKETS = 24;
+    constexpr uint32_t READ_EXPIRE_MS = 50, WRITE_EXPIRE_MS = 500, DEADLINE_BATCH = 16, WRITES_STARVED = 2;
+
+    enum class Op : uint8_t
+    {
+        READ,
+        WRITE,
+        FLUSH
+    };
+
+    enum class Status : uint8_t
+    {
+        PENDING,
+        OK,
+        IO_ERROR,
+        UNSUPPORTED,
+        INVALID
+    };
+
+    enum class Scheduler : uint8_t
+    {
+        NONE,
+        DEADLINE
+    };
+
+    struct Device;
+    struct Request;
+    using Callback = void(*)(Request* request);
+
+    struct Segment
+    {
+        uint64_t physical;
+        uint32_t length;
+    };
+
+    struct Request
+    {
+        Device* device = nullptr;
+        Op op = Op::READ;
+        Status status = Status::PENDING;
+        uint16_t queue = 0;
+        uint32_t sectors = 0;
+        uint64_t sector = 0;
+        void* buffer = nullptr;
+        Callback callback = nullptr;
+        void* context = nullptr;
+        Request *next = nullptr, *merged = nullptr, *sortNext = nullptr;
+        uint64_t submitTsc = 0, deadline = 0;
+    };
+
+    struct Plug
+    {
+        Request* head = nullptr;
+        uint32_t count = 0;
+    };
+
+    struct Operations
+    {
+        uint32_t (*submit)(Device* device, uint32_t queue, Request** requests, uint32_t count);
+        uint32_t (*poll)(Device* device, uint32_t queue);
+    };
+
+    struct Device
+    {
+        char name[NAME_LENGTH] = {};
+        uint64_t sectors = 0;
+        uint32_t sectorSize = SECTOR_SIZE, queueCount = 1, queueDepth = 0, maxSectors = 0, maxSegments = 0;
+        bool readOnly = false, hybridPoll = false;
+        Scheduler scheduler = Scheduler::NONE;
+        uint64_t meanLatency = 0;
+        const Operations* ops = nullptr;
+        void* driverData = nullptr;
+        uint16_t queueForCpu[SMP::MAX_CPUS] = {};
+    };
+
+    bool registerDevice(Device* device);
+    uint32_t getDeviceCount();
+    Device* getDevice(uint32_t index);
+    Device* findDevice(const char* name);
+    bool setScheduler(Device* device, Scheduler scheduler);
+
+    Request* allocRequest();
+    void freeRequest(Request* request);
+
+    bool submit(Request* request);
+    uint32_t submitBatch(Device* device, Request** requests, uint32_t count);
+    void plug(Plug& plug, Request* request);
+    void unplug(Plug& plug);
+    void complete(Request* request, Status status);
+    void completeList(Request* list);
+    void kick(Device* device, uint32_t queue);
+    uint32_t poll(Device* device);
+
+    Status transfer(Device* device, Op op, uint64_t sector, uint32_t sectors, void* buffer);
+    uint32_t buildSegments(const void* buffer, uint64_t length, Segment* segments, uint32_t maxSegments);
+    void dumpStats();
+}
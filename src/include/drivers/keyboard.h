@@ -46,7 +46,6 @@ namespace Keyboard
 
     void init();
     void irq();
-    void service();
 
     bool readEvent(Event& event);
     char readChar();
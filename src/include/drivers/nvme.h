@@ -0,0 +1,11 @@
+#pragma once
+
+#include <core/utils.h>
+
+namespace Nvme
+{
+    constexpr uint8_t CLASS_STORAGE = 0x01, SUBCLASS_NVM = 0x08, PROG_IF_NVME = 0x02;
+    constexpr uint32_t MAX_QUEUES = 64, QUEUE_DEPTH = 256, ADMIN_DEPTH = 32, MAX_TRANSFER = 128 * 1024;
+
+    bool init();
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <arch/x86_64/acpi.h>
+#include <arch/x86_64/irq.h>
+#include <core/utils.h>
+
+namespace PCI
+{
+    constexpr uint32_t MAX_DEVICES = 256, MAX_DRIVERS = 32, MAX_BARS = 6;
+    constexpr uint16_t ANY_ID = 0xFFFF;
+    constexpr uint8_t ANY_CLASS = 0xFF;
+
+    constexpr uint16_t REG_VENDOR = 0x00, REG_COMMAND = 0x04, REG_STATUS = 0x06, REG_REVISION = 0x08,
+                       REG_HEADER_TYPE = 0x0E, REG_BAR0 = 0x10, REG_CAPABILITIES = 0x34, REG_INTERRUPT_LINE = 0x3C;
+    constexpr uint16_t COMMAND_IO = 1u << 0, COMMAND_MEMORY = 1u << 1, COMMAND_BUS_MASTER = 1u << 2,
+                       COMMAND_INTX_DISABLE = 1u << 10, STATUS_CAPABILITIES = 1u << 4;
+    constexpr uint8_t CAP_MSI = 0x05, CAP_PCIE = 0x10, CAP_MSIX = 0x11;
+    constexpr uint16_t MSI_ENABLE = 1u << 0, MSIX_FUNCTION_MASK = 1u << 14, MSIX_ENABLE = 1u << 15;
+
+    enum class BarType : uint8_t
+    {
+        NONE,
+        IO,
+        MEMORY32,
+        MEMORY64
+    };
+
+    struct Bar
+    {
+        uint64_t address = 0, size = 0;
+        BarType type = BarType::NONE;
+        bool prefetchable = false;
+        void* mapped = nullptr;
+    };
+
+    struct MSIInfo
+    {
+        uint8_t offset = 0, maxVectors = 0;
+        bool is64Bit = false, perVectorMask = false;
+    };
+
+    struct MSIXInfo
+    {
+        uint8_t offset = 0, tableBar = 0, pbaBar = 0;
+        uint16_t tableSize = 0;
+        uint32_t tableOffset = 0, pbaOffset = 0;
+    };
+
+    struct Driver;
+
+    struct Device
+    {
+        uint16_t segment = 0;
+        uint8_t bus = 0, device = 0, function = 0;
+        uint16_t vendorId = 0, deviceId = 0;
+        uint8_t classCode = 0, subclass = 0, progIf = 0, revision = 0, headerType = 0;
+        uint8_t interruptLine = 0, interruptPin = 0, pcieOffset = 0;
+        Bar bars[MAX_BARS] = {};
+        MSIInfo msi = {};
+        MSIXInfo msix = {};
+        volatile uint32_t* msixTable = nullptr;
+        volatile uint8_t* config = nullptr;
+        const Driver* driver = nullptr;
+        void* driverData = nullptr;
+    };
+
+    struct Driver
+    {
+        const char* name = nullptr;
+        uint16_t vendorId = ANY_ID, deviceId = ANY_ID;
+        uint8_t classCode = ANY_CLASS, subclass = ANY_CLASS, progIf = ANY_CLASS;
+        bool (*probe)(Device& device) = nullptr;
+    };
+
+    bool init(const ACPI::MCFGInfo& mcfg);
+    bool registerDriver(const Driver& driver);
+
+    uint32_t getDeviceCount();
+    Device* getDevice(uint32_t index);
+    Device* findDevice(uint16_t vendorId, uint16_t deviceId);
+
+    uint8_t read8(const Device& device, uint16_t offset);
+    uint16_t read16(const Device& device, uint16_t offset);
+    uint32_t read32(const Device& device, uint16_t offset);
+    void write8(const Device& device, uint16_t offset, uint8_t value);
+    void write16(const Device& device, uint16_t offset, uint16_t value);
+    void write32(const Device& device, uint16_t offset, uint32_t value);
+
+    uint8_t findCapability(const Device& device, uint8_t id, uint8_t after = 0);
+    void setCommand(const Device& device, uint16_t set, uint16_t clear = 0);
+    void* mapBar(Device& device, uint32_t index);
+
+    bool enableMSI(Device& device, const IRQ::Vector& vector);
+    bool enableMSIX(Device& device, const IRQ::Vector* vectors, uint32_t count);
+    void maskMSIX(Device& device, uint32_t entry, bool masked);
+    uint32_t allocateVectors(Device& device, uint32_t count, IRQ::Handler handler, void* const* args,
+                             IRQ::Vector* out, IRQ::LineId* lines = nullptr, const uint32_t* cpuIds = nullptr);
+    void freeVectors(Device& device, const IRQ::Vector* vectors, const IRQ::LineId* lines, uint32_t count);
+    void disableMSI(Device& device);
+
+    void dump();
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <core/utils.h>
+#include <drivers/pci.h>
+#include <memory/spinlock.h>
+
+namespace Virtio
+{
+    constexpr uint16_t VENDOR_ID = 0x1AF4, NO_VECTOR = 0xFFFF, MAX_QUEUE_SIZE = 256;
+    constexpr uint16_t DESC_F_NEXT = 1u << 0, DESC_F_WRITE = 1u << 1, USED_F_NO_NOTIFY = 1u << 0;
+    constexpr uint64_t F_RING_EVENT_IDX = 1ULL << 29, F_VERSION_1 = 1ULL << 32;
+
+    struct Descriptor
+    {
+        uint64_t address;
+        uint32_t length;
+        uint16_t flags, next;
+    };
+
+    struct UsedElement
+    {
+        uint32_t id, length;
+    };
+
+    struct Queue
+    {
+        Spinlock lock;
+        uint16_t index = 0, size = 0, freeHead = 0, freeCount = 0, lastUsed = 0, availShadow = 0, notified = 0;
+        bool eventIdx = false;
+        Descriptor* descriptors = nullptr;
+        volatile uint16_t *avail = nullptr, *used = nullptr, *notify = nullptr;
+        uint64_t physical = 0;
+    };
+
+    struct Transport
+    {
+        PCI::Device* pci = nullptr;
+        volatile uint8_t *common = nullptr, *notifyBase = nullptr, *isr = nullptr, *deviceConfig = nullptr;
+        uint32_t notifyMultiplier = 0;
+        uint64_t features = 0;
+    };
+
+    bool initTransport(PCI::Device& device, Transport& transport);
+    bool negotiate(Transport& transport, uint64_t required, uint64_t optional);
+    uint16_t getQueueCount(const Transport& transport);
+    bool setupQueue(Transport& transport, Queue& queue, uint16_t index, uint16_t msixEntry);
+    void setDriverOk(Transport& transport);
+    void fail(Transport& transport);
+    void reset(Transport& transport);
+    void releaseQueue(Queue& queue);
+
+    int32_t allocChain(Queue& queue, uint16_t count);
+    void freeChain(Queue& queue, uint16_t head);
+    void publish(Queue& queue, uint16_t head);
+    void kick(Queue& queue);
+    bool popUsed(Queue& queue, uint16_t& head, uint32_t& length);
+    bool armInterrupt(Queue& queue);
+}
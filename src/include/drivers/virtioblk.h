@@ -0,0 +1,11 @@
+#pragma once
+
+#include <core/utils.h>
+
+namespace VirtioBlk
+{
+    constexpr uint16_t TRANSITIONAL_DEVICE_ID = 0x1001, MODERN_DEVICE_ID = 0x1042;
+    constexpr uint32_t MAX_QUEUES = 64, MAX_SEGMENTS = 64;
+
+    bool init();
+}
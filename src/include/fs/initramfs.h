@@ -0,0 +1,17 @@
+#pragma once
+
+#include <core/utils.h>
+#include <fs/vfs.h>
+
+namespace Initramfs
+{
+    constexpr uint32_t MAX_PATH = 256;
+
+    struct Image
+    {
+        uint64_t physical, size;
+    };
+
+    bool init();
+    uint32_t getImageCount();
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <core/utils.h>
+#include <drivers/block.h>
+#include <memory/pagecache.h>
+#include <memory/seqlock.h>
+#include <memory/spinlock.h>
+
+namespace VFS
+{
+    constexpr uint32_t NAME_LENGTH = 64, HASH_BITS = 12, HASH_BUCKETS = 1u << HASH_BITS, MAX_FILESYSTEMS = 8;
+    constexpr uint32_t MAX_DEPTH = 64, DENTRY_LIMIT = 8192, SHRINK_BATCH = 64;
+
+    enum class Status : uint8_t
+    {
+        OK,
+        NOT_FOUND,
+        NOT_DIRECTORY,
+        IS_DIRECTORY,
+        EXISTS,
+        NAME_TOO_LONG,
+        NO_MEMORY,
+        READ_ONLY,
+        UNSUPPORTED,
+        INVALID,
+        IO_ERROR,
+        BUSY,
+        NOT_EMPTY
+    };
+
+    enum class InodeType : uint8_t
+    {
+        FILE,
+        DIRECTORY
+    };
+
+    struct Inode;
+    struct SuperBlock;
+    struct FileSystem;
+
+    struct DirEntry
+    {
+        char name[NAME_LENGTH];
+        uint32_t length;
+        InodeType type;
+        uint64_t number;
+    };
+
+    struct InodeOperations
+    {
+        Status (*lookup)(Inode* dir, const char* name, uint32_t length, Inode** out);
+        Status (*create)(Inode* dir, const char* name, uint32_t length, InodeType type, Inode** out);
+        Status (*unlink)(Inode* dir, const char* name, uint32_t length, Inode* inode);
+        Status (*readdir)(Inode* dir, uint64_t& cookie, DirEntry& out);
+        uint64_t (*read)(Inode* inode, uint64_t offset, void* buffer, uint64_t length);
+        uint64_t (*write)(Inode* inode, uint64_t offset, const void* buffer, uint64_t length);
+        const void* (*map)(Inode* inode, uint64_t offset, uint64_t& length);
+        void (*evict)(Inode* inode);
+    };
+
+    struct Inode
+    {
+        uint64_t number = 0, size = 0;
+        InodeType type = InodeType::FILE;
+        uint32_t refs = 0;
+        bool locked = false;
+        SuperBlock* superBlock = nullptr;
+        const InodeOperations* ops = nullptr;
+        void* data = nullptr;
+        PageCache::Mapping mapping;
+    };
+
+    struct Dentry
+    {
+        SeqCount seq;
+        uint32_t hash = 0, length = 0, refs = 0, children = 0;
+        uint8_t flags = 0;
+        Dentry *parent = nullptr, *hashNext = nullptr, *lruNext = nullptr, *lruPrev = nullptr;
+        Dentry *mounted = nullptr, *mountpoint = nullptr;
+        Dentry *childHead = nullptr, *childTail = nullptr, *siblingNext = nullptr, *siblingPrev = nullptr;
+        uint64_t cookie = 0, nextCookie = 0;
+        Inode* inode = nullptr;
+        char name[NAME_LENGTH] = {};
+    };
+
+    struct SuperBlock
+    {
+        const FileSystem* fileSystem = nullptr;
+        Block::Device* device = nullptr;
+        Inode* root = nullptr;
+        void* data = nullptr;
+        bool readOnly = false, dcacheBacked = false;
+    };
+
+    struct FileSystem
+    {
+        const char* name;
+        Status (*mount)(Block::Device* device, const void* data, SuperBlock* superBlock);
+        void (*unmount)(SuperBlock* superBlock);
+    };
+
+    struct File
+    {
+        Dentry* dentry = nullptr;
+        Inode* inode = nullptr;
+        uint64_t offset = 0;
+        bool writable = false;
+    };
+
+    bool init();
+    bool registerFileSystem(const FileSystem* fileSystem);
+    Status mount(const char* path, const char* fileSystem, Block::Device* device, const void* data);
+    Status unmount(const char* path);
+
+    Status lookup(const char* path, Dentry** out);
+    void release(Dentry* dentry);
+    Status create(const char* path, InodeType type, Dentry** out = nullptr);
+    Status unlink(const char* path);
+
+    Status open(const char* path, File& file, bool writable = false);
+    void close(File& file);
+    uint64_t read(File& file, void* buffer, uint64_t length);
+    uint64_t write(File& file, const void* buffer, uint64_t length);
+    const void* map(const File& file, uint64_t& length);
+    Status readdir(File& file, DirEntry& entry);
+
+    Inode* allocInode(SuperBlock* superBlock, InodeType type, const InodeOperations* ops);
+    uint64_t allocInodeNumber();
+    void getInode(Inode* inode);
+    void putInode(Inode* inode);
+
+    uint64_t shrinkDentries(uint64_t count);
+    uint64_t getDentryCount();
+}
@@ -2,15 +2,51 @@
 
 #include <core/utils.h>
 
+enum class AllocFlags : uint32_t
+{
+    NONE = 0,
+    DMA32 = 1u << 0,
+    ZEROED = 1u << 1
+};
+
+constexpr AllocFlags operator|(AllocFlags a, AllocFlags b)
+{
+    return static_cast<AllocFlags>(static_cast<uint32_t>(a) | static_cast<uint32_t>(b));
+}
+
+constexpr AllocFlags operator&(AllocFlags a, AllocFlags b)
+{
+    return static_cast<AllocFlags>(static_cast<uint32_t>(a) & static_cast<uint32_t>(b));
+}
+
 namespace BuddyAllocator
 {
+    enum class Zone : uint8_t
+    {
+        DMA32,
+        NORMAL,
+        COUNT
+    };
+
+    constexpr uint64_t DMA32_LIMIT = 0x100000000ULL;
+    constexpr int MAX_ORDER = 18;
+    constexpr uint32_t MAX_RECLAIMERS = 4;
+
+    using Reclaimer = uint64_t(*)(uint64_t pages);
+
     bool init();
+    bool isReady();
+    uint64_t reclaimBootloaderMemory(uint64_t keepAddress);
+    uint64_t addMemory(uint64_t start, uint64_t end);
 
-    uint64_t alloc(int order);
+    uint64_t alloc(int order, AllocFlags flags = AllocFlags::NONE);
+    uint64_t allocBelow(int order, uint64_t limit);
     void free(uint64_t address, int order);
+    bool registerReclaimer(Reclaimer reclaimer);
+    uint64_t reclaim(uint64_t pages);
 
+    int getMaxOrder();
     uint64_t getTotalPages();
     uint64_t getFreePages();
-    uint64_t getBaseAddress();
-    uint64_t getSize();
+    uint64_t getFreePages(Zone zone);
 }
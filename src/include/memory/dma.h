@@ -0,0 +1,24 @@
+#pragma once
+
+#include <core/utils.h>
+
+namespace DMA
+{
+    struct Constraints
+    {
+        uint64_t alignment = 4096, boundary = 0, maxAddress = ~0ULL;
+    };
+
+    struct Buffer
+    {
+        uint64_t physical = 0, size = 0;
+        void* virt = nullptr;
+        int order = -1;
+    };
+
+    constexpr uint64_t MASK_24BIT = 0xFFFFFFULL, MASK_32BIT = 0xFFFFFFFFULL, MASK_64BIT = ~0ULL;
+
+    bool alloc(uint64_t size, const Constraints& constraints, Buffer& buffer);
+    bool allocCoherent(uint64_t size, Buffer& buffer, uint64_t maxAddress = MASK_32BIT);
+    void free(Buffer& buffer);
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <core/utils.h>
+#include <drivers/block.h>
+#include <memory/spinlock.h>
+
+namespace PageCache
+{
+    constexpr uint32_t RADIX_SHIFT = 6, RADIX_SLOTS = 1u << RADIX_SHIFT, MAX_HEIGHT = 11;
+    constexpr uint32_t READAHEAD_MIN_PAGES = 4, READAHEAD_MAX_PAGES = 64, IO_BATCH = 32;
+    constexpr uint32_t WRITEBACK_INTERVAL_MS = 500, DIRTY_EXPIRE_MS = 3000;
+    constexpr uint64_t DIRTY_LIMIT_PAGES = 8192, LOW_FREE_PAGES = 2048, HIGH_FREE_PAGES = 4096;
+
+    enum PageFlags : uint8_t
+    {
+        UPTODATE = 1u << 0,
+        DIRTY = 1u << 1,
+        LOCKED = 1u << 2,
+        WRITEBACK = 1u << 3,
+        ERROR = 1u << 4,
+        REFERENCED = 1u << 5,
+        READAHEAD = 1u << 6
+    };
+
+    struct Mapping;
+
+    struct Page
+    {
+        Mapping* mapping;
+        uint64_t index, physical, dirtySince;
+        Page *lruNext, *lruPrev;
+        uint32_t refs;
+        uint8_t flags;
+    };
+
+    struct Operations
+    {
+        void (*readPages)(Mapping* mapping, Page** pages, uint32_t count);
+        void (*writePages)(Mapping* mapping, Page** pages, uint32_t count);
+        void (*poll)(Mapping* mapping);
+        bool (*flush)(Mapping* mapping);
+    };
+
+    struct Mapping
+    {
+        Spinlock lock;
+        void* root = nullptr;
+        uint32_t height = 0;
+        uint64_t size = 0, pageCount = 0, dirtyCount = 0, writebackCount = 0;
+        uint64_t readaheadNext = 0, readaheadSize = 0, lastRead = 0;
+        bool writeError = false;
+        const Operations* ops = nullptr;
+        void* data = nullptr;
+        Mapping* next = nullptr;
+    };
+
+    bool init();
+    bool initMapping(Mapping* mapping, const Operations* ops, void* data, uint64_t size);
+    void releaseMapping(Mapping* mapping);
+    Mapping* blockMapping(Block::Device* device);
+
+    uint64_t read(Mapping* mapping, uint64_t offset, void* buffer, uint64_t length);
+    uint64_t write(Mapping* mapping, uint64_t offset, const void* buffer, uint64_t length);
+    Page* getPage(Mapping* mapping, uint64_t index);
+    void putPage(Page* page);
+    void endIo(Page* page, bool ok);
+
+    bool sync(Mapping* mapping);
+    bool syncAll();
+    uint64_t shrink(uint64_t pages);
+    uint64_t getCachedPages();
+    uint64_t getDirtyPages();
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <core/utils.h>
+#include <memory/buddy.h>
 #include <memory/spinlock.h>
 
 enum class PageFlags : uint64_t
@@ -41,21 +42,23 @@ namespace Alignment
 namespace Paging
 {
     bool init();
+    void enable();
     bool map(uint64_t virtualAddress, uint64_t physicalAddress, uint64_t size, PageFlags flags);
     void unmap(uint64_t virtualAddress, uint64_t size);
+    uint64_t translate(uint64_t virtualAddress);
 }
 
 namespace FrameAllocator
 {
     bool init();
-    void* alloc();
+    void* allocEarly(uint64_t count);
+    uint64_t earlyUsed(size_t entryIndex);
+
+    void* alloc(AllocFlags flags = AllocFlags::NONE);
     void free(void* frame);
-    bool used(void* frame);
 
     uint64_t usedCount();
     uint64_t totalCount();
-    uint64_t baseAddress();
-    uint64_t size();
 
     constexpr uint64_t SMALL_SIZE = 4096, MEDIUM_SIZE = 2ULL * 1024 * 1024, LARGE_SIZE = 1ULL * 1024 * 1024 * 1024;
 }
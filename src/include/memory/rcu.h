@@ -0,0 +1,19 @@
+#pragma once
+
+#include <core/utils.h>
+
+namespace Rcu
+{
+    void synchronize();
+}
+
+class RcuReadGuard
+{
+public:
+    RcuReadGuard();
+    ~RcuReadGuard();
+
+private:
+    uint64_t rflags = 0;
+    uint32_t cpuId;
+};
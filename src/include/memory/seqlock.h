@@ -0,0 +1,31 @@
+#pragma once
+
+#include <core/utils.h>
+
+class SeqCount
+{
+public:
+    uint32_t readBegin() const
+    {
+        uint32_t start;
+        while ((start = __atomic_load_n(&sequence, __ATOMIC_ACQUIRE)) & 1) asm volatile ("pause");
+        return start;
+    }
+
+    [[nodiscard]] bool readRetry(const uint32_t start) const
+    {
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        return __atomic_load_n(&sequence, __ATOMIC_RELAXED) != start;
+    }
+
+    void writeBegin()
+    {
+        __atomic_store_n(&sequence, sequence + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+    }
+
+    void writeEnd() { __atomic_store_n(&sequence, sequence + 1, __ATOMIC_RELEASE); }
+
+private:
+    uint32_t sequence = 0;
+};
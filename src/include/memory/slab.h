@@ -2,10 +2,17 @@
 
 #include <core/utils.h>
 
+struct SlabCache;
+
 namespace SlabAllocator
 {
+    constexpr uint32_t MAX_DEDICATED_CACHES = 16;
+
     bool init();
     void* alloc(size_t size, size_t alignment = 16);
     void free(void* obj);
     size_t usableSize(void* obj);
+
+    SlabCache* createCache(const char* name, size_t objectSize, size_t alignment = 16);
+    void* cacheAlloc(SlabCache* cache);
 }
@@ -5,6 +5,8 @@
 
 namespace VMM
 {
+    constexpr uint64_t STACK_GUARD_PAGES = 1;
+
     enum class RegionType : uint8_t
     {
         ANONYMOUS,
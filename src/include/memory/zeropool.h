@@ -0,0 +1,11 @@
+#pragma once
+
+#include <core/utils.h>
+
+namespace ZeroPool
+{
+    bool initCPU(uint32_t cpuId);
+    uint64_t take();
+    uint64_t drain();
+    void zeroPages(uint64_t physical, uint64_t count);
+}
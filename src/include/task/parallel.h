@@ -0,0 +1,19 @@
+#pragma once
+
+#include <core/utils.h>
+
+namespace Parallel
+{
+    using TaskFn = void(*)(void*);
+    using RangeFn = void(*)(uint64_t begin, uint64_t end, void* arg);
+
+    struct TaskGroup
+    {
+        uint32_t pending = 0;
+    };
+
+    bool initCPU(uint32_t cpuId);
+    void spawn(TaskGroup* group, TaskFn fn, void* arg);
+    void join(TaskGroup* group);
+    void parallelFor(uint64_t begin, uint64_t end, uint64_t grain, RangeFn fn, void* arg);
+}
@@ -16,11 +16,12 @@ namespace Scheduler
         RunQueue queues[Task::MAX_PRIORITY + 1];
         Spinlock lock;
         uint32_t bitmap = 0, cpuId = 0;
-        Task::Task *currentTask = nullptr, *idleTask = nullptr, *deadHead = nullptr;
+        Task::Task *currentTask = nullptr, *idleTask = nullptr, *deadHead = nullptr, *sleepHead = nullptr;
     };
 
     void initCPU(Scheduler* scheduler, Task::Task* idleTask);
     void addReady(Scheduler* scheduler, Task::Task* task);
+    void addSleeping(Scheduler* scheduler, Task::Task* task, uint64_t wakeTick);
     Task::Task* pickNextTask(Scheduler* scheduler);
     uint64_t onTimerIRQ(Scheduler* scheduler);
     uint64_t onYieldIRQ(Scheduler* scheduler);
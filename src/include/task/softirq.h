@@ -0,0 +1,18 @@
+#pragma once
+
+#include <core/utils.h>
+
+namespace Softirq
+{
+    enum class Type : uint8_t
+    {
+        KEYBOARD,
+        COUNT
+    };
+
+    using Handler = void(*)();
+
+    void setHandler(Type type, Handler handler);
+    void raise(Type type);
+    void run();
+}
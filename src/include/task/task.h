@@ -20,7 +20,7 @@ namespace Task
         uint64_t id;
         TaskState state;
         int priority, timeSlice;
-        uint64_t context, kernelStackBase, kernelStackTop, kernelStackSize;
+        uint64_t context, kernelStackBase, kernelStackTop, kernelStackSize, wakeTick;
         Task *next, *prev;
         bool queued;
         uint32_t ownedCpuId;
@@ -32,4 +32,5 @@ namespace Task
     Task* taskCreate(void (*entry)(void*), void* arg, int priority);
     void taskDestroy(Task* task);
     void taskYield();
+    void taskSleep(uint64_t ms);
 }
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <core/utils.h>
+
+namespace WorkQueue
+{
+    using WorkFn = void(*)(void*);
+
+    bool initCPU(uint32_t cpuId);
+    bool queueWork(WorkFn fn, void* arg);
+    bool queueWorkOn(uint32_t cpuId, WorkFn fn, void* arg);
+}
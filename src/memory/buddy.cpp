@@ -1,291 +1,473 @@
+#include <arch/x86_64/smp.h>
 #include <core/limine.h>
+#include <core/stats.h>
+#include <core/trace.h>
 #include <core/utils.h>
 #include <drivers/serial.h>
 #include <memory/buddy.h>
 #include <memory/paging.h>
 #include <memory/spinlock.h>
+#include <memory/zeropool.h>
 
-struct Page
+struct __attribute__ ((packed)) Page
 {
-    uint16_t order = 0;
-    bool free = false, head = false, reserved = false;
-    Page *next = nullptr, *prev = nullptr;
+    uint32_t next, prev;
+    uint8_t state;
 };
 
-struct FreeList
+struct FreeRange
 {
-    Page* head = nullptr;
+    uint64_t start, end;
 };
 
+extern limine_memmap_request memmap_request;
 extern limine_hhdm_request hhdm_request;
-constexpr int MAX_WANTED_ORDER = 9;
+constexpr int MAX_WANTED_ORDER = BuddyAllocator::MAX_ORDER, ZONE_COUNT = static_cast<int>(BuddyAllocator::Zone::COUNT);
+constexpr uint64_t MIN_BUDDY_ADDRESS = 0x100000, DMA32_RESERVE_PAGES = 4096;
+constexpr size_t MAX_FREE_RANGES = 256;
+constexpr uint32_t NO_PAGE = 0xFFFFFFFF;
+constexpr uint8_t PAGE_ORDER_MASK = 0x1F, PAGE_FREE = 1u << 6, PAGE_HEAD = 1u << 7;
 
 Spinlock buddyLock;
-uint64_t buddyBase = 0, buddySize = 0, totalPages = 0, freePages = 0;
+uint64_t totalPages = 0, managedPages = 0, zoneFreePages[ZONE_COUNT] = {}, zoneManagedPages[ZONE_COUNT] = {};
 int maxOrder = 0;
+bool buddyReady = false;
 Page* pages = nullptr;
-FreeList* freeLists = nullptr;
+uint32_t freeLists[ZONE_COUNT][MAX_WANTED_ORDER + 1] = {};
+FreeRange freeRanges[MAX_FREE_RANGES] = {};
+size_t freeRangeCount = 0;
+BuddyAllocator::Reclaimer reclaimers[BuddyAllocator::MAX_RECLAIMERS] = {};
+uint32_t reclaimerCount = 0;
 
-uint64_t indexFromAddress(const uint64_t address) { return (address - buddyBase) / FrameAllocator::SMALL_SIZE; }
-uint64_t addressFromIndex(const uint64_t index) { return buddyBase + index * FrameAllocator::SMALL_SIZE; }
+uint64_t indexFromAddress(const uint64_t address) { return address / FrameAllocator::SMALL_SIZE; }
+uint64_t addressFromIndex(const uint64_t index) { return index * FrameAllocator::SMALL_SIZE; }
 
-void listRemove(const int order, Page* page)
+int zoneOf(const uint64_t index)
 {
-    if (!page) return;
+    return static_cast<int>(addressFromIndex(index) < BuddyAllocator::DMA32_LIMIT
+                                ? BuddyAllocator::Zone::DMA32
+                                : BuddyAllocator::Zone::NORMAL);
+}
 
-    if (page->prev) page->prev->next = page->next;
-    else freeLists[order].head = page->next;
+bool isFreeHead(const uint64_t index, const int order)
+{
+    return pages[index].state == (PAGE_HEAD | PAGE_FREE | static_cast<uint8_t>(order));
+}
 
-    if (page->next) page->next->prev = page->prev;
-    page->next = page->prev = nullptr;
+void setHead(const uint64_t index, const int order, const bool isFree)
+{
+    pages[index].state = PAGE_HEAD | (isFree ? PAGE_FREE : 0) | static_cast<uint8_t>(order);
 }
 
-void listAdd(const int order, Page* page)
+void listRemove(const int order, const uint64_t index)
 {
-    page->prev = nullptr;
-    page->next = freeLists[order].head;
-    if (freeLists[order].head) freeLists[order].head->prev = page;
+    Page& page = pages[index];
+
+    if (page.prev != NO_PAGE) pages[page.prev].next = page.next;
+    else freeLists[zoneOf(index)][order] = page.next;
 
-    freeLists[order].head = page;
+    if (page.next != NO_PAGE) pages[page.next].prev = page.prev;
+    page.next = page.prev = NO_PAGE;
 }
 
-void setBlockState(const uint64_t headIndex, const int order, const bool isFree, const bool isReserved)
+void listAdd(const int order, const uint64_t index)
 {
-    for (uint64_t i = 0; i < 1ULL << order; ++i)
-    {
-        auto& page = pages[headIndex + i];
-        page.free = isFree;
-        page.reserved = isReserved;
-        page.head = i == 0;
-        page.order = i == 0 ? static_cast<uint16_t>(order) : 0;
-        page.next = page.prev = nullptr;
-    }
+    uint32_t& head = freeLists[zoneOf(index)][order];
+    Page& page = pages[index];
+
+    page.prev = NO_PAGE;
+    page.next = head;
+    if (head != NO_PAGE) pages[head].prev = static_cast<uint32_t>(index);
+
+    head = static_cast<uint32_t>(index);
+}
+
+int largestBlockOrder(const uint64_t index, const uint64_t end)
+{
+    int order = maxOrder;
+    while (order > 0 && ((index & ((1ULL << order) - 1)) != 0 || index + (1ULL << order) > end)) --order;
+
+    return order;
 }
 
-void buildInitialFreeLists(const uint8_t* freeMask)
+struct InitChunk
+{
+    uint32_t heads[ZONE_COUNT][MAX_WANTED_ORDER + 1], tails[ZONE_COUNT][MAX_WANTED_ORDER + 1];
+    uint64_t freePages[ZONE_COUNT];
+};
+
+void chunkAdd(InitChunk& chunk, const uint64_t index, const int order)
 {
-    for (int order = 0; order <= maxOrder; ++order) freeLists[order].head = nullptr;
-    freePages = 0;
+    const int zone = zoneOf(index);
+    Page& page = pages[index];
+
+    setHead(index, order, true);
+    page.next = NO_PAGE;
+    page.prev = chunk.tails[zone][order];
+
+    if (chunk.tails[zone][order] != NO_PAGE) pages[chunk.tails[zone][order]].next = static_cast<uint32_t>(index);
+    else chunk.heads[zone][order] = static_cast<uint32_t>(index);
+
+    chunk.tails[zone][order] = static_cast<uint32_t>(index);
+    chunk.freePages[zone] += 1ULL << order;
+}
 
-    uint64_t i = 0;
-    while (i < totalPages)
+constexpr uint64_t MAX_INIT_CHUNKS = 256, MIN_INIT_CHUNK_PAGES = 1ULL << 15;
+
+InitChunk initChunks[MAX_INIT_CHUNKS] = {};
+uint64_t initChunkPages = 0;
+
+void initChunk(const uint64_t chunkIndex, void*)
+{
+    InitChunk& chunk = initChunks[chunkIndex];
+    memset(chunk.heads, 0xFF, sizeof(chunk.heads));
+    memset(chunk.tails, 0xFF, sizeof(chunk.tails));
+    memset(chunk.freePages, 0, sizeof(chunk.freePages));
+
+    const uint64_t first = chunkIndex * initChunkPages;
+    const uint64_t last = first + initChunkPages < totalPages ? first + initChunkPages : totalPages;
+    memset(&pages[first], 0, (last - first) * sizeof(Page));
+
+    for (size_t r = 0; r < freeRangeCount; ++r)
     {
-        if (!(freeMask[i / 8] & (1u << (i % 8))))
+        uint64_t index = freeRanges[r].start > first ? freeRanges[r].start : first;
+        const uint64_t end = freeRanges[r].end < last ? freeRanges[r].end : last;
+
+        while (index < end)
         {
-            ++i;
-            continue;
+            const int order = largestBlockOrder(index, end);
+            chunkAdd(chunk, index, order);
+            index += 1ULL << order;
         }
+    }
+}
+
+void buildInitialFreeLists()
+{
+    memset(freeLists, 0xFF, sizeof(freeLists));
 
-        int best = 0;
-        for (int order = maxOrder; order >= 0; --order)
+    const uint64_t blockPages = 1ULL << maxOrder;
+    initChunkPages = Alignment::alignUp((totalPages + MAX_INIT_CHUNKS - 1) / MAX_INIT_CHUNKS, blockPages);
+    if (initChunkPages < MIN_INIT_CHUNK_PAGES) initChunkPages = Alignment::alignUp(MIN_INIT_CHUNK_PAGES, blockPages);
+
+    const uint64_t chunks = (totalPages + initChunkPages - 1) / initChunkPages;
+    SMP::bootParallel(initChunk, nullptr, chunks);
+
+    uint32_t tails[ZONE_COUNT][MAX_WANTED_ORDER + 1];
+    memset(tails, 0xFF, sizeof(tails));
+
+    for (uint64_t c = 0; c < chunks; ++c)
+    {
+        const InitChunk& chunk = initChunks[c];
+
+        for (int zone = 0; zone < ZONE_COUNT; ++zone)
         {
-            const uint64_t blockPages = 1ULL << order;
-            if ((i & (blockPages - 1)) != 0 || i + blockPages > totalPages) continue;
+            zoneFreePages[zone] += chunk.freePages[zone];
 
-            bool ok = true;
-            for (uint64_t j = 0; j < blockPages; ++j)
-                if (!(freeMask[(i + j) / 8] & (1u << ((i + j) % 8))))
+            for (int order = 0; order <= maxOrder; ++order)
+            {
+                if (chunk.heads[zone][order] == NO_PAGE) continue;
+
+                if (tails[zone][order] != NO_PAGE)
                 {
-                    ok = false;
-                    break;
+                    pages[tails[zone][order]].next = chunk.heads[zone][order];
+                    pages[chunk.heads[zone][order]].prev = tails[zone][order];
                 }
+                else freeLists[zone][order] = chunk.heads[zone][order];
 
-            if (ok)
-            {
-                best = order;
-                break;
+                tails[zone][order] = chunk.tails[zone][order];
             }
         }
+    }
+}
+
+void releaseBlock(const uint64_t index, const int order)
+{
+    int currentOrder = order;
+    uint64_t headIndex = index;
+
+    while (currentOrder < maxOrder)
+    {
+        const uint64_t i = headIndex ^ (1ULL << currentOrder);
+        if (i >= totalPages || !isFreeHead(i, currentOrder)) break;
+
+        listRemove(currentOrder, i);
+        pages[i > headIndex ? i : headIndex].state = 0;
+
+        headIndex = i < headIndex ? i : headIndex;
+        ++currentOrder;
+    }
+
+    setHead(headIndex, currentOrder, true);
+    listAdd(currentOrder, headIndex);
+    zoneFreePages[zoneOf(index)] += 1ULL << order;
+    if (currentOrder > order) Stats::add(Stats::BUDDY_MERGES, static_cast<uint64_t>(currentOrder - order));
+}
+
+uint64_t takeBlock(const int zone, int currentOrder, const uint64_t index, const int order)
+{
+    listRemove(currentOrder, index);
+    if (currentOrder > order) Stats::add(Stats::BUDDY_SPLITS, static_cast<uint64_t>(currentOrder - order));
+
+    while (currentOrder > order)
+    {
+        --currentOrder;
 
-        setBlockState(i, best, true, false);
-        listAdd(best, &pages[i]);
-        freePages += 1ULL << best;
-        i += 1ULL << best;
+        const uint64_t i = index + (1ULL << currentOrder);
+        setHead(i, currentOrder, true);
+        listAdd(currentOrder, i);
     }
+
+    setHead(index, order, false);
+    zoneFreePages[zone] -= 1ULL << order;
+
+    return addressFromIndex(index);
 }
 
-void setFreeBit(uint8_t* mask, const uint64_t index, const bool isFree)
+uint64_t allocFromZone(const int zone, const int order)
 {
-    const uint64_t byteIndex = index / 8;
-    const auto bitMask = static_cast<uint8_t>(1u << (index % 8));
+    int currentOrder = order;
+    while (currentOrder <= maxOrder && freeLists[zone][currentOrder] == NO_PAGE) ++currentOrder;
+    if (currentOrder > maxOrder) return 0;
 
-    if (isFree) mask[byteIndex] |= bitMask;
-    else mask[byteIndex] &= static_cast<uint8_t>(~bitMask);
+    return takeBlock(zone, currentOrder, freeLists[zone][currentOrder], order);
+}
+
+uint64_t allocFromZoneBelow(const int zone, const int order, const uint64_t limitIndex)
+{
+    for (int currentOrder = order; currentOrder <= maxOrder; ++currentOrder)
+        for (uint32_t index = freeLists[zone][currentOrder]; index != NO_PAGE; index = pages[index].next)
+            if (index + (1ULL << order) <= limitIndex) return takeBlock(zone, currentOrder, index, order);
+
+    return 0;
+}
+
+bool dma32FallbackAllowed(const int order)
+{
+    if (!zoneManagedPages[static_cast<int>(BuddyAllocator::Zone::NORMAL)]) return true;
+    return zoneFreePages[static_cast<int>(BuddyAllocator::Zone::DMA32)] >= DMA32_RESERVE_PAGES + (1ULL << order);
+}
+
+void addFreeRange(uint64_t start, uint64_t end)
+{
+    if (start < MIN_BUDDY_ADDRESS) start = MIN_BUDDY_ADDRESS;
+    start = Alignment::alignUp(start, FrameAllocator::SMALL_SIZE);
+    end = Alignment::alignDown(end, FrameAllocator::SMALL_SIZE);
+    if (end <= start) return;
+
+    if (freeRangeCount >= MAX_FREE_RANGES)
+    {
+        Serial::printf("BuddyAllocator: Too many usable ranges, ignoring 0x%lx-0x%lx\n", start, end);
+        return;
+    }
+
+    freeRanges[freeRangeCount++] = {indexFromAddress(start), indexFromAddress(end)};
+}
+
+uint64_t releaseRange(const uint64_t start, const uint64_t end)
+{
+    const uint64_t first = indexFromAddress(Alignment::alignUp(start < MIN_BUDDY_ADDRESS ? MIN_BUDDY_ADDRESS : start,
+                                                               FrameAllocator::SMALL_SIZE));
+    uint64_t last = indexFromAddress(Alignment::alignDown(end, FrameAllocator::SMALL_SIZE));
+    if (last > totalPages) last = totalPages;
+
+    uint64_t released = 0;
+    for (uint64_t index = first; index < last;)
+    {
+        const int order = largestBlockOrder(index, last);
+        releaseBlock(index, order);
+
+        zoneManagedPages[zoneOf(index)] += 1ULL << order;
+        released += 1ULL << order;
+        index += 1ULL << order;
+    }
+
+    managedPages += released;
+    return released;
 }
 
 bool BuddyAllocator::init()
 {
     LockGuard guard(buddyLock);
 
-    buddyBase = FrameAllocator::baseAddress();
-    buddySize = FrameAllocator::size();
-
-    if (buddyBase == 0 || buddySize < FrameAllocator::SMALL_SIZE)
+    uint64_t highest = 0;
+    for (size_t i = 0; i < memmap_request.response->entry_count; ++i)
     {
-        Serial::printf("BuddyAllocator: No memory available for buddy allocator\n");
-        return false;
+        const auto* e = memmap_request.response->entries[i];
+        if (e->type != LIMINE_MEMMAP_USABLE && e->type != LIMINE_MEMMAP_BOOTLOADER_RECLAIMABLE) continue;
+        if (e->base + e->length > highest) highest = e->base + e->length;
     }
 
-    const uint64_t alignedBase = Alignment::alignUp(buddyBase, FrameAllocator::SMALL_SIZE),
-                   alignedEnd = Alignment::alignDown(buddyBase + buddySize, FrameAllocator::SMALL_SIZE);
-    if (alignedEnd <= alignedBase)
+    totalPages = Alignment::alignDown(highest, FrameAllocator::SMALL_SIZE) / FrameAllocator::SMALL_SIZE;
+    if (totalPages >= NO_PAGE)
+    {
+        Serial::printf("BuddyAllocator: Limiting managed memory to %lu pages\n", static_cast<uint64_t>(NO_PAGE - 1));
+        totalPages = NO_PAGE - 1;
+    }
+    if (totalPages == 0)
     {
-        Serial::printf("BuddyAllocator: Region too small after alignment\n");
+        Serial::printf("BuddyAllocator: No memory available for buddy allocator\n");
         return false;
     }
 
-    buddyBase = alignedBase;
-    buddySize = alignedEnd - alignedBase;
-    totalPages = buddySize / FrameAllocator::SMALL_SIZE;
-    freePages = 0;
-
     int maxPossible = 0;
     while ((1ULL << (maxPossible + 1)) <= totalPages) ++maxPossible;
     maxOrder = MAX_WANTED_ORDER < maxPossible ? MAX_WANTED_ORDER : maxPossible;
 
-    const uint64_t pagesBytes = totalPages * sizeof(Page),
-                   listsBytes = static_cast<uint64_t>(maxOrder + 1) * sizeof(FreeList),
-                   metaPages = (Alignment::alignUp(pagesBytes, FrameAllocator::SMALL_SIZE) +
-                           Alignment::alignUp(listsBytes, FrameAllocator::SMALL_SIZE) +
-                           Alignment::alignUp((totalPages + 7) / 8, FrameAllocator::SMALL_SIZE)) /
-                       FrameAllocator::SMALL_SIZE;
-    if (metaPages >= totalPages)
+    const uint64_t metaPages = Alignment::alignUp(totalPages * sizeof(Page), FrameAllocator::SMALL_SIZE) /
+        FrameAllocator::SMALL_SIZE;
+    void* meta = FrameAllocator::allocEarly(metaPages);
+    if (!meta)
     {
-        Serial::printf("BuddyAllocator: Not enough space for metadata\n");
+        Serial::printf("BuddyAllocator: Failed to allocate %lu contiguous frames for metadata\n", metaPages);
         return false;
     }
 
-    uint64_t metaPhys = 0;
-    for (uint64_t i = 0; i < metaPages; ++i)
-    {
-        void* f = FrameAllocator::alloc();
-        if (!f)
-        {
-            Serial::printf("BuddyAllocator: Failed to allocate frame for metadata\n");
-            return false;
-        }
+    pages = reinterpret_cast<Page*>(reinterpret_cast<uint64_t>(meta) + hhdm_request.response->offset);
 
-        if (i == 0) metaPhys = reinterpret_cast<uint64_t>(f);
-        else if (reinterpret_cast<uint64_t>(f) != metaPhys + i * FrameAllocator::SMALL_SIZE)
-        {
-            Serial::printf("BuddyAllocator: Metadata frames are not contiguous\n");
-            return false;
-        }
+    freeRangeCount = 0;
+    for (size_t i = 0; i < memmap_request.response->entry_count; ++i)
+    {
+        const auto* e = memmap_request.response->entries[i];
+        if (e->type == LIMINE_MEMMAP_USABLE) addFreeRange(e->base + FrameAllocator::earlyUsed(i), e->base + e->length);
     }
 
-    const uint64_t metaVirtBase = metaPhys + hhdm_request.response->offset;
-    pages = reinterpret_cast<Page*>(metaVirtBase);
-    freeLists = reinterpret_cast<FreeList*>(metaVirtBase + Alignment::alignUp(pagesBytes, FrameAllocator::SMALL_SIZE));
-    memset(pages, 0, totalPages * sizeof(Page));
-    memset(freeLists, 0, (maxOrder + 1) * sizeof(FreeList));
-
-    const auto isFree = reinterpret_cast<uint8_t*>(metaVirtBase +
-        Alignment::alignUp(pagesBytes, FrameAllocator::SMALL_SIZE) +
-        Alignment::alignUp(listsBytes, FrameAllocator::SMALL_SIZE));
-    memset(isFree, 0, (totalPages + 7) / 8);
+    buildInitialFreeLists();
 
-    for (size_t i = 0; i < totalPages; ++i)
+    for (size_t i = 0; i < memmap_request.response->entry_count; ++i)
     {
-        if (i < metaPages)
-        {
-            setFreeBit(isFree, i, false);
-            continue;
-        }
-        setFreeBit(isFree, i, !FrameAllocator::used(reinterpret_cast<void*>(addressFromIndex(i))));
+        const auto* e = memmap_request.response->entries[i];
+        if (e->type != LIMINE_MEMMAP_USABLE) continue;
+
+        for (uint64_t p = 0; p < FrameAllocator::earlyUsed(i); p += FrameAllocator::SMALL_SIZE)
+            if (const uint64_t index = indexFromAddress(e->base + p); index < totalPages) setHead(index, 0, false);
     }
 
-    for (uint64_t i = 0; i < metaPages; ++i)
+    for (int zone = 0; zone < ZONE_COUNT; ++zone) zoneManagedPages[zone] = zoneFreePages[zone];
+    managedPages = zoneFreePages[0] + zoneFreePages[1];
+    for (size_t i = 0; i < memmap_request.response->entry_count; ++i)
+        if (memmap_request.response->entries[i]->type == LIMINE_MEMMAP_USABLE)
+            managedPages += FrameAllocator::earlyUsed(i) / FrameAllocator::SMALL_SIZE;
+
+    __atomic_store_n(&buddyReady, true, __ATOMIC_RELEASE);
+    return true;
+}
+
+bool BuddyAllocator::isReady() { return __atomic_load_n(&buddyReady, __ATOMIC_ACQUIRE); }
+
+uint64_t BuddyAllocator::reclaimBootloaderMemory(const uint64_t keepAddress)
+{
+    if (!isReady()) return 0;
+    LockGuard guard(buddyLock);
+
+    uint64_t reclaimed = 0;
+    for (size_t i = 0; i < memmap_request.response->entry_count; ++i)
     {
-        auto& page = pages[i];
-        page.reserved = true;
-        page.free = false;
-        page.head = false;
-        page.order = 0;
+        const auto* e = memmap_request.response->entries[i];
+        if (e->type != LIMINE_MEMMAP_BOOTLOADER_RECLAIMABLE) continue;
+        if (keepAddress >= e->base && keepAddress < e->base + e->length) continue;
+
+        reclaimed += releaseRange(e->base, e->base + e->length);
     }
 
-    buildInitialFreeLists(isFree);
-    return true;
+    return reclaimed;
 }
 
-uint64_t BuddyAllocator::alloc(const int order)
+uint64_t BuddyAllocator::addMemory(const uint64_t start, const uint64_t end)
 {
-    if (order < 0 || order > maxOrder || !freePages || !freeLists) return 0;
+    if (!isReady() || end <= start) return 0;
     LockGuard guard(buddyLock);
 
-    int currentOrder = order;
-    while (currentOrder <= maxOrder && !freeLists[currentOrder].head) ++currentOrder;
-    if (currentOrder > maxOrder) return 0;
+    return releaseRange(start, end);
+}
 
-    Page* block = freeLists[currentOrder].head;
-    listRemove(currentOrder, block);
+uint64_t allocFromZones(const int order, const AllocFlags flags)
+{
+    constexpr int dma32 = static_cast<int>(BuddyAllocator::Zone::DMA32);
+    constexpr int normal = static_cast<int>(BuddyAllocator::Zone::NORMAL);
+    LockGuard guard(buddyLock);
 
-    const uint64_t index = block - pages;
-    while (currentOrder > order)
-    {
-        --currentOrder;
+    if ((flags & AllocFlags::DMA32) != AllocFlags::NONE) return allocFromZone(dma32, order);
+    if (const uint64_t address = allocFromZone(normal, order)) return address;
 
-        const uint64_t i = index + (1ULL << currentOrder);
-        setBlockState(i, currentOrder, true, false);
+    return dma32FallbackAllowed(order) ? allocFromZone(dma32, order) : 0;
+}
 
-        Page* buddy = &pages[i];
-        buddy->order = static_cast<uint16_t>(currentOrder);
-        buddy->head = true;
-        buddy->free = true;
-        buddy->reserved = false;
+uint64_t BuddyAllocator::alloc(const int order, const AllocFlags flags)
+{
+    if (order < 0 || order > maxOrder || !isReady()) return 0;
 
-        listAdd(currentOrder, buddy);
-        setBlockState(index, currentOrder, true, false);
+    const bool zeroed = (flags & AllocFlags::ZEROED) != AllocFlags::NONE;
+    uint64_t address = 0;
+    if (zeroed && order == 0 && (flags & AllocFlags::DMA32) == AllocFlags::NONE) address = ZeroPool::take();
+
+    if (!address)
+    {
+        address = allocFromZones(order, flags);
+        if (!address && ZeroPool::drain()) address = allocFromZones(order, flags);
+        if (!address && BuddyAllocator::reclaim(1ULL << order)) address = allocFromZones(order, flags);
+        if (address && zeroed) ZeroPool::zeroPages(address, 1ULL << order);
     }
 
-    setBlockState(index, order, false, false);
-    Page* head = &pages[index];
-    head->head = true;
-    head->free = false;
-    head->reserved = false;
-    head->order = static_cast<uint16_t>(order);
+    Trace::point(Trace::Event::BUDDY_ALLOC, address, static_cast<uint64_t>(order), static_cast<uint32_t>(flags));
+    if (address) Stats::add(Stats::BUDDY_ALLOCS);
+    return address;
+}
 
-    freePages -= 1ULL << order;
-    return addressFromIndex(index);
+uint64_t BuddyAllocator::allocBelow(const int order, const uint64_t limit)
+{
+    if (order < 0 || order > maxOrder || !isReady()) return 0;
+    if (limit >= addressFromIndex(totalPages)) return alloc(order);
+    if (limit == DMA32_LIMIT) return alloc(order, AllocFlags::DMA32);
+
+    LockGuard guard(buddyLock);
+    const uint64_t limitIndex = indexFromAddress(limit);
+
+    if (limit > DMA32_LIMIT)
+        if (const uint64_t address = allocFromZoneBelow(static_cast<int>(Zone::NORMAL), order, limitIndex))
+            return address;
+
+    return allocFromZoneBelow(static_cast<int>(Zone::DMA32), order, limitIndex);
 }
 
 void BuddyAllocator::free(const uint64_t address, const int order)
 {
-    if (!address || order < 0) return;
+    if (!address || order < 0 || !isReady()) return;
     LockGuard guard(buddyLock);
 
-    if (!pages || !freeLists || address < buddyBase || address >= buddyBase + buddySize ||
-        (address - buddyBase) % FrameAllocator::SMALL_SIZE != 0 || order > maxOrder)
+    if (address % FrameAllocator::SMALL_SIZE != 0 || indexFromAddress(address) >= totalPages || order > maxOrder)
         return;
 
     const uint64_t index = indexFromAddress(address);
-    if (pages[index].reserved || pages[index].free || !pages[index].head ||
-        pages[index].order != static_cast<uint16_t>(order))
-        return;
+    if (pages[index].state != (PAGE_HEAD | static_cast<uint8_t>(order))) return;
 
-    int currentOrder = order;
-    uint64_t headIndex = index;
+    releaseBlock(index, order);
+    Trace::point(Trace::Event::BUDDY_FREE, address, static_cast<uint64_t>(order));
+    Stats::add(Stats::BUDDY_FREES);
+}
 
-    while (currentOrder < maxOrder)
-    {
-        if ((headIndex & ((1ULL << currentOrder) - 1)) != 0) break;
-        const uint64_t i = headIndex ^ (1ULL << currentOrder);
-        if (i >= totalPages || (i & ((1ULL << currentOrder) - 1)) != 0) break;
+bool BuddyAllocator::registerReclaimer(const Reclaimer reclaimer)
+{
+    if (!reclaimer) return false;
+    LockGuard guard(buddyLock);
 
-        Page& buddy = pages[i];
-        if (!buddy.free || !buddy.head || buddy.reserved || buddy.order != static_cast<uint16_t>(currentOrder)) break;
+    if (reclaimerCount >= MAX_RECLAIMERS) return false;
+    reclaimers[reclaimerCount] = reclaimer;
+    __atomic_store_n(&reclaimerCount, reclaimerCount + 1, __ATOMIC_RELEASE);
 
-        listRemove(currentOrder, &buddy);
-        headIndex = i < headIndex ? i : headIndex;
-        ++currentOrder;
-    }
+    return true;
+}
 
-    setBlockState(headIndex, currentOrder, true, false);
-    Page* head = &pages[headIndex];
-    head->order = static_cast<uint16_t>(currentOrder);
-    head->head = true;
-    head->free = true;
-    head->reserved = false;
+uint64_t BuddyAllocator::reclaim(const uint64_t pages)
+{
+    uint64_t released = 0;
+    for (uint32_t i = 0; i < __atomic_load_n(&reclaimerCount, __ATOMIC_ACQUIRE) && released < pages; ++i)
+        released += reclaimers[i](pages - released);
 
-    listAdd(currentOrder, head);
-    freePages += 1ULL << order;
+    return released;
 }
+
+int BuddyAllocator::getMaxOrder() { return maxOrder; }
+uint64_t BuddyAllocator::getTotalPages() { return managedPages; }
+uint64_t BuddyAllocator::getFreePages() { return zoneFreePages[0] + zoneFreePages[1]; }
+uint64_t BuddyAllocator::getFreePages(const Zone zone) { return zoneFreePages[static_cast<int>(zone)]; }
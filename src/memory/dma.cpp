@@ -0,0 +1,66 @@
+#include <core/limine.h>
+#include <drivers/serial.h>
+#include <memory/buddy.h>
+#include <memory/dma.h>
+#include <memory/paging.h>
+
+extern limine_hhdm_request hhdm_request;
+
+bool isPowerOfTwo(const uint64_t value) { return value && !(value & (value - 1)); }
+
+bool DMA::alloc(const uint64_t size, const Constraints& constraints, Buffer& buffer)
+{
+    buffer = {};
+    if (size == 0) return false;
+
+    if (!isPowerOfTwo(constraints.alignment) || (constraints.boundary && !isPowerOfTwo(constraints.boundary)))
+    {
+        Serial::printf("DMA: Alignment 0x%lx and boundary 0x%lx must be powers of two\n", constraints.alignment,
+                       constraints.boundary);
+        return false;
+    }
+
+    const uint64_t need = size > constraints.alignment ? size : constraints.alignment;
+    int order = 0;
+    while ((FrameAllocator::SMALL_SIZE << order) < need) ++order;
+
+    const uint64_t blockSize = FrameAllocator::SMALL_SIZE << order;
+    if (order > BuddyAllocator::getMaxOrder() || (constraints.boundary && blockSize > constraints.boundary))
+    {
+        Serial::printf("DMA: Cannot satisfy %lu bytes (alignment 0x%lx, boundary 0x%lx)\n", size,
+                       constraints.alignment, constraints.boundary);
+        return false;
+    }
+
+    const uint64_t limit = constraints.maxAddress == ~0ULL ? ~0ULL : constraints.maxAddress + 1;
+    const uint64_t physical = BuddyAllocator::allocBelow(order, limit);
+    if (!physical)
+    {
+        Serial::printf("DMA: Out of memory for %lu bytes below 0x%lx\n", size, limit);
+        return false;
+    }
+
+    buffer.physical = physical;
+    buffer.size = size;
+    buffer.order = order;
+    buffer.virt = reinterpret_cast<void*>(physical + hhdm_request.response->offset);
+
+    return true;
+}
+
+bool DMA::allocCoherent(const uint64_t size, Buffer& buffer, const uint64_t maxAddress)
+{
+    Constraints constraints;
+    constraints.maxAddress = maxAddress;
+
+    if (!alloc(size, constraints, buffer)) return false;
+
+    memset(buffer.virt, 0, size);
+    return true;
+}
+
+void DMA::free(Buffer& buffer)
+{
+    if (buffer.physical && buffer.order >= 0) BuddyAllocator::free(buffer.physical, buffer.order);
+    buffer = {};
+}
@@ -0,0 +1,872 @@
+#include <arch/x86_64/cpu.h>
+#include <arch/x86_64/isr.h>
+#include <arch/x86_64/tsc.h>
+#include <core/limine.h>
+#include <core/stats.h>
+#include <drivers/serial.h>
+#include <memory/buddy.h>
+#include <memory/pagecache.h>
+#include <memory/paging.h>
+#include <memory/slab.h>
+#include <task/scheduler.h>
+
+struct PageCacheNode
+{
+    void* slots[PageCache::RADIX_SLOTS];
+    uint64_t present, dirty;
+};
+
+constexpr int PAGE_CACHE_WRITEBACK_PRIORITY = 2;
+constexpr uint8_t PAGE_CACHE_BUSY = PageCache::DIRTY | PageCache::LOCKED | PageCache::WRITEBACK;
+
+extern limine_hhdm_request hhdm_request;
+extern Scheduler::Scheduler schedulers[SMP::MAX_CPUS];
+
+Spinlock pageCacheLruLock, pageCacheMappingLock, pageCacheBlockLock;
+PageCache::Page* pageCacheHand = nullptr;
+PageCache::Mapping* pageCacheMappings = nullptr;
+PageCache::Mapping pageCacheBlockMappings[Block::MAX_DEVICES];
+bool pageCacheBlockMapped[Block::MAX_DEVICES] = {};
+uint64_t pageCacheLruCount = 0, pageCacheDirtyCount = 0;
+SlabCache *pageCachePageSlab = nullptr, *pageCacheNodeSlab = nullptr;
+Stats::Id pageCacheHits = Stats::INVALID, pageCacheMisses = Stats::INVALID, pageCacheReadahead = Stats::INVALID,
+          pageCacheWritten = Stats::INVALID, pageCacheEvicted = Stats::INVALID;
+bool pageCacheReady = false;
+
+void pageCacheCount(const Stats::Id id, const uint64_t delta = 1)
+{
+    if (id != Stats::INVALID) Stats::add(id, delta);
+}
+
+uint8_t* pageCacheData(const PageCache::Page* page)
+{
+    return reinterpret_cast<uint8_t*>(page->physical + hhdm_request.response->offset);
+}
+
+uint32_t pageCacheSlot(const uint64_t index, const uint32_t level)
+{
+    return static_cast<uint32_t>(index >> (level * PageCache::RADIX_SHIFT)) & (PageCache::RADIX_SLOTS - 1);
+}
+
+bool pageCacheFits(const uint32_t height, const uint64_t index)
+{
+    return height && (height * PageCache::RADIX_SHIFT >= 64 || index >> (height * PageCache::RADIX_SHIFT) == 0);
+}
+
+PageCacheNode* pageCacheNewNode()
+{
+    auto* node = static_cast<PageCacheNode*>(SlabAllocator::cacheAlloc(pageCacheNodeSlab));
+    if (node) memset(node, 0, sizeof(PageCacheNode));
+
+    return node;
+}
+
+bool pageCacheWalk(const PageCache::Mapping& mapping, const uint64_t index, PageCacheNode** path)
+{
+    if (!pageCacheFits(mapping.height, index)) return false;
+
+    auto* node = static_cast<PageCacheNode*>(mapping.root);
+    for (uint32_t level = mapping.height; level-- > 0;)
+    {
+        path[level] = node;
+        if (level && !(node = static_cast<PageCacheNode*>(node->slots[pageCacheSlot(index, level)]))) return false;
+    }
+
+    return true;
+}
+
+PageCache::Page* pageCacheLookup(const PageCache::Mapping& mapping, const uint64_t index)
+{
+    PageCacheNode* path[PageCache::MAX_HEIGHT];
+    if (!pageCacheWalk(mapping, index, path)) return nullptr;
+
+    return static_cast<PageCache::Page*>(path[0]->slots[pageCacheSlot(index, 0)]);
+}
+
+bool pageCacheInsert(PageCache::Mapping& mapping, const uint64_t index, PageCache::Page* page)
+{
+    while (!pageCacheFits(mapping.height, index))
+    {
+        PageCacheNode* node = pageCacheNewNode();
+        if (!node) return false;
+
+        if (auto* root = static_cast<PageCacheNode*>(mapping.root))
+        {
+            node->slots[0] = root;
+            node->present = 1;
+            node->dirty = root->dirty ? 1 : 0;
+        }
+
+        mapping.root = node;
+        ++mapping.height;
+    }
+
+    auto* node = static_cast<PageCacheNode*>(mapping.root);
+    for (uint32_t level = mapping.height - 1; level; --level)
+    {
+        const uint32_t slot = pageCacheSlot(index, level);
+        if (!node->slots[slot])
+        {
+            if (!(node->slots[slot] = pageCacheNewNode())) return false;
+            node->present |= 1ULL << slot;
+        }
+
+        node = static_cast<PageCacheNode*>(node->slots[slot]);
+    }
+
+    const uint32_t slot = pageCacheSlot(index, 0);
+    if (node->slots[slot]) return false;
+
+    node->slots[slot] = page;
+    node->present |= 1ULL << slot;
+    return true;
+}
+
+void pageCacheErase(PageCache::Mapping& mapping, const uint64_t index)
+{
+    PageCacheNode* path[PageCache::MAX_HEIGHT];
+    if (!pageCacheWalk(mapping, index, path)) return;
+
+    for (uint32_t level = 0; level < mapping.height; ++level)
+    {
+        PageCacheNode* node = path[level];
+        const uint32_t slot = pageCacheSlot(index, level);
+        node->slots[slot] = nullptr;
+        node->present &= ~(1ULL << slot);
+        node->dirty &= ~(1ULL << slot);
+        if (node->present) return;
+
+        SlabAllocator::free(node);
+    }
+
+    mapping.root = nullptr;
+    mapping.height = 0;
+}
+
+void pageCacheTag(PageCache::Mapping& mapping, const uint64_t index, const bool dirty)
+{
+    PageCacheNode* path[PageCache::MAX_HEIGHT];
+    if (!pageCacheWalk(mapping, index, path)) return;
+
+    for (uint32_t level = 0; level < mapping.height; ++level)
+    {
+        const uint64_t bit = 1ULL << pageCacheSlot(index, level);
+        if (dirty) path[level]->dirty |= bit;
+        else if (path[level]->dirty &= ~bit) return;
+    }
+}
+
+PageCache::Page* pageCacheFind(const PageCacheNode* node, const uint32_t level, const uint64_t base,
+                               const uint64_t from, const bool dirty)
+{
+    const uint32_t shift = level * PageCache::RADIX_SHIFT;
+    const uint64_t first = from > base ? (from - base) >> shift : 0;
+    uint64_t slots = (dirty ? node->dirty : node->present) & (first < 64 ? ~0ULL << first : 0);
+
+    while (slots)
+    {
+        const uint32_t slot = __builtin_ctzll(slots);
+        slots &= slots - 1;
+
+        if (!level) return static_cast<PageCache::Page*>(node->slots[slot]);
+
+        const uint64_t childBase = base + (static_cast<uint64_t>(slot) << shift);
+        if (PageCache::Page* page = pageCacheFind(static_cast<const PageCacheNode*>(node->slots[slot]), level - 1,
+                                                  childBase, from > childBase ? from : childBase, dirty))
+            return page;
+    }
+
+    return nullptr;
+}
+
+PageCache::Page* pageCacheFirst(const PageCache::Mapping& mapping, const uint64_t from, const bool dirty)
+{
+    if (!pageCacheFits(mapping.height, from)) return nullptr;
+    return pageCacheFind(static_cast<const PageCacheNode*>(mapping.root), mapping.height - 1, 0, from, dirty);
+}
+
+void pageCacheLruAdd(PageCache::Page* page)
+{
+    if (!pageCacheHand)
+    {
+        page->lruNext = page->lruPrev = page;
+        pageCacheHand = page;
+    }
+    else
+    {
+        page->lruNext = pageCacheHand;
+        page->lruPrev = pageCacheHand->lruPrev;
+        pageCacheHand->lruPrev->lruNext = page;
+        pageCacheHand->lruPrev = page;
+    }
+
+    ++pageCacheLruCount;
+}
+
+void pageCacheLruRemove(PageCache::Page* page)
+{
+    if (page->lruNext == page) pageCacheHand = nullptr;
+    else
+    {
+        page->lruPrev->lruNext = page->lruNext;
+        page->lruNext->lruPrev = page->lruPrev;
+        if (pageCacheHand == page) pageCacheHand = page->lruNext;
+    }
+
+    page->lruNext = page->lruPrev = nullptr;
+    --pageCacheLruCount;
+}
+
+void pageCacheFreePage(PageCache::Page* page)
+{
+    BuddyAllocator::free(page->physical, 0);
+    SlabAllocator::free(page);
+}
+
+PageCache::Page* pageCacheGrab(PageCache::Mapping& mapping, const uint64_t index)
+{
+    LockGuard guard(mapping.lock);
+    PageCache::Page* page = pageCacheLookup(mapping, index);
+    if (page) __atomic_add_fetch(&page->refs, 1, __ATOMIC_RELAXED);
+
+    return page;
+}
+
+PageCache::Page* pageCacheCreate(PageCache::Mapping& mapping, const uint64_t index, const bool reference,
+                                 bool& created)
+{
+    created = false;
+    if (PageCache::Page* page = reference ? pageCacheGrab(mapping, index) : nullptr) return page;
+
+    const uint64_t physical = BuddyAllocator::alloc(0);
+    if (!physical) return nullptr;
+
+    auto* fresh = static_cast<PageCache::Page*>(SlabAllocator::cacheAlloc(pageCachePageSlab));
+    if (!fresh)
+    {
+        BuddyAllocator::free(physical, 0);
+        return nullptr;
+    }
+
+    memset(fresh, 0, sizeof(PageCache::Page));
+    fresh->mapping = &mapping;
+    fresh->index = index;
+    fresh->physical = physical;
+    fresh->refs = reference;
+    fresh->flags = PageCache::LOCKED;
+
+    PageCache::Page* page;
+    {
+        LockGuard guard(mapping.lock);
+        if ((page = pageCacheLookup(mapping, index)))
+        {
+            if (reference) __atomic_add_fetch(&page->refs, 1, __ATOMIC_RELAXED);
+        }
+        else if (pageCacheInsert(mapping, index, fresh))
+        {
+            ++mapping.pageCount;
+            LockGuard lruGuard(pageCacheLruLock, false);
+            pageCacheLruAdd(fresh);
+
+            created = true;
+            return fresh;
+        }
+    }
+
+    pageCacheFreePage(fresh);
+    return reference ? page : nullptr;
+}
+
+void pageCacheWait(PageCache::Mapping& mapping)
+{
+    if (mapping.ops->poll) mapping.ops->poll(&mapping);
+
+    if (Interrupt::interruptsEnabled()) Task::taskYield();
+    else asm volatile ("pause");
+}
+
+uint64_t pageCacheLastIndex(const PageCache::Mapping& mapping)
+{
+    return (mapping.size + FrameAllocator::SMALL_SIZE - 1) / FrameAllocator::SMALL_SIZE;
+}
+
+void pageCacheStartReads(PageCache::Mapping& mapping, const uint64_t start, uint64_t count, const uint64_t marker)
+{
+    const uint64_t end = pageCacheLastIndex(mapping);
+    if (start >= end) return;
+    if (count > end - start) count = end - start;
+
+    PageCache::Page* batch[PageCache::IO_BATCH];
+    uint32_t batchCount = 0, started = 0;
+
+    for (uint64_t index = start; index < start + count; ++index)
+    {
+        bool created;
+        PageCache::Page* page = pageCacheCreate(mapping, index, false, created);
+        if (!created) continue;
+
+        if (index == marker) __atomic_or_fetch(&page->flags, PageCache::READAHEAD, __ATOMIC_RELAXED);
+        batch[batchCount++] = page;
+        ++started;
+
+        if (batchCount == PageCache::IO_BATCH)
+        {
+            mapping.ops->readPages(&mapping, batch, batchCount);
+            batchCount = 0;
+        }
+    }
+
+    if (batchCount) mapping.ops->readPages(&mapping, batch, batchCount);
+    pageCacheCount(pageCacheReadahead, started);
+}
+
+void pageCacheReadaheadMiss(PageCache::Mapping& mapping, const uint64_t index, uint64_t requested)
+{
+    if (requested > PageCache::READAHEAD_MAX_PAGES) requested = PageCache::READAHEAD_MAX_PAGES;
+
+    uint64_t size;
+    {
+        LockGuard guard(mapping.lock);
+        if (index == mapping.readaheadNext && mapping.readaheadSize) size = mapping.readaheadSize * 2;
+        else if (index == mapping.lastRead) size = PageCache::READAHEAD_MIN_PAGES;
+        else size = requested;
+
+        if (size > PageCache::READAHEAD_MAX_PAGES) size = PageCache::READAHEAD_MAX_PAGES;
+        if (size < requested) size = requested;
+
+        mapping.readaheadSize = size > requested ? size : 0;
+        mapping.readaheadNext = index + size;
+    }
+
+    pageCacheStartReads(mapping, index, size, size > requested ? index + requested : UINT64_MAX);
+}
+
+void pageCacheReadaheadAsync(PageCache::Mapping& mapping)
+{
+    uint64_t start, size;
+    {
+        LockGuard guard(mapping.lock);
+        size = mapping.readaheadSize * 2;
+        if (size < PageCache::READAHEAD_MIN_PAGES) size = PageCache::READAHEAD_MIN_PAGES;
+        if (size > PageCache::READAHEAD_MAX_PAGES) size = PageCache::READAHEAD_MAX_PAGES;
+
+        start = mapping.readaheadNext;
+        mapping.readaheadSize = size;
+        mapping.readaheadNext = start + size;
+    }
+
+    pageCacheStartReads(mapping, start, size, start);
+}
+
+bool pageCacheUptodate(PageCache::Mapping& mapping, PageCache::Page* page)
+{
+    bool issued = false;
+
+    while (true)
+    {
+        const uint8_t flags = __atomic_load_n(&page->flags, __ATOMIC_ACQUIRE);
+        if (flags & PageCache::UPTODATE) return true;
+        if (flags & PageCache::LOCKED)
+        {
+            pageCacheWait(mapping);
+            continue;
+        }
+
+        if (issued) return false;
+        if (__atomic_fetch_or(&page->flags, PageCache::LOCKED, __ATOMIC_ACQ_REL) & PageCache::LOCKED) continue;
+
+        __atomic_and_fetch(&page->flags, static_cast<uint8_t>(~PageCache::ERROR), __ATOMIC_RELAXED);
+        mapping.ops->readPages(&mapping, &page, 1);
+        issued = true;
+    }
+}
+
+PageCache::Page* pageCacheGet(PageCache::Mapping& mapping, const uint64_t index, const uint64_t requested)
+{
+    PageCache::Page* page = pageCacheGrab(mapping, index);
+    if (page) pageCacheCount(pageCacheHits);
+    else
+    {
+        pageCacheCount(pageCacheMisses);
+        pageCacheReadaheadMiss(mapping, index, requested);
+
+        bool created;
+        if (!(page = pageCacheCreate(mapping, index, true, created))) return nullptr;
+        if (created) mapping.ops->readPages(&mapping, &page, 1);
+    }
+
+    if (__atomic_fetch_and(&page->flags, static_cast<uint8_t>(~PageCache::READAHEAD), __ATOMIC_RELAXED) &
+        PageCache::READAHEAD)
+        pageCacheReadaheadAsync(mapping);
+
+    if (pageCacheUptodate(mapping, page))
+    {
+        __atomic_or_fetch(&page->flags, PageCache::REFERENCED, __ATOMIC_RELAXED);
+        return page;
+    }
+
+    PageCache::putPage(page);
+    return nullptr;
+}
+
+void pageCacheMarkDirty(PageCache::Mapping& mapping, PageCache::Page* page)
+{
+    LockGuard guard(mapping.lock);
+    if (__atomic_fetch_or(&page->flags, PageCache::DIRTY, __ATOMIC_ACQ_REL) & PageCache::DIRTY) return;
+
+    page->dirtySince = TSC::read();
+    ++mapping.dirtyCount;
+    __atomic_add_fetch(&pageCacheDirtyCount, 1, __ATOMIC_RELAXED);
+    pageCacheTag(mapping, page->index, true);
+}
+
+uint64_t pageCacheWriteback(PageCache::Mapping& mapping, const uint64_t olderThan)
+{
+    uint64_t cursor = 0, written = 0;
+
+    while (true)
+    {
+        PageCache::Page* batch[PageCache::IO_BATCH];
+        uint32_t count = 0;
+        {
+            LockGuard guard(mapping.lock);
+            while (count < PageCache::IO_BATCH)
+            {
+                PageCache::Page* page = pageCacheFirst(mapping, cursor, true);
+                if (!page) break;
+
+                cursor = page->index + 1;
+                if (page->dirtySince > olderThan) continue;
+                if (__atomic_load_n(&page->flags, __ATOMIC_ACQUIRE) & PageCache::WRITEBACK) continue;
+
+                __atomic_and_fetch(&page->flags, static_cast<uint8_t>(~PageCache::DIRTY), __ATOMIC_RELAXED);
+                __atomic_or_fetch(&page->flags, PageCache::WRITEBACK, __ATOMIC_RELEASE);
+                pageCacheTag(mapping, page->index, false);
+
+                --mapping.dirtyCount;
+                __atomic_sub_fetch(&pageCacheDirtyCount, 1, __ATOMIC_RELAXED);
+                __atomic_add_fetch(&mapping.writebackCount, 1, __ATOMIC_RELAXED);
+                batch[count++] = page;
+            }
+        }
+
+        if (!count) return written;
+
+        mapping.ops->writePages(&mapping, batch, count);
+        pageCacheCount(pageCacheWritten, count);
+        written += count;
+    }
+}
+
+uint64_t pageCacheReclaim(const uint64_t pages)
+{
+    return PageCache::shrink(pages < PageCache::IO_BATCH ? PageCache::IO_BATCH : pages);
+}
+
+void pageCacheWritebackMain(void*)
+{
+    while (true)
+    {
+        Task::taskSleep(PageCache::WRITEBACK_INTERVAL_MS);
+
+        const uint64_t now = TSC::read(), expire = TSC::getFrequency() / 1000 * PageCache::DIRTY_EXPIRE_MS;
+        const uint64_t olderThan = PageCache::getDirtyPages() > PageCache::DIRTY_LIMIT_PAGES ? UINT64_MAX
+                                   : now > expire                                             ? now - expire
+                                                                                              : 0;
+        if (olderThan)
+        {
+            LockGuard guard(pageCacheMappingLock);
+            for (PageCache::Mapping* mapping = pageCacheMappings; mapping; mapping = mapping->next)
+                if (__atomic_load_n(&mapping->dirtyCount, __ATOMIC_RELAXED)) pageCacheWriteback(*mapping, olderThan);
+        }
+
+        if (const uint64_t freePages = BuddyAllocator::getFreePages(); freePages < PageCache::LOW_FREE_PAGES)
+            PageCache::shrink(PageCache::HIGH_FREE_PAGES - freePages);
+    }
+}
+
+bool PageCache::init()
+{
+    if (pageCacheReady) return true;
+
+    pageCachePageSlab = SlabAllocator::createCache("pagecache-page", sizeof(Page), alignof(Page));
+    pageCacheNodeSlab = SlabAllocator::createCache("pagecache-node", sizeof(PageCacheNode), alignof(PageCacheNode));
+    if (!pageCachePageSlab || !pageCacheNodeSlab)
+    {
+        Serial::printf("PageCache: Failed to create slab caches\n");
+        return false;
+    }
+
+    pageCacheHits = Stats::registerCounter("pagecache_hits");
+    pageCacheMisses = Stats::registerCounter("pagecache_misses");
+    pageCacheReadahead = Stats::registerCounter("pagecache_readahead");
+    pageCacheWritten = Stats::registerCounter("pagecache_writeback");
+    pageCacheEvicted = Stats::registerCounter("pagecache_evictions");
+    Stats::registerGauge("pagecache_pages", getCachedPages);
+    Stats::registerGauge("pagecache_dirty", getDirtyPages);
+
+    Task::Task* task = Task::taskCreate(pageCacheWritebackMain, nullptr, PAGE_CACHE_WRITEBACK_PRIORITY);
+    if (!task)
+    {
+        Serial::printf("PageCache: Failed to create write-back task\n");
+        return false;
+    }
+
+    BuddyAllocator::registerReclaimer(pageCacheReclaim);
+    __atomic_store_n(&pageCacheReady, true, __ATOMIC_RELEASE);
+    Scheduler::addReady(&schedulers[CPUManager::getCurrentCPUId()], task);
+
+    return true;
+}
+
+bool PageCache::initMapping(Mapping* mapping, const Operations* ops, void* data, const uint64_t size)
+{
+    if (!mapping || !ops || !ops->readPages || !__atomic_load_n(&pageCacheReady, __ATOMIC_ACQUIRE)) return false;
+
+    mapping->root = nullptr;
+    mapping->height = 0;
+    mapping->size = size;
+    mapping->pageCount = mapping->dirtyCount = mapping->writebackCount = 0;
+    mapping->readaheadNext = mapping->readaheadSize = mapping->lastRead = 0;
+    mapping->writeError = false;
+    mapping->ops = ops;
+    mapping->data = data;
+
+    LockGuard guard(pageCacheMappingLock);
+    mapping->next = pageCacheMappings;
+    pageCacheMappings = mapping;
+
+    return true;
+}
+
+void PageCache::releaseMapping(Mapping* mapping)
+{
+    if (!mapping || !mapping->ops) return;
+    if (mapping->ops->writePages) sync(mapping);
+
+    {
+        LockGuard guard(pageCacheMappingLock);
+        for (Mapping** link = &pageCacheMappings; *link; link = &(*link)->next)
+            if (*link == mapping)
+            {
+                *link = mapping->next;
+                break;
+            }
+    }
+
+    while (true)
+    {
+        Page* page;
+        {
+            LockGuard guard(mapping->lock);
+            if (!(page = pageCacheFirst(*mapping, 0, false))) break;
+
+            if (!(__atomic_load_n(&page->flags, __ATOMIC_ACQUIRE) & (LOCKED | WRITEBACK)))
+            {
+                if (__atomic_load_n(&page->flags, __ATOMIC_RELAXED) & DIRTY)
+                {
+                    --mapping->dirtyCount;
+                    __atomic_sub_fetch(&pageCacheDirtyCount, 1, __ATOMIC_RELAXED);
+                }
+
+                pageCacheErase(*mapping, page->index);
+                --mapping->pageCount;
+
+                LockGuard lruGuard(pageCacheLruLock, false);
+                pageCacheLruRemove(page);
+            }
+            else page = nullptr;
+        }
+
+        if (page) pageCacheFreePage(page);
+        else pageCacheWait(*mapping);
+    }
+
+    mapping->ops = nullptr;
+}
+
+PageCache::Page* PageCache::getPage(Mapping* mapping, const uint64_t index)
+{
+    if (!mapping || !mapping->ops || index >= pageCacheLastIndex(*mapping)) return nullptr;
+    return pageCacheGet(*mapping, index, 1);
+}
+
+void PageCache::putPage(Page* page)
+{
+    if (page) __atomic_sub_fetch(&page->refs, 1, __ATOMIC_RELEASE);
+}
+
+void PageCache::endIo(Page* page, const bool ok)
+{
+    const uint8_t flags = __atomic_load_n(&page->flags, __ATOMIC_ACQUIRE);
+    if (flags & LOCKED)
+    {
+        __atomic_or_fetch(&page->flags, ok ? UPTODATE : ERROR, __ATOMIC_RELEASE);
+        __atomic_and_fetch(&page->flags, static_cast<uint8_t>(~LOCKED), __ATOMIC_RELEASE);
+    }
+    else if (flags & WRITEBACK)
+    {
+        Mapping* mapping = page->mapping;
+        if (!ok) __atomic_store_n(&mapping->writeError, true, __ATOMIC_RELAXED);
+
+        __atomic_and_fetch(&page->flags, static_cast<uint8_t>(~WRITEBACK), __ATOMIC_RELEASE);
+        __atomic_sub_fetch(&mapping->writebackCount, 1, __ATOMIC_RELEASE);
+    }
+}
+
+uint64_t PageCache::read(Mapping* mapping, const uint64_t offset, void* buffer, uint64_t length)
+{
+    if (!mapping || !mapping->ops || !buffer || offset >= mapping->size) return 0;
+    if (length > mapping->size - offset) length = mapping->size - offset;
+
+    auto* out = static_cast<uint8_t*>(buffer);
+    uint64_t done = 0;
+
+    while (done < length)
+    {
+        const uint64_t position = offset + done, index = position / FrameAllocator::SMALL_SIZE,
+                       last = (offset + length - 1) / FrameAllocator::SMALL_SIZE;
+        const uint64_t pageOffset = position % FrameAllocator::SMALL_SIZE;
+        uint64_t chunk = FrameAllocator::SMALL_SIZE - pageOffset;
+        if (chunk > length - done) chunk = length - done;
+
+        Page* page = pageCacheGet(*mapping, index, last - index + 1);
+        if (!page) break;
+
+        memcpy(out + done, pageCacheData(page) + pageOffset, chunk);
+        putPage(page);
+        done += chunk;
+    }
+
+    if (done) __atomic_store_n(&mapping->lastRead, (offset + done - 1) / FrameAllocator::SMALL_SIZE + 1,
+                               __ATOMIC_RELAXED);
+    return done;
+}
+
+uint64_t PageCache::write(Mapping* mapping, const uint64_t offset, const void* buffer, uint64_t length)
+{
+    if (!mapping || !mapping->ops || !mapping->ops->writePages || !buffer || offset >= mapping->size) return 0;
+    if (length > mapping->size - offset) length = mapping->size - offset;
+
+    const auto* in = static_cast<const uint8_t*>(buffer);
+    uint64_t done = 0;
+
+    while (done < length)
+    {
+        const uint64_t position = offset + done, index = position / FrameAllocator::SMALL_SIZE;
+        const uint64_t pageOffset = position % FrameAllocator::SMALL_SIZE;
+        uint64_t chunk = FrameAllocator::SMALL_SIZE - pageOffset;
+        if (chunk > length - done) chunk = length - done;
+
+        bool created;
+        Page* page = pageCacheCreate(*mapping, index, true, created);
+        if (!page) break;
+
+        const bool whole = !pageOffset && (chunk == FrameAllocator::SMALL_SIZE || position + chunk == mapping->size);
+        if (created && whole)
+        {
+            memset(pageCacheData(page) + chunk, 0, FrameAllocator::SMALL_SIZE - chunk);
+            __atomic_or_fetch(&page->flags, UPTODATE, __ATOMIC_RELEASE);
+            __atomic_and_fetch(&page->flags, static_cast<uint8_t>(~LOCKED), __ATOMIC_RELEASE);
+        }
+        else if (created) mapping->ops->readPages(mapping, &page, 1);
+
+        if (!pageCacheUptodate(*mapping, page))
+        {
+            putPage(page);
+            break;
+        }
+
+        memcpy(pageCacheData(page) + pageOffset, in + done, chunk);
+        __atomic_or_fetch(&page->flags, REFERENCED, __ATOMIC_RELAXED);
+        pageCacheMarkDirty(*mapping, page);
+        putPage(page);
+        done += chunk;
+    }
+
+    if (getDirtyPages() > DIRTY_LIMIT_PAGES) pageCacheWriteback(*mapping, UINT64_MAX);
+    return done;
+}
+
+bool PageCache::sync(Mapping* mapping)
+{
+    if (!mapping || !mapping->ops || !mapping->ops->writePages) return false;
+
+    do
+    {
+        pageCacheWriteback(*mapping, UINT64_MAX);
+        while (__atomic_load_n(&mapping->writebackCount, __ATOMIC_ACQUIRE)) pageCacheWait(*mapping);
+    } while (__atomic_load_n(&mapping->dirtyCount, __ATOMIC_RELAXED));
+
+    const bool flushed = !mapping->ops->flush || mapping->ops->flush(mapping);
+    return !__atomic_exchange_n(&mapping->writeError, false, __ATOMIC_ACQ_REL) && flushed;
+}
+
+bool PageCache::syncAll()
+{
+    bool ok = true;
+
+    while (true)
+    {
+        uint64_t outstanding = 0;
+        {
+            LockGuard guard(pageCacheMappingLock);
+            for (Mapping* mapping = pageCacheMappings; mapping; mapping = mapping->next)
+            {
+                if (!mapping->ops->writePages) continue;
+
+                pageCacheWriteback(*mapping, UINT64_MAX);
+                outstanding += __atomic_load_n(&mapping->writebackCount, __ATOMIC_ACQUIRE);
+                if (__atomic_exchange_n(&mapping->writeError, false, __ATOMIC_ACQ_REL)) ok = false;
+            }
+        }
+
+        if (!outstanding) break;
+
+        for (uint32_t i = 0; i < Block::getDeviceCount(); ++i) Block::poll(Block::getDevice(i));
+        if (Interrupt::interruptsEnabled()) Task::taskYield();
+        else asm volatile ("pause");
+    }
+
+    for (uint32_t i = 0; i < Block::MAX_DEVICES; ++i)
+        if (__atomic_load_n(&pageCacheBlockMapped[i], __ATOMIC_ACQUIRE) && pageCacheBlockMappings[i].ops->flush)
+            ok &= pageCacheBlockMappings[i].ops->flush(&pageCacheBlockMappings[i]);
+
+    return ok;
+}
+
+uint64_t PageCache::shrink(const uint64_t pages)
+{
+    uint64_t freed = 0;
+
+    while (freed < pages)
+    {
+        Page* victims[IO_BATCH];
+        uint32_t count = 0;
+        {
+            LockGuard guard(pageCacheLruLock);
+            for (uint64_t scan = pageCacheLruCount * 2; scan && pageCacheHand && count < IO_BATCH &&
+                                                        freed + count < pages; --scan)
+            {
+                Page* page = pageCacheHand;
+                pageCacheHand = page->lruNext;
+
+                const uint8_t flags = __atomic_load_n(&page->flags, __ATOMIC_ACQUIRE);
+                if (flags & REFERENCED)
+                {
+                    __atomic_and_fetch(&page->flags, static_cast<uint8_t>(~REFERENCED), __ATOMIC_RELAXED);
+                    continue;
+                }
+
+                if (flags & PAGE_CACHE_BUSY || __atomic_load_n(&page->refs, __ATOMIC_ACQUIRE)) continue;
+
+                Mapping* mapping = page->mapping;
+                if (!mapping->lock.tryLock()) continue;
+
+                if (!(__atomic_load_n(&page->flags, __ATOMIC_ACQUIRE) & PAGE_CACHE_BUSY) &&
+                    !__atomic_load_n(&page->refs, __ATOMIC_ACQUIRE))
+                {
+                    pageCacheErase(*mapping, page->index);
+                    --mapping->pageCount;
+                    pageCacheLruRemove(page);
+                    victims[count++] = page;
+                }
+
+                mapping->lock.unlock();
+            }
+        }
+
+        if (!count) break;
+
+        for (uint32_t i = 0; i < count; ++i) pageCacheFreePage(victims[i]);
+        pageCacheCount(pageCacheEvicted, count);
+        freed += count;
+    }
+
+    return freed;
+}
+
+uint64_t PageCache::getCachedPages() { return __atomic_load_n(&pageCacheLruCount, __ATOMIC_RELAXED); }
+
+uint64_t PageCache::getDirtyPages() { return __atomic_load_n(&pageCacheDirtyCount, __ATOMIC_RELAXED); }
+
+void pageCacheBlockDone(Block::Request* request)
+{
+    PageCache::endIo(static_cast<PageCache::Page*>(request->context), request->status == Block::Status::OK);
+    Block::freeRequest(request);
+}
+
+void pageCacheBlockIo(PageCache::Mapping* mapping, PageCache::Page** pages, const uint32_t count, const Block::Op op)
+{
+    constexpr uint32_t sectorsPerPage = FrameAllocator::SMALL_SIZE / Block::SECTOR_SIZE;
+    auto* device = static_cast<Block::Device*>(mapping->data);
+    Block::Plug plug;
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        Block::Request* request = Block::allocRequest();
+        if (!request)
+        {
+            PageCache::endIo(pages[i], false);
+            continue;
+        }
+
+        const uint64_t sector = pages[i]->index * sectorsPerPage;
+        request->device = device;
+        request->op = op;
+        request->sector = sector;
+        request->sectors = device->sectors - sector < sectorsPerPage ? static_cast<uint32_t>(device->sectors - sector)
+                                                                     : sectorsPerPage;
+        request->buffer = pageCacheData(pages[i]);
+        request->callback = pageCacheBlockDone;
+        request->context = pages[i];
+        Block::plug(plug, request);
+    }
+
+    Block::unplug(plug);
+}
+
+void pageCacheBlockRead(PageCache::Mapping* mapping, PageCache::Page** pages, const uint32_t count)
+{
+    pageCacheBlockIo(mapping, pages, count, Block::Op::READ);
+}
+
+void pageCacheBlockWrite(PageCache::Mapping* mapping, PageCache::Page** pages, const uint32_t count)
+{
+    pageCacheBlockIo(mapping, pages, count, Block::Op::WRITE);
+}
+
+void pageCacheBlockPoll(PageCache::Mapping* mapping) { Block::poll(static_cast<Block::Device*>(mapping->data)); }
+
+bool pageCacheBlockFlush(PageCache::Mapping* mapping)
+{
+    return Block::transfer(static_cast<Block::Device*>(mapping->data), Block::Op::FLUSH, 0, 0, nullptr) ==
+           Block::Status::OK;
+}
+
+constexpr PageCache::Operations pageCacheBlockOps = {pageCacheBlockRead, pageCacheBlockWrite, pageCacheBlockPoll,
+                                                     pageCacheBlockFlush},
+                                pageCacheBlockReadOnlyOps = {pageCacheBlockRead, nullptr, pageCacheBlockPoll, nullptr};
+
+PageCache::Mapping* PageCache::blockMapping(Block::Device* device)
+{
+    for (uint32_t i = 0; i < Block::getDeviceCount(); ++i)
+    {
+        if (Block::getDevice(i) != device) continue;
+        if (__atomic_load_n(&pageCacheBlockMapped[i], __ATOMIC_ACQUIRE)) return &pageCacheBlockMappings[i];
+
+        LockGuard guard(pageCacheBlockLock);
+        if (!pageCacheBlockMapped[i])
+        {
+            const Operations* ops = device->readOnly ? &pageCacheBlockReadOnlyOps : &pageCacheBlockOps;
+            if (!initMapping(&pageCacheBlockMappings[i], ops, device, device->sectors * Block::SECTOR_SIZE))
+                return nullptr;
+
+            __atomic_store_n(&pageCacheBlockMapped[i], true, __ATOMIC_RELEASE);
+        }
+
+        return &pageCacheBlockMappings[i];
+    }
+
+    return nullptr;
+}
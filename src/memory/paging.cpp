@@ -1,6 +1,8 @@
 #include <core/limine.h>
 #include <core/panic.h>
+#include <core/stats.h>
 #include <drivers/serial.h>
+#include <memory/buddy.h>
 #include <memory/paging.h>
 
 extern limine_framebuffer_request framebuffer_request;
@@ -8,23 +10,29 @@ extern limine_memmap_request memmap_request;
 extern limine_hhdm_request hhdm_request;
 extern limine_executable_address_request executable_addr_request;
 extern uint8_t _text_start[], _text_end[], _rodata_start[], _rodata_end[], __data_start[], __data_end[], __bss_start[],
-               __bss_end[];
+               __bss_end[], __ksymtab_start[], __ksymtab_end[];
+
+constexpr size_t MAX_EARLY_ENTRIES = 256;
 
 Spinlock pagingLock, frameAllocatorLock;
-uint64_t memoryBase = 0, memorySize = 0, totalFrames = 0, usedFrames = 0, next = 0, *bitmap = nullptr, *pml4 = nullptr;
+uint64_t *pml4 = nullptr, earlyConsumed[MAX_EARLY_ENTRIES] = {};
+size_t earlyEntryCount = 0;
 bool pagingInitialized = false;
 
-void invlpg(const uint64_t address) { if (pagingInitialized) asm volatile ("invlpg (%0)" :: "r"(address) : "memory"); }
+void invlpg(const uint64_t address)
+{
+    if (!pagingInitialized) return;
+
+    asm volatile ("invlpg (%0)" :: "r"(address) : "memory");
+    Stats::add(Stats::TLB_FLUSHES);
+}
 
 uint64_t* createPageTable()
 {
-    void* frame = FrameAllocator::alloc();
+    void* frame = FrameAllocator::alloc(AllocFlags::ZEROED);
     if (!frame) return nullptr;
 
-    const auto address = reinterpret_cast<uint64_t*>(reinterpret_cast<uint64_t>(frame) + hhdm_request.response->offset);
-    memset(address, 0, FrameAllocator::SMALL_SIZE);
-
-    return address;
+    return reinterpret_cast<uint64_t*>(reinterpret_cast<uint64_t>(frame) + hhdm_request.response->offset);
 }
 
 uint64_t* ensureTable(uint64_t* parent, const uint16_t index, const PageFlags flags)
@@ -191,22 +199,6 @@ void unmapLarge(const uint64_t virtualAddress)
     if (tableEmpty(pdpt)) freeTable(pml4, static_cast<uint16_t>(pml4Index));
 }
 
-void reserve(void* frame)
-{
-    const auto phys = reinterpret_cast<uint64_t>(frame);
-    if (phys < memoryBase || phys >= memoryBase + memorySize || (phys - memoryBase) % FrameAllocator::SMALL_SIZE != 0)
-        return;
-
-    const uint64_t index = (phys - memoryBase) / FrameAllocator::SMALL_SIZE;
-    auto& word = bitmap[index / 64];
-
-    if (const uint64_t mask = 1ULL << (index % 64); !(word & mask))
-    {
-        word |= mask;
-        ++usedFrames;
-    }
-}
-
 bool Paging::init()
 {
     pml4 = createPageTable();
@@ -251,6 +243,15 @@ bool Paging::init()
         return false;
     }
 
+    if (const auto ksymtabVirt = reinterpret_cast<uint64_t>(__ksymtab_start);
+        !map(ksymtabVirt, ksymtabVirt - kernelDelta, reinterpret_cast<uint64_t>(__ksymtab_end) - ksymtabVirt,
+             PageFlags::PRESENT | PageFlags::GLOBAL | PageFlags::NO_EXECUTE))
+    {
+        Serial::printf("Paging: Failed to map ksymtab page at 0x%lx to 0x%lx\n", ksymtabVirt,
+                       ksymtabVirt - kernelDelta);
+        return false;
+    }
+
     for (size_t i = 0; i < memmap_request.response->entry_count; ++i)
     {
         const auto* e = memmap_request.response->entries[i];
@@ -261,6 +262,13 @@ bool Paging::init()
             Panic::panic("Failed to map physical memory page at 0x%lx\n", e->base + hhdm_request.response->offset);
     }
 
+    enable();
+    pagingInitialized = true;
+    return true;
+}
+
+void Paging::enable()
+{
     asm volatile ("mov %0, %%cr3" :: "r"(reinterpret_cast<uint64_t>(pml4) - hhdm_request.response->offset) : "memory");
     uint64_t cr4;
     asm volatile ("mov %%cr4, %0" : "=r"(cr4));
@@ -274,9 +282,6 @@ bool Paging::init()
     asm volatile ("mov %%cr0, %0" : "=r"(cr0));
     cr0 |= 1 << 31 | 1 << 16;
     asm volatile ("mov %0, %%cr0" :: "r"(cr0));
-
-    pagingInitialized = true;
-    return true;
 }
 
 bool Paging::map(uint64_t virtualAddress, uint64_t physicalAddress, uint64_t size, const PageFlags flags)
@@ -349,124 +354,109 @@ void Paging::unmap(const uint64_t virtualAddress, const uint64_t size)
     }
 }
 
-bool FrameAllocator::init()
+uint64_t Paging::translate(const uint64_t virtualAddress)
 {
-    LockGuard guard(frameAllocatorLock);
-    uint64_t bestBase = 0, bestSize = 0;
+    LockGuard guard(pagingLock);
+    constexpr uint64_t present = static_cast<uint64_t>(PageFlags::PRESENT), huge = static_cast<uint64_t>(PageFlags::HUGE),
+                       addressMask = 0x000FFFFFFFFFF000ULL;
 
-    for (size_t i = 0; i < memmap_request.response->entry_count; ++i)
-    {
-        const auto* entry = memmap_request.response->entries[i];
-        if (entry->type != LIMINE_MEMMAP_USABLE || entry->base < 0x100000) continue;
-        if (entry->length > bestSize)
-        {
-            bestBase = entry->base;
-            bestSize = entry->length;
-        }
-    }
+    const uint64_t pml4Entry = pml4[virtualAddress >> 39 & 0x1FF];
+    if (!(pml4Entry & present)) return 0;
 
-    if (bestBase == 0 || bestSize == 0)
-    {
-        Serial::printf("Paging: No memory region for frame allocator\n");
-        return false;
-    }
+    const auto* pdpt = reinterpret_cast<const uint64_t*>(hhdm_request.response->offset + (pml4Entry & addressMask));
+    const uint64_t pdptEntry = pdpt[virtualAddress >> 30 & 0x1FF];
+    if (!(pdptEntry & present)) return 0;
+    if (pdptEntry & huge) return (pdptEntry & addressMask & ~0x3FFFFFFFULL) | (virtualAddress & 0x3FFFFFFFULL);
 
-    const uint64_t total = bestSize / SMALL_SIZE, bitmapBytes = (total + 63) / 64 * sizeof(uint64_t),
-                   bitmapPages = (bitmapBytes + SMALL_SIZE - 1) / SMALL_SIZE, bitmapPhys = bestBase;
-    bitmap = reinterpret_cast<uint64_t*>(hhdm_request.response->offset + bitmapPhys);
-    memset(bitmap, 0, bitmapPages * SMALL_SIZE);
+    const auto* pd = reinterpret_cast<const uint64_t*>(hhdm_request.response->offset + (pdptEntry & addressMask));
+    const uint64_t pdEntry = pd[virtualAddress >> 21 & 0x1FF];
+    if (!(pdEntry & present)) return 0;
+    if (pdEntry & huge) return (pdEntry & addressMask & ~0x1FFFFFULL) | (virtualAddress & 0x1FFFFFULL);
 
-    memoryBase = bestBase + bitmapPages * SMALL_SIZE;
-    memorySize = bestSize - bitmapPages * SMALL_SIZE;
-    totalFrames = memorySize / SMALL_SIZE;
-    usedFrames = 0;
+    const auto* pt = reinterpret_cast<const uint64_t*>(hhdm_request.response->offset + (pdEntry & addressMask));
+    const uint64_t ptEntry = pt[virtualAddress >> 12 & 0x1FF];
+    if (!(ptEntry & present)) return 0;
 
-    for (size_t i = 0; i < memmap_request.response->entry_count; ++i)
-    {
-        const auto* e = memmap_request.response->entries[i];
-        if (e->length == 0) continue;
-        if (e->type == LIMINE_MEMMAP_USABLE) continue;
+    return (ptEntry & addressMask) | (virtualAddress & 0xFFF);
+}
 
-        uint64_t start = e->base, end = e->base + e->length;
-        if (end <= memoryBase || start >= memoryBase + memorySize) continue;
-        if (start < memoryBase) start = memoryBase;
-        if (end > memoryBase + memorySize) end = memoryBase + memorySize;
+bool FrameAllocator::init()
+{
+    LockGuard guard(frameAllocatorLock);
 
-        start = (start + SMALL_SIZE - 1) & ~(SMALL_SIZE - 1);
-        end = end & ~(SMALL_SIZE - 1);
+    earlyEntryCount = memmap_request.response->entry_count;
+    if (earlyEntryCount > MAX_EARLY_ENTRIES) earlyEntryCount = MAX_EARLY_ENTRIES;
+    memset(earlyConsumed, 0, sizeof(earlyConsumed));
 
-        for (uint64_t p = start; p < end; p += SMALL_SIZE) reserve(reinterpret_cast<void*>(p));
+    for (size_t i = 0; i < earlyEntryCount; ++i)
+    {
+        const auto* e = memmap_request.response->entries[i];
+        if (e->type == LIMINE_MEMMAP_USABLE && e->base >= 0x100000 && e->length >= SMALL_SIZE) return true;
     }
 
-    for (uint64_t i = 0; i < bitmapPages; ++i) reserve(reinterpret_cast<void*>(bitmapPhys + i * SMALL_SIZE));
-    return true;
+    Serial::printf("Paging: No memory region for frame allocator\n");
+    return false;
 }
 
-void* FrameAllocator::alloc()
+void* FrameAllocator::allocEarly(const uint64_t count)
 {
+    if (count == 0 || BuddyAllocator::isReady()) return nullptr;
     LockGuard guard(frameAllocatorLock);
 
-    const uint64_t words = (totalFrames + 63) / 64;
-    uint64_t w = next / 64;
-
-    for (uint64_t pass = 0; pass < 2; ++pass)
+    for (size_t i = 0; i < earlyEntryCount; ++i)
     {
-        for (; w < words; ++w)
-        {
-            const uint64_t used = bitmap[w];
-            uint64_t freeMask = ~used;
-
-            if (w == words - 1)
-                if (const uint64_t validBits = totalFrames - (words - 1) * 64; validBits < 64)
-                    freeMask &= (1ULL << validBits) - 1;
-            if (!freeMask) continue;
+        const auto* e = memmap_request.response->entries[i];
+        if (e->type != LIMINE_MEMMAP_USABLE || e->base < 0x100000) continue;
 
-            const uint64_t bit1 = __builtin_ctzll(freeMask) + 1;
-            if (bit1 == 0) continue;
-            bitmap[w] = used | (1ULL << (bit1 - 1));
-            ++usedFrames;
+        const uint64_t base = Alignment::alignUp(e->base, SMALL_SIZE), end = Alignment::alignDown(e->base + e->length,
+            SMALL_SIZE);
+        if (base + earlyConsumed[i] + count * SMALL_SIZE > end) continue;
 
-            const uint64_t frameIndex = w * 64 + (bit1 - 1);
-            next = frameIndex + 1;
+        const uint64_t frame = base + earlyConsumed[i];
+        earlyConsumed[i] += count * SMALL_SIZE;
 
-            return reinterpret_cast<void*>(memoryBase + frameIndex * SMALL_SIZE);
-        }
-        w = 0;
+        return reinterpret_cast<void*>(frame);
     }
 
-    Serial::printf("Paging: Out of memory in FrameAllocator! Used: %lu, Total: %lu\n", usedFrames, totalFrames);
+    Serial::printf("Paging: Out of early memory allocating %lu frames\n", count);
     return nullptr;
 }
 
-void FrameAllocator::free(void* frame)
+uint64_t FrameAllocator::earlyUsed(const size_t entryIndex)
 {
-    LockGuard guard(frameAllocatorLock);
+    if (entryIndex >= earlyEntryCount || !earlyConsumed[entryIndex]) return 0;
+
+    const auto* e = memmap_request.response->entries[entryIndex];
+    return Alignment::alignUp(e->base, SMALL_SIZE) - e->base + earlyConsumed[entryIndex];
+}
 
-    const auto phys = reinterpret_cast<uint64_t>(frame);
-    if (phys < memoryBase || phys >= memoryBase + memorySize || (phys - memoryBase) % SMALL_SIZE != 0) return;
+void* FrameAllocator::alloc(const AllocFlags flags)
+{
+    if (!BuddyAllocator::isReady())
+    {
+        void* frame = allocEarly(1);
+        if (frame && (flags & AllocFlags::ZEROED) != AllocFlags::NONE)
+            memset(reinterpret_cast<void*>(reinterpret_cast<uint64_t>(frame) + hhdm_request.response->offset), 0,
+                   SMALL_SIZE);
 
-    const uint64_t index = (phys - memoryBase) / SMALL_SIZE;
-    auto& word = bitmap[index / 64];
+        return frame;
+    }
 
-    if (const uint64_t mask = 1ULL << (index % 64); word & mask)
+    const uint64_t frame = BuddyAllocator::alloc(0, flags);
+    if (!frame)
     {
-        word &= ~mask;
-        --usedFrames;
+        Serial::printf("Paging: Out of memory in FrameAllocator! Free: %lu, Total: %lu\n",
+                       BuddyAllocator::getFreePages(), BuddyAllocator::getTotalPages());
+        return nullptr;
     }
+
+    return reinterpret_cast<void*>(frame);
 }
 
-bool FrameAllocator::used(void* frame)
+void FrameAllocator::free(void* frame)
 {
-    LockGuard guard(frameAllocatorLock);
-
-    const auto phys = reinterpret_cast<uint64_t>(frame);
-    if (phys < memoryBase || phys >= memoryBase + memorySize || (phys - memoryBase) % SMALL_SIZE != 0) return false;
-
-    const uint64_t index = (phys - memoryBase) / SMALL_SIZE;
-    return bitmap[index / 64] & 1ULL << (index % 64);
+    if (BuddyAllocator::isReady()) BuddyAllocator::free(reinterpret_cast<uint64_t>(frame), 0);
 }
 
-uint64_t FrameAllocator::usedCount() { return usedFrames; }
-uint64_t FrameAllocator::totalCount() { return totalFrames; }
-uint64_t FrameAllocator::baseAddress() { return memoryBase; }
-uint64_t FrameAllocator::size() { return memorySize; }
+uint64_t FrameAllocator::usedCount() { return BuddyAllocator::getTotalPages() - BuddyAllocator::getFreePages(); }
+uint64_t FrameAllocator::totalCount() { return BuddyAllocator::getTotalPages(); }
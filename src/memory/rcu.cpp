@@ -0,0 +1,47 @@
+#include <arch/x86_64/cpu.h>
+#include <arch/x86_64/isr.h>
+#include <memory/rcu.h>
+
+struct alignas(64) RcuCpuState
+{
+    uint64_t sequence;
+    uint32_t nesting;
+};
+
+RcuCpuState rcuCpus[SMP::MAX_CPUS] = {};
+
+RcuReadGuard::RcuReadGuard()
+{
+    asm volatile ("pushfq\npopq %0" : "=r"(rflags) :: "memory");
+    Interrupt::disableInterrupts();
+
+    cpuId = CPUManager::getCurrentCPUId();
+    RcuCpuState& state = rcuCpus[cpuId];
+    if (state.nesting++) return;
+
+    __atomic_store_n(&state.sequence, state.sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+RcuReadGuard::~RcuReadGuard()
+{
+    RcuCpuState& state = rcuCpus[cpuId];
+    if (!--state.nesting) __atomic_store_n(&state.sequence, state.sequence + 1, __ATOMIC_RELEASE);
+
+    asm volatile ("pushq %0\npopfq" :: "r"(rflags) : "memory");
+}
+
+void Rcu::synchronize()
+{
+    uint64_t snapshot[SMP::MAX_CPUS];
+    const uint32_t cpuCount = SMP::getCpuCount();
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    for (uint32_t i = 0; i < cpuCount; ++i) snapshot[i] = __atomic_load_n(&rcuCpus[i].sequence, __ATOMIC_ACQUIRE);
+
+    for (uint32_t i = 0; i < cpuCount; ++i)
+        if (snapshot[i] & 1)
+            while (__atomic_load_n(&rcuCpus[i].sequence, __ATOMIC_ACQUIRE) == snapshot[i]) asm volatile ("pause");
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
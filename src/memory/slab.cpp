@@ -1,4 +1,6 @@
 #include <core/limine.h>
+#include <core/stats.h>
+#include <core/trace.h>
 #include <core/utils.h>
 #include <drivers/serial.h>
 #include <memory/buddy.h>
@@ -35,14 +37,17 @@ struct BigHeader
 extern limine_hhdm_request hhdm_request;
 
 constexpr uint32_t SLAB_MAGIC = 0xDEADBEEF, BIG_MAGIC = 0xB16B00B5;
-constexpr size_t classes[] = {8, 16, 32, 64, 128, 256, 512, 1024, 2048, 4096},
+constexpr size_t classes[] = {8, 16, 32, 64, 128, 256, 512, 1024, 2048},
                  numClasses = sizeof(classes) / sizeof(classes[0]);
 constexpr const char* cacheNames[] = {
     "SlabCache-8", "SlabCache-16", "SlabCache-32", "SlabCache-64", "SlabCache-128", "SlabCache-256", "SlabCache-512",
-    "SlabCache-1024", "SlabCache-2048", "SlabCache-4096"
+    "SlabCache-1024", "SlabCache-2048"
 };
 
 SlabCache slabCaches[numClasses] = {};
+SlabCache dedicatedCaches[SlabAllocator::MAX_DEDICATED_CACHES] = {};
+uint32_t dedicatedCacheCount = 0;
+Spinlock dedicatedCacheLock;
 
 uint64_t virtualToPhysical(void* virt)
 {
@@ -163,7 +168,7 @@ bool SlabAllocator::init()
     {
         slabCaches[i].name = cacheNames[i];
         slabCaches[i].objectSize = classes[i];
-        slabCaches[i].alignment = 16;
+        slabCaches[i].alignment = classes[i];
         slabCaches[i].partial = nullptr;
     }
 
@@ -174,8 +179,20 @@ void* SlabAllocator::alloc(size_t size, size_t alignment)
 {
     if (size == 0) size = 1;
     if (alignment < 16) alignment = 16;
+    if (alignment >= FrameAllocator::SMALL_SIZE)
+    {
+        Serial::printf("SlabAllocator: Alignment %lu is too large, use BuddyAllocator instead\n", alignment);
+        return nullptr;
+    }
+
+    if (SlabCache* cache = findCache(size, alignment))
+    {
+        void* obj = allocateSlab(cache);
+        Trace::point(Trace::Event::SLAB_ALLOC, reinterpret_cast<uint64_t>(obj), size);
+        if (obj) Stats::add(static_cast<Stats::Id>(Stats::SLAB_ALLOCS + (cache - slabCaches)));
 
-    if (SlabCache* cache = findCache(size, alignment)) return allocateSlab(cache);
+        return obj;
+    }
 
     const size_t total = sizeof(BigHeader) + size + (alignment - 1);
     const int order = orderForSize(total);
@@ -189,12 +206,18 @@ void* SlabAllocator::alloc(size_t size, size_t alignment)
     header->order = static_cast<uint16_t>(order);
     header->objectSize = size;
 
-    return reinterpret_cast<void*>(Alignment::alignUp(reinterpret_cast<uint64_t>(base) + sizeof(BigHeader), alignment));
+    const uint64_t address = Alignment::alignUp(reinterpret_cast<uint64_t>(base) + sizeof(BigHeader), alignment);
+    Trace::point(Trace::Event::SLAB_ALLOC, address, size);
+    Stats::add(Stats::SLAB_ALLOCS + numClasses);
+
+    return reinterpret_cast<void*>(address);
 }
 
 void SlabAllocator::free(void* obj)
 {
     if (!obj) return;
+    Trace::point(Trace::Event::SLAB_FREE, reinterpret_cast<uint64_t>(obj));
+    Stats::add(Stats::SLAB_FREES);
 
     const uint64_t pageBase = Alignment::alignDown(reinterpret_cast<uint64_t>(obj), FrameAllocator::SMALL_SIZE);
     if (auto* slab = reinterpret_cast<SlabHeader*>(pageBase); slab->magic == SLAB_MAGIC && slab->cache)
@@ -212,6 +235,44 @@ void SlabAllocator::free(void* obj)
     Serial::printf("SlabAllocator: Attempted to free invalid pointer %p\n", obj);
 }
 
+SlabCache* SlabAllocator::createCache(const char* name, const size_t objectSize, size_t alignment)
+{
+    if (alignment < sizeof(void*)) alignment = sizeof(void*);
+    if (!objectSize || alignment & (alignment - 1)) return nullptr;
+
+    const size_t size = Alignment::alignUp(objectSize, alignment);
+    if (Alignment::alignUp(sizeof(SlabHeader), alignment) + size > FrameAllocator::SMALL_SIZE)
+    {
+        Serial::printf("SlabAllocator: Objects of %lu bytes are too large for cache %s\n", objectSize, name);
+        return nullptr;
+    }
+
+    LockGuard guard(dedicatedCacheLock);
+    if (dedicatedCacheCount >= MAX_DEDICATED_CACHES)
+    {
+        Serial::printf("SlabAllocator: Cache table full, cannot create %s\n", name);
+        return nullptr;
+    }
+
+    SlabCache* cache = &dedicatedCaches[dedicatedCacheCount++];
+    cache->name = name;
+    cache->objectSize = size;
+    cache->alignment = alignment;
+    cache->partial = nullptr;
+
+    return cache;
+}
+
+void* SlabAllocator::cacheAlloc(SlabCache* cache)
+{
+    if (!cache) return nullptr;
+
+    void* obj = allocateSlab(cache);
+    Trace::point(Trace::Event::SLAB_ALLOC, reinterpret_cast<uint64_t>(obj), cache->objectSize);
+
+    return obj;
+}
+
 size_t SlabAllocator::usableSize(void* obj)
 {
     if (!obj) return 0;
@@ -1,9 +1,18 @@
 #include <arch/x86_64/isr.h>
+#include <arch/x86_64/tsc.h>
+#include <core/trace.h>
 #include <memory/spinlock.h>
 
 Spinlock::Spinlock() : locked(0) {}
 
-void Spinlock::lock() { while (__atomic_test_and_set(&locked, __ATOMIC_ACQUIRE)) asm volatile ("pause"); }
+void Spinlock::lock()
+{
+    if (!__atomic_test_and_set(&locked, __ATOMIC_ACQUIRE)) return;
+
+    const uint64_t start = TSC::read();
+    while (__atomic_test_and_set(&locked, __ATOMIC_ACQUIRE)) asm volatile ("pause");
+    Trace::point(Trace::Event::LOCK_CONTENDED, reinterpret_cast<uint64_t>(this), TSC::read() - start);
+}
 void Spinlock::unlock() { __atomic_clear(&locked, __ATOMIC_RELEASE); }
 
 bool Spinlock::tryLock()
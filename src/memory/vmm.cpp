@@ -158,6 +158,28 @@ const char* regionTypeName(const VMM::RegionType type)
     }
 }
 
+uint64_t guardPages(const VMM::RegionNode* node)
+{
+    return node->region.type == VMM::RegionType::STACK && node->pageCount > VMM::STACK_GUARD_PAGES
+               ? VMM::STACK_GUARD_PAGES
+               : 0;
+}
+
+void releasePages(VMM::RegionNode* node)
+{
+    for (uint64_t i = 0; i < node->pageCount; ++i)
+    {
+        if (!node->pages[i]) continue;
+
+        Paging::unmap(node->region.base + i * FrameAllocator::SMALL_SIZE, FrameAllocator::SMALL_SIZE);
+        FrameAllocator::free(reinterpret_cast<void*>(node->pages[i]));
+        node->pages[i] = 0;
+    }
+
+    SlabAllocator::free(node->pages);
+    node->pages = nullptr;
+}
+
 bool remap(VMM::RegionNode* node, const PageFlags newFlags)
 {
     if (!node || !node->region.committed) return false;
@@ -166,7 +188,7 @@ bool remap(VMM::RegionNode* node, const PageFlags newFlags)
     const PageFlags mapFlags = newFlags | PageFlags::PRESENT;
 
     Paging::unmap(base, size);
-    for (uint64_t i = 0; i < pageCount; ++i)
+    for (uint64_t i = guardPages(node); i < pageCount; ++i)
     {
         const uint64_t phys = node->region.directMapped
                                   ? node->physicalBase + i * FrameAllocator::SMALL_SIZE
@@ -175,7 +197,7 @@ bool remap(VMM::RegionNode* node, const PageFlags newFlags)
                                   : 0;
         if (!phys || !Paging::map(base + i * FrameAllocator::SMALL_SIZE, phys, FrameAllocator::SMALL_SIZE, mapFlags))
         {
-            for (uint64_t j = 0; j < i; ++j)
+            for (uint64_t j = guardPages(node); j < i; ++j)
                 Paging::map(base + j * FrameAllocator::SMALL_SIZE,
                             node->region.directMapped
                                 ? node->physicalBase + j * FrameAllocator::SMALL_SIZE
@@ -272,23 +294,12 @@ bool VMM::commit(void* base)
     memset(node->pages, 0, node->pageCount * sizeof(uint64_t));
 
     const PageFlags mapFlags = region->flags | PageFlags::PRESENT;
-    uint64_t mappedPages = 0;
-
-    for (uint64_t i = 0; i < node->pageCount; ++i)
+    for (uint64_t i = guardPages(node); i < node->pageCount; ++i)
     {
-        void* frame = FrameAllocator::alloc();
+        void* frame = FrameAllocator::alloc(AllocFlags::ZEROED);
         if (!frame)
         {
-            for (uint64_t j = 0; j < mappedPages; ++j)
-            {
-                Paging::unmap(region->base + j * FrameAllocator::SMALL_SIZE, FrameAllocator::SMALL_SIZE);
-                if (node->pages[j]) FrameAllocator::free(reinterpret_cast<void*>(node->pages[j]));
-                node->pages[j] = 0;
-            }
-
-            SlabAllocator::free(node->pages);
-            node->pages = nullptr;
-
+            releasePages(node);
             return false;
         }
 
@@ -296,21 +307,11 @@ bool VMM::commit(void* base)
         if (!Paging::map(region->base + i * FrameAllocator::SMALL_SIZE, phys, FrameAllocator::SMALL_SIZE, mapFlags))
         {
             FrameAllocator::free(frame);
-            for (uint64_t j = 0; j < mappedPages; ++j)
-            {
-                Paging::unmap(region->base + j * FrameAllocator::SMALL_SIZE, FrameAllocator::SMALL_SIZE);
-                if (node->pages[j]) FrameAllocator::free(reinterpret_cast<void*>(node->pages[j]));
-                node->pages[j] = 0;
-            }
-
-            SlabAllocator::free(node->pages);
-            node->pages = nullptr;
-
+            releasePages(node);
             return false;
         }
 
         node->pages[i] = phys;
-        mappedPages++;
     }
 
     node->ownedPhysical = true;
@@ -347,7 +348,7 @@ bool VMM::map(void* virtualAddress, const uint64_t physicalAddress, uint64_t siz
 
     bool created = false;
     RegionNode* createdNode = nullptr;
-    Region* region = findRegion(virt, size);
+    Region* region = ::findRegion(virt, size);
 
     if (!region)
     {
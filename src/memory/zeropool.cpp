@@ -0,0 +1,165 @@
+#include <arch/x86_64/cpu.h>
+#include <core/limine.h>
+#include <drivers/serial.h>
+#include <memory/buddy.h>
+#include <memory/paging.h>
+#include <memory/spinlock.h>
+#include <memory/zeropool.h>
+#include <task/scheduler.h>
+
+constexpr uint32_t ZERO_POOL_CAPACITY = 256, ZERO_POOL_LOW_WATERMARK = 64;
+constexpr uint64_t ZERO_POOL_MIN_FREE_PAGES = 1024;
+constexpr int ZERO_WORKER_PRIORITY = 1;
+
+struct alignas(64) ZeroPoolState
+{
+    Spinlock lock;
+    uint64_t pages[ZERO_POOL_CAPACITY];
+    uint32_t count;
+    Task::Task* task;
+    bool sleeping;
+};
+
+extern limine_hhdm_request hhdm_request;
+extern Scheduler::Scheduler schedulers[SMP::MAX_CPUS];
+
+ZeroPoolState zeroPools[SMP::MAX_CPUS] = {};
+bool zeroPoolActive = false;
+
+void zeroWorkerSleep(ZeroPoolState* pool)
+{
+    {
+        LockGuard guard(pool->lock);
+        pool->sleeping = true;
+        pool->task->state = Task::TaskState::BLOCKED;
+    }
+
+    Task::taskYield();
+}
+
+void zeroWorkerMain(void* arg)
+{
+    auto* pool = static_cast<ZeroPoolState*>(arg);
+
+    while (true)
+    {
+        if (__atomic_load_n(&pool->count, __ATOMIC_RELAXED) >= ZERO_POOL_CAPACITY ||
+            BuddyAllocator::getFreePages() < ZERO_POOL_MIN_FREE_PAGES)
+        {
+            zeroWorkerSleep(pool);
+            continue;
+        }
+
+        const uint64_t page = BuddyAllocator::alloc(0);
+        if (!page)
+        {
+            zeroWorkerSleep(pool);
+            continue;
+        }
+
+        ZeroPool::zeroPages(page, 1);
+
+        bool stored = false;
+        {
+            LockGuard guard(pool->lock);
+            if (pool->count < ZERO_POOL_CAPACITY)
+            {
+                pool->pages[pool->count++] = page;
+                stored = true;
+            }
+        }
+
+        if (!stored) BuddyAllocator::free(page, 0);
+    }
+}
+
+bool ZeroPool::initCPU(const uint32_t cpuId)
+{
+    if (cpuId >= SMP::MAX_CPUS) return false;
+
+    ZeroPoolState& pool = zeroPools[cpuId];
+    if (pool.task) return true;
+
+    Task::Task* task = Task::taskCreate(zeroWorkerMain, &pool, ZERO_WORKER_PRIORITY);
+    if (!task)
+    {
+        Serial::printf("ZeroPool: Failed to create worker for CPU %u\n", cpuId);
+        return false;
+    }
+
+    {
+        LockGuard guard(pool.lock);
+        pool.task = task;
+        pool.sleeping = false;
+    }
+
+    __atomic_store_n(&zeroPoolActive, true, __ATOMIC_RELEASE);
+    Scheduler::addReady(&schedulers[cpuId], task);
+
+    return true;
+}
+
+uint64_t ZeroPool::take()
+{
+    if (!__atomic_load_n(&zeroPoolActive, __ATOMIC_ACQUIRE)) return 0;
+
+    const uint32_t cpuId = CPUManager::getCurrentCPUId();
+    ZeroPoolState& pool = zeroPools[cpuId];
+    uint64_t page = 0;
+    bool wake = false;
+    {
+        LockGuard guard(pool.lock);
+        if (pool.count) page = pool.pages[--pool.count];
+
+        if (pool.sleeping && pool.count < ZERO_POOL_LOW_WATERMARK)
+        {
+            pool.sleeping = false;
+            wake = true;
+        }
+    }
+
+    if (wake) Scheduler::addReady(&schedulers[cpuId], pool.task);
+    return page;
+}
+
+uint64_t ZeroPool::drain()
+{
+    uint64_t released = 0;
+
+    for (uint32_t i = 0; i < SMP::getCpuCount(); ++i)
+    {
+        ZeroPoolState& pool = zeroPools[i];
+        while (true)
+        {
+            uint64_t page;
+            {
+                LockGuard guard(pool.lock);
+                if (!pool.count) break;
+                page = pool.pages[--pool.count];
+            }
+
+            BuddyAllocator::free(page, 0);
+            ++released;
+        }
+    }
+
+    return released;
+}
+
+void ZeroPool::zeroPages(const uint64_t physical, const uint64_t count)
+{
+    auto* p = reinterpret_cast<uint64_t*>(physical + hhdm_request.response->offset);
+    const uint64_t* end = p + count * FrameAllocator::SMALL_SIZE / sizeof(uint64_t);
+
+    for (; p < end; p += 8)
+        asm volatile ("movnti %1, 0(%0)\n"
+            "movnti %1, 8(%0)\n"
+            "movnti %1, 16(%0)\n"
+            "movnti %1, 24(%0)\n"
+            "movnti %1, 32(%0)\n"
+            "movnti %1, 40(%0)\n"
+            "movnti %1, 48(%0)\n"
+            "movnti %1, 56(%0)" :: "r"(p), "r"(0ULL) : "memory");
+
+    asm volatile ("sfence" ::: "memory");
+}
@@ -0,0 +1,324 @@
+#include <arch/x86_64/cpu.h>
+#include <arch/x86_64/isr.h>
+#include <drivers/serial.h>
+#include <memory/slab.h>
+#include <memory/spinlock.h>
+#include <task/parallel.h>
+#include <task/scheduler.h>
+
+struct Job
+{
+    Parallel::TaskFn fn;
+    Parallel::RangeFn rangeFn;
+    void* arg;
+    Parallel::TaskGroup* group;
+    uint64_t begin, end, grain;
+};
+
+constexpr int64_t DEQUE_CAPACITY = 256;
+
+struct alignas(64) WorkDeque
+{
+    int64_t top;
+    alignas(64) int64_t bottom;
+    Job* jobs[DEQUE_CAPACITY];
+};
+
+struct alignas(64) PoolWorker
+{
+    Spinlock lock;
+    Task::Task* task;
+    bool sleeping;
+};
+
+extern Scheduler::Scheduler schedulers[SMP::MAX_CPUS];
+constexpr int POOL_WORKER_PRIORITY = 12;
+
+WorkDeque deques[SMP::MAX_CPUS] = {};
+PoolWorker poolWorkers[SMP::MAX_CPUS] = {};
+uint32_t idleWorkers = 0, poolSize = 0;
+
+uint64_t saveInterrupts()
+{
+    uint64_t rflags;
+    asm volatile ("pushfq\npopq %0" : "=r"(rflags) :: "memory");
+    Interrupt::disableInterrupts();
+
+    return rflags;
+}
+
+void restoreInterrupts(const uint64_t rflags) { asm volatile ("pushq %0\npopfq" :: "r"(rflags) : "memory"); }
+
+bool dequePush(WorkDeque& deque, Job* job)
+{
+    const int64_t b = __atomic_load_n(&deque.bottom, __ATOMIC_RELAXED);
+    const int64_t t = __atomic_load_n(&deque.top, __ATOMIC_ACQUIRE);
+    if (b - t >= DEQUE_CAPACITY) return false;
+
+    __atomic_store_n(&deque.jobs[b % DEQUE_CAPACITY], job, __ATOMIC_RELAXED);
+    __atomic_store_n(&deque.bottom, b + 1, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+Job* dequePop(WorkDeque& deque)
+{
+    const int64_t b = __atomic_load_n(&deque.bottom, __ATOMIC_RELAXED) - 1;
+    __atomic_store_n(&deque.bottom, b, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    int64_t t = __atomic_load_n(&deque.top, __ATOMIC_RELAXED);
+    if (t > b)
+    {
+        __atomic_store_n(&deque.bottom, b + 1, __ATOMIC_RELAXED);
+        return nullptr;
+    }
+
+    Job* job = __atomic_load_n(&deque.jobs[b % DEQUE_CAPACITY], __ATOMIC_RELAXED);
+    if (t == b)
+    {
+        if (!__atomic_compare_exchange_n(&deque.top, &t, t + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+            job = nullptr;
+        __atomic_store_n(&deque.bottom, b + 1, __ATOMIC_RELAXED);
+    }
+
+    return job;
+}
+
+Job* dequeSteal(WorkDeque& deque)
+{
+    int64_t t = __atomic_load_n(&deque.top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    const int64_t b = __atomic_load_n(&deque.bottom, __ATOMIC_ACQUIRE);
+    if (t >= b) return nullptr;
+
+    Job* job = __atomic_load_n(&deque.jobs[t % DEQUE_CAPACITY], __ATOMIC_RELAXED);
+    if (!__atomic_compare_exchange_n(&deque.top, &t, t + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+        return nullptr;
+
+    return job;
+}
+
+bool pushLocal(Job* job)
+{
+    const uint64_t rflags = saveInterrupts();
+    const bool pushed = dequePush(deques[CPUManager::getCurrentCPUId()], job);
+    restoreInterrupts(rflags);
+
+    return pushed;
+}
+
+Job* popLocal()
+{
+    const uint64_t rflags = saveInterrupts();
+    Job* job = dequePop(deques[CPUManager::getCurrentCPUId()]);
+    restoreInterrupts(rflags);
+
+    return job;
+}
+
+Job* findJob()
+{
+    if (Job* job = popLocal()) return job;
+
+    const uint32_t self = CPUManager::getCurrentCPUId(), count = SMP::getCpuCount();
+    for (uint32_t i = 1; i < count; ++i)
+        if (Job* job = dequeSteal(deques[(self + i) % count])) return job;
+
+    return nullptr;
+}
+
+bool anyJobQueued()
+{
+    for (uint32_t i = 0; i < SMP::getCpuCount(); ++i)
+    {
+        const WorkDeque& deque = deques[i];
+        if (__atomic_load_n(&deque.top, __ATOMIC_ACQUIRE) < __atomic_load_n(&deque.bottom, __ATOMIC_ACQUIRE))
+            return true;
+    }
+
+    return false;
+}
+
+void wakeWorker()
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (!__atomic_load_n(&idleWorkers, __ATOMIC_RELAXED)) return;
+
+    const uint32_t self = CPUManager::getCurrentCPUId(), count = SMP::getCpuCount();
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const uint32_t cpuId = (self + i) % count;
+        PoolWorker& worker = poolWorkers[cpuId];
+        if (!worker.task || !__atomic_load_n(&worker.sleeping, __ATOMIC_RELAXED)) continue;
+
+        {
+            LockGuard guard(worker.lock);
+            if (!worker.sleeping) continue;
+
+            worker.sleeping = false;
+            __atomic_sub_fetch(&idleWorkers, 1, __ATOMIC_SEQ_CST);
+        }
+
+        Scheduler::addReady(&schedulers[cpuId], worker.task);
+        return;
+    }
+}
+
+void runRange(Job* job);
+
+void runJob(Job* job)
+{
+    if (job->rangeFn) runRange(job);
+    else job->fn(job->arg);
+
+    if (job->group) __atomic_sub_fetch(&job->group->pending, 1, __ATOMIC_RELEASE);
+    SlabAllocator::free(job);
+}
+
+bool submitJob(Job* job)
+{
+    if (job->group) __atomic_add_fetch(&job->group->pending, 1, __ATOMIC_RELAXED);
+    if (pushLocal(job))
+    {
+        wakeWorker();
+        return true;
+    }
+
+    if (job->group) __atomic_sub_fetch(&job->group->pending, 1, __ATOMIC_RELAXED);
+    return false;
+}
+
+void runRange(Job* job)
+{
+    uint64_t end = job->end;
+    while (end - job->begin > job->grain)
+    {
+        const uint64_t mid = job->begin + (end - job->begin) / 2;
+
+        auto* half = static_cast<Job*>(SlabAllocator::alloc(sizeof(Job), alignof(Job)));
+        if (!half) break;
+
+        *half = {nullptr, job->rangeFn, job->arg, job->group, mid, end, job->grain};
+        if (!submitJob(half))
+        {
+            SlabAllocator::free(half);
+            break;
+        }
+
+        end = mid;
+    }
+
+    job->rangeFn(job->begin, end, job->arg);
+}
+
+void poolWorkerMain(void* arg)
+{
+    auto* worker = static_cast<PoolWorker*>(arg);
+
+    while (true)
+    {
+        if (Job* job = findJob())
+        {
+            runJob(job);
+            continue;
+        }
+
+        {
+            LockGuard guard(worker->lock);
+
+            worker->sleeping = true;
+            __atomic_add_fetch(&idleWorkers, 1, __ATOMIC_SEQ_CST);
+
+            if (anyJobQueued())
+            {
+                worker->sleeping = false;
+                __atomic_sub_fetch(&idleWorkers, 1, __ATOMIC_SEQ_CST);
+                continue;
+            }
+
+            worker->task->state = Task::TaskState::BLOCKED;
+        }
+
+        Task::taskYield();
+    }
+}
+
+bool Parallel::initCPU(const uint32_t cpuId)
+{
+    if (cpuId >= SMP::MAX_CPUS) return false;
+
+    PoolWorker& worker = poolWorkers[cpuId];
+    if (worker.task) return true;
+
+    Task::Task* task = Task::taskCreate(poolWorkerMain, &worker, POOL_WORKER_PRIORITY);
+    if (!task)
+    {
+        Serial::printf("Parallel: Failed to create worker for CPU %u\n", cpuId);
+        return false;
+    }
+
+    {
+        LockGuard guard(worker.lock);
+        worker.task = task;
+        worker.sleeping = false;
+    }
+
+    __atomic_add_fetch(&poolSize, 1, __ATOMIC_RELAXED);
+    Scheduler::addReady(&schedulers[cpuId], task);
+
+    return true;
+}
+
+void Parallel::spawn(TaskGroup* group, const TaskFn fn, void* arg)
+{
+    if (!fn) return;
+
+    auto* job = static_cast<Job*>(SlabAllocator::alloc(sizeof(Job), alignof(Job)));
+    if (!job)
+    {
+        fn(arg);
+        return;
+    }
+
+    *job = {fn, nullptr, arg, group, 0, 0, 0};
+    if (submitJob(job)) return;
+
+    SlabAllocator::free(job);
+    fn(arg);
+}
+
+void Parallel::join(TaskGroup* group)
+{
+    if (!group) return;
+
+    while (__atomic_load_n(&group->pending, __ATOMIC_ACQUIRE))
+    {
+        if (Job* job = findJob())
+        {
+            runJob(job);
+            continue;
+        }
+
+        if (Interrupt::interruptsEnabled()) Task::taskYield();
+        else asm volatile ("pause");
+    }
+}
+
+void Parallel::parallelFor(const uint64_t begin, const uint64_t end, uint64_t grain, const RangeFn fn, void* arg)
+{
+    if (!fn || begin >= end) return;
+
+    if (grain == 0)
+    {
+        const uint64_t workers = __atomic_load_n(&poolSize, __ATOMIC_RELAXED);
+        grain = (end - begin) / ((workers ? workers : 1) * 8);
+        if (grain == 0) grain = 1;
+    }
+
+    TaskGroup group = {};
+    Job root = {nullptr, fn, arg, &group, begin, end, grain};
+
+    runRange(&root);
+    join(&group);
+}
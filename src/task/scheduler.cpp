@@ -1,6 +1,11 @@
 #include <arch/x86_64/cpu.h>
+#include <arch/x86_64/ipi.h>
 #include <arch/x86_64/isr.h>
 #include <arch/x86_64/lapic.h>
+#include <core/profiler.h>
+#include <core/stats.h>
+#include <core/trace.h>
+#include <task/softirq.h>
 #include <task/scheduler.h>
 
 Scheduler::Scheduler schedulers[SMP::MAX_CPUS];
@@ -51,6 +56,42 @@ void reapDead(Scheduler::Scheduler* scheduler, const Task::Task* current)
     }
 }
 
+void wakeSleepers(Scheduler::Scheduler* scheduler)
+{
+    const uint64_t now = LAPIC::timerGetTicks();
+    Task::Task* woken = nullptr;
+    {
+        LockGuard schedulerLock(scheduler->lock);
+        Task::Task** link = &scheduler->sleepHead;
+
+        while (Task::Task* task = *link)
+        {
+            if (task->wakeTick > now)
+            {
+                link = &task->next;
+                continue;
+            }
+
+            *link = task->next;
+            task->next = woken;
+            woken = task;
+        }
+    }
+
+    while (woken)
+    {
+        Task::Task* task = woken;
+        woken = task->next;
+        Scheduler::addReady(scheduler, task);
+    }
+}
+
+void saveContext(Interrupt::TimerFrame* frame)
+{
+    if (CPU* cpu = CPUManager::getCurrentCPU(); cpu && cpu->currentTask && !cpu->preemptCount)
+        cpu->currentTask->context = reinterpret_cast<uint64_t>(frame);
+}
+
 void Scheduler::initCPU(Scheduler* scheduler, Task::Task* idleTask)
 {
     if (!scheduler || !idleTask) return;
@@ -66,16 +107,39 @@ void Scheduler::initCPU(Scheduler* scheduler, Task::Task* idleTask)
 void Scheduler::addReady(Scheduler* scheduler, Task::Task* task)
 {
     if (!scheduler || !task) return;
-    LockGuard schedulerLock(scheduler->lock);
-    if (task == scheduler->idleTask || task->state == Task::TaskState::DEAD || task->queued) return;
 
-    const int p = task->priority;
-    RunQueue& queue = scheduler->queues[p];
+    {
+        LockGuard schedulerLock(scheduler->lock);
+        if (task == scheduler->idleTask || task->state == Task::TaskState::DEAD || task->queued) return;
+
+        const int p = task->priority;
+        RunQueue& queue = scheduler->queues[p];
+
+        task->queued = true;
+        push(queue, task);
+        scheduler->bitmap |= 1u << p;
+        task->state = Task::TaskState::READY;
+
+        if (task->ownedCpuId != scheduler->cpuId)
+        {
+            Trace::point(Trace::Event::SCHED_MIGRATE, task->id, task->ownedCpuId, scheduler->cpuId);
+            task->ownedCpuId = scheduler->cpuId;
+        }
+        Trace::point(Trace::Event::SCHED_WAKE, task->id, static_cast<uint64_t>(p), scheduler->cpuId);
+    }
 
-    task->queued = true;
-    push(queue, task);
-    scheduler->bitmap |= 1u << p;
-    task->state = Task::TaskState::READY;
+    if (scheduler->cpuId != CPUManager::getCurrentCPUId()) IPI::sendReschedule(scheduler->cpuId);
+}
+
+void Scheduler::addSleeping(Scheduler* scheduler, Task::Task* task, const uint64_t wakeTick)
+{
+    if (!scheduler || !task || task == scheduler->idleTask) return;
+
+    LockGuard schedulerLock(scheduler->lock);
+    task->state = Task::TaskState::SLEEPING;
+    task->wakeTick = wakeTick;
+    task->next = scheduler->sleepHead;
+    scheduler->sleepHead = task;
 }
 
 Task::Task* Scheduler::pickNextTask(Scheduler* scheduler)
@@ -101,11 +165,14 @@ uint64_t Scheduler::onTimerIRQ(Scheduler* scheduler)
         return 0;
     }
 
-    LAPIC::timerIrq();
+    if (cpu->id == 0) LAPIC::timerIrq();
     LAPIC::sendEOI();
+    Softirq::run();
+    if (cpu->preemptCount) return 0;
 
     Task::Task* current = cpu->currentTask;
     reapDead(scheduler, current);
+    wakeSleepers(scheduler);
     if (!current) return 0;
 
     if (current != scheduler->idleTask && current->state == Task::TaskState::RUNNING)
@@ -119,8 +186,14 @@ uint64_t Scheduler::onTimerIRQ(Scheduler* scheduler)
 
     Task::Task* next = pickNextTask(scheduler);
     if (!next) next = scheduler->idleTask;
-    if (next == current) return 0;
+    if (next == current)
+    {
+        current->state = Task::TaskState::RUNNING;
+        return 0;
+    }
 
+    Trace::point(Trace::Event::SCHED_SWITCH, current->id, next->id, static_cast<uint32_t>(current->state));
+    Stats::add(Stats::CONTEXT_SWITCHES);
     cpu->currentTask = next;
     scheduler->currentTask = next;
     next->state = Task::TaskState::RUNNING;
@@ -133,7 +206,7 @@ uint64_t Scheduler::onTimerIRQ(Scheduler* scheduler)
 uint64_t Scheduler::onYieldIRQ(Scheduler* scheduler)
 {
     CPU* cpu = CPUManager::getCurrentCPU();
-    if (!cpu || !cpu->scheduler || !cpu->schedulerReady) return 0;
+    if (!cpu || !cpu->scheduler || !cpu->schedulerReady || cpu->preemptCount) return 0;
 
     Task::Task* current = cpu->currentTask;
     reapDead(scheduler, current);
@@ -143,8 +216,14 @@ uint64_t Scheduler::onYieldIRQ(Scheduler* scheduler)
 
     Task::Task* next = pickNextTask(scheduler);
     if (!next) next = scheduler->idleTask;
-    if (next == current) return 0;
+    if (next == current)
+    {
+        current->state = Task::TaskState::RUNNING;
+        return 0;
+    }
 
+    Trace::point(Trace::Event::SCHED_SWITCH, current->id, next->id, static_cast<uint32_t>(current->state));
+    Stats::add(Stats::CONTEXT_SWITCHES);
     cpu->currentTask = next;
     scheduler->currentTask = next;
     next->state = Task::TaskState::RUNNING;
@@ -154,12 +233,36 @@ uint64_t Scheduler::onYieldIRQ(Scheduler* scheduler)
 
 extern "C" Task::Task* schedulerGetCurrentTask() { return CPUManager::getCurrentCPU()->currentTask; }
 
-extern "C" uint64_t schedulerTimerIRQ(Interrupt::TimerFrame*)
+extern "C" uint64_t schedulerTimerIRQ(Interrupt::TimerFrame* frame)
 {
-    return Scheduler::onTimerIRQ(CPUManager::getCurrentCPU()->scheduler);
+    Trace::point(Trace::Event::IRQ_ENTRY, 0x22);
+    Stats::add(Stats::IRQS + 0x22);
+    saveContext(frame);
+    Profiler::sample(frame);
+
+    const uint64_t next = Scheduler::onTimerIRQ(CPUManager::getCurrentCPU()->scheduler);
+    Trace::point(Trace::Event::IRQ_EXIT, 0x22);
+
+    return next;
 }
 
-extern "C" uint64_t schedulerYieldIRQ(Interrupt::TimerFrame*)
+extern "C" uint64_t schedulerYieldIRQ(Interrupt::TimerFrame* frame)
 {
+    Stats::add(Stats::IRQS + 0x80);
+    saveContext(frame);
     return Scheduler::onYieldIRQ(CPUManager::getCurrentCPU()->scheduler);
 }
+
+extern "C" uint64_t schedulerRescheduleIRQ(Interrupt::TimerFrame* frame)
+{
+    Trace::point(Trace::Event::IRQ_ENTRY, IPI::VECTOR_RESCHEDULE);
+    Stats::add(Stats::IRQS + IPI::VECTOR_RESCHEDULE);
+    IPI::acknowledgeReschedule();
+    LAPIC::sendEOI();
+
+    saveContext(frame);
+    const uint64_t next = Scheduler::onYieldIRQ(CPUManager::getCurrentCPU()->scheduler);
+    Trace::point(Trace::Event::IRQ_EXIT, IPI::VECTOR_RESCHEDULE);
+
+    return next;
+}
@@ -0,0 +1,58 @@
+#include <arch/x86_64/cpu.h>
+#include <arch/x86_64/isr.h>
+#include <task/softirq.h>
+
+struct alignas(64) SoftirqState
+{
+    uint32_t pending;
+    bool running;
+};
+
+constexpr int MAX_RESTARTS = 8;
+
+SoftirqState softirqStates[SMP::MAX_CPUS] = {};
+Softirq::Handler softirqHandlers[static_cast<size_t>(Softirq::Type::COUNT)] = {};
+
+void Softirq::setHandler(const Type type, const Handler handler)
+{
+    if (type >= Type::COUNT) return;
+    softirqHandlers[static_cast<size_t>(type)] = handler;
+}
+
+void Softirq::raise(const Type type)
+{
+    if (type >= Type::COUNT) return;
+    __atomic_or_fetch(&softirqStates[CPUManager::getCurrentCPUId()].pending, 1u << static_cast<uint32_t>(type),
+                      __ATOMIC_RELEASE);
+}
+
+void Softirq::run()
+{
+    CPU* cpu = CPUManager::getCurrentCPU();
+    SoftirqState& state = softirqStates[cpu->id];
+    if (state.running || !__atomic_load_n(&state.pending, __ATOMIC_ACQUIRE)) return;
+
+    const bool wasEnabled = Interrupt::interruptsEnabled();
+    state.running = true;
+    ++cpu->preemptCount;
+
+    for (int restart = 0; restart < MAX_RESTARTS; ++restart)
+    {
+        uint32_t pending = __atomic_exchange_n(&state.pending, 0, __ATOMIC_ACQ_REL);
+        if (!pending) break;
+
+        Interrupt::enableInterrupts();
+        while (pending)
+        {
+            const int type = __builtin_ctz(pending);
+            pending &= pending - 1;
+
+            if (const Handler handler = softirqHandlers[type]) handler();
+        }
+        Interrupt::disableInterrupts();
+    }
+
+    --cpu->preemptCount;
+    state.running = false;
+    if (wasEnabled) Interrupt::enableInterrupts();
+}
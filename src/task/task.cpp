@@ -1,5 +1,6 @@
 #include <arch/x86_64/cpu.h>
 #include <arch/x86_64/isr.h>
+#include <arch/x86_64/lapic.h>
 #include <memory/atomic.h>
 #include <memory/slab.h>
 #include <memory/vmm.h>
@@ -69,7 +70,8 @@ Task::Task* Task::taskCreate(void (*entry)(void*), void* arg, int priority)
     t->prev = nullptr;
     t->kernelStackSize = 16384;
 
-    void* stackRegion = VMM::reserve(t->kernelStackSize + FrameAllocator::SMALL_SIZE, VMM::RegionType::STACK,
+    const uint64_t guardSize = VMM::STACK_GUARD_PAGES * FrameAllocator::SMALL_SIZE;
+    void* stackRegion = VMM::reserve(t->kernelStackSize + guardSize, VMM::RegionType::STACK,
                                      PageFlags::RW | PageFlags::GLOBAL | PageFlags::NO_EXECUTE);
     if (!stackRegion)
     {
@@ -77,8 +79,7 @@ Task::Task* Task::taskCreate(void (*entry)(void*), void* arg, int priority)
         return nullptr;
     }
 
-    const uint64_t usableBase = reinterpret_cast<uint64_t>(stackRegion) + FrameAllocator::SMALL_SIZE;
-    if (!VMM::commit(reinterpret_cast<void*>(usableBase)))
+    if (!VMM::commit(stackRegion))
     {
         VMM::unmap(stackRegion);
         SlabAllocator::free(t);
@@ -86,6 +87,8 @@ Task::Task* Task::taskCreate(void (*entry)(void*), void* arg, int priority)
         return nullptr;
     }
 
+    const uint64_t usableBase = reinterpret_cast<uint64_t>(stackRegion) + guardSize;
+
     t->kernelStackBase = reinterpret_cast<uint64_t>(stackRegion);
     t->kernelStackTop = usableBase + t->kernelStackSize;
 
@@ -97,6 +100,8 @@ Task::Task* Task::taskCreate(void (*entry)(void*), void* arg, int priority)
     frame->rip = reinterpret_cast<uint64_t>(taskStart);
     frame->cs = 0x08;
     frame->rflags = 0x202;
+    frame->rsp = (t->kernelStackTop & ~0xFULL) - 8;
+    frame->ss = 0x10;
 
     t->context = sp;
     return t;
@@ -111,3 +116,17 @@ void Task::taskDestroy(Task* task)
 }
 
 void Task::taskYield() { asm volatile ("int $0x80" ::: "memory"); }
+
+void Task::taskSleep(const uint64_t ms)
+{
+    const CPU* cpu = CPUManager::getCurrentCPU();
+    Task* current = cpu->currentTask;
+    if (!current || !cpu->timerReady || current == cpu->scheduler->idleTask)
+    {
+        LAPIC::sleepMs(ms);
+        return;
+    }
+
+    Scheduler::addSleeping(cpu->scheduler, current, LAPIC::timerGetTicks() + ms);
+    taskYield();
+}
@@ -0,0 +1,111 @@
+#include <arch/x86_64/cpu.h>
+#include <drivers/serial.h>
+#include <memory/slab.h>
+#include <memory/spinlock.h>
+#include <task/scheduler.h>
+#include <task/workqueue.h>
+
+struct Work
+{
+    WorkQueue::WorkFn fn;
+    void* arg;
+    Work* next;
+};
+
+struct alignas(64) Worker
+{
+    Spinlock lock;
+    Work *head, *tail;
+    Task::Task* task;
+    bool sleeping;
+};
+
+extern Scheduler::Scheduler schedulers[SMP::MAX_CPUS];
+constexpr int WORKER_PRIORITY = 16;
+
+Worker workers[SMP::MAX_CPUS] = {};
+
+void workerMain(void* arg)
+{
+    auto* worker = static_cast<Worker*>(arg);
+
+    while (true)
+    {
+        Work* work;
+        {
+            LockGuard guard(worker->lock);
+
+            work = worker->head;
+            if (work)
+            {
+                worker->head = work->next;
+                if (!worker->head) worker->tail = nullptr;
+            }
+            else
+            {
+                worker->sleeping = true;
+                worker->task->state = Task::TaskState::BLOCKED;
+            }
+        }
+
+        if (!work)
+        {
+            Task::taskYield();
+            continue;
+        }
+
+        work->fn(work->arg);
+        SlabAllocator::free(work);
+    }
+}
+
+bool WorkQueue::initCPU(const uint32_t cpuId)
+{
+    if (cpuId >= SMP::MAX_CPUS) return false;
+
+    Worker& worker = workers[cpuId];
+    if (worker.task) return true;
+
+    Task::Task* task = Task::taskCreate(workerMain, &worker, WORKER_PRIORITY);
+    if (!task)
+    {
+        Serial::printf("WorkQueue: Failed to create worker for CPU %u\n", cpuId);
+        return false;
+    }
+
+    {
+        LockGuard guard(worker.lock);
+        worker.task = task;
+        worker.sleeping = false;
+    }
+
+    Scheduler::addReady(&schedulers[cpuId], task);
+    return true;
+}
+
+bool WorkQueue::queueWork(const WorkFn fn, void* arg) { return queueWorkOn(CPUManager::getCurrentCPUId(), fn, arg); }
+
+bool WorkQueue::queueWorkOn(const uint32_t cpuId, const WorkFn fn, void* arg)
+{
+    if (!fn || cpuId >= SMP::MAX_CPUS || !workers[cpuId].task) return false;
+
+    auto* work = static_cast<Work*>(SlabAllocator::alloc(sizeof(Work), alignof(Work)));
+    if (!work) return false;
+    *work = {fn, arg, nullptr};
+
+    Worker& worker = workers[cpuId];
+    bool wake = false;
+    {
+        LockGuard guard(worker.lock);
+
+        if (worker.tail) worker.tail->next = work;
+        else worker.head = work;
+        worker.tail = work;
+
+        wake = worker.sleeping;
+        worker.sleeping = false;
+    }
+
+    if (wake) Scheduler::addReady(&schedulers[cpuId], worker.task);
+    return true;
+}